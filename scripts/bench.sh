@@ -0,0 +1,152 @@
+#!/bin/bash
+# ==============================================================================
+#  bench.sh - Avvia il kernel in modalità benchmark sotto QEMU, senza display
+#
+#  Parte dall'immagine di "make build", ne fa una copia con "bench" aggiunto
+#  alla command line di limine.conf e la avvia con il dispositivo
+#  isa-debug-exit: il kernel esegue la suite (klib/bench), scrive una riga
+#  JSON per benchmark sulla seriale e termina QEMU con il proprio stato.
+#
+#  Uso:
+#    scripts/bench.sh [-o risultati.jsonl] [-b baseline.jsonl] [-s nomi]
+#                     [-r esecuzioni] [-t soglia%] [-T timeout_s]
+#
+#    -o  file dei risultati (default .build/bench.jsonl)
+#    -b  baseline da confrontare: regressioni oltre la soglia -> uscita 1
+#    -s  benchmark da eseguire, separati da virgola (default: tutti)
+#    -r  esecuzioni misurate per benchmark (bench_runs=)
+#    -t  soglia di regressione in percento sui cicli mediani (default 5)
+#    -T  timeout di QEMU in secondi (default 300)
+#
+#  Per creare una baseline basta conservare un file dei risultati:
+#    scripts/bench.sh -o baseline.jsonl
+#
+#  Uscita: 0 ok, 1 regressioni, 2 benchmark falliti o QEMU non terminato
+#  dal kernel.
+# ==============================================================================
+set -e
+
+SCRIPT_DIR="$(cd -- "$(dirname -- "${BASH_SOURCE[0]}")" &> /dev/null && pwd)"
+PROJECT_ROOT="$(realpath "$SCRIPT_DIR/..")"
+IMG="$PROJECT_ROOT/.build/kernel.img"
+CODE="$PROJECT_ROOT/boot/OVMF_CODE.fd"
+CONF="$PROJECT_ROOT/boot/limine.conf"
+OFFSET=$((2048 * 512)) # Partizione ESP a 1 MiB (vedi build.sh)
+
+OUT="$PROJECT_ROOT/.build/bench.jsonl"
+BASELINE=""
+SELECT=""
+RUNS=""
+THRESHOLD=5
+TIMEOUT=300
+
+while getopts "o:b:s:r:t:T:" opt; do
+  case "$opt" in
+    o) OUT="$OPTARG" ;;
+    b) BASELINE="$OPTARG" ;;
+    s) SELECT="$OPTARG" ;;
+    r) RUNS="$OPTARG" ;;
+    t) THRESHOLD="$OPTARG" ;;
+    T) TIMEOUT="$OPTARG" ;;
+    *) sed -n '2,26p' "$0"; exit 2 ;;
+  esac
+done
+
+if [[ ! -f "$IMG" ]]; then
+  echo "❌ Immagine $IMG non trovata. Esegui prima: make build"
+  exit 2
+fi
+if [[ ! -f "$CODE" ]]; then
+  echo "❌ OVMF_CODE.fd non trovato in: $CODE"
+  exit 2
+fi
+if [[ -n "$BASELINE" && ! -f "$BASELINE" ]]; then
+  echo "❌ Baseline $BASELINE non trovata"
+  exit 2
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+# === Immagine con la command line di benchmark ===
+ARGS="bench"
+[[ -n "$SELECT" ]] && ARGS="bench=$SELECT"
+[[ -n "$RUNS" ]] && ARGS="$ARGS bench_runs=$RUNS"
+
+cp "$IMG" "$WORK/kernel.img"
+sed -E "s/^([[:space:]]*cmdline:.*)$/\1 $ARGS/" "$CONF" > "$WORK/limine.conf"
+mcopy -o -i "$WORK/kernel.img"@@$OFFSET "$WORK/limine.conf" ::/boot/limine.conf
+
+# === Esecuzione ===
+echo "▶️ Benchmark in QEMU ($ARGS)..."
+set +e
+timeout "$TIMEOUT" qemu-system-x86_64 \
+  -m 512M \
+  -machine q35 \
+  -drive format=raw,file="$WORK/kernel.img" \
+  -bios "$CODE" \
+  -display none \
+  -serial file:"$WORK/serial.log" \
+  -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+  -no-reboot
+QEMU_RC=$?
+set -e
+
+# isa-debug-exit: codice di QEMU = (stato << 1) | 1. Pari = il kernel non ha scritto
+if (( QEMU_RC % 2 == 0 )); then
+  echo "❌ QEMU terminato senza isa-debug-exit (codice $QEMU_RC, timeout ${TIMEOUT}s?)"
+  exit 2
+fi
+STATUS=$(( QEMU_RC >> 1 ))
+
+mkdir -p "$(dirname "$OUT")"
+awk '/^# bench-begin/ { on = 1; next } /^# bench-end/ { on = 0 } on && /^\{/' "$WORK/serial.log" | tr -d '\r' > "$OUT"
+echo "[✓] $(wc -l < "$OUT") risultati in $OUT (stato del kernel: $STATUS)"
+
+# === Confronto con la baseline ===
+RC=0
+if [[ -n "$BASELINE" ]]; then
+  set +e
+  awk -v threshold="$THRESHOLD" '
+    BEGIN { regressions = 0 }
+    function field(line, key,    re) {
+      re = "\"" key "\":[0-9]+"
+      if (!match(line, re)) return ""
+      return substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 3)
+    }
+    function name_of(line) {
+      if (!match(line, /"name":"[^"]*"/)) return ""
+      return substr(line, RSTART + 8, RLENGTH - 9)
+    }
+    function per_op(line,    iters) {
+      iters = field(line, "iters")
+      return iters > 0 ? field(line, "cycles_median") / iters : 0
+    }
+    FNR == NR { base[name_of($0)] = per_op($0); next }
+    {
+      name = name_of($0)
+      cur = per_op($0)
+      if (!(name in base) || base[name] == 0) {
+        printf "%-20s %12s %12.1f   nuovo\n", name, "-", cur
+        next
+      }
+      delta = (cur - base[name]) * 100 / base[name]
+      mark = delta > threshold ? "  REGRESSIONE" : (delta < -threshold ? "  miglioramento" : "")
+      printf "%-20s %12.1f %12.1f %+7.1f%%%s\n", name, base[name], cur, delta, mark
+      if (delta > threshold) regressions++
+    }
+    END {
+      if (regressions) { printf "%d regressioni oltre il %s%%\n", regressions, threshold; exit 1 }
+    }
+  ' "$BASELINE" "$OUT" > "$WORK/compare.txt"
+  [[ $? -ne 0 ]] && RC=1
+  set -e
+  printf "%-20s %12s %12s %8s\n" "benchmark" "base cy/op" "cy/op" "delta"
+  cat "$WORK/compare.txt"
+fi
+
+if (( STATUS != 0 )); then
+  echo "❌ Benchmark falliti (vedi le righe con \"ok\":false in $OUT)"
+  exit 2
+fi
+exit $RC
@@ -0,0 +1,103 @@
+#!/bin/bash
+# Usage: ./scripts/gen_ksyms.sh <kernel.elf> > ksyms.S
+#
+# Genera la tabella dei simboli del kernel (vedi klib/ksym/ksym.h) a partire
+# dai simboli di testo dell'ELF, come sorgente GAS per la sezione .ksymtab.
+#
+# Formato:
+# - ksym_offsets:  offset u32 da _text_start, ordinati e senza duplicati
+# - ksym_names:    nomi in "front coding": per ogni simbolo un byte con la
+#                  lunghezza del prefisso in comune col nome precedente, un
+#                  byte con la lunghezza del resto e il resto
+# - ksym_restarts: ogni KSYM_INTERVAL simboli il nome è scritto per intero
+#                  e se ne registra la posizione, così la decodifica parte
+#                  dal punto di restart più vicino
+#
+# Gli indirizzi sono ordinati, quindi i nomi adiacenti appartengono allo
+# stesso file sorgente e condividono spesso il prefisso (pmm_, vmm_, ...).
+set -e
+
+ELF="$1"
+NM="${NM:-nm}"
+KSYM_INTERVAL=16
+
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+  echo "gen_ksyms: ELF non trovato: $ELF" >&2
+  exit 1
+fi
+
+"$NM" -n --defined-only "$ELF" | awk -v interval="$KSYM_INTERVAL" '
+function hex_low32(h,    v, i, c) {
+  v = 0
+  h = tolower(h)
+  if (length(h) > 8)
+    h = substr(h, length(h) - 7)
+  for (i = 1; i <= length(h); i++) {
+    c = index("0123456789abcdef", substr(h, i, 1)) - 1
+    v = v * 16 + c
+  }
+  return v
+}
+
+BEGIN { count = 0 }
+
+$3 == "_text_start" { base = hex_low32($1); have_base = 1; next }
+$3 == "_text_end" || $3 == "_kernel_start" { next }
+NF == 3 && ($2 == "T" || $2 == "t" || $2 == "W") && $3 !~ /^\.L/ {
+  addr = hex_low32($1)
+  if (count > 0 && addr == addrs[count - 1])
+    next
+  addrs[count] = addr
+  names[count] = substr($3, 1, 255)
+  count++
+}
+
+END {
+  if (!have_base) {
+    print "gen_ksyms: _text_start non trovato" > "/dev/stderr"
+    exit 1
+  }
+
+  print "/* Generato da scripts/gen_ksyms.sh: non modificare */"
+  print "  .section .ksymtab, \"a\""
+  print "  .balign 4"
+  print "  .globl ksym_count, ksym_interval, ksym_offsets, ksym_restarts, ksym_names"
+  print "ksym_count:"
+  printf "  .long %d\n", count
+  print "ksym_interval:"
+  printf "  .long %d\n", interval
+
+  print "ksym_offsets:"
+  for (i = 0; i < count; i++) {
+    off = addrs[i] - base
+    if (off < 0)
+      off += 4294967296
+    printf "  .long 0x%08x\n", off
+  }
+
+  pos = 0
+  prev = ""
+  for (i = 0; i < count; i++) {
+    name = names[i]
+    shared = 0
+    if (i % interval == 0) {
+      restarts[i / interval] = pos
+    } else {
+      max = length(prev) < length(name) ? length(prev) : length(name)
+      while (shared < max && substr(prev, shared + 1, 1) == substr(name, shared + 1, 1))
+        shared++
+    }
+    rest = substr(name, shared + 1)
+    encoded[i] = sprintf("  .byte %d, %d\n  .ascii \"%s\"", shared, length(rest), rest)
+    pos += 2 + length(rest)
+    prev = name
+  }
+
+  print "ksym_restarts:"
+  for (r = 0; r * interval < count; r++)
+    printf "  .long %d\n", restarts[r]
+
+  print "ksym_names:"
+  for (i = 0; i < count; i++)
+    print encoded[i]
+}'
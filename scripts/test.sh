@@ -0,0 +1,61 @@
+#!/bin/bash
+# ==============================================================================
+#  test.sh - Compila ed esegue i test host (tests/host) con il cc dell'host
+#
+#  Ogni tests/host/<nome>_test.c viene compilato insieme al sorgente del
+#  kernel che verifica, indicato nella tabella SOURCES qui sotto, con gli
+#  header di src/kernel. Niente QEMU né toolchain cross: solo codice klib
+#  che non dipende dall'hardware.
+#
+#  Uso:
+#    scripts/test.sh [nomi...]     (default: tutti i test in tabella)
+#
+#  Uscita: 0 se tutti i test passano, 1 altrimenti.
+# ==============================================================================
+set -e
+
+SCRIPT_DIR="$(cd -- "$(dirname -- "${BASH_SOURCE[0]}")" &> /dev/null && pwd)"
+PROJECT_ROOT="$(realpath "$SCRIPT_DIR/..")"
+KERNEL="$PROJECT_ROOT/src/kernel"
+OUT_DIR="$PROJECT_ROOT/.build/tests"
+CC="${CC:-cc}"
+CFLAGS="-std=c11 -O2 -g -Wall -Wextra -Werror -I$KERNEL"
+
+# Test -> sorgenti del kernel da compilare con esso
+declare -A SOURCES=(
+  [rbtree]="klib/rbtree/rbtree.c"
+)
+
+TESTS=("$@")
+if [[ ${#TESTS[@]} -eq 0 ]]; then
+  TESTS=("${!SOURCES[@]}")
+fi
+
+mkdir -p "$OUT_DIR"
+FAILED=0
+
+for name in "${TESTS[@]}"; do
+  if [[ -z "${SOURCES[$name]}" ]]; then
+    echo "❌ Test sconosciuto: $name"
+    FAILED=1
+    continue
+  fi
+
+  srcs=()
+  for src in ${SOURCES[$name]}; do
+    srcs+=("$KERNEL/$src")
+  done
+
+  echo "[+] $name"
+  # shellcheck disable=SC2086
+  $CC $CFLAGS -o "$OUT_DIR/${name}_test" "$PROJECT_ROOT/tests/host/${name}_test.c" "${srcs[@]}"
+  if ! "$OUT_DIR/${name}_test"; then
+    FAILED=1
+  fi
+done
+
+if [[ $FAILED -ne 0 ]]; then
+  echo "❌ Test falliti"
+  exit 1
+fi
+echo "✅ Tutti i test passati"
@@ -9,7 +9,7 @@
  * differenti piattaforme.
  *
  * Funzionalità incluse:
- *  - Controllo dello stato della CPU (halt, pause)
+ *  - Controllo dello stato della CPU (halt, idle, pause)
  *  - Gestione globale degli interrupt
  *  - Recupero di informazioni hardware di base
  *  - Sincronizzazione e memory barrier
@@ -24,6 +24,7 @@
 
 #pragma once
 #include <lib/stdbool.h>
+#include <lib/stddef.h>
 #include <lib/stdint.h>
 
 /**
@@ -32,6 +33,13 @@
  */
 void arch_cpu_halt(void);
 
+/**
+ * @brief Attende il prossimo interrupt con gli interrupt abilitati
+ *        solo per la durata dell'attesa (sti; hlt; cli su x86_64).
+ *        Senza una sorgente periodica attiva la CPU non si risveglia.
+ */
+void arch_cpu_idle(void);
+
 /**
  * @brief Abilita l'accettazione di interrupt hardware globalmente.
  */
@@ -74,3 +82,32 @@ void arch_cpu_memory_barrier(void);
  *        Tipico per SMP (multi-core) in fase di avvio.
  */
 void arch_cpu_sync_barrier(void);
+
+/**
+ * @brief Legge il contatore di cicli della CPU (TSC, cycle counter, ecc.).
+ *        Monotono sul core corrente: usato per misurare il costo CPU
+ *        di sottosistemi e benchmark, non come sorgente di tempo assoluto.
+ */
+uint64_t arch_cpu_cycles(void);
+
+/**
+ * @brief Frequenza di arch_cpu_cycles() in Hz, 0 se non ancora nota.
+ *        Serve a convertire cicli in tempo per tassi e latenze; la prima
+ *        chiamata la ricava dall'hardware, le successive la riusano.
+ */
+uint64_t arch_cpu_cycles_hz(void);
+
+/**
+ * @brief Calcola il CRC32C (Castagnoli) di un buffer.
+ *
+ * Usa l'istruzione hardware dove disponibile (SSE4.2 su x86_64) e ricade
+ * su un'implementazione software altrimenti. Il risultato è identico in
+ * entrambi i casi, quindi i checksum sono confrontabili tra loro.
+ *
+ * @param crc  Valore di partenza (0 per un nuovo calcolo, oppure il
+ *             risultato precedente per concatenare più buffer)
+ * @param data Buffer da elaborare
+ * @param len  Lunghezza in byte
+ * @return CRC32C aggiornato
+ */
+uint32_t arch_crc32c(uint32_t crc, const void *data, size_t len);
@@ -0,0 +1,73 @@
+/**
+ * @file arch/ftrace.h
+ * @brief Siti d'ingresso delle funzioni riscrivibili dal tracer
+ *
+ * Il kernel è compilato con -fpatchable-function-entry: ogni funzione
+ * inizia con un'area di NOP di ARCH_FTRACE_SITE_SIZE byte e il suo
+ * indirizzo viene registrato in __patchable_function_entries. Da spento il
+ * sito è un unico NOP; acceso diventa una call al trampolino d'ingresso,
+ * che salva i registri degli argomenti e chiama
+ *
+ *   ftrace_function_enter(ip, parent)
+ *
+ * con ip l'indirizzo della funzione e parent il puntatore alla cella dello
+ * stack che contiene il suo indirizzo di ritorno. Per tracciare anche
+ * l'uscita il tracer sostituisce quella cella con arch_ftrace_return_trampoline,
+ * che alla return chiama ftrace_function_exit() e salta all'indirizzo che
+ * questa restituisce, preservando il valore di ritorno.
+ *
+ * Non va usato direttamente: l'interfaccia è <klib/ftrace/ftrace.h>.
+ *
+ * Implementazione:
+ *   patch dei siti in `arch/<arch>/cpu/ftrace.c`
+ *   trampolini in `arch/<arch>/cpu/ftrace_asm.s`
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+#define ARCH_FTRACE_SITE_SIZE 5 // Byte di NOP all'ingresso (-fpatchable-function-entry=5)
+
+/**
+ * @brief Funzione senza sito: mai tracciata
+ *
+ * Per le funzioni chiamate dal tracer stesso fuori dai file compilati
+ * senza NOP (es. arch_cpu_cycles()).
+ */
+#define __notrace __attribute__((patchable_function_entry(0, 0)))
+
+/**
+ * @brief Destinazione da sostituire all'indirizzo di ritorno (vedi sopra)
+ */
+void arch_ftrace_return_trampoline(void);
+
+/**
+ * @brief Prende il lock delle riscritture del testo del kernel
+ *
+ * Lo stesso delle static key: va tenuto attorno a ogni gruppo di
+ * arch_ftrace_patch()/arch_ftrace_sync() e allo stato del tracer che ne
+ * dipende. Non annidabile.
+ */
+void arch_ftrace_lock(void);
+
+/**
+ * @brief Rilascia il lock preso con arch_ftrace_lock()
+ */
+void arch_ftrace_unlock(void);
+
+/**
+ * @brief Porta il sito allo stato richiesto (con arch_ftrace_lock() preso)
+ *
+ * Un sito non riconosciuto (né NOP né la call del tracer) non viene toccato.
+ *
+ * @param site Indirizzo della funzione (inizio dell'area di NOP)
+ * @param enable true = call al trampolino, false = NOP
+ * @return false se il sito non è riconosciuto
+ */
+bool arch_ftrace_patch(uptr site, bool enable);
+
+/**
+ * @brief Da chiamare dopo un gruppo di arch_ftrace_patch(), con il lock
+ */
+void arch_ftrace_sync(void);
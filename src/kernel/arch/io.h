@@ -0,0 +1,30 @@
+/**
+ * @file arch/io.h
+ * @brief Accesso allo spazio di I/O dei dispositivi legacy
+ *
+ * Su x86_64 i dispositivi legacy (UART, PIT, PIC) stanno nello spazio delle
+ * porte di I/O, raggiungibile solo con le istruzioni in/out. Le funzioni
+ * sono inline: ogni accesso è una singola istruzione.
+ *
+ * Le architetture senza porte di I/O mappano questi dispositivi in MMIO e
+ * non forniscono questo header.
+ */
+
+#pragma once
+#include <lib/stdint.h>
+
+#if defined(__x86_64__)
+
+static inline void arch_io_outb(uint16_t port, uint8_t value) {
+  __asm__ volatile("outb %0, %1" ::"a"(value), "Nd"(port));
+}
+
+static inline uint8_t arch_io_inb(uint16_t port) {
+  uint8_t value;
+  __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+  return value;
+}
+
+#else
+#error "<arch/io.h> non disponibile per questa architettura"
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file arch/jump_label.h
+ * @brief Siti di salto patchabili per le static key
+ *
+ * Un sito è una singola istruzione di 5 byte nel flusso del codice: un NOP
+ * (si prosegue) oppure un JMP verso il ramo alternativo. Il ramo non legge
+ * memoria né condiziona il branch predictor; cambiarne il verso significa
+ * riscrivere l'istruzione. Ogni sito registra in .jump_table l'indirizzo
+ * dell'istruzione, quello del ramo alternativo e la chiave che lo governa.
+ *
+ * Non va usato direttamente: l'interfaccia è <klib/static_key/static_key.h>.
+ *
+ * Implementazione:
+ *   arch_jump_label_transform() in `arch/<arch>/cpu/jump_label.c`
+ *   macro NASM in `arch/<arch>/cpu/jump_label.inc`
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/**
+ * @brief Voce di .jump_table (offset relativi al campo stesso)
+ *
+ * Il bit 0 di key è il verso "atteso" del sito (branch): il sito salta se
+ * e solo se lo stato della chiave è diverso da branch.
+ */
+typedef struct {
+  s32 code;   // Istruzione patchabile
+  s32 target; // Ramo alternativo
+  s64 key;    // Chiave | branch
+} __attribute__((packed)) jump_entry_t;
+
+#define JUMP_LABEL_INSN_SIZE 5
+
+#if defined(__x86_64__)
+
+/*
+ * Le macro usano etichette locali (__label__) invece di funzioni inline:
+ * il kernel è compilato senza ottimizzazioni e il vincolo "i" su
+ * &key richiede una costante già nel punto in cui si scrive l'asm.
+ */
+#define __ARCH_JUMP_ENTRY(key, branch, label)                                                                                                        \
+  ".pushsection .jump_table,\"a\"\n\t"                                                                                                               \
+  ".balign 8\n\t"                                                                                                                                    \
+  ".long 1b - .\n\t"                                                                                                                                 \
+  ".long %l[" #label "] - .\n\t"                                                                                                                     \
+  ".quad %c0 + %c1 - .\n\t"                                                                                                                          \
+  ".popsection\n\t"
+
+/**
+ * @brief Sito che nasce come NOP: vale false finché non viene patchato
+ */
+#define arch_static_branch(key, branch)                                                                                                              \
+  ({                                                                                                                                                 \
+    __label__ __jl_yes, __jl_out;                                                                                                                    \
+    bool __jl_ret = false;                                                                                                                           \
+    __asm__ goto("1: .byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n\t" __ARCH_JUMP_ENTRY(key, branch, __jl_yes)::"i"(key), "i"(branch)::__jl_yes);              \
+    goto __jl_out;                                                                                                                                   \
+  __jl_yes:                                                                                                                                          \
+    __jl_ret = true;                                                                                                                                 \
+  __jl_out:                                                                                                                                          \
+    __jl_ret;                                                                                                                                        \
+  })
+
+/**
+ * @brief Sito che nasce come JMP (rel32): vale true finché non viene patchato
+ */
+#define arch_static_branch_jump(key, branch)                                                                                                         \
+  ({                                                                                                                                                 \
+    __label__ __jl_yes, __jl_out;                                                                                                                    \
+    bool __jl_ret = false;                                                                                                                           \
+    __asm__ goto("1: .byte 0xe9\n\t"                                                                                                                 \
+                 ".long %l[__jl_yes] - 2f\n\t"                                                                                                       \
+                 "2:\n\t" __ARCH_JUMP_ENTRY(key, branch, __jl_yes)::"i"(key), "i"(branch)::__jl_yes);                                                \
+    goto __jl_out;                                                                                                                                   \
+  __jl_yes:                                                                                                                                          \
+    __jl_ret = true;                                                                                                                                 \
+  __jl_out:                                                                                                                                          \
+    __jl_ret;                                                                                                                                        \
+  })
+
+#else
+#error "arch_static_branch non implementata per questa architettura"
+#endif
+
+/**
+ * @brief Riscrive un sito come JMP (jump = true) o NOP
+ *
+ * Chiamata con il lock delle static key preso. La sincronizzazione delle
+ * altre CPU è a carico dell'implementazione.
+ */
+void arch_jump_label_transform(const jump_entry_t *entry, bool jump);
@@ -0,0 +1,39 @@
+/**
+ * @file arch/percpu.h
+ * @brief Registro base dell'area per-CPU (GS su x86_64, tp su RISC-V...)
+ *
+ * Ogni CPU punta il proprio registro base all'inizio della sua area
+ * per-CPU; la lettura di un campo a offset fisso dalla base è una sola
+ * istruzione e non richiede di conoscere l'ID della CPU.
+ *
+ * A differenza di <arch/cpu.h> la lettura è inline: è nel percorso caldo
+ * di ogni accesso per-CPU e una chiamata costerebbe più dell'accesso.
+ *
+ * Implementazione:
+ *   arch_percpu_set_base() in `arch/<arch>/cpu/cpu.c`
+ */
+
+#pragma once
+#include <lib/stddef.h>
+#include <lib/stdint.h>
+
+/**
+ * @brief Imposta la base dell'area per-CPU della CPU corrente
+ *
+ * @note Su x86_64 scrive IA32_GS_BASE: va richiamata dopo ogni ricarica
+ *       del selettore GS (es. caricamento della GDT), che azzera la base.
+ */
+void arch_percpu_set_base(void *base);
+
+/**
+ * @brief Legge la word a offset dalla base per-CPU della CPU corrente
+ */
+static inline uintptr_t arch_percpu_read(size_t offset) {
+#if defined(__x86_64__)
+  uintptr_t value;
+  __asm__ volatile("movq %%gs:(%1), %0" : "=r"(value) : "r"(offset));
+  return value;
+#else
+#error "arch_percpu_read non implementata per questa architettura"
+#endif
+}
@@ -31,3 +31,22 @@ const char *arch_get_name(void);
  * Deve essere invocata una sola volta all'avvio del kernel.
  */
 void arch_init(void);
+
+/**
+ * @brief Restituisce la command line passata dal bootloader.
+ * @return Stringa terminata da '\0', vuota se il bootloader non la fornisce.
+ */
+const char *arch_get_cmdline(void);
+
+/**
+ * @brief Termina la macchina con uno stato d'uscita, se la piattaforma lo consente.
+ *
+ * Pensata per i boot automatici (benchmark, test) sotto emulatore: su
+ * x86_64 scrive nel dispositivo isa-debug-exit di QEMU
+ * (-device isa-debug-exit,iobase=0xf4,iosize=0x04), che termina QEMU
+ * con codice (status << 1) | 1.
+ *
+ * @param status Stato da riportare (0 = successo)
+ * @note Ritorna se il dispositivo non c'è (hardware reale, QEMU senza device).
+ */
+void arch_platform_exit(uint32_t status);
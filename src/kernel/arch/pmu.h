@@ -0,0 +1,70 @@
+/**
+ * @file arch/pmu.h
+ * @brief Contatori hardware di performance (PMU)
+ *
+ * Espone un insieme fisso di eventi, uguale per ogni architettura. Il
+ * backend programma i contatori disponibili su ogni CPU e li legge senza
+ * MSR nel percorso caldo (rdpmc su x86_64). Gli eventi che la CPU (o
+ * l'hypervisor) non fornisce restano non supportati e valgono 0: il
+ * chiamante deve controllare arch_pmu_supported() prima di interpretarli.
+ *
+ * Senza PMU (es. QEMU TCG) rimane almeno PMU_EVENT_CYCLES, ricavato dal
+ * contatore di cicli di <arch/cpu.h>.
+ *
+ * Non va usato direttamente per misurare: l'interfaccia è
+ * <klib/perf/perf.h>.
+ *
+ * Implementazione:
+ *   `arch/<arch>/cpu/pmu.c`
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/stdint.h>
+
+typedef enum {
+  PMU_EVENT_CYCLES,        // Cicli di core (o del contatore di riferimento senza PMU)
+  PMU_EVENT_INSTRUCTIONS,  // Istruzioni ritirate
+  PMU_EVENT_REF_CYCLES,    // Cicli a frequenza di riferimento
+  PMU_EVENT_LLC_MISSES,    // Miss dell'ultimo livello di cache
+  PMU_EVENT_DTLB_MISSES,   // Miss del dTLB che avviano un page walk
+  PMU_EVENT_BRANCH_MISSES, // Salti predetti male
+  PMU_EVENT_COUNT
+} pmu_event_t;
+
+/**
+ * @brief Rileva la PMU e programma i contatori della CPU corrente
+ *
+ * Da chiamare una volta sulla CPU di boot.
+ *
+ * @return false se non c'è una PMU utilizzabile (resta il fallback)
+ */
+bool arch_pmu_init(void);
+
+/**
+ * @brief Programma i contatori della CPU corrente (AP dopo il bring-up)
+ */
+void arch_pmu_cpu_init(void);
+
+/**
+ * @brief Nome del backend attivo (per i report)
+ */
+const char *arch_pmu_name(void);
+
+/**
+ * @brief true se l'evento è contato su questa macchina
+ */
+bool arch_pmu_supported(pmu_event_t event);
+
+/**
+ * @brief Legge tutti gli eventi della CPU corrente (0 se non supportati)
+ *
+ * I valori sono grezzi e si riavvolgono alla larghezza del contatore:
+ * le differenze vanno mascherate con arch_pmu_counter_mask().
+ */
+void arch_pmu_read(uint64_t values[PMU_EVENT_COUNT]);
+
+/**
+ * @brief Maschera della larghezza del contatore che conta l'evento
+ */
+uint64_t arch_pmu_counter_mask(pmu_event_t event);
@@ -0,0 +1,42 @@
+/**
+ * @file arch/sampling.h
+ * @brief Sorgenti di interrupt periodici per il profiler a campionamento
+ *
+ * Il backend programma una sorgente sulla CPU corrente e, a ogni
+ * campione, chiama l'handler con lo stato del codice interrotto. L'handler
+ * gira in contesto di interrupt (o NMI): non può prendere lock né loggare.
+ *
+ * Implementazione:
+ *   `arch/<arch>/cpu/sampling.c`
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/stdint.h>
+
+typedef enum {
+  ARCH_SAMPLE_TIMER, // Timer locale: campiona anche la CPU in idle
+  ARCH_SAMPLE_PMU,   // Overflow del contatore di cicli: solo cicli non halted
+} arch_sample_source_t;
+
+/**
+ * @param pc Istruzione interrotta
+ * @param fp Frame pointer al momento dell'interrupt
+ * @param sp Stack pointer al momento dell'interrupt
+ */
+typedef void (*arch_sample_handler_t)(uintptr_t pc, uintptr_t fp, uintptr_t sp);
+
+/**
+ * @brief Avvia il campionamento sulla CPU corrente
+ *
+ * Abilita gli interrupt della CPU se la sorgente ne ha bisogno.
+ *
+ * @param hz Campioni al secondo (approssimati per la sorgente PMU)
+ * @return false se la sorgente non è disponibile
+ */
+bool arch_sampling_start(arch_sample_source_t source, uint32_t hz, arch_sample_handler_t handler);
+
+/**
+ * @brief Ferma il campionamento sulla CPU corrente
+ */
+void arch_sampling_stop(void);
@@ -0,0 +1,35 @@
+/**
+ * @file arch/tick.h
+ * @brief Tick periodico del kernel
+ *
+ * Sveglia la CPU a intervalli regolari dall'idle: il lavoro in background
+ * (teardown degli spazi, reclaim, scansione KSM, quiescent state RCU) gira
+ * nel loop di idle dopo ogni risveglio. L'handler fa solo l'EOI e conta i
+ * tick: nessun lavoro in contesto di interrupt.
+ *
+ * Il timer locale è lo stesso della sorgente ARCH_SAMPLE_TIMER del
+ * profiler: il tick va avviato dopo arch_sampling_stop().
+ *
+ * Implementazione:
+ *   `arch/<arch>/cpu/tick.c`
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/stdint.h>
+
+/**
+ * @brief Avvia il tick periodico sulla CPU corrente
+ *
+ * Non abilita gli interrupt: li apre arch_cpu_idle() per la durata
+ * dell'attesa.
+ *
+ * @param hz Tick al secondo
+ * @return false se il timer locale non è disponibile
+ */
+bool arch_tick_start(uint32_t hz);
+
+/**
+ * @brief Tick ricevuti dalla CPU corrente dall'avvio del tick
+ */
+uint64_t arch_tick_count(void);
@@ -0,0 +1,184 @@
+/**
+ * @file arch/x86_64/apic/lapic.c
+ * @brief Local APIC (xAPIC, MMIO) - implementazione
+ *
+ * Calibrazione: il canale 2 del PIT (1.193182 MHz, gate comandato dalla
+ * porta 0x61) conta LAPIC_CALIBRATE_MS millisecondi in modalità one-shot;
+ * nel frattempo il timer del local APIC scende da 0xFFFFFFFF e il TSC
+ * avanza. Funziona sia sotto KVM sia sotto TCG.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include "lapic.h"
+#include <arch/cpu.h>
+#include <arch/io.h>
+#include <arch/x86_64/cpu/cpu_lowlevel.h>
+#include <klib/klog/klog.h>
+#include <lib/cache.h>
+#include <mm/vmm.h>
+
+/* ============================================================
+ *  REGISTRI
+ * ============================================================ */
+#define MSR_IA32_APIC_BASE 0x1B
+#define APIC_BASE_ENABLE (1UL << 11)
+#define APIC_BASE_ADDR_MASK 0x000FFFFFFFFFF000UL
+
+#define LAPIC_REG_EOI 0x0B0
+#define LAPIC_REG_SVR 0x0F0
+#define LAPIC_REG_ICR_LOW 0x300
+#define LAPIC_REG_ICR_HIGH 0x310
+#define LAPIC_REG_LVT_TIMER 0x320
+#define LAPIC_REG_LVT_PERFMON 0x340
+#define LAPIC_REG_TIMER_INITIAL 0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE 0x3E0
+
+#define LAPIC_SVR_ENABLE (1U << 8)
+#define LAPIC_LVT_MASKED (1U << 16)
+#define LAPIC_LVT_PERIODIC (1U << 17)
+#define LAPIC_LVT_NMI (4U << 8)
+#define LAPIC_DIVIDE_16 0x3
+#define LAPIC_ICR_PENDING (1U << 12)      // Delivery status: invio in corso
+#define LAPIC_ICR_ASSERT (1U << 14)       // Level assert (obbligatorio per fixed)
+#define LAPIC_ICR_ALL_BUT_SELF (3U << 18) // Destination shorthand
+
+/* ============================================================
+ *  PIT (solo calibrazione)
+ * ============================================================ */
+#define PIT_HZ 1193182
+#define PIT_PORT_CH2 0x42
+#define PIT_PORT_CMD 0x43
+#define PIT_PORT_GATE 0x61
+#define PIT_GATE_ENABLE 0x01
+#define PIT_SPEAKER 0x02
+#define PIT_CH2_OUT 0x20
+#define PIT_CMD_CH2_ONESHOT 0xB0 // Canale 2, lobyte/hibyte, modo 0
+
+#define PIC1_DATA 0x21
+#define PIC2_DATA 0xA1
+
+#define LAPIC_CALIBRATE_MS 10
+
+static volatile u32 *lapic_regs __read_mostly;
+static u32 lapic_ticks_per_ms __read_mostly; // Con divisore 16
+static u64 lapic_tsc_hz __read_mostly;
+
+static inline u32 lapic_read(u32 reg) {
+  return lapic_regs[reg / 4];
+}
+
+static inline void lapic_write(u32 reg, u32 value) {
+  lapic_regs[reg / 4] = value;
+}
+
+static void lapic_calibrate(void) {
+  u16 count = (u16)(PIT_HZ * LAPIC_CALIBRATE_MS / 1000);
+
+  u8 gate = arch_io_inb(PIT_PORT_GATE) & ~(PIT_SPEAKER | PIT_GATE_ENABLE);
+  arch_io_outb(PIT_PORT_GATE, gate);
+  arch_io_outb(PIT_PORT_CMD, PIT_CMD_CH2_ONESHOT);
+  arch_io_outb(PIT_PORT_CH2, count & 0xFF);
+  arch_io_outb(PIT_PORT_CH2, count >> 8);
+
+  lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+  lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+
+  // Il fronte di salita del gate avvia il conteggio
+  arch_io_outb(PIT_PORT_GATE, gate | PIT_GATE_ENABLE);
+  lapic_write(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+  u64 tsc_start = arch_cpu_cycles();
+
+  while (!(arch_io_inb(PIT_PORT_GATE) & PIT_CH2_OUT))
+    arch_cpu_pause();
+
+  u64 tsc_end = arch_cpu_cycles();
+  u32 elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+  lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+  arch_io_outb(PIT_PORT_GATE, gate);
+
+  lapic_ticks_per_ms = elapsed / LAPIC_CALIBRATE_MS;
+  lapic_tsc_hz = (tsc_end - tsc_start) * (1000 / LAPIC_CALIBRATE_MS);
+}
+
+bool x86_64_lapic_init(void) {
+  u32 edx;
+  cpu_cpuid(0x01, 0, NULL, NULL, NULL, &edx);
+  if (!(edx & (1U << 9))) {
+    klog_warn("LAPIC: non presente");
+    return false;
+  }
+
+  if (!lapic_regs) {
+    u64 base = cpu_rdmsr(MSR_IA32_APIC_BASE);
+    u64 phys = base & APIC_BASE_ADDR_MASK;
+    u64 virt = (u64)vmm_phys_to_virt(phys);
+    u64 mapped;
+
+    // La pagina MMIO non fa parte del direct map (solo RAM)
+    if (!vmm_resolve(vmm_kernel_space(), virt, &mapped)) {
+      if (!vmm_map(vmm_kernel_space(), virt, phys, 1, VMM_FLAG_READ | VMM_FLAG_WRITE | VMM_FLAG_NO_CACHE | VMM_FLAG_GLOBAL)) {
+        klog_error("LAPIC: impossibile mappare 0x%lx", phys);
+        return false;
+      }
+    }
+    cpu_wrmsr(MSR_IA32_APIC_BASE, base | APIC_BASE_ENABLE);
+    lapic_regs = (volatile u32 *)virt;
+  }
+
+  // Il PIC legacy non deve consegnare nulla: i suoi vettori coincidono
+  // con quelli delle eccezioni
+  arch_io_outb(PIC1_DATA, 0xFF);
+  arch_io_outb(PIC2_DATA, 0xFF);
+
+  lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_VECTOR_SPURIOUS);
+  lapic_write(LAPIC_REG_LVT_PERFMON, LAPIC_LVT_MASKED);
+
+  if (lapic_ticks_per_ms == 0) {
+    lapic_calibrate();
+    klog_info("LAPIC: timer %u tick/ms (div 16), TSC %lu MHz", lapic_ticks_per_ms, lapic_tsc_hz / 1000000);
+  }
+  return true;
+}
+
+bool x86_64_lapic_ready(void) {
+  return lapic_regs != NULL;
+}
+
+void x86_64_lapic_eoi(void) {
+  lapic_write(LAPIC_REG_EOI, 0);
+}
+
+void x86_64_lapic_timer_start(u8 vector, u32 hz) {
+  u64 ticks = hz ? (u64)lapic_ticks_per_ms * 1000 / hz : 0;
+  if (ticks == 0)
+    ticks = 1;
+  if (ticks > 0xFFFFFFFF)
+    ticks = 0xFFFFFFFF;
+
+  lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+  lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_PERIODIC | vector);
+  lapic_write(LAPIC_REG_TIMER_INITIAL, (u32)ticks);
+}
+
+void x86_64_lapic_timer_stop(void) {
+  lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+  lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+}
+
+void x86_64_lapic_perfmon_nmi(bool enable) {
+  lapic_write(LAPIC_REG_LVT_PERFMON, enable ? LAPIC_LVT_NMI : LAPIC_LVT_MASKED);
+}
+
+void x86_64_lapic_ipi_others(u8 vector) {
+  lapic_write(LAPIC_REG_ICR_HIGH, 0);
+  lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | vector);
+  while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING)
+    arch_cpu_pause();
+}
+
+u64 x86_64_lapic_tsc_hz(void) {
+  return lapic_tsc_hz;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file arch/x86_64/apic/lapic.h
+ * @brief Local APIC (xAPIC, MMIO) della CPU corrente
+ *
+ * Copre solo quanto serve alle sorgenti di interrupt locali: abilitazione,
+ * EOI, timer periodico, voce LVT dei contatori di performance e IPI
+ * broadcast verso le altre CPU (sincronizzazione di text_poke). Niente
+ * I/O APIC.
+ *
+ * Il timer viene calibrato una volta con il canale 2 del PIT, insieme alla
+ * frequenza del TSC.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+#define LAPIC_VECTOR_TIMER 0xF0
+#define LAPIC_VECTOR_TEXT_POKE 0xF1 // IPI di serializzazione dopo text_poke
+#define LAPIC_VECTOR_SPURIOUS 0xFF
+
+/**
+ * @brief Mappa e abilita il local APIC della CPU corrente
+ *
+ * Richiede il VMM (la pagina MMIO viene mappata non cacheable nel direct
+ * map). Maschera il PIC legacy e calibra timer e TSC al primo uso.
+ *
+ * @return false se la CPU non ha un local APIC
+ */
+bool x86_64_lapic_init(void);
+
+/**
+ * @brief true dopo un x86_64_lapic_init() riuscito
+ */
+bool x86_64_lapic_ready(void);
+
+/**
+ * @brief Segnala la fine dell'interrupt corrente
+ */
+void x86_64_lapic_eoi(void);
+
+/**
+ * @brief Avvia il timer periodico sul vettore indicato
+ *
+ * @param hz Frequenza (limitata a quella ottenibile dal timer)
+ */
+void x86_64_lapic_timer_start(u8 vector, u32 hz);
+
+/**
+ * @brief Ferma il timer
+ */
+void x86_64_lapic_timer_stop(void);
+
+/**
+ * @brief Instrada l'overflow dei contatori PMU come NMI (o lo maschera)
+ *
+ * Su molte CPU la consegna di un PMI maschera la voce: l'handler deve
+ * richiamarla per riarmarla.
+ */
+void x86_64_lapic_perfmon_nmi(bool enable);
+
+/**
+ * @brief Invia un IPI fixed a tutte le CPU tranne quella corrente
+ *
+ * Ritorna quando il local APIC ha consegnato il messaggio (delivery
+ * status a 0), non quando le altre CPU lo hanno gestito.
+ */
+void x86_64_lapic_ipi_others(u8 vector);
+
+/**
+ * @brief Frequenza del TSC misurata in calibrazione (0 se non misurata)
+ */
+u64 x86_64_lapic_tsc_hz(void);
@@ -0,0 +1,269 @@
+/**
+ * @file arch/x86_64/cpu/alternative.c
+ * @brief Feature CPU e patch delle istruzioni al boot - implementazione
+ *
+ * Le voci di .altinstructions sono raccolte dal linker fra
+ * _alt_instructions_start e _alt_instructions_end (tools/linker.ld).
+ * Per ogni voce la cui feature è presente, il buffer [sostituzione | NOP]
+ * viene scritto sul sito con text_poke().
+ *
+ * I siti riscritti a kernel avviato (static key, ftrace) passano da
+ * text_poke_bp(): il primo byte diventa int3 prima di toccare il resto,
+ * così un'altra CPU non può mai eseguire un'istruzione a metà. Una CPU
+ * che trova l'int3 salta il sito (vedi text_poke_bp_trap), e ogni passo
+ * è seguito da text_poke_sync(), che serializza le altre CPU con un IPI.
+ * text_mutex copre l'intero protocollo: text_poke_bp_addr/len descrivono
+ * un solo sito alla volta, e due riscritture intrecciate farebbero
+ * saltare all'handler di #BP il sito sbagliato.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include <arch/cpu.h>
+#include <arch/x86_64/apic/lapic.h>
+#include <arch/x86_64/cpu/alternative.h>
+#include <arch/x86_64/cpu/cpu_lowlevel.h>
+#include <arch/x86_64/idt/idt.h>
+#include <klib/klog/klog.h>
+#include <klib/spinlock.h>
+
+extern x86_64_alt_instr_t _alt_instructions_start[];
+extern x86_64_alt_instr_t _alt_instructions_end[];
+
+/* ============================================================
+ *  FEATURE CPU
+ * ============================================================ */
+static u32 x86_64_caps[X86_CAP_WORDS];
+static bool x86_64_caps_ready = false;
+
+void x86_64_cpu_features_init(void) {
+  u32 eax, ebx, ecx, edx;
+
+  if (x86_64_caps_ready)
+    return;
+
+  cpu_cpuid(0x00, 0, &eax, NULL, NULL, NULL);
+  u32 max_leaf = eax;
+
+  cpu_cpuid(0x01, 0, NULL, NULL, &ecx, &edx);
+  x86_64_caps[X86_CAP_WORD_1_ECX] = ecx;
+  x86_64_caps[X86_CAP_WORD_1_EDX] = edx;
+
+  if (max_leaf >= 0x07) {
+    cpu_cpuid(0x07, 0, NULL, &ebx, NULL, &edx);
+    x86_64_caps[X86_CAP_WORD_7_EBX] = ebx;
+    x86_64_caps[X86_CAP_WORD_7_EDX] = edx;
+  }
+
+  cpu_cpuid(0x80000000u, 0, &eax, NULL, NULL, NULL);
+  if (eax >= 0x80000001u) {
+    cpu_cpuid(0x80000001u, 0, NULL, NULL, NULL, &edx);
+    x86_64_caps[X86_CAP_WORD_80000001_EDX] = edx;
+  }
+
+  x86_64_caps_ready = true;
+}
+
+bool x86_64_cpu_has(u16 feature) {
+  if (feature / 32 >= X86_CAP_WORDS)
+    return false;
+  return (x86_64_caps[feature / 32] >> (feature % 32)) & 1;
+}
+
+/* ============================================================
+ *  TEXT POKE
+ * ============================================================ */
+#define CR0_WP (1UL << 16)
+
+static inline u64 alt_read_cr0(void) {
+  u64 value;
+  __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+  return value;
+}
+
+static inline void alt_write_cr0(u64 value) {
+  __asm__ volatile("mov %0, %%cr0" ::"r"(value) : "memory");
+}
+
+static inline u64 alt_irq_save(void) {
+  u64 flags;
+  __asm__ volatile("pushfq\n\tpopq %0\n\tcli" : "=r"(flags)::"memory");
+  return flags;
+}
+
+static inline void alt_irq_restore(u64 flags) {
+  __asm__ volatile("pushq %0\n\tpopfq" ::"r"(flags) : "memory", "cc");
+}
+
+void text_poke(void *addr, const void *opcode, size_t len) {
+  // Copia a byte con volatile: il compilatore non deve trasformarla in
+  // una chiamata a memcpy, che potrebbe essere proprio il codice patchato
+  volatile u8 *dst = (volatile u8 *)addr;
+  const u8 *src = (const u8 *)opcode;
+
+  u64 flags = alt_irq_save();
+  u64 cr0 = alt_read_cr0();
+  alt_write_cr0(cr0 & ~CR0_WP);
+
+  for (size_t i = 0; i < len; i++)
+    dst[i] = src[i];
+
+  alt_write_cr0(cr0);
+  alt_irq_restore(flags);
+
+  // CPUID serializza: la CPU non esegue byte vecchi già prelevati
+  cpu_cpuid(0, 0, NULL, NULL, NULL, NULL);
+}
+
+#define TEXT_POKE_INT3 0xCC
+#define IDT_VECTOR_BREAKPOINT 3
+
+static spinlock_t text_mutex = SPINLOCK_INITIALIZER; // Un solo sito in riscrittura alla volta
+static u32 text_poke_cpus = 1;                       // CPU che eseguono codice del kernel
+static u32 text_poke_acks;                           // Conferme dell'IPI di sync in corso
+static uptr text_poke_bp_addr;                       // Sito con int3 in riscrittura (0 = nessuno)
+static size_t text_poke_bp_len;                      // Lunghezza dell'istruzione del sito
+
+// Ritorno dall'IPI (IRETQ) serializza: basta confermare
+static void text_poke_sync_ipi(x86_64_irq_frame_t *frame) {
+  (void)frame;
+  __atomic_add_fetch(&text_poke_acks, 1, __ATOMIC_RELEASE);
+  x86_64_lapic_eoi();
+}
+
+/**
+ * @brief #BP su un sito in riscrittura: lo esegue come NOP
+ *
+ * I siti riscritti a runtime alternano NOP e JMP/CALL: saltarli equivale
+ * allo stato spento, uno dei due stati validi durante la transizione.
+ */
+static void text_poke_bp_trap(x86_64_irq_frame_t *frame) {
+  uptr addr = __atomic_load_n(&text_poke_bp_addr, __ATOMIC_ACQUIRE);
+  if (addr && frame->rip - 1 == addr) {
+    frame->rip = addr + text_poke_bp_len;
+    return;
+  }
+  klog_panic("Eccezione 3 (#BP breakpoint) a RIP=0x%lx", frame->rip - 1);
+}
+
+void x86_64_text_poke_init(void) {
+  x86_64_idt_set_handler(IDT_VECTOR_BREAKPOINT, text_poke_bp_trap);
+  x86_64_idt_set_handler(LAPIC_VECTOR_TEXT_POKE, text_poke_sync_ipi);
+}
+
+void x86_64_text_poke_cpu_online(void) {
+  __atomic_add_fetch(&text_poke_cpus, 1, __ATOMIC_ACQ_REL);
+}
+
+void text_poke_sync(void) {
+  cpu_cpuid(0, 0, NULL, NULL, NULL, NULL);
+
+  u32 others = __atomic_load_n(&text_poke_cpus, __ATOMIC_ACQUIRE) - 1;
+  if (others == 0)
+    return;
+
+  // Un AP è online solo dopo il LAPIC della BSP: senza, nessun IPI possibile
+  if (!x86_64_lapic_ready())
+    klog_panic("text_poke: %u CPU online senza local APIC", others + 1);
+
+  __atomic_store_n(&text_poke_acks, 0, __ATOMIC_RELEASE);
+  x86_64_lapic_ipi_others(LAPIC_VECTOR_TEXT_POKE);
+  while (__atomic_load_n(&text_poke_acks, __ATOMIC_ACQUIRE) < others)
+    arch_cpu_pause();
+}
+
+void text_poke_lock(void) {
+  spinlock_lock(&text_mutex);
+}
+
+void text_poke_unlock(void) {
+  spinlock_unlock(&text_mutex);
+}
+
+void text_poke_bp(void *addr, const void *opcode, size_t len) {
+  text_poke_lock();
+  text_poke_bp_locked(addr, opcode, len);
+  text_poke_unlock();
+}
+
+void text_poke_bp_locked(void *addr, const void *opcode, size_t len) {
+  const u8 *src = (const u8 *)opcode;
+  const u8 int3 = TEXT_POKE_INT3;
+
+  __atomic_store_n(&text_poke_bp_len, len, __ATOMIC_RELAXED);
+  __atomic_store_n(&text_poke_bp_addr, (uptr)addr, __ATOMIC_RELEASE);
+
+  // 1. int3 sul primo byte: da qui nessuno esegue il resto del sito
+  text_poke(addr, &int3, 1);
+  text_poke_sync();
+
+  // 2. Coda dell'istruzione nuova, invisibile dietro l'int3
+  if (len > 1) {
+    text_poke((u8 *)addr + 1, src + 1, len - 1);
+    text_poke_sync();
+  }
+
+  // 3. Primo byte: l'istruzione nuova diventa eseguibile tutta insieme
+  text_poke(addr, src, 1);
+  text_poke_sync();
+
+  __atomic_store_n(&text_poke_bp_addr, 0, __ATOMIC_RELEASE);
+}
+
+/* ============================================================
+ *  ALTERNATIVES
+ * ============================================================ */
+
+/* NOP multi-byte raccomandati da Intel (SDM vol. 2B, "NOP") */
+static const u8 alt_nops[9][9] = {
+    {0},
+    {0x90},
+    {0x66, 0x90},
+    {0x0f, 0x1f, 0x00},
+    {0x0f, 0x1f, 0x40, 0x00},
+    {0x0f, 0x1f, 0x44, 0x00, 0x00},
+    {0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00},
+    {0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00},
+    {0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+static void alt_fill_nops(u8 *buf, size_t len) {
+  while (len > 0) {
+    size_t chunk = len > 8 ? 8 : len;
+    for (size_t i = 0; i < chunk; i++)
+      buf[i] = alt_nops[chunk][i];
+    buf += chunk;
+    len -= chunk;
+  }
+}
+
+void x86_64_apply_alternatives(void) {
+  u8 buf[256];
+  size_t patched = 0, skipped = 0;
+
+  x86_64_cpu_features_init();
+
+  for (x86_64_alt_instr_t *alt = _alt_instructions_start; alt < _alt_instructions_end; alt++) {
+    if (!x86_64_cpu_has(alt->feature))
+      continue;
+
+    u8 *instr = (u8 *)&alt->instr_offset + alt->instr_offset;
+    const u8 *repl = (const u8 *)&alt->repl_offset + alt->repl_offset;
+
+    if (alt->repl_len > alt->instr_len) {
+      klog_error("alternatives: sostituzione di %u byte su sito di %u byte a %p", alt->repl_len, alt->instr_len, instr);
+      skipped++;
+      continue;
+    }
+
+    for (size_t i = 0; i < alt->repl_len; i++)
+      buf[i] = repl[i];
+    alt_fill_nops(buf + alt->repl_len, alt->instr_len - alt->repl_len);
+
+    text_poke(instr, buf, alt->instr_len);
+    patched++;
+  }
+
+  klog_info("alternatives: %zu siti patchati, %zu scartati (ERMS=%d INVPCID=%d)", patched, skipped, x86_64_cpu_has(X86_FEATURE_ERMS), x86_64_cpu_has(X86_FEATURE_INVPCID));
+}
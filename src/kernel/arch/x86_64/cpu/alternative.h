@@ -0,0 +1,176 @@
+/**
+ * @file arch/x86_64/cpu/alternative.h
+ * @brief Feature CPU e patch delle istruzioni al boot (alternatives)
+ *
+ * Un sito ALTERNATIVE() contiene la sequenza "di base", valida su ogni CPU
+ * x86_64, e registra in .altinstructions una sostituzione da usare se la
+ * CPU ha una certa feature. x86_64_apply_alternatives(), chiamata una sola
+ * volta da arch_init(), riscrive i siti: il percorso caldo resta codice
+ * lineare, senza flag da controllare né salti indiretti.
+ *
+ * REGOLE PER I SITI:
+ * - La sostituzione non può essere più lunga dell'originale (il resto
+ *   viene riempito di NOP); un sito che viola la regola non viene
+ *   patchato e resta corretto
+ * - Niente indirizzamenti relativi a RIP, jmp o call nella sostituzione:
+ *   i byte vengono copiati altrove e non rilocati
+ * - Le due sequenze devono avere gli stessi operandi e clobber: usare
+ *   vincoli a registro fisso ("D", "S", "c"...) per renderle indipendenti
+ *   dalle scelte del compilatore
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* --------------------------------------------------------------------------
+ * Feature CPU
+ * --------------------------------------------------------------------------
+ * Numerate come word*32 + bit; ogni word è un registro CPUID.
+ */
+#define X86_CAP_WORD_7_EBX 0        // CPUID.(EAX=7,ECX=0):EBX
+#define X86_CAP_WORD_1_ECX 1        // CPUID.1:ECX
+#define X86_CAP_WORD_1_EDX 2        // CPUID.1:EDX
+#define X86_CAP_WORD_80000001_EDX 3 // CPUID.80000001h:EDX
+#define X86_CAP_WORD_7_EDX 4        // CPUID.(EAX=7,ECX=0):EDX
+#define X86_CAP_WORDS 5
+
+#define X86_FEATURE_ERMS (0 * 32 + 9)     // rep movsb/stosb veloci
+#define X86_FEATURE_INVPCID (0 * 32 + 10) // Istruzione INVPCID
+#define X86_FEATURE_PCID (1 * 32 + 17)    // Process-context identifier
+#define X86_FEATURE_SSE4_2 (1 * 32 + 20)  // SSE4.2 (crc32)
+#define X86_FEATURE_X2APIC (1 * 32 + 21)  // x2APIC via MSR
+#define X86_FEATURE_TSC (2 * 32 + 4)      // Time stamp counter
+#define X86_FEATURE_NX (3 * 32 + 20)      // No-execute
+#define X86_FEATURE_FSRM (4 * 32 + 4)     // rep movsb veloce anche su copie brevi
+
+/**
+ * @brief Legge le feature via CPUID (idempotente)
+ */
+void x86_64_cpu_features_init(void);
+
+/**
+ * @brief true se la CPU ha la feature X86_FEATURE_*
+ */
+bool x86_64_cpu_has(u16 feature);
+
+/* --------------------------------------------------------------------------
+ * Alternatives
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Voce di .altinstructions (offset relativi al campo stesso)
+ */
+typedef struct {
+  s32 instr_offset; // Sito originale
+  s32 repl_offset;  // Sostituzione in .altinstr_replacement
+  u16 feature;      // X86_FEATURE_* che abilita la sostituzione
+  u8 instr_len;     // Byte del sito originale
+  u8 repl_len;      // Byte della sostituzione
+} __attribute__((packed)) x86_64_alt_instr_t;
+
+#define __ALT_STRINGIFY(x) #x
+#define ALT_STRINGIFY(x) __ALT_STRINGIFY(x)
+
+/**
+ * @brief Sequenza oldinstr, sostituita da newinstr se la CPU ha feature
+ *
+ * Da usare come template di __asm__ volatile(); le stringhe seguono le
+ * normali regole dell'inline asm (registri con %%).
+ */
+#define ALTERNATIVE(oldinstr, newinstr, feature)                                                                                                     \
+  "661:\n\t" oldinstr "\n"                                                                                                                           \
+  "662:\n"                                                                                                                                           \
+  ".pushsection .altinstructions,\"a\"\n"                                                                                                            \
+  " .long 661b - .\n"                                                                                                                                \
+  " .long 663f - .\n"                                                                                                                                \
+  " .word " ALT_STRINGIFY(feature) "\n"                                                                                                              \
+  " .byte 662b - 661b\n"                                                                                                                             \
+  " .byte 664f - 663f\n"                                                                                                                             \
+  ".popsection\n"                                                                                                                                    \
+  ".pushsection .altinstr_replacement,\"ax\"\n"                                                                                                      \
+  "663:\n\t" newinstr "\n"                                                                                                                           \
+  "664:\n"                                                                                                                                           \
+  ".popsection\n"
+
+/**
+ * @brief Applica tutte le alternatives del kernel
+ *
+ * Da chiamare una volta, su una sola CPU, prima di avviare le altre.
+ */
+void x86_64_apply_alternatives(void);
+
+/**
+ * @brief Riscrive len byte di codice del kernel
+ *
+ * Disabilita temporaneamente CR0.WP (il testo è mappato in sola lettura)
+ * e serializza la CPU prima di tornare.
+ *
+ * @note Sicura solo se nessun'altra CPU sta eseguendo i byte modificati
+ *       (alternatives al boot): a runtime si usa text_poke_bp().
+ */
+void text_poke(void *addr, const void *opcode, size_t len);
+
+/**
+ * @brief Serializza ogni CPU dopo una modifica del testo del kernel
+ *
+ * Al ritorno nessuna CPU può eseguire byte prelevati prima del text_poke():
+ * la corrente esegue CPUID, le altre ricevono un IPI (LAPIC_VECTOR_TEXT_POKE)
+ * e confermano dal suo handler. Con la sola CPU di boot online non invia
+ * nulla.
+ *
+ * @note Va chiamata con gli interrupt abilitati sulle altre CPU: una CPU
+ *       ferma con IF=0 in attesa di chi chiama la bloccherebbe.
+ */
+void text_poke_sync(void);
+
+/**
+ * @brief Prende il lock delle riscritture a runtime (text_mutex)
+ *
+ * Serializza ogni text_poke_bp(). Chi riscrive un gruppo di siti e deve
+ * tenerlo insieme a un proprio stato (es. ftrace) lo prende una volta e
+ * usa text_poke_bp_locked(). Non annidabile.
+ *
+ * @note Con più CPU online chi attende il lock deve farlo con gli
+ *       interrupt abilitati, per confermare il text_poke_sync() di chi lo
+ *       tiene.
+ */
+void text_poke_lock(void);
+
+/**
+ * @brief Rilascia il lock preso con text_poke_lock()
+ */
+void text_poke_unlock(void);
+
+/**
+ * @brief Riscrive un'istruzione che altre CPU possono star eseguendo
+ *
+ * Protocollo int3: int3 sul primo byte, sync, coda dell'istruzione nuova,
+ * sync, primo byte nuovo, sync. Una CPU che incontra l'int3 nel frattempo
+ * salta il sito come fosse un NOP: adatto ai siti NOP <-> JMP/CALL (static
+ * key, ftrace), non a istruzioni che devono sempre essere eseguite.
+ *
+ * Prende text_mutex per tutto il protocollo, sync compresi.
+ */
+void text_poke_bp(void *addr, const void *opcode, size_t len);
+
+/**
+ * @brief Come text_poke_bp(), con text_mutex già preso dal chiamante
+ */
+void text_poke_bp_locked(void *addr, const void *opcode, size_t len);
+
+/**
+ * @brief Registra gli handler di #BP e dell'IPI di sync (dopo l'IDT)
+ */
+void x86_64_text_poke_init(void);
+
+/**
+ * @brief Conta una CPU in più fra quelle da sincronizzare
+ *
+ * Da chiamare dal codice di avvio di ogni AP, dopo x86_64_idt_load() e
+ * l'abilitazione del suo local APIC, prima che esegua codice riscrivibile.
+ */
+void x86_64_text_poke_cpu_online(void);
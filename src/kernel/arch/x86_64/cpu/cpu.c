@@ -14,14 +14,20 @@
  *  - Memory ordering e sincronizzazione (mfence, pause)
  *  - Gestione TLB (invlpg) e indirizzo di fault (CR2)
  *  - Rilevazione feature (NX, SYSCALL/SYSRET)
+ *  - Contatore di cicli (RDTSC) e sua frequenza, CRC32C hardware (SSE4.2)
+ *  - Base dell'area per-CPU (IA32_GS_BASE)
  *
  * @author Enzo Tasca
  * @date 2025
  */
 
 #include <arch/cpu.h>
+#include <arch/ftrace.h>
+#include <arch/percpu.h>
+#include <arch/x86_64/apic/lapic.h>
 #include <lib/stdbool.h>
 #include <lib/stdint.h>
+#include <lib/string/string.h>
 
 /* ============================================================
  *  Helpers interni per CPUID e MSR
@@ -65,6 +71,12 @@ void arch_cpu_halt(void) {
   __asm__ volatile("hlt");
 }
 
+void arch_cpu_idle(void) {
+  // sti ha effetto dopo l'istruzione successiva: un interrupt non può
+  // arrivare fra i due e lasciare la CPU in hlt fino al tick seguente
+  __asm__ volatile("sti; hlt; cli" ::: "memory");
+}
+
 void arch_cpu_enable_interrupts(void) {
   __asm__ volatile("sti");
 }
@@ -97,6 +109,15 @@ unsigned int arch_cpu_current_id(void) {
   return (ebx >> 24) & 0xFF; // APIC ID
 }
 
+/* ============================================================
+ *  PER-CPU BASE
+ * ============================================================ */
+#define MSR_GS_BASE 0xC0000101
+
+void arch_percpu_set_base(void *base) {
+  cpu_wrmsr(MSR_GS_BASE, (uint64_t)(uintptr_t)base);
+}
+
 /* ============================================================
  *  CACHE / MEMORY ORDERING
  * ============================================================ */
@@ -142,3 +163,96 @@ bool arch_cpu_has_fast_syscall(void) {
 uintptr_t arch_cpu_fault_address(void) {
   return cpu_read_cr2();
 }
+
+/* ============================================================
+ *  CYCLE COUNTER
+ * ============================================================ */
+// Chiamata dal tracer delle funzioni a ogni evento
+__notrace uint64_t arch_cpu_cycles(void) {
+  uint32_t lo, hi;
+  __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t cpu_tsc_hz;
+
+/*
+ * Ordine delle sorgenti:
+ * 1. CPUID 0x15: rapporto TSC/cristallo e frequenza del cristallo, esatta
+ * 2. CPUID 0x16: frequenza base del processore in MHz, che sulle CPU con
+ *    TSC invariante coincide con quella del TSC a meno di arrotondamenti
+ * 3. calibrazione contro il PIT fatta dal LAPIC, se già avvenuta
+ * Le macchine virtuali spesso non espongono le foglie 0x15/0x16.
+ */
+uint64_t arch_cpu_cycles_hz(void) {
+  if (cpu_tsc_hz)
+    return cpu_tsc_hz;
+
+  uint32_t max_leaf, denominator, numerator, crystal_hz, base_mhz, unused;
+  cpu_cpuid(0x00, 0, &max_leaf, &unused, &unused, &unused);
+
+  if (max_leaf >= 0x15) {
+    cpu_cpuid(0x15, 0, &denominator, &numerator, &crystal_hz, &unused);
+    if (denominator && numerator && crystal_hz)
+      cpu_tsc_hz = (uint64_t)crystal_hz * numerator / denominator;
+  }
+
+  if (!cpu_tsc_hz && max_leaf >= 0x16) {
+    cpu_cpuid(0x16, 0, &base_mhz, &unused, &unused, &unused);
+    cpu_tsc_hz = (uint64_t)(base_mhz & 0xFFFF) * 1000000;
+  }
+
+  if (!cpu_tsc_hz)
+    cpu_tsc_hz = x86_64_lapic_tsc_hz();
+  return cpu_tsc_hz;
+}
+
+/* ============================================================
+ *  CRC32C (Castagnoli)
+ * ============================================================ */
+
+/* Tabella a nibble per il fallback software (polinomio riflesso 0x82F63B78) */
+static const uint32_t crc32c_nibble_table[16] = {0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1, 0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+                                                 0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9, 0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75};
+
+/* 0 = non ancora rilevato, 1 = SSE4.2 presente, 2 = assente */
+static int crc32c_hw_state = 0;
+
+static bool cpu_has_sse42(void) {
+  if (crc32c_hw_state == 0) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0x01, 0, &eax, &ebx, &ecx, &edx);
+    crc32c_hw_state = ((ecx >> 20) & 1) ? 1 : 2; // Bit SSE4.2
+  }
+  return crc32c_hw_state == 1;
+}
+
+uint32_t arch_crc32c(uint32_t crc, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint64_t c = ~crc;
+
+  if (cpu_has_sse42()) {
+    /* Blocchi da 8 byte con crc32q, coda byte per byte con crc32b */
+    while (len >= 8) {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      __asm__("crc32q %1, %0" : "+r"(c) : "rm"(v));
+      p += 8;
+      len -= 8;
+    }
+    while (len--) {
+      uint32_t c32 = (uint32_t)c;
+      __asm__("crc32b %1, %0" : "+r"(c32) : "rm"(*p++));
+      c = c32;
+    }
+    return ~(uint32_t)c;
+  }
+
+  uint32_t c32 = (uint32_t)c;
+  while (len--) {
+    uint8_t byte = *p++;
+    c32 = crc32c_nibble_table[(c32 ^ byte) & 0x0F] ^ (c32 >> 4);
+    c32 = crc32c_nibble_table[(c32 ^ (byte >> 4)) & 0x0F] ^ (c32 >> 4);
+  }
+  return ~c32;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file arch/x86_64/cpu/ftrace.c
+ * @brief Siti d'ingresso del tracer (x86_64) - implementazione
+ *
+ * Un sito alterna fra il NOP a 5 byte e CALL rel32 (e8 xx xx xx xx) verso
+ * x86_64_ftrace_entry_trampoline (ftrace_asm.s). Il compilatore può
+ * emettere l'area come cinque NOP da un byte: vale come sito spento, e la
+ * prima riscrittura la porta al NOP unico, più economico da eseguire.
+ *
+ * Questo file è compilato senza area di NOP (vedi il Makefile): riscrive
+ * il codice e non deve tracciare se stesso.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include <arch/ftrace.h>
+#include <arch/x86_64/cpu/alternative.h>
+
+extern void x86_64_ftrace_entry_trampoline(void);
+
+static const u8 ftrace_nop[ARCH_FTRACE_SITE_SIZE] = {0x0f, 0x1f, 0x44, 0x00, 0x00};
+static const u8 ftrace_nop_bytes[ARCH_FTRACE_SITE_SIZE] = {0x90, 0x90, 0x90, 0x90, 0x90};
+
+static inline bool ftrace_same(const u8 *a, const u8 *b) {
+  for (size_t i = 0; i < ARCH_FTRACE_SITE_SIZE; i++) {
+    if (a[i] != b[i])
+      return false;
+  }
+  return true;
+}
+
+void arch_ftrace_lock(void) {
+  text_poke_lock();
+}
+
+void arch_ftrace_unlock(void) {
+  text_poke_unlock();
+}
+
+bool arch_ftrace_patch(uptr site, bool enable) {
+  u8 *code = (u8 *)site;
+  s32 rel = (s32)((uptr)x86_64_ftrace_entry_trampoline - (site + ARCH_FTRACE_SITE_SIZE));
+  u8 call[ARCH_FTRACE_SITE_SIZE] = {0xe8, (u8)rel, (u8)(rel >> 8), (u8)(rel >> 16), (u8)(rel >> 24)};
+
+  if (!ftrace_same(code, ftrace_nop) && !ftrace_same(code, ftrace_nop_bytes) && !ftrace_same(code, call))
+    return false;
+
+  const u8 *want = enable ? call : ftrace_nop;
+  if (!ftrace_same(code, want))
+    text_poke_bp_locked(code, want, ARCH_FTRACE_SITE_SIZE);
+  return true;
+}
+
+void arch_ftrace_sync(void) {
+  text_poke_sync();
+}
@@ -0,0 +1,68 @@
+; ==============================================================================
+;  File: ftrace_asm.s
+;  Description: Trampolini del tracer delle funzioni (vedi arch/ftrace.h)
+;
+;  x86_64_ftrace_entry_trampoline è la destinazione della CALL scritta al
+;  posto del NOP d'ingresso. All'arrivo:
+;      [rsp]     = funzione + 5 (si riprende dopo il sito)
+;      [rsp + 8] = indirizzo di ritorno della funzione
+;  Gli argomenti della funzione sono ancora nei registri: si salvano tutti
+;  i registri caller-saved, si chiama il tracer e si torna nella funzione
+;  come se il sito fosse stato un NOP.
+;
+;  arch_ftrace_return_trampoline prende il posto dell'indirizzo di ritorno
+;  quando il tracer registra anche l'uscita: salva il valore di ritorno
+;  (rax:rdx), chiede al tracer l'indirizzo originale e ci salta.
+;
+;  Allineamento: all'ingresso della funzione rsp = 8 mod 16, quindi
+;  all'ingresso del trampolino d'ingresso e dopo la ret della funzione
+;  rsp = 0 mod 16; il numero di push è pari in entrambi i casi.
+; ==============================================================================
+
+extern ftrace_function_enter
+extern ftrace_function_exit
+global x86_64_ftrace_entry_trampoline
+global arch_ftrace_return_trampoline
+
+section .text
+
+align 16
+x86_64_ftrace_entry_trampoline:
+    push    rbp
+    mov     rbp, rsp       ; frame valido per lo stack walk del profiler
+    push    rax            ; al: numero di registri vettoriali (varargs)
+    push    rcx
+    push    rdx
+    push    rsi
+    push    rdi
+    push    r8
+    push    r9
+    push    r10
+    push    r11
+
+    mov     rdi, [rbp + 8]
+    sub     rdi, 5         ; ip: inizio della funzione
+    lea     rsi, [rbp + 16] ; parent: cella dell'indirizzo di ritorno
+    call    ftrace_function_enter
+
+    pop     r11
+    pop     r10
+    pop     r9
+    pop     r8
+    pop     rdi
+    pop     rsi
+    pop     rdx
+    pop     rcx
+    pop     rax
+    pop     rbp
+    ret
+
+align 16
+arch_ftrace_return_trampoline:
+    push    rax            ; valore di ritorno
+    push    rdx
+    call    ftrace_function_exit
+    mov     r11, rax       ; r11 è caller-saved: libero al ritorno
+    pop     rdx
+    pop     rax
+    jmp     r11
@@ -0,0 +1,45 @@
+/**
+ * @file arch/x86_64/cpu/jump_label.c
+ * @brief Siti delle static key (x86_64) - implementazione
+ *
+ * Un sito alterna fra NOP a 5 byte e JMP rel32 (e9 xx xx xx xx) verso il
+ * ramo alternativo. Prima di riscriverlo si verifica che contenga l'una o
+ * l'altra istruzione: qualsiasi altra cosa significa una .jump_table
+ * corrotta o un sito già patchato da altri (alternatives), e scrivere
+ * alla cieca romperebbe il codice.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include <arch/jump_label.h>
+#include <arch/x86_64/cpu/alternative.h>
+#include <klib/klog/klog.h>
+
+static const u8 jump_label_nop[JUMP_LABEL_INSN_SIZE] = {0x0f, 0x1f, 0x44, 0x00, 0x00};
+
+static inline bool jump_label_same(const u8 *a, const u8 *b) {
+  for (size_t i = 0; i < JUMP_LABEL_INSN_SIZE; i++) {
+    if (a[i] != b[i])
+      return false;
+  }
+  return true;
+}
+
+void arch_jump_label_transform(const jump_entry_t *entry, bool jump) {
+  u8 *code = (u8 *)&entry->code + entry->code;
+  u8 *target = (u8 *)&entry->target + entry->target;
+  s32 rel = (s32)(target - (code + JUMP_LABEL_INSN_SIZE));
+
+  u8 jmp[JUMP_LABEL_INSN_SIZE] = {0xe9, (u8)rel, (u8)(rel >> 8), (u8)(rel >> 16), (u8)(rel >> 24)};
+  const u8 *want = jump ? jmp : jump_label_nop;
+
+  if (jump_label_same(code, want))
+    return;
+
+  const u8 *expect = jump ? jump_label_nop : jmp;
+  if (!jump_label_same(code, expect))
+    klog_panic("jump_label: sito %p non riconosciuto (%x %x %x %x %x)", code, code[0], code[1], code[2], code[3], code[4]);
+
+  text_poke_bp(code, want, JUMP_LABEL_INSN_SIZE);
+}
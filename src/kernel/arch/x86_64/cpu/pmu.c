@@ -0,0 +1,333 @@
+/**
+ * @file arch/x86_64/cpu/pmu.c
+ * @brief PMU architetturale Intel (CPUID 0xA) - implementazione
+ *
+ * CPUID 0xA descrive la PMU in modo indipendente dal modello:
+ * - EAX: versione, numero e larghezza dei contatori general-purpose
+ * - EBX: eventi architetturali NON disponibili (un bit per evento)
+ * - EDX: numero e larghezza dei contatori fissi (versione >= 2)
+ *
+ * Assegnazione dei contatori:
+ * - Istruzioni, cicli e cicli di riferimento usano i contatori fissi 0-2
+ *   quando ci sono; altrimenti l'evento architetturale equivalente su un
+ *   contatore general-purpose
+ * - LLC miss e branch miss sono eventi architetturali su contatori
+ *   general-purpose
+ * - Le miss del dTLB non sono architetturali: si usa la codifica
+ *   DTLB_LOAD_MISSES.MISS_CAUSES_A_WALK (0x08/0x01) delle CPU Intel
+ *   "core" di famiglia 6, solo se resta un contatore libero
+ *
+ * La PMU viene usata solo se la versione è >= 1 e c'è almeno un contatore:
+ * sotto TCG o su CPU AMD CPUID 0xA vale 0 e si ricade sul TSC per i cicli.
+ * Accedere a un contatore inesistente causa #GP, quindi si leggono solo
+ * i contatori assegnati qui.
+ *
+ * Sotto KVM la PMU virtuale è esposta con "-cpu host" (o pmu=on).
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include <arch/cpu.h>
+#include <arch/pmu.h>
+#include <arch/x86_64/cpu/cpu_lowlevel.h>
+#include <arch/x86_64/cpu/pmu_overflow.h>
+#include <klib/klog/klog.h>
+#include <lib/cache.h>
+
+/* ============================================================
+ *  MSR E CODIFICHE
+ * ============================================================ */
+#define MSR_IA32_PMC0 0x0C1
+#define MSR_IA32_PERFEVTSEL0 0x186
+#define MSR_IA32_FIXED_CTR0 0x309
+#define MSR_IA32_FIXED_CTR_CTRL 0x38D
+#define MSR_IA32_PERF_GLOBAL_STATUS 0x38E
+#define MSR_IA32_PERF_GLOBAL_CTRL 0x38F
+#define MSR_IA32_PERF_GLOBAL_OVF_CTRL 0x390
+
+#define PERFEVTSEL_USR (1UL << 16)
+#define PERFEVTSEL_OS (1UL << 17)
+#define PERFEVTSEL_INT (1UL << 20)
+#define PERFEVTSEL_EN (1UL << 22)
+
+#define FIXED_CTR_CTRL_OS_USR 0x3 // Conta in ring 0 e ring 3 (4 bit per contatore)
+
+#define RDPMC_FIXED (1U << 30) // Indice rdpmc dei contatori fissi
+
+#define PMU_MAX_GP 8
+#define PMU_MAX_FIXED 3
+
+// Bit di CPUID.0xA:EBX (1 = evento NON disponibile)
+#define PMU_ARCH_CYCLES_BIT 0
+#define PMU_ARCH_INSTRUCTIONS_BIT 1
+#define PMU_ARCH_REF_CYCLES_BIT 2
+#define PMU_ARCH_LLC_MISSES_BIT 4
+#define PMU_ARCH_BRANCH_MISSES_BIT 6
+
+typedef struct {
+  u8 event;
+  u8 umask;
+  s8 arch_bit;     // Bit in CPUID.0xA:EBX, -1 se non architetturale
+  s8 fixed;        // Contatore fisso equivalente, -1 se nessuno
+  bool intel_core; // Codifica valida solo su Intel famiglia 6
+} pmu_event_desc_t;
+
+static const pmu_event_desc_t pmu_event_descs[PMU_EVENT_COUNT] = {
+    [PMU_EVENT_CYCLES] = {0x3C, 0x00, PMU_ARCH_CYCLES_BIT, 1, false},
+    [PMU_EVENT_INSTRUCTIONS] = {0xC0, 0x00, PMU_ARCH_INSTRUCTIONS_BIT, 0, false},
+    [PMU_EVENT_REF_CYCLES] = {0x3C, 0x01, PMU_ARCH_REF_CYCLES_BIT, 2, false},
+    [PMU_EVENT_LLC_MISSES] = {0x2E, 0x41, PMU_ARCH_LLC_MISSES_BIT, -1, false},
+    [PMU_EVENT_DTLB_MISSES] = {0x08, 0x01, -1, -1, true},
+    [PMU_EVENT_BRANCH_MISSES] = {0xC5, 0x00, PMU_ARCH_BRANCH_MISSES_BIT, -1, false},
+};
+
+/* ============================================================
+ *  STATO
+ * ============================================================ */
+typedef enum {
+  PMU_SLOT_NONE,  // Evento non contato
+  PMU_SLOT_GP,    // Contatore general-purpose
+  PMU_SLOT_FIXED, // Contatore fisso
+  PMU_SLOT_TSC,   // Fallback: time stamp counter
+} pmu_slot_kind_t;
+
+typedef struct {
+  pmu_slot_kind_t kind;
+  u8 index;  // Indice del contatore nel suo gruppo
+  u64 mask;  // Larghezza del contatore
+} pmu_slot_t;
+
+// Identica su tutte le CPU: scritta al boot, poi solo letta
+static struct {
+  bool active; // PMU architetturale in uso
+  u8 version;
+  u8 gp_count;
+  u8 fixed_count;
+  u8 gp_used;
+  u64 gp_mask;            // Larghezza dei contatori GP
+  u64 evtsel[PMU_MAX_GP]; // Programmazione dei contatori GP
+  u64 fixed_ctrl;         // IA32_FIXED_CTR_CTRL
+  u64 global_ctrl;        // IA32_PERF_GLOBAL_CTRL
+  pmu_slot_t slots[PMU_EVENT_COUNT];
+} pmu_state __read_mostly;
+
+/* ============================================================
+ *  UTILITY
+ * ============================================================ */
+static inline u64 pmu_rdpmc(u32 index) {
+  u32 lo, hi;
+  __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(index));
+  return ((u64)hi << 32) | lo;
+}
+
+static inline u64 pmu_width_mask(u32 bits) {
+  return bits >= 64 ? ~0UL : (1UL << bits) - 1;
+}
+
+static bool pmu_is_intel_core(void) {
+  u32 ebx, ecx, edx, eax;
+  cpu_cpuid(0x00, 0, NULL, &ebx, &ecx, &edx);
+  // "GenuineIntel"
+  if (ebx != 0x756e6547 || edx != 0x49656e69 || ecx != 0x6c65746e)
+    return false;
+  cpu_cpuid(0x01, 0, &eax, NULL, NULL, NULL);
+  return ((eax >> 8) & 0xF) == 6;
+}
+
+/**
+ * Rileva la PMU e decide quale contatore conta ogni evento.
+ */
+static void pmu_probe(void) {
+  u32 max_leaf, eax, ebx, edx;
+
+  for (int e = 0; e < PMU_EVENT_COUNT; e++)
+    pmu_state.slots[e].kind = PMU_SLOT_NONE;
+
+  cpu_cpuid(0x00, 0, &max_leaf, NULL, NULL, NULL);
+  if (max_leaf >= 0x0A) {
+    cpu_cpuid(0x0A, 0, &eax, &ebx, NULL, &edx);
+    pmu_state.version = eax & 0xFF;
+    pmu_state.gp_count = (eax >> 8) & 0xFF;
+    if (pmu_state.gp_count > PMU_MAX_GP)
+      pmu_state.gp_count = PMU_MAX_GP;
+    if (pmu_state.version >= 2) {
+      pmu_state.fixed_count = edx & 0x1F;
+      if (pmu_state.fixed_count > PMU_MAX_FIXED)
+        pmu_state.fixed_count = PMU_MAX_FIXED;
+    }
+  }
+
+  if (pmu_state.version == 0 || (pmu_state.gp_count == 0 && pmu_state.fixed_count == 0)) {
+    pmu_state.slots[PMU_EVENT_CYCLES] = (pmu_slot_t){PMU_SLOT_TSC, 0, ~0UL};
+    return;
+  }
+
+  u32 ebx_len = (eax >> 24) & 0xFF; // Bit validi di EBX
+  u64 gp_mask = pmu_width_mask((eax >> 16) & 0xFF);
+  pmu_state.gp_mask = gp_mask;
+  u64 fixed_mask = pmu_width_mask((edx >> 5) & 0xFF);
+  bool intel_core = pmu_is_intel_core();
+
+  for (int e = 0; e < PMU_EVENT_COUNT; e++) {
+    const pmu_event_desc_t *desc = &pmu_event_descs[e];
+
+    if (desc->fixed >= 0 && desc->fixed < pmu_state.fixed_count) {
+      pmu_state.slots[e] = (pmu_slot_t){PMU_SLOT_FIXED, (u8)desc->fixed, fixed_mask};
+      pmu_state.fixed_ctrl |= (u64)FIXED_CTR_CTRL_OS_USR << (desc->fixed * 4);
+      pmu_state.global_ctrl |= 1UL << (32 + desc->fixed);
+      continue;
+    }
+
+    if (desc->arch_bit >= 0 && ((u32)desc->arch_bit >= ebx_len || (ebx >> desc->arch_bit) & 1))
+      continue;
+    if (desc->intel_core && !intel_core)
+      continue;
+    if (pmu_state.gp_used >= pmu_state.gp_count)
+      continue;
+
+    u8 gp = pmu_state.gp_used++;
+    pmu_state.evtsel[gp] = desc->event | ((u64)desc->umask << 8) | PERFEVTSEL_USR | PERFEVTSEL_OS | PERFEVTSEL_EN;
+    pmu_state.global_ctrl |= 1UL << gp;
+    pmu_state.slots[e] = (pmu_slot_t){PMU_SLOT_GP, gp, gp_mask};
+  }
+
+  // Senza contatore di cicli si ripiega comunque sul TSC
+  if (pmu_state.slots[PMU_EVENT_CYCLES].kind == PMU_SLOT_NONE)
+    pmu_state.slots[PMU_EVENT_CYCLES] = (pmu_slot_t){PMU_SLOT_TSC, 0, ~0UL};
+
+  pmu_state.active = true;
+}
+
+/* ============================================================
+ *  API
+ * ============================================================ */
+bool arch_pmu_init(void) {
+  pmu_probe();
+  arch_pmu_cpu_init();
+
+  if (!pmu_state.active) {
+    klog_warn("PMU: nessuna PMU architetturale (CPUID 0xA), solo cicli via TSC");
+    return false;
+  }
+
+  klog_info("PMU: versione %u, %u contatori GP (%u usati), %u fissi", pmu_state.version, pmu_state.gp_count, pmu_state.gp_used, pmu_state.fixed_count);
+  return true;
+}
+
+void arch_pmu_cpu_init(void) {
+  if (!pmu_state.active)
+    return;
+
+  // Fermi durante la programmazione: nessun conteggio parziale
+  if (pmu_state.version >= 2)
+    cpu_wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, 0);
+
+  for (u8 gp = 0; gp < pmu_state.gp_count; gp++) {
+    cpu_wrmsr(MSR_IA32_PERFEVTSEL0 + gp, gp < pmu_state.gp_used ? pmu_state.evtsel[gp] : 0);
+    cpu_wrmsr(MSR_IA32_PMC0 + gp, 0);
+  }
+
+  if (pmu_state.fixed_count > 0) {
+    cpu_wrmsr(MSR_IA32_FIXED_CTR_CTRL, pmu_state.fixed_ctrl);
+    for (u8 f = 0; f < pmu_state.fixed_count; f++)
+      cpu_wrmsr(MSR_IA32_FIXED_CTR0 + f, 0);
+  }
+
+  if (pmu_state.version >= 2)
+    cpu_wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, pmu_state.global_ctrl);
+}
+
+const char *arch_pmu_name(void) {
+  return pmu_state.active ? "intel-arch" : "tsc";
+}
+
+bool arch_pmu_supported(pmu_event_t event) {
+  return event < PMU_EVENT_COUNT && pmu_state.slots[event].kind != PMU_SLOT_NONE;
+}
+
+void arch_pmu_read(uint64_t values[PMU_EVENT_COUNT]) {
+  for (int e = 0; e < PMU_EVENT_COUNT; e++) {
+    const pmu_slot_t *slot = &pmu_state.slots[e];
+    switch (slot->kind) {
+    case PMU_SLOT_GP:
+      values[e] = pmu_rdpmc(slot->index);
+      break;
+    case PMU_SLOT_FIXED:
+      values[e] = pmu_rdpmc(RDPMC_FIXED | slot->index);
+      break;
+    case PMU_SLOT_TSC:
+      values[e] = arch_cpu_cycles();
+      break;
+    default:
+      values[e] = 0;
+      break;
+    }
+  }
+}
+
+uint64_t arch_pmu_counter_mask(pmu_event_t event) {
+  if (event >= PMU_EVENT_COUNT || pmu_state.slots[event].kind == PMU_SLOT_NONE)
+    return 0;
+  return pmu_state.slots[event].mask;
+}
+
+/* ============================================================
+ *  CAMPIONAMENTO SU OVERFLOW
+ * ============================================================ */
+
+// Stato della CPU che campiona (una sola finché non ci sono AP)
+static u64 pmu_overflow_period;
+static s8 pmu_overflow_gp = -1;
+
+bool x86_64_pmu_overflow_start(u64 period) {
+  if (!pmu_state.active || pmu_state.gp_used >= pmu_state.gp_count || period == 0 || period >= (1UL << 31))
+    return false;
+
+  u8 gp = pmu_state.gp_used;
+  pmu_overflow_gp = (s8)gp;
+  pmu_overflow_period = period;
+
+  const pmu_event_desc_t *cycles = &pmu_event_descs[PMU_EVENT_CYCLES];
+  cpu_wrmsr(MSR_IA32_PERFEVTSEL0 + gp, 0);
+  // La scrittura legacy del PMC estende il segno dei 32 bit bassi
+  cpu_wrmsr(MSR_IA32_PMC0 + gp, (-period) & pmu_state.gp_mask);
+  cpu_wrmsr(MSR_IA32_PERFEVTSEL0 + gp, cycles->event | ((u64)cycles->umask << 8) | PERFEVTSEL_OS | PERFEVTSEL_INT | PERFEVTSEL_EN);
+
+  if (pmu_state.version >= 2)
+    cpu_wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, pmu_state.global_ctrl | (1UL << gp));
+  return true;
+}
+
+void x86_64_pmu_overflow_stop(void) {
+  if (pmu_overflow_gp < 0)
+    return;
+
+  cpu_wrmsr(MSR_IA32_PERFEVTSEL0 + pmu_overflow_gp, 0);
+  if (pmu_state.version >= 2) {
+    cpu_wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, pmu_state.global_ctrl);
+    cpu_wrmsr(MSR_IA32_PERF_GLOBAL_OVF_CTRL, 1UL << pmu_overflow_gp);
+  }
+  pmu_overflow_gp = -1;
+}
+
+bool x86_64_pmu_overflow_ack(void) {
+  if (pmu_overflow_gp < 0)
+    return false;
+
+  u8 gp = (u8)pmu_overflow_gp;
+  bool overflow;
+  if (pmu_state.version >= 2) {
+    overflow = (cpu_rdmsr(MSR_IA32_PERF_GLOBAL_STATUS) >> gp) & 1;
+  } else {
+    // Senza registro di stato: dopo l'overflow il contatore riparte da 0
+    overflow = pmu_rdpmc(gp) < pmu_overflow_period;
+  }
+  if (!overflow)
+    return false;
+
+  cpu_wrmsr(MSR_IA32_PMC0 + gp, (-pmu_overflow_period) & pmu_state.gp_mask);
+  if (pmu_state.version >= 2)
+    cpu_wrmsr(MSR_IA32_PERF_GLOBAL_OVF_CTRL, 1UL << gp);
+  return true;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file arch/x86_64/cpu/pmu_overflow.h
+ * @brief Campionamento sull'overflow di un contatore PMU (x86_64)
+ *
+ * Usa un contatore general-purpose rimasto libero dopo l'assegnazione
+ * degli eventi di arch_pmu_init(): le misure di <arch/pmu.h> non vengono
+ * disturbate. Il contatore conta i cicli non halted ed è precaricato a
+ * -period, così va in overflow (e genera un PMI) ogni period cicli.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/**
+ * @brief Programma il contatore di campionamento sulla CPU corrente
+ *
+ * @param period Cicli fra due overflow (< 2^31)
+ * @return false senza PMU o senza un contatore libero
+ */
+bool x86_64_pmu_overflow_start(u64 period);
+
+/**
+ * @brief Ferma il contatore di campionamento
+ */
+void x86_64_pmu_overflow_stop(void);
+
+/**
+ * @brief Verifica se l'NMI corrente viene dal contatore e lo riarma
+ *
+ * @return true se il contatore era in overflow
+ */
+bool x86_64_pmu_overflow_ack(void);
@@ -0,0 +1,93 @@
+/**
+ * @file arch/x86_64/cpu/sampling.c
+ * @brief Sorgenti di campionamento (x86_64) - implementazione
+ *
+ * - ARCH_SAMPLE_TIMER: timer periodico del local APIC su
+ *   LAPIC_VECTOR_TIMER. È un interrupt mascherabile: le sezioni con IF=0
+ *   vengono attribuite al punto in cui gli interrupt tornano abilitati
+ * - ARCH_SAMPLE_PMU: overflow del contatore di cicli consegnato come NMI,
+ *   quindi campiona anche il codice con gli interrupt disabilitati
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include <arch/cpu.h>
+#include <arch/sampling.h>
+#include <arch/x86_64/apic/lapic.h>
+#include <arch/x86_64/cpu/pmu_overflow.h>
+#include <arch/x86_64/idt/idt.h>
+#include <klib/klog/klog.h>
+
+static arch_sample_handler_t sampling_handler;
+static arch_sample_source_t sampling_source;
+static bool sampling_active = false;
+
+static void sampling_timer_irq(x86_64_irq_frame_t *frame) {
+  arch_sample_handler_t handler = sampling_handler;
+  if (handler)
+    handler(frame->rip, frame->rbp, frame->rsp);
+  x86_64_lapic_eoi();
+}
+
+static void sampling_pmu_nmi(x86_64_irq_frame_t *frame) {
+  if (!x86_64_pmu_overflow_ack())
+    return; // NMI di un'altra sorgente
+
+  arch_sample_handler_t handler = sampling_handler;
+  if (handler)
+    handler(frame->rip, frame->rbp, frame->rsp);
+
+  // La consegna del PMI maschera la voce LVT: va riarmata
+  x86_64_lapic_perfmon_nmi(true);
+}
+
+static void sampling_spurious_irq(x86_64_irq_frame_t *frame) {
+  (void)frame; // Nessun EOI per lo spurious
+}
+
+bool arch_sampling_start(arch_sample_source_t source, uint32_t hz, arch_sample_handler_t handler) {
+  if (sampling_active || hz == 0)
+    return false;
+  if (!x86_64_lapic_ready() && !x86_64_lapic_init())
+    return false;
+
+  sampling_handler = handler;
+  x86_64_idt_set_handler(LAPIC_VECTOR_SPURIOUS, sampling_spurious_irq);
+
+  if (source == ARCH_SAMPLE_TIMER) {
+    x86_64_idt_set_handler(LAPIC_VECTOR_TIMER, sampling_timer_irq);
+    x86_64_lapic_timer_start(LAPIC_VECTOR_TIMER, hz);
+    arch_cpu_enable_interrupts();
+  } else {
+    u64 cpu_hz = x86_64_lapic_tsc_hz();
+    if (cpu_hz == 0 || !x86_64_pmu_overflow_start(cpu_hz / hz)) {
+      klog_warn("sampling: overflow PMU non disponibile");
+      sampling_handler = NULL;
+      return false;
+    }
+    x86_64_idt_set_handler(IDT_VECTOR_NMI, sampling_pmu_nmi);
+    x86_64_lapic_perfmon_nmi(true);
+  }
+
+  sampling_source = source;
+  sampling_active = true;
+  return true;
+}
+
+void arch_sampling_stop(void) {
+  if (!sampling_active)
+    return;
+
+  // Gli handler restano registrati: un interrupt già in volo deve
+  // comunque ricevere l'EOI (o essere riconosciuto come NMI nostro)
+  if (sampling_source == ARCH_SAMPLE_TIMER) {
+    x86_64_lapic_timer_stop();
+  } else {
+    x86_64_lapic_perfmon_nmi(false);
+    x86_64_pmu_overflow_stop();
+  }
+
+  sampling_handler = NULL;
+  sampling_active = false;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file arch/x86_64/cpu/tick.c
+ * @brief Tick periodico del kernel (x86_64) - implementazione
+ *
+ * Timer periodico del local APIC su LAPIC_VECTOR_TIMER, lo stesso vettore
+ * del campionamento a timer: l'handler del tick sostituisce quello del
+ * profiler, che a quel punto è già fermo.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include <arch/tick.h>
+#include <arch/x86_64/apic/lapic.h>
+#include <arch/x86_64/idt/idt.h>
+
+static volatile u64 tick_count = 0;
+static bool tick_active = false;
+
+static void tick_timer_irq(x86_64_irq_frame_t *frame) {
+  (void)frame;
+  tick_count++;
+  x86_64_lapic_eoi();
+}
+
+static void tick_spurious_irq(x86_64_irq_frame_t *frame) {
+  (void)frame; // Nessun EOI per lo spurious
+}
+
+bool arch_tick_start(uint32_t hz) {
+  if (tick_active || hz == 0)
+    return false;
+  if (!x86_64_lapic_ready() && !x86_64_lapic_init())
+    return false;
+
+  x86_64_idt_set_handler(LAPIC_VECTOR_SPURIOUS, tick_spurious_irq);
+  x86_64_idt_set_handler(LAPIC_VECTOR_TIMER, tick_timer_irq);
+  x86_64_lapic_timer_start(LAPIC_VECTOR_TIMER, hz);
+  tick_active = true;
+  return true;
+}
+
+uint64_t arch_tick_count(void) {
+  return tick_count;
+}
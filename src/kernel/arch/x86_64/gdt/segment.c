@@ -11,6 +11,8 @@
 /* Header privato del backend GDT/TSS */
 #include "gdt.h"
 
+#include <arch/x86_64/cpu/alternative.h>
+#include <arch/x86_64/idt/idt.h>
 #include <klib/klog/klog.h>
 
 void arch_segment_init(void) {
@@ -19,4 +21,9 @@ void arch_segment_init(void) {
 
   /* Log dopo il load: ora i registri segmento sono coerenti */
   klog_info("arch[x86_64]: segment initialized (GDT/TSS)\n");
+
+  /* IDT dopo la GDT: i gate usano il nostro selettore di codice.
+     Da qui le eccezioni diventano panic leggibili invece di un triple fault */
+  x86_64_idt_init();
+  x86_64_text_poke_init(); // #BP dei siti in riscrittura e IPI di sync
 }
@@ -0,0 +1,106 @@
+/**
+ * @file arch/x86_64/idt/idt.c
+ * @brief Interrupt Descriptor Table (x86_64) - implementazione
+ *
+ * Ogni voce è un interrupt gate a 64 bit (IF azzerato all'ingresso) sul
+ * selettore di codice del kernel, verso lo stub corrispondente di
+ * idt_asm.s.
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#include "idt.h"
+#include <klib/klog/klog.h>
+#include <klib/ksym/ksym.h>
+#include <mm/vmm_fault.h>
+
+#define IDT_KERNEL_CS 0x08
+#define IDT_GATE_INTERRUPT 0x8E // Present, DPL 0, interrupt gate a 64 bit
+
+typedef struct {
+  u16 offset_low;
+  u16 selector;
+  u8 ist;
+  u8 type_attr;
+  u16 offset_mid;
+  u32 offset_high;
+  u32 reserved;
+} __attribute__((packed)) idt_gate_t;
+
+typedef struct {
+  u16 limit;
+  u64 base;
+} __attribute__((packed)) idt_pointer_t;
+
+extern const u64 x86_64_isr_stub_table[IDT_VECTORS];
+
+static idt_gate_t idt[IDT_VECTORS] __attribute__((aligned(16)));
+static idt_pointer_t idt_pointer;
+static x86_64_irq_handler_t idt_handlers[IDT_VECTORS];
+
+static const char *const idt_exception_names[IDT_EXCEPTIONS] = {
+    "#DE divide error", "#DB debug", "NMI", "#BP breakpoint", "#OF overflow", "#BR bound range", "#UD invalid opcode", "#NM device not available",
+    "#DF double fault", "coprocessor overrun", "#TS invalid TSS", "#NP segment not present", "#SS stack fault", "#GP general protection", "#PF page fault", "reserved",
+    "#MF x87 error", "#AC alignment check", "#MC machine check", "#XM SIMD error", "#VE virtualization", "#CP control protection", "reserved", "reserved",
+    "reserved", "reserved", "reserved", "reserved", "#HV hypervisor injection", "#VC VMM communication", "#SX security", "reserved",
+};
+
+static void idt_set_gate(u8 vector, u64 stub) {
+  idt_gate_t *gate = &idt[vector];
+  gate->offset_low = stub & 0xFFFF;
+  gate->selector = IDT_KERNEL_CS;
+  gate->ist = 0;
+  gate->type_attr = IDT_GATE_INTERRUPT;
+  gate->offset_mid = (stub >> 16) & 0xFFFF;
+  gate->offset_high = (u32)(stub >> 32);
+  gate->reserved = 0;
+}
+
+static void idt_exception_panic(x86_64_irq_frame_t *frame, u64 cr2) {
+  char where[96];
+  ksym_snprint(where, sizeof(where), frame->rip);
+  klog_panic("Eccezione %lu (%s) a RIP=0x%lx <%s> err=0x%lx CR2=0x%lx RSP=0x%lx", frame->vector, idt_exception_names[frame->vector], frame->rip, where, frame->error_code, cr2, frame->rsp);
+}
+
+// Demand paging, zero page e COW break: solo i fault che il VMM rifiuta sono fatali
+static void idt_page_fault(x86_64_irq_frame_t *frame) {
+  u64 cr2;
+  __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+  if (!vmm_handle_page_fault(cr2, frame->error_code, frame->rip))
+    idt_exception_panic(frame, cr2);
+}
+
+void x86_64_idt_init(void) {
+  for (u32 v = 0; v < IDT_VECTORS; v++)
+    idt_set_gate((u8)v, x86_64_isr_stub_table[v]);
+
+  x86_64_idt_set_handler(IDT_VECTOR_PAGE_FAULT, idt_page_fault);
+
+  idt_pointer.limit = sizeof(idt) - 1;
+  idt_pointer.base = (u64)&idt;
+  x86_64_idt_load();
+
+  klog_info("IDT initialized (%u vettori)", IDT_VECTORS);
+}
+
+void x86_64_idt_load(void) {
+  __asm__ volatile("lidt %0" ::"m"(idt_pointer));
+}
+
+void x86_64_idt_set_handler(u8 vector, x86_64_irq_handler_t handler) {
+  __atomic_store_n(&idt_handlers[vector], handler, __ATOMIC_RELEASE);
+}
+
+void x86_64_idt_dispatch(x86_64_irq_frame_t *frame) {
+  x86_64_irq_handler_t handler = __atomic_load_n(&idt_handlers[frame->vector & 0xFF], __ATOMIC_ACQUIRE);
+  if (handler) {
+    handler(frame);
+    return;
+  }
+
+  if (frame->vector < IDT_EXCEPTIONS)
+    idt_exception_panic(frame, 0);
+
+  klog_warn("IDT: interrupt %lu senza handler", frame->vector);
+}
@@ -0,0 +1,63 @@
+/**
+ * @file arch/x86_64/idt/idt.h
+ * @brief Interrupt Descriptor Table (x86_64)
+ *
+ * Tutti i 256 vettori passano da uno stub NASM comune (idt_asm.s) che
+ * salva i registri general-purpose e chiama x86_64_idt_dispatch() con il
+ * frame completo. Il dispatcher chiama l'handler registrato per il
+ * vettore; le eccezioni senza handler fermano il kernel con un panic che
+ * riporta vettore, RIP e codice d'errore. Il #PF è registrato da
+ * x86_64_idt_init() e passa al VMM (vmm_handle_page_fault()): il panic
+ * arriva solo per i fault che il VMM non sa risolvere.
+ *
+ * Il kernel non ha ancora ring 3: gli stub non eseguono swapgs e tutti i
+ * vettori usano lo stack corrente (nessuno stack IST).
+ *
+ * @author Enzo Tasca
+ * @date 2025
+ */
+
+#pragma once
+#include <lib/types.h>
+
+#define IDT_VECTORS 256
+#define IDT_EXCEPTIONS 32
+
+#define IDT_VECTOR_NMI 2
+#define IDT_VECTOR_PAGE_FAULT 14
+
+/**
+ * @brief Stato salvato all'ingresso di un interrupt
+ *
+ * L'ordine rispecchia le push di idt_asm.s: registri (dall'ultimo
+ * salvato), vettore e codice d'errore degli stub, frame della CPU.
+ */
+typedef struct {
+  u64 r15, r14, r13, r12, r11, r10, r9, r8;
+  u64 rbp, rdi, rsi, rdx, rcx, rbx, rax;
+  u64 vector;
+  u64 error_code; // 0 per i vettori che non ne hanno uno
+  u64 rip, cs, rflags, rsp, ss;
+} x86_64_irq_frame_t;
+
+typedef void (*x86_64_irq_handler_t)(x86_64_irq_frame_t *frame);
+
+/**
+ * @brief Costruisce e carica l'IDT della CPU corrente
+ */
+void x86_64_idt_init(void);
+
+/**
+ * @brief Carica l'IDT già costruita (AP dopo il bring-up)
+ */
+void x86_64_idt_load(void);
+
+/**
+ * @brief Registra l'handler di un vettore (NULL = nessuno)
+ */
+void x86_64_idt_set_handler(u8 vector, x86_64_irq_handler_t handler);
+
+/**
+ * @brief Punto d'ingresso C di tutti gli stub
+ */
+void x86_64_idt_dispatch(x86_64_irq_frame_t *frame);
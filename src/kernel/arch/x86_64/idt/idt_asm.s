@@ -0,0 +1,77 @@
+; ==============================================================================
+;  File: idt_asm.s
+;  Description: Stub d'ingresso dei 256 vettori dell'IDT (vedi idt.h)
+;               Ogni stub uniforma lo stack (codice d'errore fittizio dove la
+;               CPU non lo fornisce), spinge il numero di vettore e salta allo
+;               stub comune, che salva i registri e chiama il dispatcher C.
+; ==============================================================================
+
+extern x86_64_idt_dispatch
+global x86_64_isr_stub_table
+
+; Vettori per cui la CPU spinge un codice d'errore
+%define HAS_ERROR_CODE(v) ((v) == 8 || ((v) >= 10 && (v) <= 14) || (v) == 17 || (v) == 21 || (v) == 29 || (v) == 30)
+
+section .text
+
+%assign vec 0
+%rep 256
+align 16
+isr_stub_ %+ vec:
+%if HAS_ERROR_CODE(vec) == 0
+    push    0              ; codice d'errore fittizio
+%endif
+    push    vec            ; numero di vettore
+    jmp     isr_common
+%assign vec vec + 1
+%endrep
+
+align 16
+isr_common:
+    push    rax
+    push    rbx
+    push    rcx
+    push    rdx
+    push    rsi
+    push    rdi
+    push    rbp
+    push    r8
+    push    r9
+    push    r10
+    push    r11
+    push    r12
+    push    r13
+    push    r14
+    push    r15
+
+    cld
+    mov     rdi, rsp       ; x86_64_irq_frame_t*
+    call    x86_64_idt_dispatch
+
+    pop     r15
+    pop     r14
+    pop     r13
+    pop     r12
+    pop     r11
+    pop     r10
+    pop     r9
+    pop     r8
+    pop     rbp
+    pop     rdi
+    pop     rsi
+    pop     rdx
+    pop     rcx
+    pop     rbx
+    pop     rax
+
+    add     rsp, 16        ; vettore e codice d'errore
+    iretq
+
+section .rodata
+align 8
+x86_64_isr_stub_table:
+%assign vec 0
+%rep 256
+    dq      isr_stub_ %+ vec
+%assign vec vec + 1
+%endrep
@@ -2,9 +2,13 @@
 #include "vmm_defs.h"
 #include <arch/x86_64/cpu/cpu_lowlevel.h>
 #include <klib/klog/klog.h>
+#include <klib/percpu_counter/percpu_counter.h>
+#include <klib/spinlock.h>
+#include <lib/cache.h>
 #include <lib/string/string.h>
 #include <lib/types.h>
 #include <mm/pmm.h>
+#include <mm/vmm_acct.h>
 
 /**
  * @file arch/x86_64/vmm_arch.c
@@ -38,6 +42,14 @@ struct vmm_space {
   vmm_x86_64_space_t arch; // Dati specifici x86_64
   u64 space_id;            // ID univoco per debug
   bool is_active;          // True se attualmente in uso
+
+  // Teardown asincrono (valido solo dopo vmm_x86_64_destroy_space)
+  struct vmm_space *teardown_next;             // Prossimo spazio in coda
+  vmm_x86_64_page_table_t *teardown_tables[4]; // Tabella corrente per livello (0 = PML4)
+  u16 teardown_index[4];                       // Prossima entry da visitare per livello
+  int teardown_depth;                          // Livello corrente del cursore
+
+  vmm_space_acct_t acct; // Contatori e limiti di memoria (mm/vmm_acct.h)
 };
 
 // Spazio di indirizzamento del kernel (singleton)
@@ -59,28 +71,36 @@ static struct vmm_space kernel_space = {
  * ============================================================================
  */
 
-static bool vmm_x86_64_initialized = false;
+static bool vmm_x86_64_initialized __read_mostly = false;
 static u64 next_space_id = 1;
 // Puntatore allo spazio attualmente attivo
 static struct vmm_space *active_space = &kernel_space;
 
 // True quando il direct map (phys→virt) è stato creato
-static bool direct_map_ready = false;
+static bool direct_map_ready __read_mostly = false;
+
+// Coda degli spazi staccati in attesa di teardown (FIFO)
+static spinlock_t teardown_lock __cacheline_aligned = SPINLOCK_INITIALIZER;
+static struct vmm_space *teardown_head = NULL;
+static struct vmm_space *teardown_tail = NULL;
 
-// Statistiche per debug
-// Statistiche per debug
+// Entry smontate subito da ogni destroy: la coda si svuota anche senza idle
+#define VMM_X86_64_TEARDOWN_INLINE_BUDGET 256
+
+// Statistiche per debug (i contatori del percorso map/unmap sono per-CPU)
 static struct {
   u64 spaces_created;
   u64 spaces_destroyed;
-  u64 pages_mapped;
-  u64 pages_unmapped;
-  u64 tlb_flushes;
-} vmm_x86_64_stats = {
+  percpu_counter_t pages_mapped;
+  percpu_counter_t pages_unmapped;
+  percpu_counter_t tlb_flushes;
+  u64 teardown_pending;     // Spazi staccati non ancora smontati
+  u64 teardown_pages_freed; // Page table e frame anonimi restituiti dal teardown
+} vmm_x86_64_stats __cacheline_aligned = {
     .spaces_created = 0,
     .spaces_destroyed = 0,
-    .pages_mapped = 0,
-    .pages_unmapped = 0,
-    .tlb_flushes = 0,
+    .teardown_pending = 0,
+    .teardown_pages_freed = 0,
 };
 
 /*
@@ -139,6 +159,7 @@ static bool alloc_page_table(vmm_x86_64_page_table_t **virt_addr, u64 *phys_addr
     klog_error("x86_64_vmm: Impossibile allocare page table dal PMM");
     return false;
   }
+  pmm_set_owner(page, 1, PMM_OWNER_PAGE_TABLE);
 
   *phys_addr = (u64)page;
 
@@ -174,25 +195,59 @@ static void free_page_table(vmm_x86_64_page_table_t *virt_addr) {
   }
 }
 
+/*
+ * ============================================================================
+ * CONTABILITÀ PER SPAZIO
+ * ============================================================================
+ *
+ * Ogni scrittura di una PTE foglia passa da acct_pte_change() con il
+ * valore vecchio e quello nuovo: la classe della pagina (anonima,
+ * condivisa, nessuna) e il bit pinned decidono quali contatori cambiano.
+ * Lo spazio kernel non è contabilizzato.
+ */
+
+// Frame della zero page globale, gestito dal VMM generico
+extern u64 vmm_zero_page_phys(void);
+
 /**
- * @brief Libera ricorsivamente le page table a partire da un livello
+ * @brief Voce RSS di una PTE, -1 se non conta (assente o zero page)
  */
-static void free_page_tables_recursive(vmm_x86_64_page_table_t *table, int level) {
-  if (!table || level <= 0)
+static inline int acct_pte_class(u64 raw) {
+  if (!VMM_X86_64_PTE_PRESENT(raw))
+    return -1;
+  if (raw & VMM_X86_64_ANON)
+    return VMM_ACCT_RSS_ANON;
+  if (VMM_X86_64_PTE_ADDR(raw) == vmm_zero_page_phys())
+    return -1;
+  return VMM_ACCT_RSS_SHARED;
+}
+
+static inline bool acct_pte_pinned(u64 raw) {
+  return VMM_X86_64_PTE_PRESENT(raw) && (raw & VMM_X86_64_PINNED);
+}
+
+static void acct_pte_change(vmm_space_t *space, u64 old_raw, u64 new_raw) {
+  if (space->arch.is_kernel_space)
     return;
 
-  if (level > 1) {
-    for (int i = 0; i < VMM_X86_64_ENTRIES_PER_TABLE; i++) {
-      vmm_x86_64_pte_t *entry = &table->entries[i];
-      if (VMM_X86_64_PTE_PRESENT(entry->raw)) {
-        vmm_x86_64_page_table_t *child = direct_map_ready ? (vmm_x86_64_page_table_t *)VMM_X86_64_PHYS_TO_VIRT(VMM_X86_64_PTE_ADDR(entry->raw))
-                                                          : (vmm_x86_64_page_table_t *)(uptr)VMM_X86_64_PTE_ADDR(entry->raw);
-        free_page_tables_recursive(child, level - 1);
-      }
-    }
+  int old_class = acct_pte_class(old_raw);
+  int new_class = acct_pte_class(new_raw);
+  if (old_class != new_class) {
+    if (old_class >= 0)
+      vmm_acct_add(&space->acct, (vmm_acct_item_t)old_class, -1);
+    if (new_class >= 0)
+      vmm_acct_add(&space->acct, (vmm_acct_item_t)new_class, 1);
   }
 
-  free_page_table(table);
+  bool old_pinned = acct_pte_pinned(old_raw);
+  bool new_pinned = acct_pte_pinned(new_raw);
+  if (old_pinned != new_pinned)
+    vmm_acct_add(&space->acct, VMM_ACCT_PINNED, new_pinned ? 1 : -1);
+}
+
+static inline void acct_page_tables(vmm_space_t *space, s64 tables) {
+  if (!space->arch.is_kernel_space)
+    vmm_acct_add(&space->acct, VMM_ACCT_PAGE_TABLES, tables);
 }
 
 /**
@@ -235,6 +290,7 @@ static vmm_x86_64_pte_t *page_walk(vmm_space_t *space, u64 virt_addr, bool creat
     }
 
     new_pdpt = true;
+    acct_page_tables(space, 1);
 
     // Imposta la entry PML4 (kernel: writable, present)
     u64 flags = VMM_X86_64_PRESENT | VMM_X86_64_WRITABLE;
@@ -265,11 +321,13 @@ static vmm_x86_64_pte_t *page_walk(vmm_space_t *space, u64 virt_addr, bool creat
       if (new_pdpt) {
         free_page_table(pdpt);
         pml4_entry->raw = 0;
+        acct_page_tables(space, -1);
       }
       return (vmm_x86_64_pte_t *)NULL;
     }
 
     new_pd = true;
+    acct_page_tables(space, 1);
 
     u64 flags = VMM_X86_64_PRESENT | VMM_X86_64_WRITABLE;
     if (!space->arch.is_kernel_space) {
@@ -299,13 +357,16 @@ static vmm_x86_64_pte_t *page_walk(vmm_space_t *space, u64 virt_addr, bool creat
       if (new_pd) {
         free_page_table(pd);
         pdpt_entry->raw = 0;
+        acct_page_tables(space, -1);
       }
       if (new_pdpt) {
         free_page_table(pdpt);
         pml4_entry->raw = 0;
+        acct_page_tables(space, -1);
       }
       return (vmm_x86_64_pte_t *)NULL;
     }
+    acct_page_tables(space, 1);
 
     u64 flags = VMM_X86_64_PRESENT | VMM_X86_64_WRITABLE;
     if (!space->arch.is_kernel_space) {
@@ -349,6 +410,11 @@ void vmm_x86_64_init_paging(void) {
   vmm_x86_64_enable_nx();
   klog_info("x86_64_vmm: Bit NX abilitato");
 
+  // Contatori per-CPU del percorso map/unmap
+  percpu_counter_init(&vmm_x86_64_stats.pages_mapped, 0, 0);
+  percpu_counter_init(&vmm_x86_64_stats.pages_unmapped, 0, 0);
+  percpu_counter_init(&vmm_x86_64_stats.tlb_flushes, 0, 0);
+
   // Crea lo spazio di indirizzamento del kernel
   if (!alloc_page_table(&kernel_space.arch.pml4, &kernel_space.arch.phys_pml4)) {
     klog_panic("x86_64_vmm: Impossibile creare PML4 kernel");
@@ -422,13 +488,16 @@ vmm_space_t *vmm_x86_64_create_space(void) {
 
   // Azzera la struttura
   memset(space, 0, sizeof(struct vmm_space));
+  vmm_acct_init(&space->acct);
 
   // Alloca PML4 per il nuovo spazio
   if (!alloc_page_table(&space->arch.pml4, &space->arch.phys_pml4)) {
     klog_error("x86_64_vmm: Impossibile allocare PML4");
+    vmm_acct_destroy(&space->acct);
     pmm_free_page(space);
     return NULL;
   }
+  vmm_acct_add(&space->acct, VMM_ACCT_PAGE_TABLES, 1);
 
   // Inizializza metadati
   space->arch.is_kernel_space = false;
@@ -452,8 +521,15 @@ vmm_space_t *vmm_x86_64_create_space(void) {
 /**
  * @brief Distrugge uno spazio di indirizzamento x86_64
  *
- * Libera ricorsivamente tutte le page table e la struttura dello spazio.
- * ATTENZIONE: Non libera le pagine fisiche mappate!
+ * Stacca la PML4 dallo spazio e lo mette in coda per il teardown: il costo
+ * è O(1) indipendentemente dalla dimensione dello spazio. Page table e
+ * frame anonimi vengono liberati da vmm_x86_64_teardown_work(), a budget
+ * limitato qui e poi dal loop di idle.
+ *
+ * Da qui in poi ogni page walk sullo spazio fallisce (pml4 == NULL), ma la
+ * struttura resta valida finché il teardown non è completo: chi conserva
+ * ancora un riferimento (es. il proprietario di una pagina CMA) non legge
+ * memoria già restituita al PMM.
  */
 void vmm_x86_64_destroy_space(vmm_space_t *space) {
   if (!space || space == &kernel_space) {
@@ -468,14 +544,188 @@ void vmm_x86_64_destroy_space(vmm_space_t *space) {
 
   klog_debug("x86_64_vmm: Distruggendo spazio ID=%lu", space->space_id);
 
-  if (space->arch.pml4) {
-    free_page_tables_recursive(space->arch.pml4, 4);
+  vmm_x86_64_page_table_t *pml4 = space->arch.pml4;
+  space->arch.pml4 = (vmm_x86_64_page_table_t *)NULL;
+  space->arch.phys_pml4 = 0;
+
+  if (!pml4) {
+    vmm_acct_destroy(&space->acct);
+    pmm_free_page(space);
+    vmm_x86_64_stats.spaces_destroyed++;
+    return;
   }
 
-  // Libera la struttura dello spazio
-  pmm_free_page(space);
+  space->teardown_next = (struct vmm_space *)NULL;
+  space->teardown_tables[0] = pml4;
+  space->teardown_index[0] = 0;
+  space->teardown_depth = 0;
+
+  spinlock_lock(&teardown_lock);
+  if (teardown_tail)
+    teardown_tail->teardown_next = space;
+  else
+    teardown_head = space;
+  teardown_tail = space;
+  vmm_x86_64_stats.teardown_pending++;
+  spinlock_unlock(&teardown_lock);
+
+  // Chi distrugge paga una quota limitata del teardown arretrato: il costo
+  // resta O(1) per chiamata e la coda non dipende solo dal loop di idle
+  vmm_x86_64_teardown_work(VMM_X86_64_TEARDOWN_INLINE_BUDGET);
+}
+
+/*
+ * ============================================================================
+ * TEARDOWN ASINCRONO
+ * ============================================================================
+ */
+
+#define VMM_X86_64_TEARDOWN_BATCH 64 // Pagine restituite al PMM per lock
+
+// Rilascio dei frame condivisi (KSM), implementato dal VMM generico
+extern void vmm_teardown_release_shared(vmm_space_t *space, u64 virt_addr, u64 phys_addr);
+
+typedef struct {
+  void *pages[VMM_X86_64_TEARDOWN_BATCH];
+  size_t count;
+} teardown_batch_t;
+
+static void teardown_batch_flush(teardown_batch_t *batch) {
+  if (batch->count == 0)
+    return;
+  vmm_x86_64_stats.teardown_pages_freed += pmm_free_pages_batch(batch->pages, batch->count);
+  batch->count = 0;
+}
 
-  vmm_x86_64_stats.spaces_destroyed++;
+static void teardown_batch_add(teardown_batch_t *batch, u64 phys) {
+  batch->pages[batch->count++] = (void *)phys;
+  if (batch->count == VMM_X86_64_TEARDOWN_BATCH)
+    teardown_batch_flush(batch);
+}
+
+static inline u64 teardown_table_phys(vmm_x86_64_page_table_t *table) {
+  return direct_map_ready ? VMM_X86_64_VIRT_TO_PHYS(table) : (u64)(uptr)table;
+}
+
+static inline vmm_x86_64_page_table_t *teardown_table_virt(u64 phys) {
+  return direct_map_ready ? (vmm_x86_64_page_table_t *)VMM_X86_64_PHYS_TO_VIRT(phys) : (vmm_x86_64_page_table_t *)(uptr)phys;
+}
+
+/**
+ * @brief Indirizzo virtuale della foglia sotto il cursore (solo metà utente)
+ */
+static inline u64 teardown_virt_addr(const struct vmm_space *space) {
+  return ((u64)space->teardown_index[0] << VMM_X86_64_PML4_SHIFT) | ((u64)space->teardown_index[1] << VMM_X86_64_PDPT_SHIFT) |
+         ((u64)space->teardown_index[2] << VMM_X86_64_PAGE_DIR_SHIFT) | ((u64)space->teardown_index[3] << VMM_X86_64_PAGE_TABLE_SHIFT);
+}
+
+/**
+ * @brief Avanza il cursore di teardown di uno spazio
+ *
+ * Visita in profondità solo la metà utente della PML4: le entry del kernel
+ * sono condivise con kernel_space e non vanno mai liberate. Ogni entry
+ * visitata consuma un'unità di budget, così il lavoro per chiamata è
+ * limitato e il cursore riprende dal punto esatto alla chiamata successiva.
+ *
+ * @return true se lo spazio è stato smontato completamente
+ */
+static bool teardown_step(struct vmm_space *space, teardown_batch_t *batch, size_t *budget) {
+  const size_t user_entries = VMM_X86_64_PML4_INDEX(VMM_X86_64_KERNEL_BASE);
+
+  while (*budget > 0) {
+    int depth = space->teardown_depth;
+    vmm_x86_64_page_table_t *table = space->teardown_tables[depth];
+    size_t limit = depth == 0 ? user_entries : VMM_X86_64_ENTRIES_PER_TABLE;
+    (*budget)--;
+
+    // Tabella esaurita: torna al PMM e il cursore risale di un livello
+    if (space->teardown_index[depth] >= limit) {
+      teardown_batch_add(batch, teardown_table_phys(table));
+      if (depth == 0)
+        return true;
+      space->teardown_depth--;
+      space->teardown_index[depth - 1]++;
+      continue;
+    }
+
+    u64 entry = table->entries[space->teardown_index[depth]].raw;
+
+    if (VMM_X86_64_PTE_PRESENT(entry) && depth < 3 && !(entry & VMM_X86_64_PAGE_SIZE)) {
+      space->teardown_tables[depth + 1] = teardown_table_virt(VMM_X86_64_PTE_ADDR(entry));
+      space->teardown_index[depth + 1] = 0;
+      space->teardown_depth++;
+      continue;
+    }
+
+    // Foglia 4KB: i frame privati tornano al PMM, quelli condivisi a KSM.
+    // Le altre mappature (MMIO, memoria del chiamante) non sono dello spazio.
+    if (VMM_X86_64_PTE_PRESENT(entry) && depth == 3) {
+      u64 phys = VMM_X86_64_PTE_ADDR(entry);
+      if (entry & VMM_X86_64_ANON)
+        teardown_batch_add(batch, phys);
+      else if (entry & VMM_X86_64_COW)
+        vmm_teardown_release_shared((vmm_space_t *)space, teardown_virt_addr(space), phys);
+    }
+
+    space->teardown_index[depth]++;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Avanza la distruzione asincrona degli spazi in coda
+ *
+ * Lo spazio in lavorazione viene tolto dalla coda per tutta la durata del
+ * passaggio, quindi più chiamanti concorrenti lavorano su spazi diversi.
+ *
+ * @param budget Entry di page table massime da visitare
+ * @return Entry visitate (0 = coda vuota)
+ */
+size_t vmm_x86_64_teardown_work(size_t budget) {
+  teardown_batch_t batch;
+  batch.count = 0;
+  size_t initial_budget = budget;
+
+  while (budget > 0) {
+    spinlock_lock(&teardown_lock);
+    struct vmm_space *space = teardown_head;
+    if (space) {
+      teardown_head = space->teardown_next;
+      if (!teardown_head)
+        teardown_tail = (struct vmm_space *)NULL;
+    }
+    spinlock_unlock(&teardown_lock);
+
+    if (!space)
+      break;
+
+    if (!teardown_step(space, &batch, &budget)) {
+      // Budget esaurito: lo spazio torna in testa per il prossimo passaggio
+      spinlock_lock(&teardown_lock);
+      space->teardown_next = teardown_head;
+      teardown_head = space;
+      if (!teardown_tail)
+        teardown_tail = space;
+      spinlock_unlock(&teardown_lock);
+      break;
+    }
+
+    klog_debug("x86_64_vmm: Teardown completato per spazio ID=%lu", space->space_id);
+
+    // La struttura dello spazio va per ultima, nello stesso batch dei suoi frame
+    vmm_acct_destroy(&space->acct);
+    teardown_batch_add(&batch, (u64)(uptr)space);
+
+    spinlock_lock(&teardown_lock);
+    vmm_x86_64_stats.teardown_pending--;
+    vmm_x86_64_stats.spaces_destroyed++;
+    spinlock_unlock(&teardown_lock);
+  }
+
+  teardown_batch_flush(&batch);
+
+  return initial_budget - budget;
 }
 
 /**
@@ -507,7 +757,7 @@ void vmm_x86_64_switch_space(vmm_space_t *space) {
   active_space = (struct vmm_space *)space;
   vmm_x86_64_write_cr3(new_cr3);
 
-  vmm_x86_64_stats.tlb_flushes++;
+  percpu_counter_inc(&vmm_x86_64_stats.tlb_flushes);
 
   klog_debug("x86_64_vmm: Switch a spazio ID=%lu (CR3=0x%016lx)", space->space_id, new_cr3);
 }
@@ -551,14 +801,14 @@ bool vmm_x86_64_map_pages(vmm_space_t *space, u64 virt_addr, u64 phys_addr, size
         u64 rb_virt = virt_addr + (j * PAGE_SIZE);
         vmm_x86_64_pte_t *rb_pte = page_walk(space, rb_virt, false);
         if (rb_pte && VMM_X86_64_PTE_PRESENT(rb_pte->raw)) {
+          acct_pte_change(space, rb_pte->raw, 0);
           rb_pte->raw = 0;
           if (space->is_active) {
             vmm_x86_64_invlpg(rb_virt);
           }
           space->arch.mapped_pages--;
-          vmm_x86_64_stats.pages_unmapped++;
-          if (vmm_x86_64_stats.pages_mapped > 0)
-            vmm_x86_64_stats.pages_mapped--;
+          percpu_counter_inc(&vmm_x86_64_stats.pages_unmapped);
+          percpu_counter_dec(&vmm_x86_64_stats.pages_mapped);
         }
       }
       return false;
@@ -568,12 +818,14 @@ bool vmm_x86_64_map_pages(vmm_space_t *space, u64 virt_addr, u64 phys_addr, size
       klog_warn("x86_64_vmm: Pagina 0x%lx già mappata (sovrascrittura)", curr_virt);
     }
 
-    pte->raw = VMM_X86_64_MAKE_PTE(curr_phys, x86_flags);
+    u64 new_raw = VMM_X86_64_MAKE_PTE(curr_phys, x86_flags);
+    acct_pte_change(space, pte->raw, new_raw);
+    pte->raw = new_raw;
 
     need_tlb_flush = need_tlb_flush || space->is_active;
 
     space->arch.mapped_pages++;
-    vmm_x86_64_stats.pages_mapped++;
+    percpu_counter_inc(&vmm_x86_64_stats.pages_mapped);
   }
 
   if (need_tlb_flush && space->is_active) {
@@ -608,12 +860,17 @@ void vmm_x86_64_unmap_pages(vmm_space_t *space, u64 virt_addr, size_t page_count
 
     // Trova la PTE (senza creare page table mancanti)
     vmm_x86_64_pte_t *pte = page_walk(space, curr_virt, false);
+    if (pte && (pte->raw & VMM_X86_64_RESERVED) && !VMM_X86_64_PTE_PRESENT(pte->raw)) {
+      pte->raw = 0; // Riserva mai popolata: nessun frame né TLB da invalidare
+      continue;
+    }
     if (!pte || !VMM_X86_64_PTE_PRESENT(pte->raw)) {
       klog_debug("x86_64_vmm: Pagina 0x%lx non mappata, saltando", curr_virt);
       continue;
     }
 
     // Azzera la PTE (rimuove mapping)
+    acct_pte_change(space, pte->raw, 0);
     pte->raw = 0;
 
     // Invalida la pagina nel TLB se lo spazio è attivo
@@ -622,7 +879,7 @@ void vmm_x86_64_unmap_pages(vmm_space_t *space, u64 virt_addr, size_t page_count
     }
 
     space->arch.mapped_pages--;
-    vmm_x86_64_stats.pages_unmapped++;
+    percpu_counter_inc(&vmm_x86_64_stats.pages_unmapped);
   }
 
   klog_debug("x86_64_vmm: Unmapping completato");
@@ -658,6 +915,448 @@ bool vmm_x86_64_resolve(vmm_space_t *space, u64 virt_addr, u64 *phys_addr) {
   return true;
 }
 
+/**
+ * @brief Legge frame fisico e flag generici di una pagina
+ *
+ * A differenza di resolve restituisce l'indirizzo del frame (senza offset)
+ * e i flag della PTE riconvertiti in VMM_FLAG_*.
+ */
+bool vmm_x86_64_query(vmm_space_t *space, u64 virt_addr, u64 *phys_addr, u64 *flags) {
+  if (!space || !vmm_x86_64_initialized) {
+    return false;
+  }
+
+  vmm_x86_64_pte_t *pte = page_walk(space, virt_addr, false);
+  if (!pte) {
+    return false;
+  }
+
+  u64 raw = pte->raw;
+  if (!VMM_X86_64_PTE_PRESENT(raw)) {
+    return false;
+  }
+
+  if (phys_addr)
+    *phys_addr = VMM_X86_64_PTE_ADDR(raw);
+  if (flags)
+    *flags = vmm_x86_64_pte_to_flags(raw);
+
+  return true;
+}
+
+/**
+ * @brief Cambia i flag di un range di pagine già mappate
+ *
+ * Mantiene il frame fisico di ogni PTE presente e riscrive solo i flag.
+ * Le pagine non mappate vengono saltate.
+ */
+bool vmm_x86_64_protect(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags) {
+  if (!space || !vmm_x86_64_initialized || !IS_PAGE_ALIGNED(virt_addr)) {
+    return false;
+  }
+
+  u64 x86_flags = vmm_x86_64_convert_flags(flags);
+  size_t updated = 0;
+
+  for (size_t i = 0; i < page_count; i++) {
+    u64 curr_virt = virt_addr + (i * PAGE_SIZE);
+
+    vmm_x86_64_pte_t *pte = page_walk(space, curr_virt, false);
+    if (!pte || !VMM_X86_64_PTE_PRESENT(pte->raw)) {
+      continue;
+    }
+
+    // Accessed e dirty restano: il lazy free distingue così le pagine riscritte
+    u64 new_raw = VMM_X86_64_MAKE_PTE(VMM_X86_64_PTE_ADDR(pte->raw), x86_flags) | (pte->raw & (VMM_X86_64_ACCESSED | VMM_X86_64_DIRTY));
+    acct_pte_change(space, pte->raw, new_raw);
+    pte->raw = new_raw;
+
+    if (space->is_active) {
+      vmm_x86_64_invlpg(curr_virt);
+    }
+    updated++;
+  }
+
+  return updated > 0;
+}
+
+/**
+ * @brief Sostituisce atomicamente il frame di una PTE
+ *
+ * La nuova PTE viene installata con una compare-and-swap sul valore letto:
+ * se la PTE non punta più a old_phys, o viene modificata tra lettura e
+ * scrittura, la sostituzione fallisce e il chiamante deve riprovare o
+ * rinunciare (es. la pagina è stata scritta durante un merge).
+ */
+bool vmm_x86_64_replace_page(vmm_space_t *space, u64 virt_addr, u64 old_phys, u64 new_phys, u64 flags) {
+  if (!space || !vmm_x86_64_initialized) {
+    return false;
+  }
+
+  if (!IS_PAGE_ALIGNED(virt_addr) || !IS_PAGE_ALIGNED(old_phys) || !IS_PAGE_ALIGNED(new_phys)) {
+    return false;
+  }
+
+  vmm_x86_64_pte_t *pte = page_walk(space, virt_addr, false);
+  if (!pte) {
+    return false;
+  }
+
+  u64 expected = pte->raw;
+  if (!VMM_X86_64_PTE_PRESENT(expected) || VMM_X86_64_PTE_ADDR(expected) != old_phys) {
+    return false;
+  }
+
+  u64 desired = VMM_X86_64_MAKE_PTE(new_phys, vmm_x86_64_convert_flags(flags));
+  if (!__sync_bool_compare_and_swap(&pte->raw, expected, desired)) {
+    return false;
+  }
+  acct_pte_change(space, expected, desired);
+
+  if (space->is_active) {
+    vmm_x86_64_invlpg(virt_addr);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Marca un range come riservato per il demand paging
+ *
+ * Crea le page table intermedie e scrive PTE non presenti con il bit
+ * VMM_X86_64_RESERVED e i flag finali. Nessun frame viene allocato: la
+ * CPU ignora il contenuto delle PTE non presenti, quindi non serve
+ * invalidare il TLB. Le pagine già presenti non vengono toccate.
+ */
+bool vmm_x86_64_reserve(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags) {
+  if (!space || !vmm_x86_64_initialized || !IS_PAGE_ALIGNED(virt_addr)) {
+    return false;
+  }
+
+  u64 marker = (vmm_x86_64_convert_flags(flags) & ~VMM_X86_64_PRESENT) | VMM_X86_64_RESERVED;
+
+  for (size_t i = 0; i < page_count; i++) {
+    u64 curr_virt = virt_addr + (i * PAGE_SIZE);
+
+    vmm_x86_64_pte_t *pte = page_walk(space, curr_virt, true);
+    if (!pte) {
+      klog_error("x86_64_vmm: Page walk fallito riservando 0x%lx", curr_virt);
+      return false;
+    }
+
+    if (!VMM_X86_64_PTE_PRESENT(pte->raw)) {
+      pte->raw = marker;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Legge i flag salvati in una PTE riservata non ancora popolata
+ */
+bool vmm_x86_64_query_reserved(vmm_space_t *space, u64 virt_addr, u64 *flags) {
+  if (!space || !vmm_x86_64_initialized) {
+    return false;
+  }
+
+  vmm_x86_64_pte_t *pte = page_walk(space, virt_addr, false);
+  if (!pte) {
+    return false;
+  }
+
+  u64 raw = pte->raw;
+  if (VMM_X86_64_PTE_PRESENT(raw) || !(raw & VMM_X86_64_RESERVED)) {
+    return false;
+  }
+
+  if (flags)
+    *flags = vmm_x86_64_pte_to_flags(raw);
+
+  return true;
+}
+
+/**
+ * @brief Popola una PTE riservata con un frame
+ *
+ * Percorso veloce del page fault: una sola compare-and-swap sulla PTE,
+ * nessun flush del TLB (la PTE precedente non era presente). Fallisce se
+ * la PTE non è più una riserva (es. popolata da un fault concorrente).
+ */
+bool vmm_x86_64_populate(vmm_space_t *space, u64 virt_addr, u64 phys_addr, u64 flags) {
+  if (!space || !vmm_x86_64_initialized || !IS_PAGE_ALIGNED(phys_addr)) {
+    return false;
+  }
+
+  vmm_x86_64_pte_t *pte = page_walk(space, virt_addr, false);
+  if (!pte) {
+    return false;
+  }
+
+  u64 expected = pte->raw;
+  if (VMM_X86_64_PTE_PRESENT(expected) || !(expected & VMM_X86_64_RESERVED)) {
+    return false;
+  }
+
+  u64 desired = VMM_X86_64_MAKE_PTE(phys_addr, vmm_x86_64_convert_flags(flags));
+  if (!__sync_bool_compare_and_swap(&pte->raw, expected, desired)) {
+    return false;
+  }
+  acct_pte_change(space, expected, desired);
+
+  space->arch.mapped_pages++;
+  percpu_counter_inc(&vmm_x86_64_stats.pages_mapped);
+  return true;
+}
+
+/*
+ * ============================================================================
+ * RANGE WALKER
+ * ============================================================================
+ */
+
+typedef bool (*leaf_walk_fn_t)(vmm_space_t *space, u64 virt_addr, vmm_x86_64_pte_t *pte, void *arg);
+
+/**
+ * @brief Visita le PTE foglia presenti o riservate di un range
+ *
+ * A ogni livello una entry assente fa saltare tutta la regione che
+ * coprirebbe (512GB, 1GB, 2MB): un range sparso costa quanto le tabelle
+ * che esistono davvero, non quanto le pagine che copre. Le huge page
+ * non sono foglie da 4KB e vengono saltate. Il callback può riscrivere
+ * la PTE visitata ma non liberare page table.
+ *
+ * @return Foglie visitate
+ */
+static size_t leaf_walk(vmm_space_t *space, u64 virt_addr, size_t page_count, leaf_walk_fn_t fn, void *arg) {
+  u64 virt = virt_addr;
+  u64 end = virt_addr + page_count * PAGE_SIZE;
+  size_t visited = 0;
+
+  while (virt < end) {
+    u64 entry = space->arch.pml4->entries[VMM_X86_64_PML4_INDEX(virt)].raw;
+    if (!VMM_X86_64_PTE_PRESENT(entry)) {
+      virt = (virt + VMM_X86_64_PML4_SIZE) & ~(VMM_X86_64_PML4_SIZE - 1);
+      continue;
+    }
+
+    entry = teardown_table_virt(VMM_X86_64_PTE_ADDR(entry))->entries[VMM_X86_64_PDPT_INDEX(virt)].raw;
+    if (!VMM_X86_64_PTE_PRESENT(entry) || (entry & VMM_X86_64_PAGE_SIZE)) {
+      virt = (virt + VMM_X86_64_PDPT_SIZE) & ~(VMM_X86_64_PDPT_SIZE - 1);
+      continue;
+    }
+
+    entry = teardown_table_virt(VMM_X86_64_PTE_ADDR(entry))->entries[VMM_X86_64_PD_INDEX(virt)].raw;
+    if (!VMM_X86_64_PTE_PRESENT(entry) || (entry & VMM_X86_64_PAGE_SIZE)) {
+      virt = (virt + VMM_X86_64_PD_SIZE) & ~(VMM_X86_64_PD_SIZE - 1);
+      continue;
+    }
+
+    vmm_x86_64_page_table_t *pt = teardown_table_virt(VMM_X86_64_PTE_ADDR(entry));
+    for (u64 i = VMM_X86_64_PT_INDEX(virt); i < VMM_X86_64_ENTRIES_PER_TABLE && virt < end; i++, virt += PAGE_SIZE) {
+      u64 raw = pt->entries[i].raw;
+      if (!VMM_X86_64_PTE_PRESENT(raw) && !(raw & VMM_X86_64_RESERVED))
+        continue;
+
+      visited++;
+      if (!fn(space, virt, &pt->entries[i], arg))
+        return visited;
+    }
+  }
+
+  return visited;
+}
+
+typedef struct {
+  vmm_x86_64_walk_fn_t fn;
+  void *arg;
+} walk_adapter_t;
+
+static bool walk_visit(vmm_space_t *space, u64 virt_addr, vmm_x86_64_pte_t *pte, void *arg) {
+  (void)space;
+  walk_adapter_t *adapter = (walk_adapter_t *)arg;
+  u64 raw = pte->raw;
+  bool present = VMM_X86_64_PTE_PRESENT(raw);
+  return adapter->fn(virt_addr, present ? VMM_X86_64_PTE_ADDR(raw) : 0, vmm_x86_64_pte_to_flags(raw), present, adapter->arg);
+}
+
+/**
+ * @brief Visita le foglie da 4KB di un range (vedi leaf_walk)
+ *
+ * @return Foglie visitate (presenti o riservate)
+ */
+size_t vmm_x86_64_walk(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_x86_64_walk_fn_t fn, void *arg) {
+  if (!space || !space->arch.pml4 || !vmm_x86_64_initialized || !IS_PAGE_ALIGNED(virt_addr) || !fn) {
+    return 0;
+  }
+
+  walk_adapter_t adapter = {.fn = fn, .arg = arg};
+  return leaf_walk(space, virt_addr, page_count, walk_visit, &adapter);
+}
+
+/*
+ * ============================================================================
+ * DISCARD E LAZY FREE (vmm_advise)
+ * ============================================================================
+ *
+ * Scartare una pagina anonima significa riscriverne la PTE come riserva
+ * con i flag con cui era stata popolata: il prossimo accesso ripassa dal
+ * demand paging e vede zeri. I frame non possono tornare al PMM finché
+ * il TLB può ancora tradurre verso di loro, quindi le PTE scartate si
+ * accumulano in un batch e ogni batch costa un solo flush.
+ */
+
+#define VMM_X86_64_DISCARD_BATCH 64 // PTE scartate per flush del TLB
+
+typedef struct {
+  u64 virt[VMM_X86_64_DISCARD_BATCH];
+  u64 raw[VMM_X86_64_DISCARD_BATCH];
+  size_t count;
+  bool lazy_only;
+  size_t dropped;
+} discard_batch_t;
+
+static void discard_batch_flush(vmm_space_t *space, discard_batch_t *batch) {
+  if (batch->count == 0)
+    return;
+
+  if (space->is_active) {
+    vmm_x86_64_flush_tlb();
+    percpu_counter_inc(&vmm_x86_64_stats.tlb_flushes);
+  }
+
+  // Solo ora nessuna traduzione punta più ai frame: privati al PMM, condivisi a KSM
+  void *pages[VMM_X86_64_DISCARD_BATCH];
+  size_t free_count = 0;
+  for (size_t i = 0; i < batch->count; i++) {
+    u64 phys = VMM_X86_64_PTE_ADDR(batch->raw[i]);
+    if (batch->raw[i] & VMM_X86_64_ANON)
+      pages[free_count++] = (void *)phys;
+    else
+      vmm_teardown_release_shared(space, batch->virt[i], phys);
+  }
+  pmm_free_pages_batch(pages, free_count);
+
+  batch->count = 0;
+}
+
+/**
+ * @brief Riserva equivalente a una PTE popolata dal demand paging
+ *
+ * Le pagine COW (zero page, KSM) tornano scrivibili come la riserva da
+ * cui erano nate; ANON e LAZYFREE appartengono al frame, non alla riserva.
+ */
+static inline u64 discard_reserve_marker(u64 raw) {
+  u64 flags = vmm_x86_64_pte_to_flags(raw);
+  if (flags & VMM_FLAG_COW)
+    flags |= VMM_FLAG_WRITE;
+  flags &= ~(u64)(VMM_FLAG_COW | VMM_FLAG_ANON | VMM_FLAG_LAZYFREE);
+  return (vmm_x86_64_convert_flags(flags) & ~VMM_X86_64_PRESENT) | VMM_X86_64_RESERVED;
+}
+
+static bool discard_visit(vmm_space_t *space, u64 virt_addr, vmm_x86_64_pte_t *pte, void *arg) {
+  discard_batch_t *batch = (discard_batch_t *)arg;
+  u64 raw = pte->raw;
+
+  // Solo frame del demand paging: le mappature esplicite (MMIO, buffer) restano
+  if (!VMM_X86_64_PTE_PRESENT(raw) || (raw & VMM_X86_64_PINNED) || !(raw & (VMM_X86_64_ANON | VMM_X86_64_COW)))
+    return true;
+
+  if (batch->lazy_only) {
+    if (!(raw & VMM_X86_64_ANON) || !(raw & VMM_X86_64_LAZYFREE))
+      return true;
+    if (raw & VMM_X86_64_DIRTY) {
+      // Riscritta dopo l'hint: torna una pagina normale
+      __sync_bool_compare_and_swap(&pte->raw, raw, raw & ~VMM_X86_64_LAZYFREE);
+      return true;
+    }
+  }
+
+  // La CAS perde contro la CPU che marca dirty una pagina lazy appena scritta
+  u64 marker = discard_reserve_marker(raw);
+  if (!__sync_bool_compare_and_swap(&pte->raw, raw, marker))
+    return true;
+  acct_pte_change(space, raw, marker);
+
+  space->arch.mapped_pages--;
+  percpu_counter_inc(&vmm_x86_64_stats.pages_unmapped);
+
+  batch->virt[batch->count] = virt_addr;
+  batch->raw[batch->count] = raw;
+  batch->count++;
+  batch->dropped++;
+  if (batch->count == VMM_X86_64_DISCARD_BATCH)
+    discard_batch_flush(space, batch);
+  return true;
+}
+
+/**
+ * @brief Riporta a riserva le pagine anonime di un range
+ *
+ * Le pagine pinned e le mappature non nate dal demand paging non vengono
+ * toccate. Con lazy_only si scartano solo le pagine LAZYFREE ancora
+ * pulite; quelle riscritte perdono il bit e tornano normali.
+ *
+ * @return Pagine scartate
+ */
+size_t vmm_x86_64_discard(vmm_space_t *space, u64 virt_addr, size_t page_count, bool lazy_only) {
+  if (!space || !space->arch.pml4 || !vmm_x86_64_initialized || !IS_PAGE_ALIGNED(virt_addr)) {
+    return 0;
+  }
+
+  discard_batch_t batch;
+  batch.count = 0;
+  batch.lazy_only = lazy_only;
+  batch.dropped = 0;
+
+  leaf_walk(space, virt_addr, page_count, discard_visit, &batch);
+  discard_batch_flush(space, &batch);
+
+  return batch.dropped;
+}
+
+static bool lazyfree_visit(vmm_space_t *space, u64 virt_addr, vmm_x86_64_pte_t *pte, void *arg) {
+  (void)space;
+  (void)virt_addr;
+  size_t *marked = (size_t *)arg;
+
+  u64 raw = pte->raw;
+  while (VMM_X86_64_PTE_PRESENT(raw) && (raw & VMM_X86_64_ANON) && !(raw & VMM_X86_64_PINNED)) {
+    u64 desired = (raw | VMM_X86_64_LAZYFREE) & ~VMM_X86_64_DIRTY;
+    if (__sync_bool_compare_and_swap(&pte->raw, raw, desired)) {
+      (*marked)++;
+      break;
+    }
+    raw = pte->raw; // La CPU ha aggiornato accessed/dirty nel frattempo
+  }
+  return true;
+}
+
+/**
+ * @brief Marca LAZYFREE le pagine anonime di un range
+ *
+ * Il bit dirty viene azzerato: una scrittura successiva lo riaccende e
+ * il reclaim la riconosce. Un solo flush alla fine, perché la CPU non
+ * riscrive dirty finché la traduzione in cache lo ha già acceso.
+ *
+ * @return Pagine marcate
+ */
+size_t vmm_x86_64_lazyfree(vmm_space_t *space, u64 virt_addr, size_t page_count) {
+  if (!space || !space->arch.pml4 || !vmm_x86_64_initialized || !IS_PAGE_ALIGNED(virt_addr)) {
+    return 0;
+  }
+
+  size_t marked = 0;
+  leaf_walk(space, virt_addr, page_count, lazyfree_visit, &marked);
+
+  if (marked && space->is_active) {
+    vmm_x86_64_flush_tlb();
+    percpu_counter_inc(&vmm_x86_64_stats.tlb_flushes);
+  }
+
+  return marked;
+}
+
 /**
  * @brief Debug dump delle page table
  *
@@ -751,6 +1450,13 @@ vmm_space_t *vmm_x86_64_get_kernel_space(void) {
   return (vmm_space_t *)&kernel_space;
 }
 
+/**
+ * @brief Ritorna lo spazio attivo (per vmm_current_space())
+ */
+vmm_space_t *vmm_x86_64_get_current_space(void) {
+  return (vmm_space_t *)active_space;
+}
+
 /**
  * @brief Stampa statistiche arch-specific
  */
@@ -758,9 +1464,10 @@ void vmm_x86_64_print_stats(void) {
   klog_info("=== VMM x86_64 STATISTICS ===");
   klog_info("Spazi creati: %lu", vmm_x86_64_stats.spaces_created);
   klog_info("Spazi distrutti: %lu", vmm_x86_64_stats.spaces_destroyed);
-  klog_info("Pagine mappate: %lu", vmm_x86_64_stats.pages_mapped);
-  klog_info("Pagine unmappate: %lu", vmm_x86_64_stats.pages_unmapped);
-  klog_info("TLB flush: %lu", vmm_x86_64_stats.tlb_flushes);
+  klog_info("Teardown in coda: %lu spazi (%lu pagine restituite)", vmm_x86_64_stats.teardown_pending, vmm_x86_64_stats.teardown_pages_freed);
+  klog_info("Pagine mappate: %lu", percpu_counter_sum_positive(&vmm_x86_64_stats.pages_mapped));
+  klog_info("Pagine unmappate: %lu", percpu_counter_sum_positive(&vmm_x86_64_stats.pages_unmapped));
+  klog_info("TLB flush: %lu", percpu_counter_sum_positive(&vmm_x86_64_stats.tlb_flushes));
   klog_info("=============================");
 }
 
@@ -827,4 +1534,40 @@ void arch_vmm_debug_dump(vmm_space_t *space) {
 }
 bool arch_vmm_check_integrity(vmm_space_t *space) {
   return vmm_x86_64_check_integrity(space);
-}
\ No newline at end of file
+}
+bool arch_vmm_query(vmm_space_t *s, u64 v, u64 *phys, u64 *flags) {
+  return vmm_x86_64_query(s, v, phys, flags);
+}
+bool arch_vmm_protect(vmm_space_t *s, u64 v, size_t n, u64 f) {
+  return vmm_x86_64_protect(s, v, n, f);
+}
+bool arch_vmm_replace_page(vmm_space_t *s, u64 v, u64 old_p, u64 new_p, u64 f) {
+  return vmm_x86_64_replace_page(s, v, old_p, new_p, f);
+}
+vmm_space_t *arch_vmm_get_current_space(void) {
+  return vmm_x86_64_get_current_space();
+}
+bool arch_vmm_reserve(vmm_space_t *s, u64 v, size_t n, u64 f) {
+  return vmm_x86_64_reserve(s, v, n, f);
+}
+bool arch_vmm_query_reserved(vmm_space_t *s, u64 v, u64 *flags) {
+  return vmm_x86_64_query_reserved(s, v, flags);
+}
+bool arch_vmm_populate(vmm_space_t *s, u64 v, u64 p, u64 f) {
+  return vmm_x86_64_populate(s, v, p, f);
+}
+size_t arch_vmm_teardown_work(size_t budget) {
+  return vmm_x86_64_teardown_work(budget);
+}
+size_t arch_vmm_walk(vmm_space_t *s, u64 v, size_t n, vmm_x86_64_walk_fn_t fn, void *arg) {
+  return vmm_x86_64_walk(s, v, n, fn, arg);
+}
+size_t arch_vmm_discard(vmm_space_t *s, u64 v, size_t n, bool lazy_only) {
+  return vmm_x86_64_discard(s, v, n, lazy_only);
+}
+size_t arch_vmm_lazyfree(vmm_space_t *s, u64 v, size_t n) {
+  return vmm_x86_64_lazyfree(s, v, n);
+}
+vmm_space_acct_t *arch_vmm_space_acct(vmm_space_t *space) {
+  return space->arch.is_kernel_space ? (vmm_space_acct_t *)NULL : &space->acct;
+}
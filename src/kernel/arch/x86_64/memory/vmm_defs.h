@@ -1,6 +1,7 @@
 #pragma once
 
 #include "paging_defs.h"
+#include <arch/x86_64/cpu/alternative.h>
 #include <lib/types.h>
 
 /**
@@ -75,6 +76,23 @@
 #define VMM_X86_64_OS_BIT_1 (1UL << 10)
 #define VMM_X86_64_OS_BIT_2 (1UL << 11)
 
+// Uso dei bit OS: pagina read-only condivisa copy-on-write
+#define VMM_X86_64_COW VMM_X86_64_OS_BIT_0
+// PTE non presente che marca una pagina anonima riservata (demand paging):
+// i restanti bit conservano i flag con cui verrà popolata al primo fault
+#define VMM_X86_64_RESERVED VMM_X86_64_OS_BIT_1
+// Frame anonimo privato dello spazio: liberato alla distruzione dello spazio
+#define VMM_X86_64_ANON VMM_X86_64_OS_BIT_2
+
+// Bit 52-58: ignorati dalla CPU (senza protection key) e liberi per l'OS
+#define VMM_X86_64_SW_BIT_52 (1UL << 52)
+#define VMM_X86_64_SW_BIT_53 (1UL << 53)
+
+// Pagina pinned: esclusa da reclaim, KSM e migrazione CMA
+#define VMM_X86_64_PINNED VMM_X86_64_SW_BIT_52
+// Pagina anonima scartabile dal reclaim finché resta pulita (dirty = 0)
+#define VMM_X86_64_LAZYFREE VMM_X86_64_SW_BIT_53
+
 // Maschera per indirizzo fisico nella PTE (bit 51-12)
 #define VMM_X86_64_PHYS_ADDR_MASK 0x000FFFFFFFFFF000UL
 
@@ -229,6 +247,10 @@ typedef enum {
   VMM_FLAG_USER = (1 << 3),
   VMM_FLAG_GLOBAL = (1 << 4),
   VMM_FLAG_NO_CACHE = (1 << 5),
+  VMM_FLAG_COW = (1 << 6),
+  VMM_FLAG_ANON = (1 << 7),
+  VMM_FLAG_PINNED = (1 << 8),
+  VMM_FLAG_LAZYFREE = (1 << 9),
 } vmm_flags_t;
 
 /**
@@ -247,10 +269,48 @@ static inline u64 vmm_x86_64_convert_flags(u64 generic_flags) {
     x86_flags |= VMM_X86_64_CACHE_DISABLE;
   if (!(generic_flags & VMM_FLAG_EXEC))
     x86_flags |= VMM_X86_64_NO_EXECUTE;
+  if (generic_flags & VMM_FLAG_COW)
+    x86_flags |= VMM_X86_64_COW;
+  if (generic_flags & VMM_FLAG_ANON)
+    x86_flags |= VMM_X86_64_ANON;
+  if (generic_flags & VMM_FLAG_PINNED)
+    x86_flags |= VMM_X86_64_PINNED;
+  if (generic_flags & VMM_FLAG_LAZYFREE)
+    x86_flags |= VMM_X86_64_LAZYFREE;
 
   return x86_flags;
 }
 
+/**
+ * @brief Converte i flag di una PTE x86_64 in flag VMM generici
+ *
+ * Inversa di vmm_x86_64_convert_flags(); usata da query e fault handler.
+ */
+static inline u64 vmm_x86_64_pte_to_flags(u64 pte) {
+  u64 generic_flags = VMM_FLAG_READ;
+
+  if (pte & VMM_X86_64_WRITABLE)
+    generic_flags |= VMM_FLAG_WRITE;
+  if (pte & VMM_X86_64_USER)
+    generic_flags |= VMM_FLAG_USER;
+  if (pte & VMM_X86_64_GLOBAL)
+    generic_flags |= VMM_FLAG_GLOBAL;
+  if (pte & VMM_X86_64_CACHE_DISABLE)
+    generic_flags |= VMM_FLAG_NO_CACHE;
+  if (!(pte & VMM_X86_64_NO_EXECUTE))
+    generic_flags |= VMM_FLAG_EXEC;
+  if (pte & VMM_X86_64_COW)
+    generic_flags |= VMM_FLAG_COW;
+  if (pte & VMM_X86_64_ANON)
+    generic_flags |= VMM_FLAG_ANON;
+  if (pte & VMM_X86_64_PINNED)
+    generic_flags |= VMM_FLAG_PINNED;
+  if (pte & VMM_X86_64_LAZYFREE)
+    generic_flags |= VMM_FLAG_LAZYFREE;
+
+  return generic_flags;
+}
+
 /*
  * ============================================================================
  * CONSTANTS FOR DEBUGGING
@@ -312,6 +372,11 @@ void vmm_x86_64_destroy_space(vmm_space_t *space);
  */
 void vmm_x86_64_switch_space(vmm_space_t *space);
 
+/**
+ * @brief Avanza la distruzione asincrona degli spazi in coda
+ */
+size_t vmm_x86_64_teardown_work(size_t budget);
+
 /**
  * @brief Implementazione arch-specific del mapping
  */
@@ -327,6 +392,61 @@ void vmm_x86_64_unmap_pages(vmm_space_t *space, u64 virt_addr, size_t page_count
  */
 bool vmm_x86_64_resolve(vmm_space_t *space, u64 virt_addr, u64 *phys_addr);
 
+/**
+ * @brief Legge indirizzo fisico e flag generici di una pagina mappata
+ */
+bool vmm_x86_64_query(vmm_space_t *space, u64 virt_addr, u64 *phys_addr, u64 *flags);
+
+/**
+ * @brief Cambia i flag di un range di pagine già mappate
+ */
+bool vmm_x86_64_protect(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags);
+
+/**
+ * @brief Sostituisce atomicamente il frame di una PTE (compare-and-swap)
+ */
+bool vmm_x86_64_replace_page(vmm_space_t *space, u64 virt_addr, u64 old_phys, u64 new_phys, u64 flags);
+
+/**
+ * @brief Marca un range come riservato (PTE non presenti con flag salvati)
+ */
+bool vmm_x86_64_reserve(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags);
+
+/**
+ * @brief Legge i flag salvati in una PTE riservata
+ */
+bool vmm_x86_64_query_reserved(vmm_space_t *space, u64 virt_addr, u64 *flags);
+
+/**
+ * @brief Popola una PTE riservata con un frame (compare-and-swap)
+ */
+bool vmm_x86_64_populate(vmm_space_t *space, u64 virt_addr, u64 phys_addr, u64 flags);
+
+/**
+ * @brief Callback del range walker: una foglia presente o riservata
+ *
+ * @param phys Frame della pagina (0 per una riserva non popolata)
+ * @param flags Flag VMM_FLAG_* della PTE
+ * @param present false per una riserva non popolata
+ * @return false per interrompere la visita
+ */
+typedef bool (*vmm_x86_64_walk_fn_t)(u64 virt_addr, u64 phys, u64 flags, bool present, void *arg);
+
+/**
+ * @brief Visita le foglie da 4KB di un range saltando le tabelle assenti
+ */
+size_t vmm_x86_64_walk(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_x86_64_walk_fn_t fn, void *arg);
+
+/**
+ * @brief Riporta a riserva le pagine anonime di un range (un flush per batch)
+ */
+size_t vmm_x86_64_discard(vmm_space_t *space, u64 virt_addr, size_t page_count, bool lazy_only);
+
+/**
+ * @brief Marca LAZYFREE le pagine anonime di un range
+ */
+size_t vmm_x86_64_lazyfree(vmm_space_t *space, u64 virt_addr, size_t page_count);
+
 /**
  * @brief Debug dump delle page table
  */
@@ -337,6 +457,11 @@ void vmm_x86_64_debug_dump(vmm_space_t *space);
  */
 vmm_space_t *vmm_x86_64_get_kernel_space(void);
 
+/**
+ * @brief Ritorna lo spazio attualmente caricato in CR3
+ */
+vmm_space_t *vmm_x86_64_get_current_space(void);
+
 /*
  * ============================================================================
  * SIMPLE INLINE ASSEMBLY HELPERS (SAFE FOR HEADERS)
@@ -367,9 +492,21 @@ static inline void vmm_x86_64_invlpg(u64 vaddr) {
 }
 
 /**
- * @brief Flush completo del TLB
+ * @brief Flush completo del TLB (voci non globali)
+ *
+ * Base: reload di CR3. Con INVPCID il sito viene riscritto al boot in
+ * INVPCID tipo 3 (tutti i contesti, globali escluse), che non serializza
+ * il cambio di page table e non rilegge CR3.
  */
 static inline void vmm_x86_64_flush_tlb(void) {
-  u64 cr3 = vmm_x86_64_read_cr3();
-  vmm_x86_64_write_cr3(cr3); // Reload CR3 per flush TLB
+  struct {
+    u64 pcid;
+    u64 addr;
+  } desc = {0, 0};
+  __asm__ volatile(ALTERNATIVE("mov %%cr3, %%rcx\n\t"
+                               "mov %%rcx, %%cr3",
+                               "invpcid (%%rdx), %%rax", X86_FEATURE_INVPCID)
+                   :
+                   : "a"(3UL), "d"(&desc), "m"(desc)
+                   : "rcx", "memory");
 }
\ No newline at end of file
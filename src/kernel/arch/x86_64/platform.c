@@ -2,29 +2,52 @@
  * @file arch/x86_64/platform.c
  * @brief Platform layer implementation (x86_64) for ZONE-OS
  *
- * Questo file implementa le API portabili dichiarate in <arch/platform.h>
- * fornendo il nome della piattaforma e il punto di inizializzazione
- * architetturale. L’inizializzazione dettagliata (GDT, IDT, timer, IRQ, ecc.)
- * verrà aggiunta progressivamente; per ora è un placeholder minimo.
+ * Implementa le API portabili di <arch/platform.h>: il collante fra il
+ * kernel generico e la macchina x86_64 su cui gira (bootloader, feature
+ * della CPU, dispositivi di piattaforma). Segmenti e IDT
+ * (arch_segment_init), LAPIC e timer hanno i loro moduli.
  *
- * Funzionalità coperte (baseline):
+ * Contenuto:
  *  - Identificazione piattaforma (arch_get_name)
- *  - Entry di init architetturale (arch_init)
+ *  - Init architetturale (arch_init): rilevamento delle feature CPU e
+ *    applicazione delle alternatives, prima di qualsiasi percorso caldo
+ *  - Command line del kernel passata da Limine (arch_get_cmdline)
+ *  - Uscita con stato tramite il dispositivo isa-debug-exit di QEMU
+ *    (arch_platform_exit), usata dalla modalità benchmark
  *
  * @author Enzo Tasca
  * @date 2025
  */
 
+#include <arch/io.h>
 #include <arch/platform.h>
+#include <arch/x86_64/cpu/alternative.h>
 #include <klib/klog/klog.h>
 #include <lib/types.h>
 #include <limine.h>
 
+// === Richiesta command line (LIMINE) ===
+volatile struct limine_executable_cmdline_request cmdline_request = {.id = LIMINE_EXECUTABLE_CMDLINE_REQUEST, .revision = 0};
+
 const char *arch_get_name(void) {
   return "x86_64";
 }
 
 void arch_init(void) {
+  // Feature CPU e patch dei percorsi caldi, prima di qualsiasi altra CPU
+  x86_64_cpu_features_init();
+  x86_64_apply_alternatives();
+}
+
+const char *arch_get_cmdline(void) {
+  if (!cmdline_request.response || !cmdline_request.response->cmdline)
+    return "";
+  return cmdline_request.response->cmdline;
+}
+
+// Porta del dispositivo isa-debug-exit di QEMU (iobase dello script di avvio)
+#define X86_64_DEBUG_EXIT_PORT 0xf4
 
-  return;
+void arch_platform_exit(uint32_t status) {
+  arch_io_outb(X86_64_DEBUG_EXIT_PORT, (uint8_t)status);
 }
@@ -0,0 +1,79 @@
+#include <arch/cpu.h>
+#include <arch/io.h>
+#include <drivers/serial/serial.h>
+#include <lib/stdarg.h>
+#include <lib/stdio/stdio.h>
+
+// === Registri della UART (offset dalla porta base) ===
+#define UART_DATA 0        // THR/RBR (DLL con DLAB=1)
+#define UART_INT_ENABLE 1  // IER (DLM con DLAB=1)
+#define UART_FIFO_CTRL 2   // FCR
+#define UART_LINE_CTRL 3   // LCR
+#define UART_MODEM_CTRL 4  // MCR
+#define UART_LINE_STATUS 5 // LSR
+
+#define UART_LCR_DLAB 0x80
+#define UART_LCR_8N1 0x03
+#define UART_LSR_THR_EMPTY 0x20
+#define UART_MCR_LOOPBACK 0x10
+
+#define UART_CLOCK 115200 // Divisore 1 = 115200 baud
+
+static bool serial_ready = false;
+
+static inline void serial_out(uint16_t reg, uint8_t value) {
+  arch_io_outb(SERIAL_COM1 + reg, value);
+}
+
+static inline uint8_t serial_in(uint16_t reg) {
+  return arch_io_inb(SERIAL_COM1 + reg);
+}
+
+bool serial_init(void) {
+  uint16_t divisor = UART_CLOCK / SERIAL_BAUD;
+
+  serial_out(UART_INT_ENABLE, 0x00); // Nessun interrupt: solo polling
+  serial_out(UART_LINE_CTRL, UART_LCR_DLAB);
+  serial_out(UART_DATA, divisor & 0xFF);
+  serial_out(UART_INT_ENABLE, divisor >> 8);
+  serial_out(UART_LINE_CTRL, UART_LCR_8N1);
+  serial_out(UART_FIFO_CTRL, 0xC7); // FIFO abilitate e svuotate, soglia 14 byte
+
+  // Loopback: il byte trasmesso deve tornare indietro
+  serial_out(UART_MODEM_CTRL, UART_MCR_LOOPBACK | 0x0E);
+  serial_out(UART_DATA, 0xAE);
+  if (serial_in(UART_DATA) != 0xAE)
+    return false;
+
+  serial_out(UART_MODEM_CTRL, 0x0F); // Modalità normale: DTR, RTS, OUT1, OUT2
+  serial_ready = true;
+  return true;
+}
+
+bool serial_is_ready(void) {
+  return serial_ready;
+}
+
+void serial_putc(char c) {
+  if (!serial_ready)
+    return;
+  if (c == '\n')
+    serial_putc('\r');
+  while (!(serial_in(UART_LINE_STATUS) & UART_LSR_THR_EMPTY))
+    arch_cpu_pause();
+  serial_out(UART_DATA, (uint8_t)c);
+}
+
+void serial_write(const char *str) {
+  while (*str)
+    serial_putc(*str++);
+}
+
+void serial_printf(const char *format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  kvsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  serial_write(buffer);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <lib/stdbool.h>
+#include <lib/stdint.h>
+
+/**
+ * @file drivers/serial/serial.h
+ * @brief Porta seriale COM1 (UART 16550) per output verso l'host
+ *
+ * Canale per dati destinati a strumenti sull'host (profili, risultati di
+ * benchmark): sotto QEMU finisce su "-serial stdio" o "-serial file:...".
+ * Solo trasmissione, in polling: nessun interrupt e nessun buffer.
+ */
+
+#define SERIAL_COM1 0x3F8
+#define SERIAL_BAUD 115200
+
+/**
+ * @brief Inizializza COM1 a 115200 8N1 e verifica la UART in loopback
+ * @return false se la UART non risponde (l'output viene scartato)
+ */
+bool serial_init(void);
+
+/**
+ * @brief true se serial_init() ha trovato la UART
+ */
+bool serial_is_ready(void);
+
+/**
+ * @brief Trasmette un carattere ('\n' diventa "\r\n")
+ * @param c Carattere da trasmettere
+ */
+void serial_putc(char c);
+
+/**
+ * @brief Trasmette una stringa terminata da \0
+ * @param str Stringa da trasmettere
+ */
+void serial_write(const char *str);
+
+/**
+ * @brief Trasmette una stringa formattata (stesso formato di kprintf)
+ * @param format Stringa di formato
+ */
+void serial_printf(const char *format, ...);
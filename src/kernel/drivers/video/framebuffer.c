@@ -1,18 +1,19 @@
 #include <drivers/video/framebuffer.h>
+#include <lib/cache.h>
 #include <lib/stdint.h>
 
 // Puntatore alla base del framebuffer (memoria video fornita da Limine)
-static uint8_t *framebuffer_address = 0;
+static uint8_t *framebuffer_address __read_mostly = 0;
 
 // Dimensioni in pixel del framebuffer
-static uint64_t framebuffer_width = 0;
-static uint64_t framebuffer_height = 0;
+static uint64_t framebuffer_width __read_mostly = 0;
+static uint64_t framebuffer_height __read_mostly = 0;
 
 // Numero di byte per riga (attenzione: può essere superiore a width * bytes_per_pixel)
-static uint64_t framebuffer_pitch = 0;
+static uint64_t framebuffer_pitch __read_mostly = 0;
 
 // Bit per pixel (normalmente 32 - formato BGRA)
-static uint16_t framebuffer_bpp = 0;
+static uint16_t framebuffer_bpp __read_mostly = 0;
 
 /**
  * @brief Inizializza il framebuffer con i parametri forniti dal bootloader.
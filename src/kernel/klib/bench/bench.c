@@ -0,0 +1,141 @@
+#include "bench.h"
+#include <arch/cpu.h>
+#include <arch/platform.h>
+#include <arch/pmu.h>
+#include <drivers/serial/serial.h>
+#include <klib/cmdline/cmdline.h>
+#include <klib/klog/klog.h>
+#include <klib/perf/perf.h>
+#include <lib/string/string.h>
+
+/**
+ * @file klib/bench.c
+ * @brief Suite di benchmark - Implementation
+ *
+ * Simboli del linker (tools/linker.ld):
+ * - _bench_start/_bench_end: i bench_t definiti con DEFINE_BENCH
+ */
+
+extern bench_t _bench_start[];
+extern bench_t _bench_end[];
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni interne                              */
+/* -------------------------------------------------------------------------- */
+
+static void bench_sort(u64 *values, u32 count) {
+  for (u32 i = 1; i < count; i++) {
+    u64 v = values[i];
+    u32 j = i;
+    for (; j > 0 && values[j - 1] > v; j--)
+      values[j] = values[j - 1];
+    values[j] = v;
+  }
+}
+
+static void bench_emit(const bench_t *bench, u32 runs, bool ok, const u64 *cycles, const perf_region_t *region) {
+  u64 mhz = arch_cpu_cycles_hz() / 1000000;
+  u64 median = runs ? cycles[runs / 2] : 0;
+
+  serial_printf("{\"name\":\"%s\",\"iters\":%lu,\"runs\":%u,\"ok\":%s", bench->name, bench->iters, runs, ok ? "true" : "false");
+  serial_printf(",\"cycles_min\":%lu,\"cycles_median\":%lu", runs ? cycles[0] : 0, median);
+  if (mhz)
+    serial_printf(",\"ns_median\":%lu", median * 1000 / mhz);
+
+  // Totali su tutte le esecuzioni misurate, solo per gli eventi contati
+  for (int e = 0; e < PMU_EVENT_COUNT; e++) {
+    if (arch_pmu_supported((pmu_event_t)e))
+      serial_printf(",\"%s\":%lu", perf_event_name((pmu_event_t)e), perf_region_total(region, (pmu_event_t)e));
+  }
+  serial_printf("}\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+bool bench_mode_requested(void) {
+  return cmdline_has("bench");
+}
+
+const bench_t *bench_find(const char *name) {
+  for (const bench_t *bench = _bench_start; bench < _bench_end; bench++) {
+    if (strcmp(bench->name, name) == 0)
+      return bench;
+  }
+  return NULL;
+}
+
+bool bench_run(const bench_t *bench, u32 runs) {
+  if (runs == 0)
+    runs = BENCH_DEFAULT_RUNS;
+  if (runs > BENCH_MAX_RUNS)
+    runs = BENCH_MAX_RUNS;
+
+  perf_region_t region = PERF_REGION_INIT(bench->name);
+  u64 cycles[BENCH_MAX_RUNS];
+  u32 done = 0;
+
+  // Riscaldamento: cache, TLB e slab/pagine già pronte per le misure
+  u64 warmup = bench->iters / 10 ? bench->iters / 10 : 1;
+  bool ok = bench->fn(warmup);
+
+  for (; ok && done < runs; done++) {
+    perf_region_begin(&region);
+    u64 start = arch_cpu_cycles();
+    ok = bench->fn(bench->iters);
+    cycles[done] = arch_cpu_cycles() - start;
+    perf_region_end(&region);
+  }
+
+  bench_sort(cycles, done);
+  bench_emit(bench, done, ok, cycles, &region);
+  return ok;
+}
+
+u32 bench_run_suite(void) {
+  u32 runs = (u32)cmdline_get_u64("bench_runs", BENCH_DEFAULT_RUNS);
+  u32 failed = 0;
+
+  char list[256];
+  if (!cmdline_get("bench", list, sizeof(list)) || strcmp(list, "all") == 0) {
+    for (const bench_t *bench = _bench_start; bench < _bench_end; bench++)
+      failed += !bench_run(bench, runs);
+    return failed;
+  }
+
+  char *name = list;
+  while (*name) {
+    char *end = name;
+    while (*end && *end != ',')
+      end++;
+    bool last = (*end == '\0');
+    *end = '\0';
+
+    if (*name) {
+      const bench_t *bench = bench_find(name);
+      if (bench) {
+        failed += !bench_run(bench, runs);
+      } else {
+        klog_warn("bench: benchmark sconosciuto '%s' sulla command line", name);
+        failed++;
+      }
+    }
+
+    if (last)
+      break;
+    name = end + 1;
+  }
+  return failed;
+}
+
+void bench_main(void) {
+  klog_info("bench: %zu benchmark registrati", (size_t)(_bench_end - _bench_start));
+
+  serial_printf("# bench-begin arch=%s pmu=%s hz=%lu\n", arch_get_name(), arch_pmu_name(), arch_cpu_cycles_hz());
+  u32 failed = bench_run_suite();
+  serial_printf("# bench-end failed=%u\n", failed);
+
+  klog_info("bench: suite completata, %u falliti", failed);
+  arch_platform_exit(failed ? 1 : 0);
+}
@@ -0,0 +1,108 @@
+/**
+ * @file klib/bench.h
+ * @brief Suite di benchmark del kernel e modalità di boot "bench"
+ *
+ * Per confrontare due build serve la stessa misura, ripetuta, senza
+ * nessuno davanti allo schermo. Ogni benchmark è una funzione che esegue
+ * iters volte l'operazione misurata; i benchmark sono raccolti dal linker
+ * in un registro (come gli istogrammi di klib/lat_hist).
+ *
+ * MISURA:
+ * Un giro di riscaldamento, poi runs esecuzioni misurate, ognuna dentro
+ * una regione perf (klib/perf): per ogni benchmark si riportano i cicli
+ * minimi e mediani per esecuzione e i totali dei contatori PMU. Il costo
+ * per operazione lo ricava chi legge (cicli / iters): il kernel non usa
+ * la virgola mobile.
+ *
+ * OUTPUT:
+ * Una riga JSON per benchmark sulla seriale, fra "# bench-begin" e
+ * "# bench-end", con solo gli eventi che la macchina conta davvero:
+ *
+ *   {"name":"slab_alloc_free","iters":100000,"runs":5,"ok":true,
+ *    "cycles_min":...,"cycles_median":...,"ns_median":...,
+ *    "instructions":...,"llc_misses":...}
+ *
+ * MODALITÀ DI BOOT:
+ * "bench" sulla command line esegue tutta la suite a fine boot, "bench=a,b"
+ * solo i benchmark indicati; "bench_runs=N" cambia il numero di
+ * esecuzioni. Alla fine il kernel chiede alla piattaforma di terminare
+ * (arch_platform_exit(): sotto QEMU il dispositivo isa-debug-exit) con
+ * stato 0 se tutti i benchmark sono riusciti. scripts/bench.sh avvia
+ * QEMU, raccoglie le righe e le confronta con una baseline.
+ *
+ * USO:
+ *   static bool bench_pmm_page(u64 iters) {
+ *     for (u64 i = 0; i < iters; i++) { ... }
+ *     return true;
+ *   }
+ *   DEFINE_BENCH(pmm_page, bench_pmm_page, 100000);
+ */
+
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define BENCH_DEFAULT_RUNS 5 // Esecuzioni misurate per benchmark
+#define BENCH_MAX_RUNS 31    // Campioni tenuti per la mediana
+
+/**
+ * @brief Esegue iters volte l'operazione misurata
+ *
+ * @return false se il benchmark non ha potuto completare (es. memoria esaurita)
+ */
+typedef bool (*bench_fn_t)(u64 iters);
+
+typedef struct {
+  const char *name;
+  bench_fn_t fn;
+  u64 iters; // Operazioni per esecuzione
+} __attribute__((aligned(8))) bench_t;
+
+#define BENCH_SECTION __attribute__((section(".data.bench"), used))
+
+/**
+ * @brief Registra un benchmark nella suite
+ */
+#define DEFINE_BENCH(bench_name, bench_fn, bench_iters)                                                                                              \
+  static bench_t bench_name##_bench BENCH_SECTION = {.name = #bench_name, .fn = (bench_fn), .iters = (bench_iters)}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief true se la command line chiede la modalità benchmark
+ */
+bool bench_mode_requested(void);
+
+/**
+ * @brief Cerca un benchmark per nome nel registro
+ */
+const bench_t *bench_find(const char *name);
+
+/**
+ * @brief Esegue un benchmark e ne scrive la riga JSON sulla seriale
+ *
+ * @param runs Esecuzioni misurate (0 = BENCH_DEFAULT_RUNS)
+ * @return false se il benchmark è fallito
+ */
+bool bench_run(const bench_t *bench, u32 runs);
+
+/**
+ * @brief Esegue i benchmark scelti dalla command line ("bench" o "bench=a,b")
+ *
+ * @return Numero di benchmark falliti o sconosciuti
+ */
+u32 bench_run_suite(void);
+
+/**
+ * @brief Modalità benchmark: esegue la suite e termina la macchina
+ *
+ * Ritorna solo se la piattaforma non sa terminare (fuori da QEMU).
+ */
+void bench_main(void);
@@ -0,0 +1,152 @@
+/**
+ * @file klib/cmdline.c
+ * @brief Parsing della command line del kernel - Implementazione
+ */
+
+#include "cmdline.h"
+#include <lib/string/string.h>
+
+static char cmdline_buffer[CMDLINE_MAX_LEN];
+
+/* Cerca il token che inizia con key; ritorna l'inizio del token o NULL */
+static const char *cmdline_find(const char *key, size_t *key_len) {
+  size_t len = strlen(key);
+  const char *p = cmdline_buffer;
+
+  while (*p) {
+    while (*p == ' ')
+      p++;
+    if (!*p)
+      break;
+
+    if (strncmp(p, key, len) == 0 && (p[len] == '\0' || p[len] == ' ' || p[len] == '=')) {
+      *key_len = len;
+      return p;
+    }
+
+    while (*p && *p != ' ')
+      p++;
+  }
+
+  return NULL;
+}
+
+/* Converte un numero decimale o 0x esadecimale; ritorna il primo carattere non consumato */
+static const char *cmdline_parse_u64(const char *s, u64 *out, bool *ok) {
+  u64 value = 0;
+  bool digits = false;
+
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    s += 2;
+    for (;; s++) {
+      u64 d;
+      if (*s >= '0' && *s <= '9')
+        d = (u64)(*s - '0');
+      else if (*s >= 'a' && *s <= 'f')
+        d = (u64)(*s - 'a' + 10);
+      else if (*s >= 'A' && *s <= 'F')
+        d = (u64)(*s - 'A' + 10);
+      else
+        break;
+      value = (value << 4) | d;
+      digits = true;
+    }
+  } else {
+    for (; *s >= '0' && *s <= '9'; s++) {
+      value = value * 10 + (u64)(*s - '0');
+      digits = true;
+    }
+  }
+
+  *out = value;
+  *ok = digits;
+  return s;
+}
+
+void cmdline_init(const char *raw) {
+  if (!raw) {
+    cmdline_buffer[0] = '\0';
+    return;
+  }
+
+  strncpy(cmdline_buffer, raw, CMDLINE_MAX_LEN - 1);
+  cmdline_buffer[CMDLINE_MAX_LEN - 1] = '\0';
+
+  /* Tab e newline diventano separatori */
+  for (char *p = cmdline_buffer; *p; p++) {
+    if (*p == '\t' || *p == '\n' || *p == '\r')
+      *p = ' ';
+  }
+}
+
+const char *cmdline_raw(void) {
+  return cmdline_buffer;
+}
+
+bool cmdline_has(const char *key) {
+  size_t len;
+  return cmdline_find(key, &len) != NULL;
+}
+
+bool cmdline_get(const char *key, char *out, size_t out_len) {
+  size_t len;
+  const char *p = cmdline_find(key, &len);
+  if (!p || p[len] != '=' || out_len == 0)
+    return false;
+
+  p += len + 1;
+  size_t i = 0;
+  while (p[i] && p[i] != ' ' && i < out_len - 1) {
+    out[i] = p[i];
+    i++;
+  }
+  out[i] = '\0';
+  return true;
+}
+
+u64 cmdline_get_u64(const char *key, u64 default_value) {
+  char value[32];
+  if (!cmdline_get(key, value, sizeof(value)))
+    return default_value;
+
+  u64 result;
+  bool ok;
+  const char *end = cmdline_parse_u64(value, &result, &ok);
+  return (ok && *end == '\0') ? result : default_value;
+}
+
+u64 cmdline_get_size(const char *key, u64 default_value) {
+  char value[32];
+  if (!cmdline_get(key, value, sizeof(value)))
+    return default_value;
+
+  u64 result;
+  bool ok;
+  const char *end = cmdline_parse_u64(value, &result, &ok);
+  if (!ok)
+    return default_value;
+
+  switch (*end) {
+  case '\0':
+    return result;
+  case 'k':
+  case 'K':
+    end++;
+    result <<= 10;
+    break;
+  case 'm':
+  case 'M':
+    end++;
+    result <<= 20;
+    break;
+  case 'g':
+  case 'G':
+    end++;
+    result <<= 30;
+    break;
+  default:
+    return default_value;
+  }
+
+  return *end == '\0' ? result : default_value;
+}
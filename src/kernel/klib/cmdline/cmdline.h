@@ -0,0 +1,65 @@
+/**
+ * @file klib/cmdline.h
+ * @brief Parsing della command line del kernel
+ *
+ * La command line fornita dal bootloader è una sequenza di token separati
+ * da spazi, nella forma "flag" oppure "chiave=valore". Il modulo ne tiene
+ * una copia statica, quindi può essere inizializzato prima dello heap.
+ *
+ * Esempio: "verbose_boot cma=32M"
+ */
+
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+#define CMDLINE_MAX_LEN 512 /* Lunghezza massima conservata (troncata oltre) */
+
+/**
+ * @brief Inizializza il modulo copiando la command line
+ *
+ * @param raw Stringa del bootloader (NULL = command line vuota)
+ */
+void cmdline_init(const char *raw);
+
+/**
+ * @brief Ritorna la command line completa
+ */
+const char *cmdline_raw(void);
+
+/**
+ * @brief Verifica la presenza di un token ("flag" o "flag=...")
+ *
+ * @param key Nome del parametro
+ * @return true se presente
+ */
+bool cmdline_has(const char *key);
+
+/**
+ * @brief Copia il valore di un parametro "chiave=valore"
+ *
+ * @param key Nome del parametro
+ * @param out Buffer di destinazione (sempre terminato da '\0')
+ * @param out_len Dimensione del buffer
+ * @return true se il parametro è presente con un valore
+ */
+bool cmdline_get(const char *key, char *out, size_t out_len);
+
+/**
+ * @brief Legge un parametro numerico (decimale o 0x esadecimale)
+ *
+ * @param key Nome del parametro
+ * @param default_value Valore ritornato se assente o non valido
+ */
+u64 cmdline_get_u64(const char *key, u64 default_value);
+
+/**
+ * @brief Legge una dimensione con suffisso opzionale K, M o G
+ *
+ * Esempio: "cma=64M" → 67108864
+ *
+ * @param key Nome del parametro
+ * @param default_value Valore in byte ritornato se assente o non valido
+ */
+u64 cmdline_get_size(const char *key, u64 default_value);
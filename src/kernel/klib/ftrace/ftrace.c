@@ -0,0 +1,374 @@
+#include "ftrace.h"
+#include <arch/cpu.h>
+#include <drivers/serial/serial.h>
+#include <klib/cmdline/cmdline.h>
+#include <klib/klog/klog.h>
+#include <klib/ksym/ksym.h>
+#include <lib/stdio/stdio.h>
+#include <lib/string/string.h>
+#include <mm/percpu.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file klib/ftrace.c
+ * @brief Tracer delle funzioni - Implementation
+ *
+ * Simboli del linker (tools/linker.ld): la tabella __patchable_function_entries
+ * contiene l'indirizzo di ogni sito, raggruppata per sottosistema.
+ * _ftrace_sites_<sottosistema> segna l'inizio di ogni gruppo,
+ * _ftrace_sites_end la fine dell'ultimo.
+ *
+ * Questo file è compilato senza NOP d'ingresso (vedi il Makefile).
+ */
+
+extern uptr _ftrace_sites_mm[];
+extern uptr _ftrace_sites_drivers[];
+extern uptr _ftrace_sites_klib[];
+extern uptr _ftrace_sites_arch[];
+extern uptr _ftrace_sites_core[];
+extern uptr _ftrace_sites_end[];
+
+typedef struct {
+  uptr ret;         // Indirizzo di ritorno originale
+  const uptr *cell; // Cella dello stack in cui è stato sostituito
+  uptr ip;
+  u64 start;
+} ftrace_frame_t;
+
+typedef struct {
+  u64 head;  // Eventi scritti dall'avvio (l'indice nell'anello è head % capacità)
+  u32 depth; // Frame validi nello stack ombra
+  u32 busy;  // Tracer in esecuzione su questa CPU (guardia contro la ricorsione)
+  u64 deep;  // Uscite non tracciate: stack ombra pieno
+  ftrace_frame_t shadow[FTRACE_MAX_DEPTH];
+  ftrace_event_t events[FTRACE_EVENTS_PER_CPU];
+} ftrace_buffer_t;
+
+#define FTRACE_BUFFER_PAGES ((sizeof(ftrace_buffer_t) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+static const char *const ftrace_subsys_names[FTRACE_SUBSYS_COUNT] = {
+    [FTRACE_SUBSYS_MM] = "mm",
+    [FTRACE_SUBSYS_DRIVERS] = "drivers",
+    [FTRACE_SUBSYS_KLIB] = "klib",
+    [FTRACE_SUBSYS_ARCH] = "arch",
+    [FTRACE_SUBSYS_CORE] = "core",
+};
+
+/* -------------------------------------------------------------------------- */
+/*                                 Stato globale                              */
+/* -------------------------------------------------------------------------- */
+
+static DEFINE_PER_CPU(ftrace_buffer_t *, ftrace_buffer);
+
+static struct {
+  bool ready;              // Buffer allocati e siti spenti
+  bool running;            // Siti accesi
+  volatile bool recording; // Gli eventi vengono registrati
+  u32 mask;                // Sottosistemi accesi
+} ftrace_state;
+
+/* -------------------------------------------------------------------------- */
+/*                                   Hook                                     */
+/* -------------------------------------------------------------------------- */
+
+static inline void ftrace_record(ftrace_buffer_t *buf, u8 type, uptr ip, u64 tsc, u64 duration) {
+  ftrace_event_t *event = &buf->events[buf->head % FTRACE_EVENTS_PER_CPU];
+  event->tsc = tsc;
+  event->ip = ip;
+  event->duration = duration > 0xffffffffULL ? 0xffffffffU : (u32)duration;
+  event->depth = (u16)buf->depth;
+  event->type = type;
+  buf->head++;
+}
+
+/*
+ * Eseguite dentro le funzioni tracciate, anche in interrupt e NMI: nessun
+ * lock, nessun log. busy impedisce che una funzione tracciata chiamata da
+ * qui (o da un NMI arrivato nel mezzo) rientri nel tracer e tocchi lo
+ * stack ombra a metà aggiornamento. Un interrupt che arriva a busy spento
+ * annida i propri frame sopra quelli interrotti e li toglie prima di
+ * tornare: l'ordine resta LIFO.
+ */
+void ftrace_function_enter(uptr ip, uptr *parent) {
+  if (!ftrace_state.recording)
+    return;
+  ftrace_buffer_t *buf = this_cpu(ftrace_buffer);
+  if (!buf || buf->busy)
+    return;
+  buf->busy = 1;
+
+  u64 now = arch_cpu_cycles();
+  ftrace_record(buf, FTRACE_EVENT_ENTER, ip, now, 0);
+
+  if (buf->depth < FTRACE_MAX_DEPTH) {
+    ftrace_frame_t *frame = &buf->shadow[buf->depth++];
+    frame->ret = *parent;
+    frame->cell = parent;
+    frame->ip = ip;
+    frame->start = now;
+    *parent = (uptr)arch_ftrace_return_trampoline;
+  } else {
+    buf->deep++;
+  }
+
+  buf->busy = 0;
+}
+
+/*
+ * Il trampolino di ritorno è raggiungibile solo da un frame dello stack
+ * ombra: lo si toglie sempre, anche a tracing fermo, altrimenti la funzione
+ * non saprebbe dove tornare.
+ */
+uptr ftrace_function_exit(void) {
+  ftrace_buffer_t *buf = this_cpu(ftrace_buffer);
+  buf->busy = 1;
+
+  ftrace_frame_t *frame = &buf->shadow[--buf->depth];
+  uptr ret = frame->ret;
+  if (ftrace_state.recording) {
+    u64 now = arch_cpu_cycles();
+    ftrace_record(buf, FTRACE_EVENT_EXIT, frame->ip, now, now - frame->start);
+  }
+
+  buf->busy = 0;
+  return ret;
+}
+
+uptr ftrace_resolve_return(uptr ret, const uptr *cell) {
+  if (ret != (uptr)arch_ftrace_return_trampoline)
+    return ret;
+
+  ftrace_buffer_t *buf = this_cpu(ftrace_buffer);
+  if (!buf)
+    return ret;
+  for (u32 i = buf->depth; i-- > 0;) {
+    if (buf->shadow[i].cell == cell)
+      return buf->shadow[i].ret;
+  }
+  return ret;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Siti                                    */
+/* -------------------------------------------------------------------------- */
+
+static inline uptr *ftrace_sites_begin(u32 subsys) {
+  static uptr *const starts[FTRACE_SUBSYS_COUNT + 1] = {_ftrace_sites_mm, _ftrace_sites_drivers, _ftrace_sites_klib, _ftrace_sites_arch, _ftrace_sites_core, _ftrace_sites_end};
+  return starts[subsys];
+}
+
+/**
+ * @brief Porta tutti i siti di un sottosistema allo stato richiesto
+ *
+ * @return Siti riconosciuti
+ */
+static u32 ftrace_patch_subsys(u32 subsys, bool enable) {
+  u32 patched = 0;
+  for (uptr *site = ftrace_sites_begin(subsys); site < ftrace_sites_begin(subsys + 1); site++) {
+    if (*site && arch_ftrace_patch(*site, enable))
+      patched++;
+  }
+  return patched;
+}
+
+static u32 ftrace_parse_mask(char *list) {
+  if (strcmp(list, "all") == 0)
+    return FTRACE_SUBSYS_ALL;
+
+  u32 mask = 0;
+  char *name = list;
+  while (*name) {
+    char *end = name;
+    while (*end && *end != ',')
+      end++;
+    bool last = (*end == '\0');
+    *end = '\0';
+
+    if (*name) {
+      u32 subsys;
+      for (subsys = 0; subsys < FTRACE_SUBSYS_COUNT; subsys++) {
+        if (strcmp(name, ftrace_subsys_names[subsys]) == 0)
+          break;
+      }
+      if (subsys < FTRACE_SUBSYS_COUNT)
+        mask |= 1U << subsys;
+      else
+        klog_warn("ftrace: sottosistema sconosciuto '%s' sulla command line", name);
+    }
+
+    if (last)
+      break;
+    name = end + 1;
+  }
+  return mask;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void ftrace_init(void) {
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    void *phys = pmm_alloc_pages(FTRACE_BUFFER_PAGES);
+    if (!phys) {
+      klog_error("ftrace: buffer della CPU %u non allocato", cpu);
+      continue;
+    }
+    ftrace_buffer_t *buf = (ftrace_buffer_t *)vmm_phys_to_virt((u64)phys);
+    buf->head = 0;
+    buf->depth = 0;
+    buf->busy = 0;
+    buf->deep = 0;
+    per_cpu(ftrace_buffer, cpu) = buf;
+  }
+
+  // Il compilatore può lasciare cinque NOP da un byte: si passa al NOP unico
+  u32 sites = 0, unknown = 0;
+  arch_ftrace_lock();
+  for (u32 subsys = 0; subsys < FTRACE_SUBSYS_COUNT; subsys++) {
+    u32 total = (u32)(ftrace_sites_begin(subsys + 1) - ftrace_sites_begin(subsys));
+    u32 patched = ftrace_patch_subsys(subsys, false);
+    sites += patched;
+    unknown += total - patched;
+  }
+  arch_ftrace_sync();
+  ftrace_state.ready = true;
+  arch_ftrace_unlock();
+  klog_info("ftrace: %u siti (%u non riconosciuti)", sites, unknown);
+
+  char list[64];
+  if (!cmdline_get("ftrace", list, sizeof(list)))
+    return;
+  u32 mask = ftrace_parse_mask(list);
+  if (mask)
+    ftrace_start(mask);
+}
+
+/*
+ * Avvio e arresto tengono il lock delle riscritture dal controllo di
+ * running fino all'ultimo sync: due chiamate concorrenti non accendono e
+ * spengono gli stessi siti intrecciate, né con le static key.
+ */
+bool ftrace_start(u32 subsys_mask) {
+  subsys_mask &= FTRACE_SUBSYS_ALL;
+  if (!subsys_mask)
+    return false;
+
+  arch_ftrace_lock();
+  if (!ftrace_state.ready || ftrace_state.running) {
+    arch_ftrace_unlock();
+    return false;
+  }
+
+  u32 patched = 0;
+  for (u32 subsys = 0; subsys < FTRACE_SUBSYS_COUNT; subsys++) {
+    if (subsys_mask & (1U << subsys))
+      patched += ftrace_patch_subsys(subsys, true);
+  }
+  arch_ftrace_sync();
+
+  ftrace_state.mask = subsys_mask;
+  ftrace_state.running = true;
+  ftrace_state.recording = true;
+  arch_ftrace_unlock();
+
+  klog_info("ftrace: tracing avviato su %u funzioni", patched);
+  return true;
+}
+
+void ftrace_stop(void) {
+  arch_ftrace_lock();
+  if (!ftrace_state.running) {
+    arch_ftrace_unlock();
+    return;
+  }
+
+  // Prima si smette di registrare: i siti ancora accesi diventano innocui
+  ftrace_state.recording = false;
+  for (u32 subsys = 0; subsys < FTRACE_SUBSYS_COUNT; subsys++) {
+    if (ftrace_state.mask & (1U << subsys))
+      ftrace_patch_subsys(subsys, false);
+  }
+  arch_ftrace_sync();
+  ftrace_state.running = false;
+  arch_ftrace_unlock();
+}
+
+bool ftrace_is_running(void) {
+  return ftrace_state.running;
+}
+
+/*
+ * Lo stack ombra non si tocca: può contenere frame di funzioni ancora in
+ * corso, che devono poter tornare.
+ */
+void ftrace_reset(void) {
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    ftrace_buffer_t *buf = per_cpu(ftrace_buffer, cpu);
+    if (buf) {
+      buf->head = 0;
+      buf->deep = 0;
+    }
+  }
+}
+
+void ftrace_dump(void) {
+  if (ftrace_state.running) {
+    klog_warn("ftrace: dump con il tracing attivo");
+    return;
+  }
+
+  static const char indent[] = "                                                                ";
+  char name[KSYM_NAME_MAX];
+  u64 total = 0, lost = 0;
+
+  serial_printf("# ftrace-begin subsys=");
+  for (u32 subsys = 0, first = 1; subsys < FTRACE_SUBSYS_COUNT; subsys++) {
+    if (ftrace_state.mask & (1U << subsys)) {
+      serial_printf(first ? "%s" : ",%s", ftrace_subsys_names[subsys]);
+      first = 0;
+    }
+  }
+  serial_printf(" hz=%lu\n", arch_cpu_cycles_hz());
+
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    ftrace_buffer_t *buf = per_cpu(ftrace_buffer, cpu);
+    if (!buf || buf->head == 0)
+      continue;
+
+    u64 first = buf->head > FTRACE_EVENTS_PER_CPU ? buf->head - FTRACE_EVENTS_PER_CPU : 0;
+    u64 base = buf->events[first % FTRACE_EVENTS_PER_CPU].tsc;
+    serial_printf("# cpu %u events=%lu overwritten=%lu deep=%lu\n", cpu, buf->head - first, first, buf->deep);
+
+    // Tempi relativi al primo evento; due spazi per livello, massimo 32 livelli
+    for (u64 i = first; i < buf->head; i++) {
+      const ftrace_event_t *event = &buf->events[i % FTRACE_EVENTS_PER_CPU];
+      u32 level = event->depth; // Ingresso e uscita di una chiamata allo stesso livello
+      if (level > 32)
+        level = 32;
+      const char *pad = indent + sizeof(indent) - 1 - 2 * level;
+      if (!ksym_lookup(event->ip, name, sizeof(name), NULL))
+        ksnprintf(name, sizeof(name), "0x%lx", event->ip);
+
+      if (event->type == FTRACE_EVENT_ENTER)
+        serial_printf("%lu %s%s {\n", event->tsc - base, pad, name);
+      else
+        serial_printf("%lu %s} %s %u\n", event->tsc - base, pad, name, event->duration);
+    }
+
+    total += buf->head - first;
+    lost += first;
+  }
+
+  serial_printf("# ftrace-end events=%lu overwritten=%lu\n", total, lost);
+  klog_info("ftrace: %lu eventi scritti sulla seriale (%lu sovrascritti)", total, lost);
+  ftrace_reset();
+}
+
+const char *ftrace_subsys_name(ftrace_subsys_t subsys) {
+  return subsys < FTRACE_SUBSYS_COUNT ? ftrace_subsys_names[subsys] : "?";
+}
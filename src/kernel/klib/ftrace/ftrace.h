@@ -0,0 +1,149 @@
+/**
+ * @file klib/ftrace.h
+ * @brief Tracer delle funzioni: ingresso e uscita con timestamp
+ *
+ * Il profiler dice dove si passa il tempo in media; per capire cosa fa una
+ * singola chiamata serve la sequenza esatta delle funzioni attraversate.
+ * Il tracer registra l'ingresso e l'uscita di ogni funzione tracciata, con
+ * il timestamp del TSC e la durata della chiamata.
+ *
+ * SITI:
+ * Il kernel è compilato con -fpatchable-function-entry (vedi il Makefile e
+ * <arch/ftrace.h>): ogni funzione inizia con un NOP a 5 byte. A tracer
+ * spento è l'unico costo; acceso, il NOP delle funzioni scelte diventa una
+ * call al trampolino. Il linker raggruppa i siti per sottosistema
+ * (tools/linker.ld), così il filtro è un intervallo della tabella e non
+ * costa nulla a runtime:
+ *
+ *   mm       mm/
+ *   drivers  drivers/
+ *   klib     klib/ e lib/
+ *   arch     arch/
+ *   core     il resto (main.c)
+ *
+ * Il tracer stesso e il codice che riscrive i siti sono compilati senza
+ * NOP: non possono tracciare se stessi.
+ *
+ * BUFFER:
+ * Ogni CPU scrive nel proprio anello di FTRACE_EVENTS_PER_CPU eventi,
+ * senza lock: pieno, sovrascrive i più vecchi. L'uscita è catturata
+ * sostituendo l'indirizzo di ritorno con un trampolino; l'originale resta
+ * in uno stack ombra per-CPU di FTRACE_MAX_DEPTH frame (oltre, la funzione
+ * registra solo l'ingresso). Non essendoci scheduler lo stack ombra segue
+ * la CPU, non il thread.
+ *
+ * USO:
+ *   "ftrace=mm,drivers" (o "ftrace=all") sulla command line avvia il
+ *   tracing al boot; ftrace_dump() scrive la traccia sulla seriale fra le
+ *   righe "# ftrace-begin" e "# ftrace-end".
+ *
+ * Con l'uscita tracciata __builtin_return_address(0) di una funzione può
+ * valere arch_ftrace_return_trampoline: chi usa l'indirizzo di ritorno
+ * (memprof, lo stack walk del profiler) passa da ftrace_return_address().
+ */
+
+#pragma once
+
+#include <arch/ftrace.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define FTRACE_EVENTS_PER_CPU 8192 // Capacità dell'anello di ogni CPU
+#define FTRACE_MAX_DEPTH 64        // Frame dello stack ombra
+
+typedef enum {
+  FTRACE_SUBSYS_MM,
+  FTRACE_SUBSYS_DRIVERS,
+  FTRACE_SUBSYS_KLIB,
+  FTRACE_SUBSYS_ARCH,
+  FTRACE_SUBSYS_CORE,
+  FTRACE_SUBSYS_COUNT
+} ftrace_subsys_t;
+
+#define FTRACE_SUBSYS_ALL ((1U << FTRACE_SUBSYS_COUNT) - 1)
+
+typedef enum {
+  FTRACE_EVENT_ENTER,
+  FTRACE_EVENT_EXIT,
+} ftrace_event_type_t;
+
+typedef struct {
+  u64 tsc;      // arch_cpu_cycles() all'evento
+  uptr ip;      // Inizio della funzione
+  u32 duration; // Solo EXIT: cicli dall'ingresso (saturato)
+  u16 depth;    // Profondità nello stack ombra
+  u8 type;      // ftrace_event_type_t
+} ftrace_event_t;
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Alloca i buffer per-CPU, spegne tutti i siti e applica la command line
+ *
+ * Richiede PMM, VMM e percpu_init().
+ */
+void ftrace_init(void);
+
+/**
+ * @brief Accende i siti dei sottosistemi indicati e avvia la registrazione
+ *
+ * @param subsys_mask Bit (1 << ftrace_subsys_t), FTRACE_SUBSYS_ALL per tutti
+ * @return false se i buffer mancano o il tracing è già in corso
+ */
+bool ftrace_start(u32 subsys_mask);
+
+/**
+ * @brief Ferma la registrazione e riporta tutti i siti al NOP
+ *
+ * Le funzioni ancora in corso escono comunque dal trampolino di ritorno.
+ */
+void ftrace_stop(void);
+
+/**
+ * @brief true se il tracing è in corso
+ */
+bool ftrace_is_running(void);
+
+/**
+ * @brief Svuota gli anelli di tutte le CPU
+ */
+void ftrace_reset(void);
+
+/**
+ * @brief Scrive la traccia sulla seriale e svuota gli anelli
+ *
+ * Va chiamata a tracing fermo.
+ */
+void ftrace_dump(void);
+
+/**
+ * @brief Nome di un sottosistema ("mm", "drivers", ...)
+ */
+const char *ftrace_subsys_name(ftrace_subsys_t subsys);
+
+/**
+ * @brief Indirizzo di ritorno originale di un frame
+ *
+ * @param ret Valore letto dalla cella
+ * @param cell Cella dello stack che contiene l'indirizzo di ritorno
+ * @return ret, o l'indirizzo salvato nello stack ombra se ret è il
+ *         trampolino di ritorno
+ */
+uptr ftrace_resolve_return(uptr ret, const uptr *cell);
+
+/**
+ * @brief __builtin_return_address(0) che tiene conto del tracer
+ *
+ * Con i frame pointer la cella dell'indirizzo di ritorno segue il frame.
+ */
+#define ftrace_return_address() ftrace_resolve_return((uptr)__builtin_return_address(0), (const uptr *)__builtin_frame_address(0) + 1)
+
+/* Chiamate dai trampolini (arch/<arch>/cpu/ftrace_asm.s) */
+void ftrace_function_enter(uptr ip, uptr *parent);
+uptr ftrace_function_exit(void);
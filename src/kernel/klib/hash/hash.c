@@ -0,0 +1,103 @@
+#include "hash.h"
+#include <lib/string/string.h>
+
+/**
+ * @file klib/hash.c
+ * @brief Funzioni hash - Implementation
+ *
+ * Schema wyhash: il nucleo è una moltiplicazione 64x64→128 bit i cui due
+ * risultati vengono combinati con XOR ("mum"). Una moltiplicazione per
+ * 16 byte di input, nessuna tabella, buona distribuzione anche sui bit
+ * bassi usati come indice di bucket.
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+#define HASH_P0 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+#define HASH_P2 0x8ebc6af09c88c6e3ULL
+#define HASH_P3 0x589965cc75374cc3ULL
+
+static inline u64 hash_mix(u64 a, u64 b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (u64)r ^ (u64)(r >> 64);
+}
+
+static inline u64 hash_read64(const u8 *p) {
+  u64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline u64 hash_read32(const u8 *p) {
+  u32 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// 1..3 byte: primo, centrale e ultimo
+static inline u64 hash_read_small(const u8 *p, size_t len) {
+  return ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                IMPLEMENTAZIONE                             */
+/* -------------------------------------------------------------------------- */
+
+u64 hash_bytes(const void *data, size_t len, u64 seed) {
+  const u8 *p = (const u8 *)data;
+  u64 a, b;
+
+  seed ^= hash_mix(seed ^ HASH_P0, HASH_P1);
+
+  if (len <= 16) {
+    if (len >= 4) {
+      // Due letture sovrapposte coprono 4..16 byte senza cicli
+      size_t mid = (len >> 3) << 2;
+      a = (hash_read32(p) << 32) | hash_read32(p + mid);
+      b = (hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - mid);
+    } else if (len > 0) {
+      a = hash_read_small(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t remaining = len;
+
+    if (remaining > 48) {
+      // Tre catene indipendenti: sfruttano il parallelismo della CPU
+      u64 s1 = seed, s2 = seed;
+      do {
+        seed = hash_mix(hash_read64(p) ^ HASH_P1, hash_read64(p + 8) ^ seed);
+        s1 = hash_mix(hash_read64(p + 16) ^ HASH_P2, hash_read64(p + 24) ^ s1);
+        s2 = hash_mix(hash_read64(p + 32) ^ HASH_P3, hash_read64(p + 40) ^ s2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= s1 ^ s2;
+    }
+
+    while (remaining > 16) {
+      seed = hash_mix(hash_read64(p) ^ HASH_P1, hash_read64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+
+    // Ultimi 16 byte (sovrapposti al blocco precedente se serve)
+    a = hash_read64(p + remaining - 16);
+    b = hash_read64(p + remaining - 8);
+  }
+
+  return hash_mix(HASH_P1 ^ len, hash_mix(a ^ HASH_P1, b ^ seed));
+}
+
+u64 hash_string(const char *str, u64 seed) {
+  return hash_bytes(str, strlen(str), seed);
+}
+
+u64 hash_u64(u64 key, u64 seed) {
+  return hash_mix(hash_mix(key ^ HASH_P0, seed ^ HASH_P1), HASH_P2);
+}
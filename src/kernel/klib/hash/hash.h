@@ -0,0 +1,32 @@
+/**
+ * @file klib/hash.h
+ * @brief Funzioni hash veloci con seed (famiglia wyhash)
+ *
+ * Pensate per le hash table del kernel, non per uso crittografico. Il seed
+ * va scelto per tabella a runtime (es. da arch_cpu_cycles()): chiavi
+ * scelte dall'esterno (nomi di file, handle) non possono così forzare
+ * collisioni prevedibili sullo stesso bucket.
+ */
+
+#pragma once
+
+#include <lib/types.h>
+
+/**
+ * @brief Hash di un buffer di lunghezza arbitraria
+ *
+ * @param data Buffer da elaborare
+ * @param len Lunghezza in byte
+ * @param seed Seed della tabella
+ */
+u64 hash_bytes(const void *data, size_t len, u64 seed);
+
+/**
+ * @brief Hash di una stringa terminata da zero
+ */
+u64 hash_string(const char *str, u64 seed);
+
+/**
+ * @brief Hash di una chiave intera (pfn, id, indirizzo)
+ */
+u64 hash_u64(u64 key, u64 seed);
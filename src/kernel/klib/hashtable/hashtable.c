@@ -0,0 +1,320 @@
+#include "hashtable.h"
+#include <arch/cpu.h>
+#include <klib/hash/hash.h>
+#include <klib/klog/klog.h>
+#include <lib/string/string.h>
+#include <mm/heap/heap.h>
+
+/**
+ * @file klib/hashtable.c
+ * @brief Hash table - Implementation
+ *
+ * Durante una migrazione gli elementi stanno in una sola delle due tabelle:
+ * quelli dei bucket di old già migrati (indice < migrate_pos) sono in
+ * table, gli altri ancora in old. Gli inserimenti vanno sempre in table.
+ *
+ * Lettori RCU e spostamenti: un nodo spostato da un bucket di old a uno di
+ * table porta con sé il lettore che lo stava attraversando, che prosegue
+ * nella catena sbagliata e può saltare dei nodi. Ogni spostamento (e il
+ * cambio di tabella all'avvio del resize) è racchiuso da move_seq: il
+ * lettore che non trova la chiave e vede move_seq cambiato riprova.
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline bool ht_is_rcu(const hashtable_t *ht) {
+  return (ht->flags & HT_FLAG_RCU) != 0;
+}
+
+static inline size_t ht_size(const ht_buckets_t *buckets) {
+  return (size_t)1 << buckets->shift;
+}
+
+static inline hlist_head_t *ht_bucket(ht_buckets_t *buckets, u64 hash) {
+  return &buckets->heads[hash & (ht_size(buckets) - 1)];
+}
+
+static ht_buckets_t *ht_buckets_alloc(u32 shift) {
+  size_t heads = (size_t)1 << shift;
+  ht_buckets_t *buckets = (ht_buckets_t *)kmalloc(sizeof(ht_buckets_t) + heads * sizeof(hlist_head_t));
+  if (!buckets)
+    return (ht_buckets_t *)NULL;
+
+  buckets->shift = shift;
+  memset(buckets->heads, 0, heads * sizeof(hlist_head_t));
+  return buckets;
+}
+
+static void ht_buckets_rcu_free(rcu_head_t *head) {
+  kfree(head); // rcu è il primo campo di ht_buckets_t
+}
+
+static void ht_buckets_free(hashtable_t *ht, ht_buckets_t *buckets) {
+  if (ht_is_rcu(ht))
+    call_rcu(&buckets->rcu, ht_buckets_rcu_free);
+  else
+    kfree(buckets);
+}
+
+/**
+ * Inserimento in testa: con RCU il nodo è pubblicato solo quando è completo.
+ */
+static void ht_link(hashtable_t *ht, hlist_head_t *head, hlist_node_t *node) {
+  if (!ht_is_rcu(ht)) {
+    hlist_add_head(head, node);
+    return;
+  }
+
+  hlist_node_t *first = head->first;
+  node->next = first;
+  node->pprev = &head->first;
+  if (first)
+    first->pprev = &node->next;
+  rcu_assign_pointer(head->first, node);
+}
+
+/**
+ * Rimozione: con RCU node->next resta valido per i lettori in volo.
+ */
+static void ht_unlink(hashtable_t *ht, hlist_node_t *node) {
+  if (!ht_is_rcu(ht)) {
+    hlist_del(node);
+    return;
+  }
+
+  hlist_node_t *next = node->next;
+  rcu_assign_pointer(*node->pprev, next);
+  if (next)
+    next->pprev = node->pprev;
+  node->pprev = (hlist_node_t **)NULL;
+}
+
+static inline void ht_move_begin(hashtable_t *ht) {
+  __atomic_store_n(&ht->move_seq, ht->move_seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void ht_move_end(hashtable_t *ht) {
+  __atomic_store_n(&ht->move_seq, ht->move_seq + 1, __ATOMIC_RELEASE);
+}
+
+static ht_node_t *ht_search_bucket(hashtable_t *ht, ht_buckets_t *buckets, u64 hash, const void *key) {
+  hlist_node_t *it = rcu_dereference(ht_bucket(buckets, hash)->first);
+
+  while (it) {
+    ht_node_t *node = HT_ENTRY(it, ht_node_t, link);
+    if (node->hash == hash && ht->eq(node, key))
+      return node;
+    it = rcu_dereference(it->next);
+  }
+
+  return (ht_node_t *)NULL;
+}
+
+static ht_node_t *ht_find_locked(hashtable_t *ht, u64 hash, const void *key) {
+  ht_node_t *node = (ht_node_t *)NULL;
+  if (ht->old)
+    node = ht_search_bucket(ht, ht->old, hash, key);
+  if (!node)
+    node = ht_search_bucket(ht, ht->table, hash, key);
+  return node;
+}
+
+/**
+ * Sposta fino a steps bucket dalla tabella vecchia a quella corrente.
+ */
+static void ht_migrate_locked(hashtable_t *ht, size_t steps) {
+  ht_buckets_t *old = ht->old;
+  if (!old)
+    return;
+
+  size_t size = ht_size(old);
+
+  while (steps-- > 0 && ht->migrate_pos < size) {
+    hlist_head_t *head = &old->heads[ht->migrate_pos];
+
+    while (head->first) {
+      hlist_node_t *it = head->first;
+      ht_node_t *node = HT_ENTRY(it, ht_node_t, link);
+
+      ht_move_begin(ht);
+      ht_unlink(ht, it);
+      ht_link(ht, ht_bucket(ht->table, node->hash), it);
+      ht_move_end(ht);
+    }
+
+    ht->migrate_pos++;
+  }
+
+  if (ht->migrate_pos == size) {
+    rcu_assign_pointer(ht->old, (ht_buckets_t *)NULL);
+    ht_buckets_free(ht, old);
+  }
+}
+
+/**
+ * Avvia il resize: la tabella corrente diventa old, inserimenti nella nuova.
+ */
+static void ht_grow_locked(hashtable_t *ht) {
+  ht_buckets_t *bigger = ht_buckets_alloc(ht->table->shift + 1);
+  if (!bigger)
+    return; // Si riproverà al prossimo inserimento: la tabella resta valida
+
+  ht_move_begin(ht);
+  rcu_assign_pointer(ht->old, ht->table);
+  rcu_assign_pointer(ht->table, bigger);
+  ht->migrate_pos = 0;
+  ht_move_end(ht);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                IMPLEMENTAZIONE                             */
+/* -------------------------------------------------------------------------- */
+
+bool hashtable_init(hashtable_t *ht, u32 shift, ht_hash_fn hash, ht_eq_fn eq, u32 flags) {
+  if (!hash || !eq)
+    return false;
+
+  if (shift == 0)
+    shift = HT_DEFAULT_SHIFT;
+  if (shift > HT_MAX_SHIFT)
+    shift = HT_MAX_SHIFT;
+
+  memset(ht, 0, sizeof(*ht));
+  ht->hash = hash;
+  ht->eq = eq;
+  ht->flags = flags;
+  ht->seed = hash_u64(arch_cpu_cycles(), (u64)(uptr)ht);
+  spinlock_init(&ht->lock);
+
+  ht->table = ht_buckets_alloc(shift);
+  if (!ht->table) {
+    klog_error("hashtable: impossibile allocare %zu bucket", (size_t)1 << shift);
+    return false;
+  }
+
+  return true;
+}
+
+void hashtable_destroy(hashtable_t *ht) {
+  spinlock_lock(&ht->lock);
+
+  if (ht->count) {
+    klog_warn("hashtable: distruzione con %zu elementi presenti", ht->count);
+  }
+
+  if (ht->old) {
+    ht_buckets_free(ht, ht->old);
+    ht->old = (ht_buckets_t *)NULL;
+  }
+  if (ht->table) {
+    ht_buckets_free(ht, ht->table);
+    ht->table = (ht_buckets_t *)NULL;
+  }
+
+  spinlock_unlock(&ht->lock);
+}
+
+bool hashtable_insert(hashtable_t *ht, ht_node_t *node, const void *key) {
+  u64 hash = ht->hash(key, ht->seed);
+
+  spinlock_lock(&ht->lock);
+
+  ht_migrate_locked(ht, HT_MIGRATE_STEP);
+
+  if (ht_find_locked(ht, hash, key)) {
+    spinlock_unlock(&ht->lock);
+    return false;
+  }
+
+  node->hash = hash;
+  ht_link(ht, ht_bucket(ht->table, hash), &node->link);
+  ht->count++;
+
+  if (!ht->old && ht->count > ht_size(ht->table) && ht->table->shift < HT_MAX_SHIFT)
+    ht_grow_locked(ht);
+
+  spinlock_unlock(&ht->lock);
+  return true;
+}
+
+ht_node_t *hashtable_lookup(hashtable_t *ht, const void *key) {
+  u64 hash = ht->hash(key, ht->seed);
+
+  if (!ht_is_rcu(ht)) {
+    spinlock_lock(&ht->lock);
+    ht_node_t *node = ht_find_locked(ht, hash, key);
+    spinlock_unlock(&ht->lock);
+    return node;
+  }
+
+  for (;;) {
+    u32 seq = __atomic_load_n(&ht->move_seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      arch_cpu_pause(); // Spostamento in corso
+      continue;
+    }
+
+    ht_buckets_t *old = rcu_dereference(ht->old);
+    ht_buckets_t *table = rcu_dereference(ht->table);
+
+    ht_node_t *node = old ? ht_search_bucket(ht, old, hash, key) : (ht_node_t *)NULL;
+    if (!node)
+      node = ht_search_bucket(ht, table, hash, key);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (node || __atomic_load_n(&ht->move_seq, __ATOMIC_RELAXED) == seq)
+      return node;
+  }
+}
+
+ht_node_t *hashtable_remove(hashtable_t *ht, const void *key) {
+  u64 hash = ht->hash(key, ht->seed);
+
+  spinlock_lock(&ht->lock);
+
+  ht_migrate_locked(ht, HT_MIGRATE_STEP);
+
+  ht_node_t *node = ht_find_locked(ht, hash, key);
+  if (node) {
+    ht_unlink(ht, &node->link);
+    ht->count--;
+  }
+
+  spinlock_unlock(&ht->lock);
+  return node;
+}
+
+void hashtable_remove_node(hashtable_t *ht, ht_node_t *node) {
+  spinlock_lock(&ht->lock);
+
+  if (!hlist_unhashed(&node->link)) {
+    ht_unlink(ht, &node->link);
+    ht->count--;
+  }
+
+  ht_migrate_locked(ht, HT_MIGRATE_STEP);
+
+  spinlock_unlock(&ht->lock);
+}
+
+void hashtable_walk(hashtable_t *ht, void (*fn)(ht_node_t *node, void *arg), void *arg) {
+  spinlock_lock(&ht->lock);
+
+  ht_buckets_t *tables[2] = {ht->old, ht->table};
+  for (int t = 0; t < 2; t++) {
+    if (!tables[t])
+      continue;
+
+    for (size_t i = 0; i < ht_size(tables[t]); i++) {
+      hlist_node_t *it, *tmp;
+      HLIST_FOR_EACH_SAFE(it, tmp, &tables[t]->heads[i]) {
+        fn(HT_ENTRY(it, ht_node_t, link), arg);
+      }
+    }
+  }
+
+  spinlock_unlock(&ht->lock);
+}
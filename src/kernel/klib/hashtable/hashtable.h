@@ -0,0 +1,141 @@
+/**
+ * @file klib/hashtable.h
+ * @brief Hash table intrusiva con bucket hlist e resize incrementale
+ *
+ * Il nodo (ht_node_t) è embedded nella struttura dell'utente; la tabella
+ * conosce la chiave solo tramite due callback: hash e confronto. L'hash di
+ * ogni nodo viene memorizzato nel nodo, così lookup e resize non devono
+ * ricalcolarlo.
+ *
+ * RESIZE INCREMENTALE:
+ * Quando gli elementi superano i bucket, viene allocata una tabella doppia
+ * e da quel momento ogni inserimento/rimozione sposta pochi bucket della
+ * vecchia (HT_MIGRATE_STEP). Nessuna operazione paga il rehash di tutta la
+ * tabella; durante la migrazione le ricerche guardano entrambe.
+ *
+ * VARIANTE RCU (HT_FLAG_RCU):
+ * - hashtable_lookup() va chiamata in rcu_read_lock() e non prende lock
+ * - I nodi rimossi possono essere ancora visti dai lettori: vanno liberati
+ *   dal chiamante con call_rcu()
+ * - Lo spostamento dei nodi durante la migrazione incrementa un contatore
+ *   di sequenza: un lettore che non trova la chiave mentre la sequenza è
+ *   cambiata ripete la ricerca
+ */
+
+#pragma once
+
+#include <klib/list/list.h>
+#include <klib/rcu/rcu.h>
+#include <klib/spinlock.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define HT_DEFAULT_SHIFT 4 // 16 bucket iniziali
+#define HT_MAX_SHIFT 24    // Limite di crescita (16M bucket)
+#define HT_MIGRATE_STEP 8  // Bucket migrati per ogni operazione di scrittura
+
+#define HT_FLAG_RCU (1 << 0) // Lookup lock-free in sezione RCU
+
+/**
+ * @brief Nodo da embeddare nelle strutture indicizzate
+ */
+typedef struct {
+  hlist_node_t link;
+  u64 hash; // Hash della chiave, calcolato all'inserimento
+} ht_node_t;
+
+typedef u64 (*ht_hash_fn)(const void *key, u64 seed);
+typedef bool (*ht_eq_fn)(const ht_node_t *node, const void *key);
+
+/**
+ * @brief Array di bucket (allocato con l'header per il rilascio RCU)
+ */
+typedef struct ht_buckets {
+  rcu_head_t rcu;
+  u32 shift;
+  hlist_head_t heads[];
+} ht_buckets_t;
+
+typedef struct {
+  ht_buckets_t *table;   // Tabella corrente (inserimenti)
+  ht_buckets_t *old;     // Tabella in migrazione (NULL se nessuna)
+  size_t migrate_pos;    // Prossimo bucket di old da migrare
+  size_t count;          // Elementi presenti
+  volatile u32 move_seq; // Dispari mentre un nodo è in spostamento
+  u32 flags;
+  u64 seed;
+  ht_hash_fn hash;
+  ht_eq_fn eq;
+  spinlock_t lock; // Serializza gli scrittori
+} hashtable_t;
+
+/**
+ * @brief Ottiene il container da un ht_node_t
+ */
+#define HT_ENTRY(ptr, type, member) ((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Inizializza una tabella vuota
+ *
+ * @param shift Log2 dei bucket iniziali (0 = HT_DEFAULT_SHIFT)
+ * @param hash Funzione hash della chiave
+ * @param eq Confronto nodo/chiave
+ * @param flags HT_FLAG_*
+ * @return false se manca memoria
+ */
+bool hashtable_init(hashtable_t *ht, u32 shift, ht_hash_fn hash, ht_eq_fn eq, u32 flags);
+
+/**
+ * @brief Rilascia i bucket (la tabella deve essere vuota)
+ */
+void hashtable_destroy(hashtable_t *ht);
+
+/**
+ * @brief Inserisce un nodo con la chiave indicata
+ *
+ * @return false se la chiave è già presente
+ */
+bool hashtable_insert(hashtable_t *ht, ht_node_t *node, const void *key);
+
+/**
+ * @brief Cerca il nodo di una chiave
+ *
+ * Tabelle RCU: chiamare in rcu_read_lock(), il nodo resta valido fino a
+ * rcu_read_unlock(). Altre tabelle: il nodo è valido finché il chiamante
+ * garantisce che nessuno lo rimuova.
+ *
+ * @return Nodo o NULL se assente
+ */
+ht_node_t *hashtable_lookup(hashtable_t *ht, const void *key);
+
+/**
+ * @brief Rimuove il nodo di una chiave
+ *
+ * @return Nodo rimosso (da liberare dopo un grace period se RCU) o NULL
+ */
+ht_node_t *hashtable_remove(hashtable_t *ht, const void *key);
+
+/**
+ * @brief Rimuove un nodo già noto
+ */
+void hashtable_remove_node(hashtable_t *ht, ht_node_t *node);
+
+/**
+ * @brief Visita tutti i nodi (con il lock preso: fn non deve modificare la tabella)
+ */
+void hashtable_walk(hashtable_t *ht, void (*fn)(ht_node_t *node, void *arg), void *arg);
+
+/**
+ * @brief Numero di elementi presenti
+ */
+static inline size_t hashtable_count(const hashtable_t *ht) {
+  return ht->count;
+}
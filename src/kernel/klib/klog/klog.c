@@ -1,14 +1,15 @@
 #include "klog.h"
 #include <drivers/video/console.h>
+#include <lib/cache.h>
 #include <lib/stdio/stdio.h>
 
 // === Stato interno del sistema di logging ===
 
 /// Livello minimo corrente per filtrare i messaggi di log
-static klog_level_t current_log_level = KLOG_DEFAULT_LEVEL;
+static klog_level_t current_log_level __read_mostly = KLOG_DEFAULT_LEVEL;
 
 /// Flag per abilitare/disabilitare i colori nella console
-static bool colors_enabled = true;
+static bool colors_enabled __read_mostly = true;
 
 /// Stili predefiniti per ogni livello di log
 static const klog_style_t log_styles[] = {
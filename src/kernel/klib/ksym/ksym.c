@@ -0,0 +1,115 @@
+#include "ksym.h"
+#include <klib/klog/klog.h>
+#include <lib/stdio/stdio.h>
+
+/**
+ * @file klib/ksym.c
+ * @brief Tabella dei simboli del kernel - Implementation
+ *
+ * I simboli della tabella sono weak: al primo passo del link non esistono
+ * e valgono 0, e il codice di questo file ha la stessa dimensione nei due
+ * passi, così gli indirizzi delle funzioni non cambiano.
+ */
+
+extern const u32 ksym_count __attribute__((weak));
+extern const u32 ksym_interval __attribute__((weak));
+extern const u32 ksym_offsets[] __attribute__((weak));
+extern const u32 ksym_restarts[] __attribute__((weak));
+extern const u8 ksym_names[] __attribute__((weak));
+
+extern const char _text_start[];
+extern const char _text_end[];
+extern const char _ksymtab_start[];
+extern const char _ksymtab_end[];
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni interne                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Indice dell'ultimo simbolo con offset <= off (ricerca binaria)
+ */
+static u32 ksym_find(u32 off) {
+  u32 lo = 0, hi = ksym_count;
+  while (hi - lo > 1) {
+    u32 mid = lo + (hi - lo) / 2;
+    if (ksym_offsets[mid] <= off)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * @brief Ricostruisce il nome del simbolo index partendo dal restart
+ *
+ * I caratteri oltre il buffer vengono saltati: il prefisso condiviso con
+ * il nome precedente non supera mai quello già scritto, quindi il troncamento
+ * resta corretto anche per i simboli successivi.
+ */
+static void ksym_decode(u32 index, char *name, size_t len) {
+  u32 restart = index / ksym_interval;
+  const u8 *p = ksym_names + ksym_restarts[restart];
+  size_t name_len = 0;
+
+  for (u32 i = restart * ksym_interval; i <= index; i++) {
+    u8 shared = p[0];
+    u8 rest = p[1];
+    p += 2;
+    for (u8 c = 0; c < rest; c++) {
+      size_t pos = (size_t)shared + c;
+      if (pos < len - 1)
+        name[pos] = (char)p[c];
+    }
+    p += rest;
+    name_len = (size_t)shared + rest;
+  }
+
+  name[name_len < len - 1 ? name_len : len - 1] = '\0';
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void ksym_init(void) {
+  if (!ksym_available()) {
+    klog_warn("ksym: tabella dei simboli assente, indirizzi non risolti");
+    return;
+  }
+  klog_info("ksym: %u simboli in %lu byte", ksym_count, (u64)(_ksymtab_end - _ksymtab_start));
+}
+
+bool ksym_available(void) {
+  return &ksym_count != NULL && ksym_count > 0 && ksym_interval > 0;
+}
+
+uptr ksym_lookup(uptr addr, char *name, size_t len, uptr *offset) {
+  if (!ksym_available() || addr < (uptr)_text_start || addr >= (uptr)_text_end)
+    return 0;
+
+  u32 off = (u32)(addr - (uptr)_text_start);
+  if (off < ksym_offsets[0])
+    return 0;
+
+  u32 index = ksym_find(off);
+  uptr start = (uptr)_text_start + ksym_offsets[index];
+
+  if (name && len > 0)
+    ksym_decode(index, name, len);
+  if (offset)
+    *offset = addr - start;
+  return start;
+}
+
+int ksym_snprint(char *buf, size_t len, uptr addr) {
+  char name[KSYM_NAME_MAX];
+  uptr offset;
+
+  if (!ksym_lookup(addr, name, sizeof(name), &offset))
+    return ksnprintf(buf, len, "0x%lx", addr);
+  if (offset == 0)
+    return ksnprintf(buf, len, "%s", name);
+  return ksnprintf(buf, len, "%s+0x%lx", name, offset);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file klib/ksym.h
+ * @brief Tabella dei simboli del kernel incorporata nell'immagine
+ *
+ * Risolve un indirizzo di codice in "funzione+offset" senza l'ELF: profiler,
+ * tracer e panic stampano nomi direttamente sulla macchina.
+ *
+ * La tabella è generata dopo un primo link da scripts/gen_ksyms.sh e
+ * inclusa nel link definitivo nella sezione .ksymtab (vedi il Makefile del
+ * kernel). Contiene solo i simboli di testo, ordinati per indirizzo:
+ * - offset a 32 bit da _text_start invece di indirizzi a 64 bit
+ * - nomi con prefisso condiviso col precedente (front coding), interi ogni
+ *   ksym_interval simboli
+ *
+ * La ricerca è binaria sugli offset; il nome si ricostruisce dal punto di
+ * restart precedente, al massimo ksym_interval passi.
+ *
+ * Se l'immagine non contiene la tabella (primo passo del link, o build
+ * senza lo script) ogni ricerca fallisce e i chiamanti stampano indirizzi.
+ */
+
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+#define KSYM_NAME_MAX 256 /* Nome più lungo conservato, terminatore incluso */
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Registra nel log dimensione e numero di simboli della tabella
+ */
+void ksym_init(void);
+
+/**
+ * @brief Verifica che l'immagine contenga la tabella
+ */
+bool ksym_available(void);
+
+/**
+ * @brief Cerca la funzione che contiene un indirizzo
+ *
+ * @param addr Indirizzo di codice
+ * @param name Buffer per il nome (troncato a len - 1), può essere NULL
+ * @param len Dimensione del buffer
+ * @param offset Distanza di addr dall'inizio della funzione, può essere NULL
+ * @return Indirizzo di inizio della funzione, 0 se non trovata
+ */
+uptr ksym_lookup(uptr addr, char *name, size_t len, uptr *offset);
+
+/**
+ * @brief Formatta un indirizzo come "nome+0xoff", o "0x..." se non risolto
+ *
+ * @return Caratteri scritti (come ksnprintf)
+ */
+int ksym_snprint(char *buf, size_t len, uptr addr);
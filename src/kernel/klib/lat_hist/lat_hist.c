@@ -0,0 +1,184 @@
+#include "lat_hist.h"
+#include <klib/cmdline/cmdline.h>
+#include <klib/klog/klog.h>
+#include <lib/string/string.h>
+
+/**
+ * @file klib/lat_hist.c
+ * @brief Istogrammi di latenza - Implementation
+ *
+ * Simboli del linker (tools/linker.ld):
+ * - _lat_hist_start/_lat_hist_end: i lat_hist_t definiti con
+ *   DEFINE_LAT_HIST, cioè il registro
+ */
+
+extern lat_hist_t _lat_hist_start[];
+extern lat_hist_t _lat_hist_end[];
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni interne                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Valore più alto che finisce nel bucket index
+ */
+static u64 lat_hist_bucket_limit(u32 index) {
+  u32 group = index / LAT_HIST_SUB_BUCKETS;
+  u64 sub = index % LAT_HIST_SUB_BUCKETS;
+
+  if (group == 0)
+    return sub;
+  if (index == LAT_HIST_BUCKETS - 1)
+    return ~0ULL;
+
+  u32 shift = group - 1;
+  return ((LAT_HIST_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Cicli in nanosecondi (con mhz 0, frequenza ignota, restano cicli)
+ */
+static u64 lat_hist_to_ns(u64 cycles, u64 mhz) {
+  return mhz ? cycles * 1000 / mhz : cycles;
+}
+
+static void lat_hist_apply_cmdline(void) {
+  char list[256];
+  if (!cmdline_get("lat_hist", list, sizeof(list)))
+    return;
+
+  if (strcmp(list, "all") == 0) {
+    for (lat_hist_t *hist = _lat_hist_start; hist < _lat_hist_end; hist++)
+      lat_hist_enable(hist);
+    return;
+  }
+
+  char *name = list;
+  while (*name) {
+    char *end = name;
+    while (*end && *end != ',')
+      end++;
+    bool last = (*end == '\0');
+    *end = '\0';
+
+    if (*name) {
+      lat_hist_t *hist = lat_hist_find(name);
+      if (hist)
+        lat_hist_enable(hist);
+      else
+        klog_warn("lat_hist: istogramma sconosciuto '%s' sulla command line", name);
+    }
+
+    if (last)
+      break;
+    name = end + 1;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void lat_hist_init(void) {
+  lat_hist_apply_cmdline();
+
+  u32 enabled = 0;
+  for (lat_hist_t *hist = _lat_hist_start; hist < _lat_hist_end; hist++)
+    enabled += static_key_enabled(hist->key);
+  klog_info("lat_hist: %zu istogrammi, %u accesi", (size_t)(_lat_hist_end - _lat_hist_start), enabled);
+}
+
+lat_hist_t *lat_hist_find(const char *name) {
+  for (lat_hist_t *hist = _lat_hist_start; hist < _lat_hist_end; hist++) {
+    if (strcmp(hist->name, name) == 0)
+      return hist;
+  }
+  return NULL;
+}
+
+void lat_hist_enable(lat_hist_t *hist) {
+  static_key_enable(hist->key);
+}
+
+void lat_hist_disable(lat_hist_t *hist) {
+  static_key_disable(hist->key);
+}
+
+void lat_hist_reset(lat_hist_t *hist) {
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    memset(per_cpu_ptr(hist->pcpu, cpu), 0, sizeof(lat_hist_data_t));
+  }
+}
+
+void lat_hist_merge(const lat_hist_t *hist, lat_hist_data_t *out) {
+  memset(out, 0, sizeof(*out));
+
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    const lat_hist_data_t *data = per_cpu_ptr(hist->pcpu, cpu);
+    if (data->count == 0)
+      continue;
+    if (out->count == 0 || data->min < out->min)
+      out->min = data->min;
+    if (data->max > out->max)
+      out->max = data->max;
+    out->count += data->count;
+    out->sum += data->sum;
+    for (u32 b = 0; b < LAT_HIST_BUCKETS; b++)
+      out->buckets[b] += data->buckets[b];
+  }
+}
+
+u64 lat_hist_percentile(const lat_hist_data_t *data, u32 permille) {
+  if (data->count == 0)
+    return 0;
+
+  // Rango del campione cercato, arrotondato per eccesso (almeno il primo)
+  u64 rank = (data->count * permille + 999) / 1000;
+  if (rank == 0)
+    rank = 1;
+
+  u64 seen = 0;
+  for (u32 b = 0; b < LAT_HIST_BUCKETS; b++) {
+    seen += data->buckets[b];
+    if (seen >= rank) {
+      u64 limit = lat_hist_bucket_limit(b);
+      return limit < data->max ? limit : data->max;
+    }
+  }
+  return data->max;
+}
+
+void lat_hist_report(const lat_hist_t *hist) {
+  lat_hist_data_t data;
+  lat_hist_merge(hist, &data);
+
+  if (data.count == 0) {
+    klog_info("lat_hist: [%s] nessun campione", hist->name);
+    return;
+  }
+
+  u64 mhz = arch_cpu_cycles_hz() / 1000000;
+  const char *unit = mhz ? "ns" : "cicli";
+
+  klog_info("lat_hist: [%s] %lu campioni, %s: min %lu media %lu max %lu", hist->name, data.count, unit, lat_hist_to_ns(data.min, mhz),
+            lat_hist_to_ns(data.sum / data.count, mhz), lat_hist_to_ns(data.max, mhz));
+  klog_info("  p50 %lu  p90 %lu  p99 %lu  p99.9 %lu", lat_hist_to_ns(lat_hist_percentile(&data, 500), mhz), lat_hist_to_ns(lat_hist_percentile(&data, 900), mhz),
+            lat_hist_to_ns(lat_hist_percentile(&data, 990), mhz), lat_hist_to_ns(lat_hist_percentile(&data, 999), mhz));
+}
+
+void lat_hist_report_all(void) {
+  for (lat_hist_t *hist = _lat_hist_start; hist < _lat_hist_end; hist++) {
+    if (static_key_enabled(hist->key) || per_cpu_ptr(hist->pcpu, 0)->count)
+      lat_hist_report(hist);
+  }
+}
+
+bool lat_hist_any_enabled(void) {
+  for (lat_hist_t *hist = _lat_hist_start; hist < _lat_hist_end; hist++) {
+    if (static_key_enabled(hist->key))
+      return true;
+  }
+  return false;
+}
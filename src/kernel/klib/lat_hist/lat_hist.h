@@ -0,0 +1,185 @@
+/**
+ * @file klib/lat_hist.h
+ * @brief Istogrammi di latenza log-lineari (stile HDR) per i percorsi caldi
+ *
+ * Le medie nascondono la coda: un'allocazione su mille che aspetta un lock
+ * non sposta la media ma è il p99.9. Un istogramma registra ogni durata
+ * (in cicli di arch_cpu_cycles()) in un bucket e a richiesta ne ricava i
+ * percentili.
+ *
+ * BUCKET:
+ * Ogni potenza di due [2^k, 2^(k+1)) è divisa in LAT_HIST_SUB_BUCKETS
+ * bucket lineari: l'errore relativo di un valore è al massimo
+ * 1/LAT_HIST_SUB_BUCKETS su tutta la scala, da pochi cicli a secondi, con
+ * un numero fisso e piccolo di contatori. I valori sotto
+ * LAT_HIST_SUB_BUCKETS sono esatti; oltre 2^LAT_HIST_MAX_SHIFT cicli
+ * finiscono nell'ultimo bucket (il massimo resta esatto).
+ *
+ * PER-CPU:
+ * Ogni CPU registra nella propria copia (mm/percpu.h), senza lock né
+ * atomiche; il report somma le copie. Un interrupt che registra nello
+ * stesso istogramma della CPU interrotta può perdere un campione: è una
+ * statistica, non un contatore esatto.
+ *
+ * USO:
+ *   DEFINE_LAT_HIST(lat_pmm_alloc);
+ *
+ *   u64 t = lat_hist_start(lat_pmm_alloc);
+ *   ...
+ *   lat_hist_stop(lat_pmm_alloc, t);
+ *
+ * Ogni istogramma ha una static key con il suo nome: spento, start e stop
+ * sono un NOP ciascuno. Si accende con "lat_hist=nome,nome" (o
+ * "lat_hist=all") sulla command line, con "static_keys=nome", oppure con
+ * lat_hist_enable(). Gli istogrammi sono raccolti dal linker in un
+ * registro: lat_hist_report_all() li stampa tutti.
+ */
+
+#pragma once
+
+#include <arch/cpu.h>
+#include <klib/static_key/static_key.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+#include <mm/percpu.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define LAT_HIST_SUB_BITS 4                          // 16 bucket per potenza di due: errore <= 6.25%
+#define LAT_HIST_SUB_BUCKETS (1U << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_SHIFT 36                        // 2^36 cicli: decine di secondi
+#define LAT_HIST_BUCKETS ((LAT_HIST_MAX_SHIFT - LAT_HIST_SUB_BITS + 2) * LAT_HIST_SUB_BUCKETS)
+
+typedef struct {
+  u64 count;
+  u64 sum;
+  u64 min;
+  u64 max;
+  u32 buckets[LAT_HIST_BUCKETS];
+} lat_hist_data_t;
+
+typedef struct {
+  const char *name;
+  lat_hist_data_t *pcpu; // Puntatore per-CPU (usare con this_cpu_ptr/per_cpu_ptr)
+  static_key_t *key;
+} __attribute__((aligned(8))) lat_hist_t;
+
+#define LAT_HIST_SECTION __attribute__((section(".data.lat_hist"), used))
+
+/**
+ * @brief Definisce un istogramma, la sua static key e le copie per-CPU
+ */
+#define DEFINE_LAT_HIST(hist_name)                                                                                                                   \
+  DEFINE_STATIC_KEY_FALSE(hist_name);                                                                                                                \
+  static DEFINE_PER_CPU(lat_hist_data_t, hist_name##_pcpu);                                                                                          \
+  lat_hist_t hist_name##_hist LAT_HIST_SECTION = {.name = #hist_name, .pcpu = &hist_name##_pcpu, .key = &hist_name.key}
+
+#define DECLARE_LAT_HIST(hist_name)                                                                                                                  \
+  DECLARE_STATIC_KEY_FALSE(hist_name);                                                                                                               \
+  extern lat_hist_t hist_name##_hist
+
+/* -------------------------------------------------------------------------- */
+/*                               Registrazione                                */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Indice del bucket di un valore
+ */
+static inline u32 lat_hist_bucket(u64 value) {
+  if (value < LAT_HIST_SUB_BUCKETS)
+    return (u32)value;
+
+  u32 msb = 63 - (u32)__builtin_clzll(value);
+  if (msb > LAT_HIST_MAX_SHIFT)
+    return LAT_HIST_BUCKETS - 1;
+
+  u32 shift = msb - LAT_HIST_SUB_BITS;
+  return (shift + 1) * LAT_HIST_SUB_BUCKETS + (u32)(value >> shift) - LAT_HIST_SUB_BUCKETS;
+}
+
+/**
+ * @brief Registra una durata nella copia della CPU corrente
+ */
+static inline void lat_hist_record(lat_hist_t *hist, u64 cycles) {
+  lat_hist_data_t *data = this_cpu_ptr(hist->pcpu);
+  if (data->count == 0 || cycles < data->min)
+    data->min = cycles;
+  if (cycles > data->max)
+    data->max = cycles;
+  data->count++;
+  data->sum += cycles;
+  data->buckets[lat_hist_bucket(cycles)]++;
+}
+
+/**
+ * @brief Istante d'inizio, 0 se l'istogramma è spento
+ */
+#define lat_hist_start(hist_name) (static_branch_unlikely(&(hist_name)) ? arch_cpu_cycles() : 0)
+
+/**
+ * @brief Registra la durata da start; niente se spento (o acceso dopo start)
+ */
+#define lat_hist_stop(hist_name, start)                                                                                                              \
+  do {                                                                                                                                               \
+    u64 __lat_start = (start);                                                                                                                       \
+    if (static_branch_unlikely(&(hist_name)) && __lat_start)                                                                                         \
+      lat_hist_record(&hist_name##_hist, arch_cpu_cycles() - __lat_start);                                                                           \
+  } while (0)
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Accende gli istogrammi indicati da "lat_hist=" sulla command line
+ *
+ * Da chiamare dopo percpu_early_init(): la registrazione usa l'area per-CPU.
+ */
+void lat_hist_init(void);
+
+/**
+ * @brief Cerca un istogramma per nome nel registro
+ */
+lat_hist_t *lat_hist_find(const char *name);
+
+void lat_hist_enable(lat_hist_t *hist);
+void lat_hist_disable(lat_hist_t *hist);
+
+/**
+ * @brief Azzera le copie di tutte le CPU
+ */
+void lat_hist_reset(lat_hist_t *hist);
+
+/**
+ * @brief Somma le copie di tutte le CPU in out
+ */
+void lat_hist_merge(const lat_hist_t *hist, lat_hist_data_t *out);
+
+/**
+ * @brief Valore sotto cui cade la frazione permille dei campioni
+ *
+ * Restituisce il limite superiore del bucket (mai oltre il massimo
+ * osservato), cioè una stima per eccesso entro l'errore dei bucket.
+ *
+ * @param permille 500 = mediana, 990 = p99, 999 = p99.9
+ */
+u64 lat_hist_percentile(const lat_hist_data_t *data, u32 permille);
+
+/**
+ * @brief Stampa conteggio, min, media, p50/p90/p99/p99.9 e max
+ *
+ * In nanosecondi se la frequenza dei cicli è nota, altrimenti in cicli.
+ */
+void lat_hist_report(const lat_hist_t *hist);
+
+/**
+ * @brief Stampa tutti gli istogrammi del registro con almeno un campione
+ */
+void lat_hist_report_all(void);
+
+/**
+ * @brief Verifica se almeno un istogramma è acceso
+ */
+bool lat_hist_any_enabled(void);
@@ -56,3 +56,45 @@ void list_remove(list_node_t *node) {
 bool list_is_empty(const list_node_t *list) {
   return list->next == list;
 }
+
+/* -------------------------------------------------------------------------- */
+/*                                    HLIST                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Inizializza una testa hlist vuota.
+ */
+void hlist_init_head(hlist_head_t *head) {
+  head->first = (hlist_node_t *)0;
+}
+
+/**
+ * Inserisce un nodo in testa: il vecchio primo nodo ora è puntato da node->next.
+ */
+void hlist_add_head(hlist_head_t *head, hlist_node_t *node) {
+  hlist_node_t *first = head->first;
+  node->next = first;
+  if (first)
+    first->pprev = &node->next;
+  head->first = node;
+  node->pprev = &head->first;
+}
+
+/**
+ * Rimuove un nodo aggiornando il puntatore che lo referenzia.
+ */
+void hlist_del(hlist_node_t *node) {
+  hlist_node_t *next = node->next;
+  *node->pprev = next;
+  if (next)
+    next->pprev = node->pprev;
+  node->next = (hlist_node_t *)0;
+  node->pprev = (hlist_node_t **)0;
+}
+
+/**
+ * Un nodo mai inserito o già rimosso ha pprev NULL.
+ */
+bool hlist_unhashed(const hlist_node_t *node) {
+  return node->pprev == (hlist_node_t **)0;
+}
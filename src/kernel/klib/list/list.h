@@ -21,6 +21,22 @@ typedef struct list_node {
   struct list_node *next;
 } list_node_t;
 
+/**
+ * @brief Lista a testa singola (hlist) per i bucket delle hash table
+ *
+ * La testa è un solo puntatore: una tabella di N bucket occupa metà della
+ * memoria rispetto a list_node_t. pprev punta al campo che punta al nodo
+ * (la testa o il next del precedente), così la rimozione resta O(1).
+ */
+typedef struct hlist_node {
+  struct hlist_node *next;
+  struct hlist_node **pprev;
+} hlist_node_t;
+
+typedef struct {
+  hlist_node_t *first;
+} hlist_head_t;
+
 /* -------------------------------------------------------------------------- */
 /*                              Funzioni disponibili                          */
 /* -------------------------------------------------------------------------- */
@@ -79,6 +95,28 @@ void list_remove(list_node_t *node);
  */
 bool list_is_empty(const list_node_t *list);
 
+/**
+ * @brief Inizializza una testa hlist vuota
+ */
+void hlist_init_head(hlist_head_t *head);
+
+/**
+ * @brief Inserisce un nodo in testa a una hlist
+ */
+void hlist_add_head(hlist_head_t *head, hlist_node_t *node);
+
+/**
+ * @brief Rimuove un nodo dalla sua hlist
+ *
+ * Il nodo viene reimpostato come "non collegato" (vedi hlist_unhashed).
+ */
+void hlist_del(hlist_node_t *node);
+
+/**
+ * @brief Verifica se un nodo non appartiene ad alcuna hlist
+ */
+bool hlist_unhashed(const hlist_node_t *node);
+
 /* -------------------------------------------------------------------------- */
 /*                         Macro di utilità per iterazione                    */
 /* -------------------------------------------------------------------------- */
@@ -108,3 +146,13 @@ bool list_is_empty(const list_node_t *list);
  * @param member Nome del campo list_node
  */
 #define LIST_ENTRY(ptr, type, member) ((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
+
+/**
+ * @brief Itera su tutti i nodi di una hlist
+ */
+#define HLIST_FOR_EACH(it, head) for ((it) = (head)->first; (it); (it) = (it)->next)
+
+/**
+ * @brief Itera su una hlist consentendo la rimozione del nodo corrente
+ */
+#define HLIST_FOR_EACH_SAFE(it, tmp, head) for ((it) = (head)->first; (it) && ((tmp) = (it)->next, 1); (it) = (tmp))
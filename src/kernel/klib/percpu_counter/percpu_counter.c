@@ -0,0 +1,114 @@
+#include "percpu_counter.h"
+#include <klib/bitmap/bitmap.h>
+#include <klib/spinlock.h>
+#include <mm/percpu.h>
+
+/**
+ * @file klib/percpu_counter.c
+ * @brief Contatori per-CPU - Implementation
+ *
+ * Gli slot sono aggiornati con add atomiche relaxed: la riga è toccata solo
+ * dalla CPU proprietaria, quindi l'add resta locale alla sua cache e non
+ * genera traffico di coerenza. L'atomicità serve contro gli interrupt sulla
+ * stessa CPU. Il riversamento usa un exchange sullo slot: nessun delta può
+ * essere contato due volte o perso.
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                                 Stato globale                              */
+/* -------------------------------------------------------------------------- */
+
+// La riga di ogni CPU sta nella sua unità per-CPU
+static DEFINE_PER_CPU(s32[PERCPU_COUNTER_SLOTS], percpu_counter_deltas);
+
+static spinlock_t percpu_counter_lock = SPINLOCK_INITIALIZER;
+static u64 percpu_counter_slot_bits[PERCPU_COUNTER_SLOTS / 64] = {1}; // Slot 0 riservato
+static bitmap_t percpu_counter_slots = {percpu_counter_slot_bits, PERCPU_COUNTER_SLOTS};
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline s32 *percpu_counter_local(const percpu_counter_t *counter) {
+  return &this_cpu(percpu_counter_deltas)[counter->slot];
+}
+
+static inline s32 *percpu_counter_of(const percpu_counter_t *counter, u32 cpu) {
+  return &per_cpu(percpu_counter_deltas, cpu)[counter->slot];
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                IMPLEMENTAZIONE                             */
+/* -------------------------------------------------------------------------- */
+
+bool percpu_counter_init(percpu_counter_t *counter, s64 initial, s32 batch) {
+  counter->count = initial;
+  counter->batch = batch > 0 ? batch : PERCPU_COUNTER_BATCH;
+  counter->slot = 0;
+
+  spinlock_lock(&percpu_counter_lock);
+  size_t slot = bitmap_find_first_clear(&percpu_counter_slots);
+  if (slot != -1UL) {
+    bitmap_set(&percpu_counter_slots, slot);
+    counter->slot = (u32)slot;
+    u32 cpu;
+    FOR_EACH_PERCPU_CPU(cpu) {
+      *percpu_counter_of(counter, cpu) = 0;
+    }
+  }
+  spinlock_unlock(&percpu_counter_lock);
+
+  return counter->slot != 0;
+}
+
+void percpu_counter_destroy(percpu_counter_t *counter) {
+  if (!counter->slot)
+    return;
+
+  // sum riversa gli slot nel totale: il valore finale resta leggibile
+  percpu_counter_set(counter, percpu_counter_sum(counter));
+
+  spinlock_lock(&percpu_counter_lock);
+  bitmap_clear(&percpu_counter_slots, counter->slot);
+  counter->slot = 0;
+  spinlock_unlock(&percpu_counter_lock);
+}
+
+void percpu_counter_add(percpu_counter_t *counter, s64 amount) {
+  // Senza slot, o con delta che da soli superano il batch: direttamente sul globale
+  if (!counter->slot || amount >= counter->batch || amount <= -counter->batch) {
+    __atomic_add_fetch(&counter->count, amount, __ATOMIC_RELAXED);
+    return;
+  }
+
+  s32 *local = percpu_counter_local(counter);
+  s32 value = __atomic_add_fetch(local, (s32)amount, __ATOMIC_RELAXED);
+
+  if (value >= counter->batch || value <= -counter->batch) {
+    s32 spill = __atomic_exchange_n(local, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counter->count, spill, __ATOMIC_RELAXED);
+  }
+}
+
+s64 percpu_counter_sum(percpu_counter_t *counter) {
+  s64 sum = __atomic_load_n(&counter->count, __ATOMIC_RELAXED);
+  if (!counter->slot)
+    return sum;
+
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    sum += __atomic_load_n(percpu_counter_of(counter, cpu), __ATOMIC_RELAXED);
+  }
+
+  return sum;
+}
+
+void percpu_counter_set(percpu_counter_t *counter, s64 value) {
+  if (counter->slot) {
+    u32 cpu;
+    FOR_EACH_PERCPU_CPU(cpu) {
+      __atomic_store_n(percpu_counter_of(counter, cpu), 0, __ATOMIC_RELAXED);
+    }
+  }
+  __atomic_store_n(&counter->count, value, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file klib/percpu_counter.h
+ * @brief Contatori per-CPU: incremento locale, somma alla lettura
+ *
+ * Un contatore condiviso aggiornato da ogni CPU a ogni operazione fa
+ * rimbalzare la sua cache line fra i core. Qui ogni CPU accumula in uno
+ * slot proprio e riversa nel totale globale solo quando il delta locale
+ * raggiunge batch.
+ *
+ * LAYOUT:
+ * Gli slot non sono dentro il contatore ma in un array per-CPU (una riga
+ * nell'unità di ogni CPU, vedi mm/percpu.h). Tutti gli slot di una CPU
+ * stanno nella sua unità: CPU diverse non condividono mai linee e un
+ * contatore costa 4 byte per CPU invece di una cache line per CPU.
+ *
+ * LETTURA:
+ * - percpu_counter_read(): solo il totale globale, O(1), errore massimo
+ *   batch × CPU. Adatto a soglie e statistiche
+ * - percpu_counter_sum(): totale più tutti gli slot, esatto a meno delle
+ *   operazioni in volo. Adatto a dump e verifiche
+ *
+ * Un contatore azzerato (es. statico) è già utilizzabile prima di
+ * percpu_counter_init(): in quel caso gli aggiornamenti vanno direttamente
+ * sul totale globale con un'add atomica. percpu_counter_init() richiede
+ * invece percpu_early_init().
+ */
+
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define PERCPU_COUNTER_SLOTS 256 // Contatori inizializzati contemporaneamente
+#define PERCPU_COUNTER_BATCH 32  // Batch di default
+
+typedef struct {
+  s64 count; // Totale globale (approssimato)
+  s32 batch; // Soglia di riversamento del delta locale
+  u32 slot;  // Colonna nell'area per-CPU (0 = nessuna, solo globale)
+} percpu_counter_t;
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Inizializza un contatore e gli assegna uno slot per-CPU
+ *
+ * Se gli slot sono esauriti il contatore funziona comunque, solo sul
+ * totale globale.
+ *
+ * @param initial Valore iniziale
+ * @param batch Soglia di riversamento (0 = PERCPU_COUNTER_BATCH)
+ * @return false se non c'erano slot liberi
+ */
+bool percpu_counter_init(percpu_counter_t *counter, s64 initial, s32 batch);
+
+/**
+ * @brief Riversa i delta locali e rilascia lo slot
+ */
+void percpu_counter_destroy(percpu_counter_t *counter);
+
+/**
+ * @brief Aggiunge amount (anche negativo) al contatore
+ */
+void percpu_counter_add(percpu_counter_t *counter, s64 amount);
+
+/**
+ * @brief Somma esatta: totale globale più gli slot di tutte le CPU
+ */
+s64 percpu_counter_sum(percpu_counter_t *counter);
+
+/**
+ * @brief Imposta il valore (azzera gli slot di tutte le CPU)
+ */
+void percpu_counter_set(percpu_counter_t *counter, s64 value);
+
+static inline void percpu_counter_inc(percpu_counter_t *counter) {
+  percpu_counter_add(counter, 1);
+}
+
+static inline void percpu_counter_dec(percpu_counter_t *counter) {
+  percpu_counter_add(counter, -1);
+}
+
+/**
+ * @brief Totale globale senza sommare gli slot (approssimato)
+ */
+static inline s64 percpu_counter_read(const percpu_counter_t *counter) {
+  return __atomic_load_n(&counter->count, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Come percpu_counter_read() ma mai negativo
+ */
+static inline s64 percpu_counter_read_positive(const percpu_counter_t *counter) {
+  s64 value = percpu_counter_read(counter);
+  return value > 0 ? value : 0;
+}
+
+/**
+ * @brief Somma esatta ridotta a u64 (per le strutture di statistiche)
+ */
+static inline u64 percpu_counter_sum_positive(percpu_counter_t *counter) {
+  s64 value = percpu_counter_sum(counter);
+  return value > 0 ? (u64)value : 0;
+}
@@ -0,0 +1,89 @@
+#include "perf.h"
+#include <klib/klog/klog.h>
+
+/**
+ * @file klib/perf.c
+ * @brief Misura di regioni di codice - Implementation
+ *
+ * begin legge i contatori per ultima cosa e end per prima, così il costo
+ * della lettura stessa ricade il meno possibile dentro la regione.
+ */
+
+static const char *const perf_event_names[PMU_EVENT_COUNT] = {
+    [PMU_EVENT_CYCLES] = "cycles",
+    [PMU_EVENT_INSTRUCTIONS] = "instructions",
+    [PMU_EVENT_REF_CYCLES] = "ref_cycles",
+    [PMU_EVENT_LLC_MISSES] = "llc_misses",
+    [PMU_EVENT_DTLB_MISSES] = "dtlb_misses",
+    [PMU_EVENT_BRANCH_MISSES] = "branch_misses",
+};
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void perf_init(void) {
+  arch_pmu_init();
+
+  char list[128];
+  size_t pos = 0;
+  list[0] = '\0';
+  for (int e = 0; e < PMU_EVENT_COUNT; e++) {
+    if (!arch_pmu_supported((pmu_event_t)e))
+      continue;
+    for (const char *s = perf_event_names[e]; *s && pos + 2 < sizeof(list); s++)
+      list[pos++] = *s;
+    if (pos + 2 < sizeof(list))
+      list[pos++] = ' ';
+    list[pos] = '\0';
+  }
+
+  klog_info("perf: backend %s, eventi: %s", arch_pmu_name(), list);
+}
+
+const char *perf_event_name(pmu_event_t event) {
+  return event < PMU_EVENT_COUNT ? perf_event_names[event] : "?";
+}
+
+void perf_region_reset(perf_region_t *region) {
+  region->runs = 0;
+  for (int e = 0; e < PMU_EVENT_COUNT; e++)
+    region->total[e] = 0;
+}
+
+void perf_region_begin(perf_region_t *region) {
+  arch_pmu_read(region->start);
+}
+
+void perf_region_end(perf_region_t *region) {
+  u64 now[PMU_EVENT_COUNT];
+  arch_pmu_read(now);
+
+  for (int e = 0; e < PMU_EVENT_COUNT; e++)
+    region->total[e] += (now[e] - region->start[e]) & arch_pmu_counter_mask((pmu_event_t)e);
+  region->runs++;
+}
+
+u64 perf_region_total(const perf_region_t *region, pmu_event_t event) {
+  return event < PMU_EVENT_COUNT ? region->total[event] : 0;
+}
+
+void perf_region_report(const perf_region_t *region) {
+  u64 runs = region->runs ? region->runs : 1;
+
+  klog_info("perf: [%s] %lu esecuzioni (%s)", region->name, region->runs, arch_pmu_name());
+  for (int e = 0; e < PMU_EVENT_COUNT; e++) {
+    if (!arch_pmu_supported((pmu_event_t)e)) {
+      klog_info("  %s: n/d", perf_event_names[e]);
+      continue;
+    }
+    klog_info("  %s: %lu (%lu per esecuzione)", perf_event_names[e], region->total[e], region->total[e] / runs);
+  }
+
+  // IPC in millesimi: niente virgola mobile nel kernel
+  u64 cycles = region->total[PMU_EVENT_CYCLES];
+  if (arch_pmu_supported(PMU_EVENT_INSTRUCTIONS) && cycles > 0) {
+    u64 ipc_milli = region->total[PMU_EVENT_INSTRUCTIONS] * 1000 / cycles;
+    klog_info("  IPC: %lu.%lu%lu%lu", ipc_milli / 1000, (ipc_milli / 100) % 10, (ipc_milli / 10) % 10, ipc_milli % 10);
+  }
+}
@@ -0,0 +1,81 @@
+/**
+ * @file klib/perf.h
+ * @brief Misura di regioni di codice con i contatori hardware
+ *
+ * Una regione accumula, su più esecuzioni, la differenza dei contatori
+ * PMU (<arch/pmu.h>) fra perf_region_begin() e perf_region_end():
+ *
+ *   static perf_region_t slab_bench = PERF_REGION_INIT("slab alloc/free");
+ *
+ *   for (...) {
+ *     perf_region_begin(&slab_bench);
+ *     ...
+ *     perf_region_end(&slab_bench);
+ *   }
+ *   perf_region_report(&slab_bench);
+ *
+ * Il report stampa totali, valori per esecuzione e IPC. Gli eventi che la
+ * macchina non conta sono indicati come "n/d" e non come zero.
+ *
+ * Una regione va aperta e chiusa sulla stessa CPU e non è annidabile con
+ * se stessa; regioni diverse si possono annidare liberamente (i costi della
+ * regione interna sono inclusi in quella esterna).
+ */
+
+#pragma once
+
+#include <arch/pmu.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  const char *name;
+  u64 runs;                    // Esecuzioni completate
+  u64 total[PMU_EVENT_COUNT];  // Somma delle differenze
+  u64 start[PMU_EVENT_COUNT];  // Valori a perf_region_begin()
+} perf_region_t;
+
+#define PERF_REGION_INIT(region_name) {.name = (region_name)}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Rileva la PMU e programma i contatori della CPU di boot
+ */
+void perf_init(void);
+
+/**
+ * @brief Nome dell'evento (per report e output macchina)
+ */
+const char *perf_event_name(pmu_event_t event);
+
+/**
+ * @brief Azzera i totali della regione
+ */
+void perf_region_reset(perf_region_t *region);
+
+/**
+ * @brief Apre un'esecuzione della regione
+ */
+void perf_region_begin(perf_region_t *region);
+
+/**
+ * @brief Chiude l'esecuzione aperta e accumula le differenze
+ */
+void perf_region_end(perf_region_t *region);
+
+/**
+ * @brief Totale di un evento (0 se non supportato)
+ */
+u64 perf_region_total(const perf_region_t *region, pmu_event_t event);
+
+/**
+ * @brief Stampa il report della regione nel log
+ */
+void perf_region_report(const perf_region_t *region);
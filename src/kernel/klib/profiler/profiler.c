@@ -0,0 +1,258 @@
+#include "profiler.h"
+#include <drivers/serial/serial.h>
+#include <klib/cmdline/cmdline.h>
+#include <klib/ftrace/ftrace.h>
+#include <klib/klog/klog.h>
+#include <klib/ksym/ksym.h>
+#include <lib/string/string.h>
+#include <mm/percpu.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file klib/profiler.c
+ * @brief Profiler statistico - Implementation
+ *
+ * Il dump ordina i campioni di ogni buffer (heapsort in place, nessuna
+ * allocazione) così gli stack uguali diventano adiacenti e basta contarli
+ * in un solo passaggio. I buffer vengono consumati: dopo il dump sono
+ * vuoti.
+ */
+
+typedef struct {
+  u32 count;   // Campioni registrati
+  u32 dropped; // Campioni persi a buffer pieno
+  profiler_sample_t samples[PROFILER_SAMPLES_PER_CPU];
+} profiler_buffer_t;
+
+#define PROFILER_BUFFER_PAGES ((sizeof(profiler_buffer_t) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+/* -------------------------------------------------------------------------- */
+/*                                 Stato globale                              */
+/* -------------------------------------------------------------------------- */
+
+static DEFINE_PER_CPU(profiler_buffer_t *, profiler_buffer);
+
+static struct {
+  bool ready;   // Buffer allocati
+  bool running; // Campionamento in corso
+  arch_sample_source_t source;
+  u32 hz;
+} profiler_state;
+
+/* -------------------------------------------------------------------------- */
+/*                               Campionamento                                */
+/* -------------------------------------------------------------------------- */
+
+static inline bool profiler_frame_ok(uptr fp, uptr sp) {
+  return fp >= sp && fp + 2 * sizeof(uptr) <= sp + PROFILER_STACK_SPAN && !(fp & (sizeof(uptr) - 1));
+}
+
+/**
+ * Handler di interrupt/NMI: nessun lock, nessun log.
+ */
+static void profiler_sample(uptr pc, uptr fp, uptr sp) {
+  profiler_buffer_t *buf = this_cpu(profiler_buffer);
+  if (!buf)
+    return;
+  if (buf->count >= PROFILER_SAMPLES_PER_CPU) {
+    buf->dropped++;
+    return;
+  }
+
+  profiler_sample_t *sample = &buf->samples[buf->count];
+  u32 depth = 0;
+  sample->pcs[depth++] = pc;
+
+  // Record di frame: [fp] = fp del chiamante, [fp + 8] = indirizzo di ritorno
+  while (depth < PROFILER_MAX_DEPTH && profiler_frame_ok(fp, sp)) {
+    const uptr *frame = (const uptr *)fp;
+    uptr ret = ftrace_resolve_return(frame[1], &frame[1]);
+    if (ret == 0)
+      break;
+    sample->pcs[depth++] = ret;
+    if (frame[0] <= fp)
+      break; // Lo stack cresce verso il basso: i chiamanti stanno più in alto
+    fp = frame[0];
+  }
+
+  sample->depth = depth;
+  buf->count++;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Dump                                    */
+/* -------------------------------------------------------------------------- */
+
+static int profiler_sample_cmp(const profiler_sample_t *a, const profiler_sample_t *b) {
+  u32 depth = a->depth < b->depth ? a->depth : b->depth;
+  // Dalla radice: stack con la stessa base restano vicini
+  for (u32 i = 1; i <= depth; i++) {
+    uptr pa = a->pcs[a->depth - i], pb = b->pcs[b->depth - i];
+    if (pa != pb)
+      return pa < pb ? -1 : 1;
+  }
+  return (int)a->depth - (int)b->depth;
+}
+
+static void profiler_sample_swap(profiler_sample_t *a, profiler_sample_t *b) {
+  profiler_sample_t tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+static void profiler_sift_down(profiler_sample_t *samples, u32 root, u32 count) {
+  while (2 * root + 1 < count) {
+    u32 child = 2 * root + 1;
+    if (child + 1 < count && profiler_sample_cmp(&samples[child], &samples[child + 1]) < 0)
+      child++;
+    if (profiler_sample_cmp(&samples[root], &samples[child]) >= 0)
+      return;
+    profiler_sample_swap(&samples[root], &samples[child]);
+    root = child;
+  }
+}
+
+static void profiler_sort(profiler_sample_t *samples, u32 count) {
+  for (u32 i = count / 2; i-- > 0;)
+    profiler_sift_down(samples, i, count);
+  for (u32 end = count; end-- > 1;) {
+    profiler_sample_swap(&samples[0], &samples[end]);
+    profiler_sift_down(samples, 0, end);
+  }
+}
+
+/**
+ * @brief Sostituisce ogni indirizzo con l'inizio della sua funzione
+ *
+ * Va fatto prima dell'ordinamento: stack che differiscono solo per il punto
+ * dentro le stesse funzioni diventano uguali e si sommano in una riga. Gli
+ * indirizzi di ritorno puntano dopo la call, che può essere l'ultima
+ * istruzione della funzione: si cerca l'indirizzo precedente.
+ */
+static void profiler_symbolize(profiler_buffer_t *buf) {
+  for (u32 s = 0; s < buf->count; s++) {
+    profiler_sample_t *sample = &buf->samples[s];
+    for (u32 i = 0; i < sample->depth; i++) {
+      uptr start = ksym_lookup(i ? sample->pcs[i] - 1 : sample->pcs[i], NULL, 0, NULL);
+      if (start)
+        sample->pcs[i] = start;
+    }
+  }
+}
+
+static void profiler_emit(const profiler_sample_t *sample, u32 count) {
+  char name[KSYM_NAME_MAX];
+  for (u32 i = sample->depth; i-- > 0;) {
+    if (ksym_lookup(sample->pcs[i], name, sizeof(name), NULL))
+      serial_printf(i ? "%s;" : "%s", name);
+    else
+      serial_printf(i ? "0x%lx;" : "0x%lx", sample->pcs[i]);
+  }
+  serial_printf(" %u\n", count);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void profiler_init(void) {
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    void *phys = pmm_alloc_pages(PROFILER_BUFFER_PAGES);
+    if (!phys) {
+      klog_error("profiler: buffer della CPU %u non allocato", cpu);
+      continue;
+    }
+    profiler_buffer_t *buf = (profiler_buffer_t *)vmm_phys_to_virt((u64)phys);
+    buf->count = 0;
+    buf->dropped = 0;
+    per_cpu(profiler_buffer, cpu) = buf;
+  }
+  profiler_state.ready = true;
+
+  char mode[16];
+  if (!cmdline_get("profile", mode, sizeof(mode)))
+    return;
+
+  arch_sample_source_t source = strcmp(mode, "pmu") == 0 ? ARCH_SAMPLE_PMU : ARCH_SAMPLE_TIMER;
+  u32 hz = (u32)cmdline_get_u64("profile_hz", PROFILER_DEFAULT_HZ);
+  if (!profiler_start(source, hz) && source == ARCH_SAMPLE_PMU) {
+    klog_warn("profiler: PMU non disponibile, uso il timer");
+    profiler_start(ARCH_SAMPLE_TIMER, hz);
+  }
+}
+
+bool profiler_start(arch_sample_source_t source, u32 hz) {
+  if (!profiler_state.ready || profiler_state.running)
+    return false;
+  if (hz == 0)
+    hz = PROFILER_DEFAULT_HZ;
+
+  if (!arch_sampling_start(source, hz, profiler_sample))
+    return false;
+
+  profiler_state.source = source;
+  profiler_state.hz = hz;
+  profiler_state.running = true;
+  klog_info("profiler: campionamento %s a %u Hz", source == ARCH_SAMPLE_PMU ? "pmu" : "timer", hz);
+  return true;
+}
+
+void profiler_stop(void) {
+  if (!profiler_state.running)
+    return;
+  arch_sampling_stop();
+  profiler_state.running = false;
+}
+
+bool profiler_is_running(void) {
+  return profiler_state.running;
+}
+
+void profiler_reset(void) {
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    profiler_buffer_t *buf = per_cpu(profiler_buffer, cpu);
+    if (buf) {
+      buf->count = 0;
+      buf->dropped = 0;
+    }
+  }
+}
+
+void profiler_dump(void) {
+  if (profiler_state.running) {
+    klog_warn("profiler: dump con il campionamento attivo");
+    return;
+  }
+
+  u64 total = 0, dropped = 0;
+  serial_printf("# profile-begin source=%s hz=%u\n", profiler_state.source == ARCH_SAMPLE_PMU ? "pmu" : "timer", profiler_state.hz);
+
+  u32 cpu;
+  FOR_EACH_PERCPU_CPU(cpu) {
+    profiler_buffer_t *buf = per_cpu(profiler_buffer, cpu);
+    if (!buf || buf->count == 0)
+      continue;
+
+    profiler_symbolize(buf);
+    profiler_sort(buf->samples, buf->count);
+    u32 run = 1;
+    for (u32 i = 1; i <= buf->count; i++) {
+      if (i < buf->count && profiler_sample_cmp(&buf->samples[i - 1], &buf->samples[i]) == 0) {
+        run++;
+        continue;
+      }
+      profiler_emit(&buf->samples[i - 1], run);
+      run = 1;
+    }
+
+    total += buf->count;
+    dropped += buf->dropped;
+  }
+
+  serial_printf("# profile-end samples=%lu dropped=%lu\n", total, dropped);
+  klog_info("profiler: %lu campioni scritti sulla seriale (%lu persi)", total, dropped);
+  profiler_reset();
+}
@@ -0,0 +1,89 @@
+/**
+ * @file klib/profiler.h
+ * @brief Profiler statistico a campionamento
+ *
+ * A frequenza fissa un interrupt (timer locale o overflow PMU, vedi
+ * <arch/sampling.h>) registra l'istruzione interrotta e la catena dei
+ * frame pointer in un buffer della CPU che lo riceve. Nessun lock nel
+ * percorso di campionamento: ogni CPU scrive solo nel proprio buffer.
+ *
+ * OUTPUT (profiler_dump):
+ * Formato "folded stack" sulla seriale, una riga per stack distinto:
+ *
+ *   kmain;heap_init;slab_cache_create 42
+ *
+ * dalla radice alla foglia, seguito dal numero di campioni: è l'input
+ * diretto di flamegraph.pl. I nomi vengono dalla tabella dei simboli
+ * incorporata (<klib/ksym/ksym.h>) e i campioni sono aggregati per funzione;
+ * gli indirizzi che non si risolvono restano in esadecimale. Le righe sono
+ * racchiuse fra "# profile-begin" e "# profile-end" per poterle estrarre
+ * dal resto del log seriale.
+ *
+ * COMMAND LINE:
+ * - "profile=timer" o "profile=pmu": profila il boot fino all'idle
+ * - "profile_hz=N": frequenza di campionamento (default PROFILER_DEFAULT_HZ)
+ *
+ * Il kernel deve essere compilato con -fno-omit-frame-pointer: senza
+ * frame pointer gli stack si fermano alla foglia.
+ */
+
+#pragma once
+
+#include <arch/sampling.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define PROFILER_MAX_DEPTH 16          // Frame registrati per campione
+#define PROFILER_SAMPLES_PER_CPU 4096  // Capacità del buffer di ogni CPU
+#define PROFILER_DEFAULT_HZ 997        // Primo rispetto ai timer periodici: evita aliasing
+#define PROFILER_STACK_SPAN (16 * 1024) // Distanza massima dei frame dallo stack pointer
+
+typedef struct {
+  u32 depth;                     // Frame validi in pcs
+  uptr pcs[PROFILER_MAX_DEPTH];  // pcs[0] = istruzione interrotta, poi i chiamanti
+} profiler_sample_t;
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Alloca i buffer per-CPU e applica la command line
+ *
+ * Richiede PMM, VMM e percpu_init().
+ */
+void profiler_init(void);
+
+/**
+ * @brief Avvia il campionamento sulla CPU corrente
+ *
+ * @param hz Campioni al secondo (0 = PROFILER_DEFAULT_HZ)
+ * @return false se la sorgente non è disponibile o i buffer mancano
+ */
+bool profiler_start(arch_sample_source_t source, u32 hz);
+
+/**
+ * @brief Ferma il campionamento
+ */
+void profiler_stop(void);
+
+/**
+ * @brief true se il campionamento è in corso
+ */
+bool profiler_is_running(void);
+
+/**
+ * @brief Svuota i buffer di tutte le CPU
+ */
+void profiler_reset(void);
+
+/**
+ * @brief Scrive il profilo in formato folded sulla seriale e svuota i buffer
+ *
+ * Va chiamata a campionamento fermo.
+ */
+void profiler_dump(void);
@@ -0,0 +1,209 @@
+#include "queue.h"
+
+/**
+ * @file klib/queue.c
+ * @brief Code lock-free - Implementation
+ *
+ * Convenzione sugli ordinamenti di memoria:
+ * - Chi pubblica un elemento scrive prima il dato e poi l'indice/puntatore
+ *   con __ATOMIC_RELEASE
+ * - Chi consuma legge indice/puntatore con __ATOMIC_ACQUIRE e solo dopo
+ *   il dato
+ * - I campi posseduti da un solo lato (es. head per il produttore SPSC)
+ *   vengono letti dal proprietario con __ATOMIC_RELAXED
+ */
+
+static inline bool queue_is_power_of_two(u64 value) {
+  return value && !(value & (value - 1));
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  SPSC ring                                 */
+/* -------------------------------------------------------------------------- */
+
+bool spsc_ring_init(spsc_ring_t *ring, void **slots, u32 capacity) {
+  if (!slots || !queue_is_power_of_two(capacity))
+    return false;
+
+  ring->head = ring->cached_tail = 0;
+  ring->tail = ring->cached_head = 0;
+  ring->mask = capacity - 1;
+  ring->slots = slots;
+  return true;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, void *item) {
+  u32 head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+  // Il ring sembra pieno con la copia locale: rilegge tail del consumatore
+  if (head - ring->cached_tail > ring->mask) {
+    ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - ring->cached_tail > ring->mask)
+      return false;
+  }
+
+  ring->slots[head & ring->mask] = item;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void **item) {
+  u32 tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+  if (tail == ring->cached_head) {
+    ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == ring->cached_head)
+      return false;
+  }
+
+  *item = ring->slots[tail & ring->mask];
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+u32 spsc_ring_count(const spsc_ring_t *ring) {
+  u32 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  u32 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  return head - tail;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 MPSC queue                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * La coda è una lista in cui head è l'ultimo nodo inserito e tail il
+ * prossimo da estrarre. Un push sostituisce head con un exchange e poi
+ * collega il nodo precedente: fra i due passi la lista è temporaneamente
+ * "spezzata" e il consumatore la vede finire prima.
+ */
+
+void mpsc_queue_init(mpsc_queue_t *queue) {
+  queue->stub.next = (mpsc_node_t *)NULL;
+  queue->head = &queue->stub;
+  queue->tail = &queue->stub;
+}
+
+void mpsc_queue_push(mpsc_queue_t *queue, mpsc_node_t *node) {
+  __atomic_store_n(&node->next, (mpsc_node_t *)NULL, __ATOMIC_RELAXED);
+  mpsc_node_t *prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+  __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+mpsc_node_t *mpsc_queue_pop(mpsc_queue_t *queue) {
+  mpsc_node_t *tail = queue->tail;
+  mpsc_node_t *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+  // La sentinella non è un elemento: saltala
+  if (tail == &queue->stub) {
+    if (!next)
+      return (mpsc_node_t *)NULL;
+    queue->tail = next;
+    tail = next;
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+  }
+
+  if (next) {
+    queue->tail = next;
+    return tail;
+  }
+
+  // tail è l'ultimo nodo collegato: se non è anche head un push è in corso
+  mpsc_node_t *head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+  if (tail != head)
+    return (mpsc_node_t *)NULL;
+
+  // Reinserisce la sentinella per poter staccare l'ultimo nodo
+  mpsc_queue_push(queue, &queue->stub);
+
+  next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+  if (next) {
+    queue->tail = next;
+    return tail;
+  }
+
+  return (mpsc_node_t *)NULL;
+}
+
+bool mpsc_queue_is_empty(mpsc_queue_t *queue) {
+  mpsc_node_t *tail = queue->tail;
+  return tail == &queue->stub && !__atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 MPMC queue                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Ogni cella ha un numero di sequenza:
+ * - seq == pos: libera, pronta per l'enqueue alla posizione pos
+ * - seq == pos + 1: piena, pronta per il dequeue alla posizione pos
+ * Dopo il dequeue seq diventa pos + capacity: la cella è libera per il
+ * giro successivo. Il confronto con segno distingue "pieno/vuoto" da
+ * "un altro thread è già avanti".
+ */
+
+bool mpmc_queue_init(mpmc_queue_t *queue, mpmc_cell_t *cells, u64 capacity) {
+  if (!cells || capacity < 2 || !queue_is_power_of_two(capacity))
+    return false;
+
+  for (u64 i = 0; i < capacity; i++) {
+    __atomic_store_n(&cells[i].seq, i, __ATOMIC_RELAXED);
+    cells[i].data = NULL;
+  }
+
+  queue->cells = cells;
+  queue->mask = capacity - 1;
+  __atomic_store_n(&queue->enqueue_pos, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&queue->dequeue_pos, 0, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool mpmc_queue_push(mpmc_queue_t *queue, void *item) {
+  u64 pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+  mpmc_cell_t *cell;
+
+  for (;;) {
+    cell = &queue->cells[pos & queue->mask];
+    u64 seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    s64 diff = (s64)seq - (s64)pos;
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+      // CAS fallito: pos contiene già il valore aggiornato
+    } else if (diff < 0) {
+      return false; // Piena: la cella non è ancora stata consumata
+    } else {
+      pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  cell->data = item;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool mpmc_queue_pop(mpmc_queue_t *queue, void **item) {
+  u64 pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+  mpmc_cell_t *cell;
+
+  for (;;) {
+    cell = &queue->cells[pos & queue->mask];
+    u64 seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    s64 diff = (s64)seq - (s64)(pos + 1);
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&queue->dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return false; // Vuota: la cella non è ancora stata scritta
+    } else {
+      pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  *item = cell->data;
+  __atomic_store_n(&cell->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+  return true;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file klib/queue.h
+ * @brief Code lock-free: SPSC ring, MPSC intrusiva, MPMC limitata
+ *
+ * Tutte le code usano i builtin __atomic (modello C11) e nessuna alloca
+ * memoria: lo storage è fornito dal chiamante. I campi scritti da lati
+ * diversi (produttore / consumatore) stanno su cache line separate per
+ * evitare false sharing.
+ *
+ * QUALE USARE:
+ * - spsc_ring_t: un produttore e un consumatore fissi (log ring, canale
+ *   fra due CPU, completamenti di un driver). È la più veloce: nessuna
+ *   operazione read-modify-write, solo load/store con acquire/release
+ * - mpsc_queue_t: molti produttori, un consumatore (work queue di una
+ *   CPU, IPC verso un server). Intrusiva e illimitata: push è un solo
+ *   exchange atomico e non fallisce mai
+ * - mpmc_queue_t: molti produttori e molti consumatori con capacità fissa
+ *   (pool di worker). Un CAS per operazione, nessun ABA grazie ai numeri
+ *   di sequenza per cella
+ */
+
+#pragma once
+
+#include <lib/cache.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                   SPSC ring (un produttore, un consumatore)                */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  // Cache line del produttore
+  u32 head ____cacheline_aligned; // Prossima cella da scrivere
+  u32 cached_tail;                // Copia locale di tail: evita di leggere la linea del consumatore
+
+  // Cache line del consumatore
+  u32 tail ____cacheline_aligned; // Prossima cella da leggere
+  u32 cached_head;                // Copia locale di head
+
+  // Sola lettura dopo l'init
+  u32 mask ____cacheline_aligned;
+  void **slots;
+} spsc_ring_t;
+
+/**
+ * @brief Inizializza un ring SPSC su storage del chiamante
+ *
+ * @param slots Array di capacity puntatori
+ * @param capacity Potenza di 2
+ * @return false se capacity non è una potenza di 2
+ */
+bool spsc_ring_init(spsc_ring_t *ring, void **slots, u32 capacity);
+
+/**
+ * @brief Accoda un elemento (solo dal produttore)
+ *
+ * @return false se il ring è pieno
+ */
+bool spsc_ring_push(spsc_ring_t *ring, void *item);
+
+/**
+ * @brief Estrae un elemento (solo dal consumatore)
+ *
+ * @return false se il ring è vuoto
+ */
+bool spsc_ring_pop(spsc_ring_t *ring, void **item);
+
+/**
+ * @brief Elementi presenti (approssimato se letto da un terzo)
+ */
+u32 spsc_ring_count(const spsc_ring_t *ring);
+
+/* -------------------------------------------------------------------------- */
+/*              MPSC intrusiva (Vyukov: molti produttori, un consumatore)     */
+/* -------------------------------------------------------------------------- */
+
+typedef struct mpsc_node {
+  struct mpsc_node *next;
+} mpsc_node_t;
+
+typedef struct {
+  mpsc_node_t *head ____cacheline_aligned; // Ultimo nodo inserito (produttori)
+  mpsc_node_t *tail ____cacheline_aligned; // Prossimo nodo da estrarre (consumatore)
+  mpsc_node_t stub;                        // Nodo sentinella: la coda non è mai vuota
+} mpsc_queue_t;
+
+/**
+ * @brief Inizializza una coda MPSC vuota
+ */
+void mpsc_queue_init(mpsc_queue_t *queue);
+
+/**
+ * @brief Accoda un nodo (da qualsiasi CPU, wait-free)
+ */
+void mpsc_queue_push(mpsc_queue_t *queue, mpsc_node_t *node);
+
+/**
+ * @brief Estrae il nodo più vecchio (solo dal consumatore)
+ *
+ * Può ritornare NULL anche con la coda non vuota se un produttore è a metà
+ * di un push: il consumatore riproverà al giro successivo.
+ *
+ * @return Nodo estratto o NULL
+ */
+mpsc_node_t *mpsc_queue_pop(mpsc_queue_t *queue);
+
+/**
+ * @brief Verifica se la coda è vuota (dal consumatore)
+ */
+bool mpsc_queue_is_empty(mpsc_queue_t *queue);
+
+/**
+ * @brief Ottiene il container da un mpsc_node
+ */
+#define MPSC_ENTRY(ptr, type, member) ((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
+
+/* -------------------------------------------------------------------------- */
+/*             MPMC limitata (Vyukov: molti produttori e consumatori)         */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  u64 seq;    // Stato della cella rispetto alle posizioni di enqueue/dequeue
+  void *data; // Elemento
+} mpmc_cell_t;
+
+typedef struct {
+  u64 enqueue_pos ____cacheline_aligned;
+  u64 dequeue_pos ____cacheline_aligned;
+  mpmc_cell_t *cells ____cacheline_aligned;
+  u64 mask;
+} mpmc_queue_t;
+
+/**
+ * @brief Inizializza una coda MPMC su storage del chiamante
+ *
+ * @param cells Array di capacity celle
+ * @param capacity Potenza di 2 (≥ 2)
+ * @return false se capacity non è valida
+ */
+bool mpmc_queue_init(mpmc_queue_t *queue, mpmc_cell_t *cells, u64 capacity);
+
+/**
+ * @brief Accoda un elemento (lock-free)
+ *
+ * @return false se la coda è piena
+ */
+bool mpmc_queue_push(mpmc_queue_t *queue, void *item);
+
+/**
+ * @brief Estrae un elemento (lock-free)
+ *
+ * @return false se la coda è vuota
+ */
+bool mpmc_queue_pop(mpmc_queue_t *queue, void **item);
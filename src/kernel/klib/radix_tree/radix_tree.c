@@ -0,0 +1,511 @@
+#include "radix_tree.h"
+#include <klib/klog/klog.h>
+#include <lib/string/string.h>
+#include <mm/heap/slab.h>
+
+/**
+ * @file klib/radix_tree.c
+ * @brief Radix Tree - Implementation
+ *
+ * Invarianti:
+ * - Un nodo con shift S copre 64 << S indici; i suoi slot puntano a nodi
+ *   con shift S-6, oppure (S == 0) direttamente agli elementi
+ * - La radice ha lo shift minimo che copre l'indice più alto presente
+ * - Nessun nodo raggiungibile è vuoto (count == 0)
+ *
+ * Regole RCU per gli scrittori:
+ * - Un nodo nuovo viene completamente inizializzato e poi pubblicato con
+ *   rcu_assign_pointer()
+ * - Un nodo rimosso viene scollegato e liberato con call_rcu(): i suoi slot
+ *   non vengono azzerati, quindi un lettore in volo lo attraversa ancora
+ *   in modo consistente
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                               Stato globale                                */
+/* -------------------------------------------------------------------------- */
+
+#define RADIX_TREE_MAX_HEIGHT ((64 + RADIX_TREE_MAP_SHIFT - 1) / RADIX_TREE_MAP_SHIFT)
+
+static slab_cache_t *radix_node_cache = (slab_cache_t *)NULL;
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline u64 radix_node_maxindex(u32 shift) {
+  if (shift + RADIX_TREE_MAP_SHIFT >= 64)
+    return ~0ULL;
+  return (1ULL << (shift + RADIX_TREE_MAP_SHIFT)) - 1;
+}
+
+static inline u32 radix_offset(u64 index, u32 shift) {
+  return (u32)((index >> shift) & RADIX_TREE_MAP_MASK);
+}
+
+static inline bool radix_tag_test(const radix_tree_node_t *node, u32 tag, u32 offset) {
+  return (__atomic_load_n(&node->tags[tag], __ATOMIC_RELAXED) >> offset) & 1;
+}
+
+static inline void radix_tag_set_bit(radix_tree_node_t *node, u32 tag, u32 offset) {
+  __atomic_store_n(&node->tags[tag], node->tags[tag] | (1ULL << offset), __ATOMIC_RELAXED);
+}
+
+static inline void radix_tag_clear_bit(radix_tree_node_t *node, u32 tag, u32 offset) {
+  __atomic_store_n(&node->tags[tag], node->tags[tag] & ~(1ULL << offset), __ATOMIC_RELAXED);
+}
+
+static radix_tree_node_t *radix_node_alloc(u32 shift, radix_tree_node_t *parent, u32 offset) {
+  if (!radix_node_cache) {
+    klog_error("radix_tree: radix_tree_init() non chiamata");
+    return (radix_tree_node_t *)NULL;
+  }
+
+  radix_tree_node_t *node = (radix_tree_node_t *)slab_cache_alloc(radix_node_cache);
+  if (!node)
+    return (radix_tree_node_t *)NULL;
+
+  memset(node, 0, sizeof(*node));
+  node->shift = (u8)shift;
+  node->parent = parent;
+  node->offset = (u8)offset;
+  return node;
+}
+
+static void radix_node_rcu_free(rcu_head_t *head) {
+  radix_tree_node_t *node = (radix_tree_node_t *)((char *)head - __builtin_offsetof(radix_tree_node_t, rcu));
+  slab_cache_free(radix_node_cache, node);
+}
+
+static void radix_node_free(radix_tree_node_t *node) {
+  call_rcu(&node->rcu, radix_node_rcu_free);
+}
+
+/**
+ * Scende fino al nodo foglia (shift 0) che contiene index.
+ *
+ * @param path[out] Nodi attraversati, dalla radice alla foglia (opzionale)
+ * @return Nodo foglia o NULL se il percorso non esiste
+ */
+static radix_tree_node_t *radix_walk_locked(radix_tree_root_t *root, u64 index, radix_tree_node_t **path, u32 *depth) {
+  radix_tree_node_t *node = root->node;
+  u32 d = 0;
+
+  if (!node || index > radix_node_maxindex(node->shift))
+    return (radix_tree_node_t *)NULL;
+
+  while (node) {
+    if (path)
+      path[d] = node;
+    d++;
+    if (node->shift == 0)
+      break;
+    node = (radix_tree_node_t *)node->slots[radix_offset(index, node->shift)];
+  }
+
+  if (depth)
+    *depth = d;
+  return node;
+}
+
+/**
+ * Aggiunge livelli sopra la radice finché index non è coperto.
+ */
+static bool radix_extend_locked(radix_tree_root_t *root, u64 index) {
+  radix_tree_node_t *old = root->node;
+
+  while (index > radix_node_maxindex(old->shift)) {
+    radix_tree_node_t *node = radix_node_alloc(old->shift + RADIX_TREE_MAP_SHIFT, (radix_tree_node_t *)NULL, 0);
+    if (!node)
+      return false;
+
+    node->slots[0] = old;
+    node->count = 1;
+    for (u32 tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++) {
+      if (old->tags[tag])
+        node->tags[tag] = 1;
+    }
+
+    old->parent = node;
+    rcu_assign_pointer(root->node, node);
+    old = node;
+  }
+
+  return true;
+}
+
+/**
+ * Accorcia l'albero finché la radice ha solo lo slot 0 occupato.
+ *
+ * La vecchia radice non viene modificata: un lettore che la sta ancora
+ * usando trova in slot 0 lo stesso sottoalbero.
+ */
+static void radix_shrink_locked(radix_tree_root_t *root) {
+  radix_tree_node_t *node = root->node;
+
+  while (node && node->shift > 0 && node->count == 1 && node->slots[0]) {
+    radix_tree_node_t *child = (radix_tree_node_t *)node->slots[0];
+    child->parent = (radix_tree_node_t *)NULL;
+    rcu_assign_pointer(root->node, child);
+    radix_node_free(node);
+    node = child;
+  }
+}
+
+/**
+ * Risale da node liberando i nodi rimasti vuoti, poi accorcia la radice.
+ *
+ * Ripristina le invarianti dopo una rimozione o un inserimento fallito a
+ * metà.
+ */
+static void radix_prune_locked(radix_tree_root_t *root, radix_tree_node_t *node) {
+  while (node && node->count == 0) {
+    radix_tree_node_t *parent = node->parent;
+    if (parent) {
+      rcu_assign_pointer(parent->slots[node->offset], NULL);
+      parent->count--;
+    } else {
+      rcu_assign_pointer(root->node, (radix_tree_node_t *)NULL);
+    }
+    radix_node_free(node);
+    node = parent;
+  }
+
+  radix_shrink_locked(root);
+}
+
+/**
+ * Ripulisce il tag risalendo dal nodo finché le bitmap si svuotano.
+ */
+static void radix_tag_clear_upward(radix_tree_node_t *node, u32 tag, u32 offset) {
+  while (node) {
+    radix_tag_clear_bit(node, tag, offset);
+    if (node->tags[tag])
+      break;
+    offset = node->offset;
+    node = node->parent;
+  }
+}
+
+/**
+ * Cerca il primo elemento con indice ≥ *pindex (con tag se tag ≥ 0).
+ *
+ * Usa uno stack locale invece dei puntatori parent: è sicura per i lettori
+ * RCU anche se nel frattempo l'albero cresce o si accorcia.
+ */
+static void *radix_find_next(radix_tree_node_t *top, u64 *pindex, int tag) {
+  radix_tree_node_t *stack[RADIX_TREE_MAX_HEIGHT];
+  u32 depth = 0;
+  u64 index = *pindex;
+
+  if (!top || index > radix_node_maxindex(top->shift))
+    return NULL;
+
+  radix_tree_node_t *node = top;
+
+  for (;;) {
+    u32 shift = node->shift;
+    u32 off = radix_offset(index, shift);
+    void *entry = NULL;
+
+    for (; off < RADIX_TREE_MAP_SIZE; off++) {
+      if (tag >= 0 && !radix_tag_test(node, (u32)tag, off))
+        continue;
+      entry = rcu_dereference(node->slots[off]);
+      if (entry)
+        break;
+    }
+
+    if (!entry) {
+      // Nodo esaurito: riprendi dal range successivo nel padre, risalendo
+      // ancora se quel range cade fuori anche dal padre
+      for (;;) {
+        if (depth == 0)
+          return NULL;
+
+        u32 span_shift = node->shift + RADIX_TREE_MAP_SHIFT;
+        u64 next = ((index >> span_shift) + 1) << span_shift;
+        node = stack[--depth];
+        if (next == 0)
+          return NULL; // Overflow: fine dello spazio degli indici
+
+        u32 parent_span = node->shift + RADIX_TREE_MAP_SHIFT;
+        if (parent_span >= 64 || (next >> parent_span) == (index >> parent_span)) {
+          index = next;
+          break;
+        }
+      }
+      continue;
+    }
+
+    // Primo indice del range coperto dallo slot trovato (se successivo)
+    if (off != radix_offset(index, shift)) {
+      u64 span = (shift + RADIX_TREE_MAP_SHIFT >= 64) ? ~0ULL : ((1ULL << (shift + RADIX_TREE_MAP_SHIFT)) - 1);
+      index = (index & ~span) | ((u64)off << shift);
+    }
+
+    if (shift == 0) {
+      *pindex = index;
+      return entry;
+    }
+
+    stack[depth++] = node;
+    node = (radix_tree_node_t *)entry;
+  }
+}
+
+static size_t radix_gang_lookup(radix_tree_root_t *root, void **results, u64 *indices, u64 first, size_t max, int tag) {
+  size_t found = 0;
+  u64 index = first;
+
+  rcu_read_lock();
+  radix_tree_node_t *top = rcu_dereference(root->node);
+
+  while (found < max) {
+    void *item = radix_find_next(top, &index, tag);
+    if (!item)
+      break;
+
+    results[found] = item;
+    if (indices)
+      indices[found] = index;
+    found++;
+
+    if (index == ~0ULL)
+      break;
+    index++;
+  }
+
+  rcu_read_unlock();
+  return found;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                IMPLEMENTAZIONE                             */
+/* -------------------------------------------------------------------------- */
+
+void radix_tree_init(void) {
+  if (radix_node_cache)
+    return;
+
+  radix_node_cache = slab_cache_create("radix_tree_node", sizeof(radix_tree_node_t), 8, NULL, NULL);
+  if (!radix_node_cache) {
+    klog_error("radix_tree: impossibile creare la slab cache dei nodi");
+    return;
+  }
+
+  klog_info("radix_tree: cache nodi pronta (%zu byte per nodo)", sizeof(radix_tree_node_t));
+}
+
+bool radix_tree_insert(radix_tree_root_t *root, u64 index, void *item) {
+  if (!item)
+    return false;
+
+  spinlock_lock(&root->lock);
+
+  if (!root->node) {
+    u32 shift = 0;
+    while (index > radix_node_maxindex(shift))
+      shift += RADIX_TREE_MAP_SHIFT;
+
+    radix_tree_node_t *node = radix_node_alloc(shift, (radix_tree_node_t *)NULL, 0);
+    if (!node) {
+      spinlock_unlock(&root->lock);
+      return false;
+    }
+    rcu_assign_pointer(root->node, node);
+  } else if (!radix_extend_locked(root, index)) {
+    // I livelli aggiunti hanno solo lo slot 0: l'accorciamento li toglie
+    radix_shrink_locked(root);
+    spinlock_unlock(&root->lock);
+    return false;
+  }
+
+  radix_tree_node_t *node = root->node;
+  while (node->shift > 0) {
+    u32 off = radix_offset(index, node->shift);
+    radix_tree_node_t *child = (radix_tree_node_t *)node->slots[off];
+
+    if (!child) {
+      child = radix_node_alloc(node->shift - RADIX_TREE_MAP_SHIFT, node, off);
+      if (!child) {
+        // I nodi creati finora sono vuoti: vanno staccati prima di uscire
+        radix_prune_locked(root, node);
+        spinlock_unlock(&root->lock);
+        return false;
+      }
+      rcu_assign_pointer(node->slots[off], (void *)child);
+      node->count++;
+    }
+    node = child;
+  }
+
+  u32 off = radix_offset(index, 0);
+  if (node->slots[off]) {
+    spinlock_unlock(&root->lock);
+    return false;
+  }
+
+  rcu_assign_pointer(node->slots[off], item);
+  node->count++;
+
+  spinlock_unlock(&root->lock);
+  return true;
+}
+
+void *radix_tree_lookup(radix_tree_root_t *root, u64 index) {
+  rcu_read_lock();
+
+  radix_tree_node_t *node = rcu_dereference(root->node);
+  void *item = NULL;
+
+  if (node && index <= radix_node_maxindex(node->shift)) {
+    while (node->shift > 0) {
+      node = (radix_tree_node_t *)rcu_dereference(node->slots[radix_offset(index, node->shift)]);
+      if (!node)
+        break;
+    }
+    if (node)
+      item = rcu_dereference(node->slots[radix_offset(index, 0)]);
+  }
+
+  rcu_read_unlock();
+  return item;
+}
+
+void *radix_tree_delete(radix_tree_root_t *root, u64 index) {
+  spinlock_lock(&root->lock);
+
+  radix_tree_node_t *leaf = radix_walk_locked(root, index, (radix_tree_node_t **)NULL, (u32 *)NULL);
+  u32 off = radix_offset(index, 0);
+  void *item = leaf ? leaf->slots[off] : NULL;
+
+  if (!item) {
+    spinlock_unlock(&root->lock);
+    return NULL;
+  }
+
+  for (u32 tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++) {
+    if (radix_tag_test(leaf, tag, off))
+      radix_tag_clear_upward(leaf, tag, off);
+  }
+
+  rcu_assign_pointer(leaf->slots[off], NULL);
+  leaf->count--;
+
+  radix_prune_locked(root, leaf);
+
+  spinlock_unlock(&root->lock);
+  return item;
+}
+
+void *radix_tree_replace(radix_tree_root_t *root, u64 index, void *item) {
+  if (!item)
+    return NULL;
+
+  spinlock_lock(&root->lock);
+
+  radix_tree_node_t *leaf = radix_walk_locked(root, index, (radix_tree_node_t **)NULL, (u32 *)NULL);
+  u32 off = radix_offset(index, 0);
+  void *old = leaf ? leaf->slots[off] : NULL;
+
+  if (old)
+    rcu_assign_pointer(leaf->slots[off], item);
+
+  spinlock_unlock(&root->lock);
+  return old;
+}
+
+bool radix_tree_tag_set(radix_tree_root_t *root, u64 index, u32 tag) {
+  if (tag >= RADIX_TREE_MAX_TAGS)
+    return false;
+
+  radix_tree_node_t *path[RADIX_TREE_MAX_HEIGHT];
+  u32 depth = 0;
+
+  spinlock_lock(&root->lock);
+
+  radix_tree_node_t *leaf = radix_walk_locked(root, index, path, &depth);
+  if (!leaf || !leaf->slots[radix_offset(index, 0)]) {
+    spinlock_unlock(&root->lock);
+    return false;
+  }
+
+  // Dalla foglia verso la radice: ogni livello marca lo slot del figlio
+  for (u32 d = depth; d-- > 0;) {
+    u32 off = radix_offset(index, path[d]->shift);
+    if (radix_tag_test(path[d], tag, off))
+      break;
+    radix_tag_set_bit(path[d], tag, off);
+  }
+
+  spinlock_unlock(&root->lock);
+  return true;
+}
+
+bool radix_tree_tag_clear(radix_tree_root_t *root, u64 index, u32 tag) {
+  if (tag >= RADIX_TREE_MAX_TAGS)
+    return false;
+
+  spinlock_lock(&root->lock);
+
+  radix_tree_node_t *leaf = radix_walk_locked(root, index, (radix_tree_node_t **)NULL, (u32 *)NULL);
+  u32 off = radix_offset(index, 0);
+  bool was_set = leaf && leaf->slots[off] && radix_tag_test(leaf, tag, off);
+
+  if (was_set)
+    radix_tag_clear_upward(leaf, tag, off);
+
+  spinlock_unlock(&root->lock);
+  return was_set;
+}
+
+bool radix_tree_tag_get(radix_tree_root_t *root, u64 index, u32 tag) {
+  if (tag >= RADIX_TREE_MAX_TAGS)
+    return false;
+
+  rcu_read_lock();
+
+  radix_tree_node_t *node = rcu_dereference(root->node);
+  bool set = false;
+
+  if (node && index <= radix_node_maxindex(node->shift)) {
+    for (;;) {
+      u32 off = radix_offset(index, node->shift);
+      if (!radix_tag_test(node, tag, off))
+        break;
+      if (node->shift == 0) {
+        set = true;
+        break;
+      }
+      node = (radix_tree_node_t *)rcu_dereference(node->slots[off]);
+      if (!node)
+        break;
+    }
+  }
+
+  rcu_read_unlock();
+  return set;
+}
+
+bool radix_tree_tagged(radix_tree_root_t *root, u32 tag) {
+  if (tag >= RADIX_TREE_MAX_TAGS)
+    return false;
+
+  rcu_read_lock();
+  radix_tree_node_t *node = rcu_dereference(root->node);
+  bool tagged = node && __atomic_load_n(&node->tags[tag], __ATOMIC_RELAXED) != 0;
+  rcu_read_unlock();
+
+  return tagged;
+}
+
+size_t radix_tree_gang_lookup(radix_tree_root_t *root, void **results, u64 *indices, u64 first, size_t max) {
+  return radix_gang_lookup(root, results, indices, first, max, -1);
+}
+
+size_t radix_tree_gang_lookup_tag(radix_tree_root_t *root, void **results, u64 *indices, u64 first, size_t max, u32 tag) {
+  if (tag >= RADIX_TREE_MAX_TAGS)
+    return 0;
+  return radix_gang_lookup(root, results, indices, first, max, (int)tag);
+}
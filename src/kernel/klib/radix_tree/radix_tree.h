@@ -0,0 +1,133 @@
+/**
+ * @file klib/radix_tree.h
+ * @brief Radix Tree - mappa sparsa indice intero → puntatore
+ *
+ * Albero a 64 vie: ogni livello consuma 6 bit dell'indice, quindi un
+ * indice a 64 bit richiede al più 11 livelli e gli indici piccoli (pfn,
+ * offset di pagina, handle) ne usano pochi. L'albero cresce in altezza solo
+ * quando serve e si accorcia quando gli indici alti vengono rimossi: la
+ * memoria è proporzionale agli elementi presenti, non al range di indici.
+ *
+ * TAG:
+ * Ogni nodo ha una bitmap per tag (es. RADIX_TAG_DIRTY): il bit di uno slot
+ * è settato se almeno un elemento del sottoalbero ha il tag. La ricerca
+ * per tag scende solo nei sottoalberi marcati.
+ *
+ * CONCORRENZA:
+ * - Scrittori serializzati dal lock interno alla radice
+ * - Lettori (lookup, gang lookup, tag_get) senza lock dentro
+ *   rcu_read_lock(): i nodi rimossi vengono liberati con call_rcu()
+ *
+ * I nodi vengono da una slab cache dedicata: radix_tree_init() va chiamata
+ * dopo heap_init(). I valori memorizzati non possono essere NULL.
+ */
+
+#pragma once
+
+#include <klib/rcu/rcu.h>
+#include <klib/spinlock.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define RADIX_TREE_MAP_SHIFT 6
+#define RADIX_TREE_MAP_SIZE (1 << RADIX_TREE_MAP_SHIFT) // 64 slot per nodo
+#define RADIX_TREE_MAP_MASK (RADIX_TREE_MAP_SIZE - 1)
+
+// Tag disponibili per ogni elemento
+#define RADIX_TAG_DIRTY 0
+#define RADIX_TAG_WRITEBACK 1
+#define RADIX_TREE_MAX_TAGS 2
+
+typedef struct radix_tree_node {
+  struct radix_tree_node *parent; // NULL per la radice (solo scrittori)
+  u8 shift;                       // Bit dell'indice sotto questo nodo
+  u8 offset;                      // Slot nel nodo padre
+  u8 count;                       // Slot non vuoti
+  void *slots[RADIX_TREE_MAP_SIZE];
+  u64 tags[RADIX_TREE_MAX_TAGS];
+  rcu_head_t rcu;
+} radix_tree_node_t;
+
+typedef struct {
+  radix_tree_node_t *node; // Nodo radice (NULL se vuoto)
+  spinlock_t lock;         // Serializza gli scrittori
+} radix_tree_root_t;
+
+#define RADIX_TREE_INIT {(radix_tree_node_t *)0, SPINLOCK_INITIALIZER}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Crea la slab cache dei nodi (una volta, dopo heap_init)
+ */
+void radix_tree_init(void);
+
+/**
+ * @brief Inizializza una radice vuota
+ */
+static inline void radix_tree_root_init(radix_tree_root_t *root) {
+  root->node = (radix_tree_node_t *)0;
+  spinlock_init(&root->lock);
+}
+
+/**
+ * @brief Inserisce un elemento
+ *
+ * @return false se l'indice è già occupato, item è NULL o manca memoria
+ */
+bool radix_tree_insert(radix_tree_root_t *root, u64 index, void *item);
+
+/**
+ * @brief Cerca l'elemento di un indice (lock-free in sezione RCU)
+ *
+ * @return Elemento o NULL se assente
+ */
+void *radix_tree_lookup(radix_tree_root_t *root, u64 index);
+
+/**
+ * @brief Rimuove l'elemento di un indice e i suoi tag
+ *
+ * @return Elemento rimosso o NULL se assente
+ */
+void *radix_tree_delete(radix_tree_root_t *root, u64 index);
+
+/**
+ * @brief Sostituisce l'elemento di un indice già occupato
+ *
+ * @return Elemento precedente o NULL se l'indice era vuoto (nessun effetto)
+ */
+void *radix_tree_replace(radix_tree_root_t *root, u64 index, void *item);
+
+/**
+ * @brief Imposta / rimuove / legge un tag su un elemento presente
+ */
+bool radix_tree_tag_set(radix_tree_root_t *root, u64 index, u32 tag);
+bool radix_tree_tag_clear(radix_tree_root_t *root, u64 index, u32 tag);
+bool radix_tree_tag_get(radix_tree_root_t *root, u64 index, u32 tag);
+
+/**
+ * @brief Verifica se almeno un elemento ha il tag (O(1))
+ */
+bool radix_tree_tagged(radix_tree_root_t *root, u32 tag);
+
+/**
+ * @brief Raccoglie fino a max elementi con indice ≥ first, in ordine
+ *
+ * @param results[out] Elementi trovati
+ * @param indices[out] Indici corrispondenti (può essere NULL)
+ * @return Numero di elementi trovati
+ */
+size_t radix_tree_gang_lookup(radix_tree_root_t *root, void **results, u64 *indices, u64 first, size_t max);
+
+/**
+ * @brief Come radix_tree_gang_lookup() ma solo elementi con il tag
+ *
+ * Costo proporzionale agli elementi marcati, non a quelli presenti.
+ */
+size_t radix_tree_gang_lookup_tag(radix_tree_root_t *root, void **results, u64 *indices, u64 first, size_t max, u32 tag);
@@ -0,0 +1,423 @@
+#include "rbtree.h"
+
+/**
+ * @file klib/rbtree.c
+ * @brief Red-Black Tree - Implementation
+ *
+ * Algoritmi classici (CLRS) con foglie NULL. Le invarianti:
+ * 1. La radice è nera
+ * 2. Un nodo rosso non ha figli rossi
+ * 3. Ogni cammino radice → NULL attraversa lo stesso numero di nodi neri
+ *
+ * garantiscono altezza ≤ 2·log2(n+1).
+ *
+ * Aggiornamento dei valori aumentati:
+ * - una rotazione cambia solo i sottoalberi dei due nodi ruotati, che
+ *   vengono ricalcolati (prima quello sceso, poi quello salito)
+ * - l'inserimento di una foglia e la rimozione cambiano i sottoalberi di
+ *   tutti gli antenati del punto modificato: si risale fino alla radice
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline bool rb_is_black(const rb_node_t *node) {
+  return !node || node->color == RB_BLACK;
+}
+
+static inline bool rb_is_red(const rb_node_t *node) {
+  return node && node->color == RB_RED;
+}
+
+/**
+ * Sostituisce old_child con new_child nel padre (o nella radice).
+ */
+static inline void rb_change_child(rb_root_t *root, rb_node_t *parent, rb_node_t *old_child, rb_node_t *new_child) {
+  if (!parent)
+    root->node = new_child;
+  else if (parent->left == old_child)
+    parent->left = new_child;
+  else
+    parent->right = new_child;
+}
+
+/**
+ * Rotazione a sinistra attorno a x: il figlio destro prende il suo posto.
+ */
+static void rb_rotate_left(rb_root_t *root, rb_node_t *x, rb_augment_fn augment) {
+  rb_node_t *y = x->right;
+
+  x->right = y->left;
+  if (y->left)
+    y->left->parent = x;
+
+  y->parent = x->parent;
+  rb_change_child(root, x->parent, x, y);
+
+  y->left = x;
+  x->parent = y;
+
+  if (augment) {
+    augment(x);
+    augment(y);
+  }
+}
+
+/**
+ * Rotazione a destra attorno a x: il figlio sinistro prende il suo posto.
+ */
+static void rb_rotate_right(rb_root_t *root, rb_node_t *x, rb_augment_fn augment) {
+  rb_node_t *y = x->left;
+
+  x->left = y->right;
+  if (y->right)
+    y->right->parent = x;
+
+  y->parent = x->parent;
+  rb_change_child(root, x->parent, x, y);
+
+  y->right = x;
+  x->parent = y;
+
+  if (augment) {
+    augment(x);
+    augment(y);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Inserimento                                */
+/* -------------------------------------------------------------------------- */
+
+void rb_insert_color(rb_root_t *root, rb_node_t *node, rb_augment_fn augment) {
+  // La nuova foglia cambia i sottoalberi di tutti i suoi antenati: il suo
+  // valore va calcolato comunque (i campi possono contenere dati vecchi)
+  if (augment) {
+    augment(node);
+    rb_augment_propagate(node->parent, augment);
+  }
+
+  node->color = RB_RED;
+
+  rb_node_t *parent;
+  while ((parent = node->parent) && parent->color == RB_RED) {
+    // Il padre è rosso quindi non è la radice: il nonno esiste
+    rb_node_t *gparent = parent->parent;
+
+    if (parent == gparent->left) {
+      rb_node_t *uncle = gparent->right;
+
+      // Caso 1: zio rosso → ricolora e risali di due livelli
+      if (rb_is_red(uncle)) {
+        parent->color = RB_BLACK;
+        uncle->color = RB_BLACK;
+        gparent->color = RB_RED;
+        node = gparent;
+        continue;
+      }
+
+      // Caso 2: nodo interno → riconduci al caso 3
+      if (node == parent->right) {
+        rb_rotate_left(root, parent, augment);
+        node = parent;
+        parent = node->parent;
+      }
+
+      // Caso 3: nodo esterno → rotazione sul nonno
+      parent->color = RB_BLACK;
+      gparent->color = RB_RED;
+      rb_rotate_right(root, gparent, augment);
+    } else {
+      rb_node_t *uncle = gparent->left;
+
+      if (rb_is_red(uncle)) {
+        parent->color = RB_BLACK;
+        uncle->color = RB_BLACK;
+        gparent->color = RB_RED;
+        node = gparent;
+        continue;
+      }
+
+      if (node == parent->left) {
+        rb_rotate_right(root, parent, augment);
+        node = parent;
+        parent = node->parent;
+      }
+
+      parent->color = RB_BLACK;
+      gparent->color = RB_RED;
+      rb_rotate_left(root, gparent, augment);
+    }
+  }
+
+  root->node->color = RB_BLACK;
+}
+
+void rb_add(rb_root_t *root, rb_node_t *node, rb_less_fn less, rb_augment_fn augment) {
+  rb_node_t **link = &root->node;
+  rb_node_t *parent = (rb_node_t *)0;
+
+  while (*link) {
+    parent = *link;
+    link = less(node, parent) ? &parent->left : &parent->right;
+  }
+
+  rb_link_node(node, parent, link);
+  rb_insert_color(root, node, augment);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  Rimozione                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Ripristina le invarianti dopo la rimozione di un nodo nero.
+ *
+ * x (eventualmente NULL) ha un nero "in meno" rispetto al fratello;
+ * parent serve perché x può essere NULL.
+ */
+static void rb_erase_fixup(rb_root_t *root, rb_node_t *x, rb_node_t *parent, rb_augment_fn augment) {
+  while (x != root->node && rb_is_black(x)) {
+    if (x == parent->left) {
+      rb_node_t *sibling = parent->right;
+
+      // Caso 1: fratello rosso → ruota per avere un fratello nero
+      if (rb_is_red(sibling)) {
+        sibling->color = RB_BLACK;
+        parent->color = RB_RED;
+        rb_rotate_left(root, parent, augment);
+        sibling = parent->right;
+      }
+
+      // Caso 2: fratello con figli neri → ricolora e risali
+      if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+        sibling->color = RB_RED;
+        x = parent;
+        parent = x->parent;
+        continue;
+      }
+
+      // Caso 3: nipote esterno nero → riconduci al caso 4
+      if (rb_is_black(sibling->right)) {
+        sibling->left->color = RB_BLACK;
+        sibling->color = RB_RED;
+        rb_rotate_right(root, sibling, augment);
+        sibling = parent->right;
+      }
+
+      // Caso 4: nipote esterno rosso → rotazione sul padre, fine
+      sibling->color = parent->color;
+      parent->color = RB_BLACK;
+      sibling->right->color = RB_BLACK;
+      rb_rotate_left(root, parent, augment);
+      x = root->node;
+      break;
+    } else {
+      rb_node_t *sibling = parent->left;
+
+      if (rb_is_red(sibling)) {
+        sibling->color = RB_BLACK;
+        parent->color = RB_RED;
+        rb_rotate_right(root, parent, augment);
+        sibling = parent->left;
+      }
+
+      if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+        sibling->color = RB_RED;
+        x = parent;
+        parent = x->parent;
+        continue;
+      }
+
+      if (rb_is_black(sibling->left)) {
+        sibling->right->color = RB_BLACK;
+        sibling->color = RB_RED;
+        rb_rotate_left(root, sibling, augment);
+        sibling = parent->left;
+      }
+
+      sibling->color = parent->color;
+      parent->color = RB_BLACK;
+      sibling->left->color = RB_BLACK;
+      rb_rotate_right(root, parent, augment);
+      x = root->node;
+      break;
+    }
+  }
+
+  if (x)
+    x->color = RB_BLACK;
+}
+
+void rb_erase(rb_root_t *root, rb_node_t *node, rb_augment_fn augment) {
+  rb_node_t *child;        // Nodo che prende il posto di quello rimosso fisicamente
+  rb_node_t *child_parent; // Suo padre dopo la rimozione
+  u8 removed_color;
+
+  if (!node->left || !node->right) {
+    // Al più un figlio: il nodo viene scavalcato
+    child = node->left ? node->left : node->right;
+    child_parent = node->parent;
+    removed_color = node->color;
+
+    if (child)
+      child->parent = child_parent;
+    rb_change_child(root, node->parent, node, child);
+  } else {
+    // Due figli: il successore (minimo del sottoalbero destro) prende il posto
+    rb_node_t *succ = node->right;
+    while (succ->left)
+      succ = succ->left;
+
+    child = succ->right;
+    removed_color = succ->color;
+
+    if (succ->parent == node) {
+      child_parent = succ;
+    } else {
+      child_parent = succ->parent;
+      child_parent->left = child;
+      if (child)
+        child->parent = child_parent;
+
+      succ->right = node->right;
+      node->right->parent = succ;
+    }
+
+    succ->left = node->left;
+    node->left->parent = succ;
+    succ->parent = node->parent;
+    succ->color = node->color;
+    rb_change_child(root, node->parent, node, succ);
+  }
+
+  // Il cammino dal punto di distacco alla radice ha sottoalberi diversi
+  if (augment) {
+    for (rb_node_t *it = child_parent; it; it = it->parent)
+      augment(it);
+  }
+
+  if (removed_color == RB_BLACK)
+    rb_erase_fixup(root, child, child_parent, augment);
+
+  node->parent = node->left = node->right = (rb_node_t *)0;
+}
+
+void rb_replace_node(rb_root_t *root, rb_node_t *old_node, rb_node_t *new_node) {
+  *new_node = *old_node;
+
+  if (old_node->left)
+    old_node->left->parent = new_node;
+  if (old_node->right)
+    old_node->right->parent = new_node;
+  rb_change_child(root, old_node->parent, old_node, new_node);
+}
+
+void rb_augment_propagate(rb_node_t *node, rb_augment_fn augment) {
+  while (node && augment(node))
+    node = node->parent;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                            Ricerca e iterazione                            */
+/* -------------------------------------------------------------------------- */
+
+rb_node_t *rb_find(const rb_root_t *root, const void *key, rb_cmp_fn cmp) {
+  rb_node_t *node = root->node;
+
+  while (node) {
+    int c = cmp(key, node);
+    if (c == 0)
+      return node;
+    node = c < 0 ? node->left : node->right;
+  }
+
+  return (rb_node_t *)0;
+}
+
+rb_node_t *rb_first(const rb_root_t *root) {
+  rb_node_t *node = root->node;
+  if (!node)
+    return (rb_node_t *)0;
+  while (node->left)
+    node = node->left;
+  return node;
+}
+
+rb_node_t *rb_last(const rb_root_t *root) {
+  rb_node_t *node = root->node;
+  if (!node)
+    return (rb_node_t *)0;
+  while (node->right)
+    node = node->right;
+  return node;
+}
+
+rb_node_t *rb_next(const rb_node_t *node) {
+  // Con un sottoalbero destro il successore è il suo minimo
+  if (node->right) {
+    node = node->right;
+    while (node->left)
+      node = node->left;
+    return (rb_node_t *)node;
+  }
+
+  // Altrimenti è il primo antenato di cui siamo nel sottoalbero sinistro
+  rb_node_t *parent;
+  while ((parent = node->parent) && node == parent->right)
+    node = parent;
+  return parent;
+}
+
+rb_node_t *rb_prev(const rb_node_t *node) {
+  if (node->left) {
+    node = node->left;
+    while (node->right)
+      node = node->right;
+    return (rb_node_t *)node;
+  }
+
+  rb_node_t *parent;
+  while ((parent = node->parent) && node == parent->left)
+    node = parent;
+  return parent;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                          Costruzione da array ordinato                     */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Costruisce ricorsivamente il sottoalbero di nodes[lo, hi).
+ *
+ * Scegliendo sempre l'elemento centrale tutte le foglie stanno alla
+ * profondità red_depth o red_depth-1: colorando di rosso solo il livello
+ * più profondo ogni cammino attraversa lo stesso numero di nodi neri.
+ */
+static rb_node_t *rb_build_range(rb_node_t **nodes, size_t lo, size_t hi, rb_node_t *parent, u32 depth, u32 red_depth, rb_augment_fn augment) {
+  if (lo >= hi)
+    return (rb_node_t *)0;
+
+  size_t mid = lo + (hi - lo) / 2;
+  rb_node_t *node = nodes[mid];
+
+  node->parent = parent;
+  node->color = (depth == red_depth && depth > 0) ? RB_RED : RB_BLACK;
+  node->left = rb_build_range(nodes, lo, mid, node, depth + 1, red_depth, augment);
+  node->right = rb_build_range(nodes, mid + 1, hi, node, depth + 1, red_depth, augment);
+
+  if (augment)
+    augment(node);
+
+  return node;
+}
+
+void rb_build_from_sorted(rb_root_t *root, rb_node_t **nodes, size_t count, rb_augment_fn augment) {
+  // Profondità massima dell'albero costruito: floor(log2(count))
+  u32 red_depth = 0;
+  for (size_t n = count; n > 1; n >>= 1)
+    red_depth++;
+
+  root->node = rb_build_range(nodes, 0, count, (rb_node_t *)0, 0, red_depth, augment);
+}
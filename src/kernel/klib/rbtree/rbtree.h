@@ -0,0 +1,187 @@
+/**
+ * @file klib/rbtree.h
+ * @brief Red-Black Tree intrusivo con supporto per dati aumentati
+ *
+ * Albero binario di ricerca bilanciato: ricerca, inserimento e rimozione
+ * in O(log n). Come klib/list, il nodo è embedded nella struttura
+ * dell'utente e non richiede allocazioni.
+ *
+ * L'albero non conosce la chiave: la ricerca e la scelta della posizione
+ * di inserimento sono scritte dal chiamante (tipicamente un while che
+ * scende a sinistra/destra), poi rb_link_node() + rb_insert_color()
+ * collegano e ribilanciano. Per i casi semplici esistono rb_add() e
+ * rb_find() con callback di confronto.
+ *
+ * ALBERI AUMENTATI:
+ * Un nodo può mantenere un valore calcolato dal proprio sottoalbero (es. il
+ * massimo "gap" libero per trovare un buco in O(log n), o il massimo end di
+ * un interval tree). Le funzioni che modificano la struttura accettano una
+ * callback rb_augment_fn che ricalcola il valore di UN nodo a partire dai
+ * figli e ritorna true se è cambiato. Passare NULL per alberi normali.
+ */
+
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+typedef struct rb_node {
+  struct rb_node *parent;
+  struct rb_node *left;
+  struct rb_node *right;
+  u8 color;
+} rb_node_t;
+
+typedef struct {
+  rb_node_t *node;
+} rb_root_t;
+
+#define RB_ROOT_INIT {(rb_node_t *)0}
+
+/**
+ * @brief Ricalcola il valore aumentato di un nodo dai suoi figli
+ *
+ * @return true se il valore è cambiato (gli antenati vanno aggiornati)
+ */
+typedef bool (*rb_augment_fn)(rb_node_t *node);
+
+/**
+ * @brief Confronto per rb_add(): true se a precede b
+ */
+typedef bool (*rb_less_fn)(const rb_node_t *a, const rb_node_t *b);
+
+/**
+ * @brief Confronto per rb_find(): <0 se key precede node, 0 se uguale
+ */
+typedef int (*rb_cmp_fn)(const void *key, const rb_node_t *node);
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Inizializza un albero vuoto
+ */
+static inline void rb_root_init(rb_root_t *root) {
+  root->node = (rb_node_t *)0;
+}
+
+/**
+ * @brief Verifica se l'albero è vuoto
+ */
+static inline bool rb_is_empty(const rb_root_t *root) {
+  return root->node == (rb_node_t *)0;
+}
+
+/**
+ * @brief Collega un nodo come foglia nella posizione trovata dal chiamante
+ *
+ * Va seguita da rb_insert_color() per ribilanciare.
+ *
+ * @param node Nodo da inserire
+ * @param parent Nodo padre (NULL se l'albero è vuoto)
+ * @param link Puntatore al campo left/right del padre (o a root->node)
+ */
+static inline void rb_link_node(rb_node_t *node, rb_node_t *parent, rb_node_t **link) {
+  node->parent = parent;
+  node->left = node->right = (rb_node_t *)0;
+  node->color = RB_RED;
+  *link = node;
+}
+
+/**
+ * @brief Ribilancia l'albero dopo rb_link_node()
+ *
+ * @param augment Callback per alberi aumentati (NULL se assente)
+ */
+void rb_insert_color(rb_root_t *root, rb_node_t *node, rb_augment_fn augment);
+
+/**
+ * @brief Rimuove un nodo dall'albero e ribilancia
+ *
+ * @param augment Callback per alberi aumentati (NULL se assente)
+ */
+void rb_erase(rb_root_t *root, rb_node_t *node, rb_augment_fn augment);
+
+/**
+ * @brief Sostituisce un nodo con un altro nella stessa posizione
+ *
+ * La chiave del nuovo nodo deve ordinarsi come quella del vecchio. Il
+ * valore aumentato va copiato dal chiamante.
+ */
+void rb_replace_node(rb_root_t *root, rb_node_t *old_node, rb_node_t *new_node);
+
+/**
+ * @brief Propaga verso la radice un valore aumentato modificato in place
+ *
+ * Da usare quando il chiamante cambia i dati di un nodo (es. la dimensione
+ * di un intervallo) senza spostarlo. Si ferma al primo antenato invariato.
+ */
+void rb_augment_propagate(rb_node_t *node, rb_augment_fn augment);
+
+/**
+ * @brief Inserisce un nodo ordinandolo con una callback di confronto
+ *
+ * I nodi uguali vengono inseriti dopo quelli già presenti.
+ */
+void rb_add(rb_root_t *root, rb_node_t *node, rb_less_fn less, rb_augment_fn augment);
+
+/**
+ * @brief Cerca un nodo con una callback di confronto
+ *
+ * @return Nodo uguale alla chiave, NULL se assente
+ */
+rb_node_t *rb_find(const rb_root_t *root, const void *key, rb_cmp_fn cmp);
+
+/**
+ * @brief Costruisce un albero bilanciato da nodi già ordinati in O(n)
+ *
+ * L'albero deve essere vuoto. Più veloce di n inserimenti e senza
+ * rotazioni: utile per caricare strutture al boot o dopo una compattazione.
+ *
+ * @param nodes Array di nodi in ordine crescente
+ * @param count Numero di nodi
+ * @param augment Callback per alberi aumentati (NULL se assente)
+ */
+void rb_build_from_sorted(rb_root_t *root, rb_node_t **nodes, size_t count, rb_augment_fn augment);
+
+/**
+ * @brief Nodo minimo / massimo dell'albero (NULL se vuoto)
+ */
+rb_node_t *rb_first(const rb_root_t *root);
+rb_node_t *rb_last(const rb_root_t *root);
+
+/**
+ * @brief Successore / predecessore in ordine (NULL alla fine)
+ */
+rb_node_t *rb_next(const rb_node_t *node);
+rb_node_t *rb_prev(const rb_node_t *node);
+
+/* -------------------------------------------------------------------------- */
+/*                         Macro di utilità per iterazione                    */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Itera in ordine crescente su tutti i nodi
+ *
+ * Non rimuovere il nodo corrente durante l'iterazione: usare
+ * RB_FOR_EACH_SAFE.
+ */
+#define RB_FOR_EACH(it, root) for ((it) = rb_first(root); (it); (it) = rb_next(it))
+
+/**
+ * @brief Itera in ordine crescente consentendo rb_erase() del nodo corrente
+ */
+#define RB_FOR_EACH_SAFE(it, tmp, root) for ((it) = rb_first(root), (tmp) = (it) ? rb_next(it) : (rb_node_t *)0; (it); (it) = (tmp), (tmp) = (it) ? rb_next(it) : (rb_node_t *)0)
+
+/**
+ * @brief Ottiene il container da un campo rb_node
+ */
+#define RB_ENTRY(ptr, type, member) ((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
@@ -0,0 +1,97 @@
+#include <klib/bench/bench.h>
+#include <klib/list/list.h>
+#include <klib/rbtree/rbtree.h>
+#include <lib/types.h>
+
+/**
+ * @file klib/rbtree/rbtree_bench.c
+ * @brief Red-black tree contro lista ordinata (suite di klib/bench)
+ *
+ * Stesso lavoro sulle due strutture: RB_BENCH_NODES chiavi inserite in
+ * ordine sparso, ognuna cercata, poi tutte rimosse. iters è il numero di
+ * giri completi, uguale per i due benchmark: i cicli si confrontano
+ * direttamente. La lista ordinata è quello che klib offriva prima
+ * dell'albero (inserimento e ricerca lineari).
+ */
+
+#define RB_BENCH_NODES 1024  // Chiavi per giro (potenza di 2)
+#define RB_BENCH_STRIDE 617  // Dispari: i * STRIDE mod NODES è una permutazione
+
+typedef struct {
+  rb_node_t rb;
+  list_node_t link;
+  u64 key;
+} rb_bench_item_t;
+
+static rb_bench_item_t rb_bench_items[RB_BENCH_NODES];
+
+static inline u64 rb_bench_key(size_t i) {
+  return (i * RB_BENCH_STRIDE) & (RB_BENCH_NODES - 1);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  rbtree                                    */
+/* -------------------------------------------------------------------------- */
+
+static bool rb_bench_less(const rb_node_t *a, const rb_node_t *b) {
+  return RB_ENTRY(a, rb_bench_item_t, rb)->key < RB_ENTRY(b, rb_bench_item_t, rb)->key;
+}
+
+static int rb_bench_cmp(const void *key, const rb_node_t *node) {
+  u64 k = *(const u64 *)key;
+  u64 nk = RB_ENTRY(node, rb_bench_item_t, rb)->key;
+  return k < nk ? -1 : (k > nk ? 1 : 0);
+}
+
+static bool rb_bench_rbtree(u64 iters) {
+  rb_root_t root = RB_ROOT_INIT;
+
+  for (u64 round = 0; round < iters; round++) {
+    for (size_t i = 0; i < RB_BENCH_NODES; i++) {
+      rb_bench_items[i].key = rb_bench_key(i);
+      rb_add(&root, &rb_bench_items[i].rb, rb_bench_less, NULL);
+    }
+    for (u64 key = 0; key < RB_BENCH_NODES; key++)
+      if (!rb_find(&root, &key, rb_bench_cmp))
+        return false;
+    for (size_t i = 0; i < RB_BENCH_NODES; i++)
+      rb_erase(&root, &rb_bench_items[i].rb, NULL);
+  }
+  return rb_is_empty(&root);
+}
+DEFINE_BENCH(rbtree_1k, rb_bench_rbtree, 50);
+
+/* -------------------------------------------------------------------------- */
+/*                               Lista ordinata                               */
+/* -------------------------------------------------------------------------- */
+
+static list_node_t *rb_bench_list_find(list_node_t *head, u64 key) {
+  list_node_t *it;
+  LIST_FOR_EACH(it, head) {
+    u64 k = LIST_ENTRY(it, rb_bench_item_t, link)->key;
+    if (k >= key)
+      return it;
+  }
+  return head;
+}
+
+static bool rb_bench_sorted_list(u64 iters) {
+  list_node_t head;
+  list_init(&head);
+
+  for (u64 round = 0; round < iters; round++) {
+    for (size_t i = 0; i < RB_BENCH_NODES; i++) {
+      rb_bench_items[i].key = rb_bench_key(i);
+      list_insert_before(rb_bench_list_find(&head, rb_bench_items[i].key), &rb_bench_items[i].link);
+    }
+    for (u64 key = 0; key < RB_BENCH_NODES; key++) {
+      list_node_t *it = rb_bench_list_find(&head, key);
+      if (it == &head || LIST_ENTRY(it, rb_bench_item_t, link)->key != key)
+        return false;
+    }
+    for (size_t i = 0; i < RB_BENCH_NODES; i++)
+      list_remove(&rb_bench_items[i].link);
+  }
+  return list_is_empty(&head);
+}
+DEFINE_BENCH(sorted_list_1k, rb_bench_sorted_list, 50);
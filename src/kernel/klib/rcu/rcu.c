@@ -0,0 +1,140 @@
+#include "rcu.h"
+#include <arch/cpu.h>
+#include <klib/spinlock.h>
+
+/**
+ * @file klib/rcu.c
+ * @brief Read-Copy-Update - gestione dei grace period
+ *
+ * I callback passano per due code:
+ * - next: accodati mentre un grace period è già in corso. Un lettore
+ *   entrato dopo il quiescent state di una CPU può ancora vedere il nodo,
+ *   quindi serve un grace period successivo
+ * - wait: in attesa del grace period corrente
+ *
+ * Quando tutte le CPU online hanno riportato un quiescent state la coda
+ * wait viene eseguita, next diventa wait e, se non vuota, parte un nuovo
+ * grace period. I quiescent state arrivano dal loop di idle, che il tick
+ * del kernel risveglia periodicamente: call_rcu() non blocca e non li
+ * riporta mai da sé, perché può essere chiamata con lock presi o dentro
+ * una sezione di lettura.
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                                 Stato globale                              */
+/* -------------------------------------------------------------------------- */
+
+static spinlock_t rcu_lock = SPINLOCK_INITIALIZER;
+
+static struct {
+  u64 online_mask;  // CPU registrate
+  u64 qs_pending;   // CPU che devono ancora riportare (0 = nessun GP in corso)
+  u64 completed;    // Grace period completati
+  rcu_head_t *wait; // Callback del grace period corrente
+  rcu_head_t **wait_tail;
+  rcu_head_t *next; // Callback per il grace period successivo
+  rcu_head_t **next_tail;
+} rcu_state = {
+    .wait_tail = &rcu_state.wait,
+    .next_tail = &rcu_state.next,
+};
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline u64 rcu_cpu_bit(void) {
+  return 1ULL << (arch_cpu_current_id() % RCU_MAX_CPUS);
+}
+
+/**
+ * Avvia un grace period per i callback in next, se non ce n'è già uno.
+ */
+static void rcu_start_gp_locked(void) {
+  // Prima di rcu_init() nessuna CPU può riportare: i callback restano in next
+  if (rcu_state.qs_pending || !rcu_state.next || !rcu_state.online_mask)
+    return;
+
+  rcu_state.wait = rcu_state.next;
+  rcu_state.wait_tail = rcu_state.next_tail;
+  rcu_state.next = (rcu_head_t *)0;
+  rcu_state.next_tail = &rcu_state.next;
+  rcu_state.qs_pending = rcu_state.online_mask;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                IMPLEMENTAZIONE                             */
+/* -------------------------------------------------------------------------- */
+
+void rcu_init(void) {
+  rcu_cpu_online();
+}
+
+void rcu_cpu_online(void) {
+  u64 bit = rcu_cpu_bit();
+  spinlock_lock(&rcu_lock);
+  rcu_state.online_mask |= bit;
+  rcu_start_gp_locked();
+  spinlock_unlock(&rcu_lock);
+}
+
+void rcu_quiescent_state(void) {
+  u64 bit = rcu_cpu_bit();
+  rcu_head_t *done = (rcu_head_t *)0;
+
+  spinlock_lock(&rcu_lock);
+
+  if (rcu_state.qs_pending & bit) {
+    rcu_state.qs_pending &= ~bit;
+
+    if (!rcu_state.qs_pending) {
+      done = rcu_state.wait;
+      rcu_state.wait = (rcu_head_t *)0;
+      rcu_state.wait_tail = &rcu_state.wait;
+      rcu_state.completed++;
+      rcu_start_gp_locked();
+    }
+  }
+
+  spinlock_unlock(&rcu_lock);
+
+  // I callback liberano memoria e possono prendere altri lock: fuori da rcu_lock
+  while (done) {
+    rcu_head_t *head = done;
+    done = head->next;
+    head->func(head);
+  }
+}
+
+void call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head)) {
+  head->func = func;
+  head->next = (rcu_head_t *)0;
+
+  spinlock_lock(&rcu_lock);
+  *rcu_state.next_tail = head;
+  rcu_state.next_tail = &head->next;
+  rcu_start_gp_locked();
+  spinlock_unlock(&rcu_lock);
+}
+
+typedef struct {
+  rcu_head_t head; // Primo campo: il callback riceve l'indirizzo del waiter
+  volatile bool done;
+} rcu_waiter_t;
+
+static void rcu_wakeme(rcu_head_t *head) {
+  ((rcu_waiter_t *)head)->done = true;
+}
+
+void synchronize_rcu(void) {
+  rcu_waiter_t waiter = {.done = false};
+
+  call_rcu(&waiter.head, rcu_wakeme);
+
+  // Il chiamante è fuori da sezioni di lettura: la sua CPU è quiescente
+  while (!waiter.done) {
+    rcu_quiescent_state();
+    if (!waiter.done)
+      arch_cpu_pause();
+  }
+}
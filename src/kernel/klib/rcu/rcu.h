@@ -0,0 +1,106 @@
+/**
+ * @file klib/rcu.h
+ * @brief Read-Copy-Update - letture senza lock su strutture condivise
+ *
+ * I lettori attraversano la struttura senza prendere lock; gli scrittori
+ * (serializzati fra loro con un lock proprio della struttura) pubblicano i
+ * nuovi nodi con rcu_assign_pointer() e rimandano la liberazione dei nodi
+ * rimossi con call_rcu() finché nessun lettore può più vederli.
+ *
+ * MODELLO (kernel non preemptible):
+ * - Una sezione di lettura (rcu_read_lock/unlock) non può dormire né cedere
+ *   la CPU: basta una barriera del compilatore, nessun contatore condiviso
+ * - Una CPU che passa dal loop di idle è in uno stato quiescente: nessuna
+ *   sezione di lettura è aperta (rcu_quiescent_state()). Il tick del
+ *   kernel (arch/tick.h) risveglia l'idle a intervalli regolari, quindi
+ *   ogni grace period termina entro un tick dall'ultimo lettore
+ * - Un grace period termina quando tutte le CPU online hanno riportato uno
+ *   stato quiescente; allora i callback in attesa vengono eseguiti
+ */
+
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+#define RCU_MAX_CPUS 64 // Una CPU per bit nella maschera dei quiescent state
+
+/**
+ * @brief Nodo da embeddare nelle strutture liberate con call_rcu()
+ */
+typedef struct rcu_head {
+  struct rcu_head *next;
+  void (*func)(struct rcu_head *head);
+} rcu_head_t;
+
+/* -------------------------------------------------------------------------- */
+/*                                 Lato lettura                               */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Apre una sezione di lettura (annidabile)
+ */
+static inline void rcu_read_lock(void) {
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Chiude una sezione di lettura
+ */
+static inline void rcu_read_unlock(void) {
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Legge un puntatore pubblicato con rcu_assign_pointer()
+ *
+ * Garantisce che i campi del nodo puntato siano visti inizializzati.
+ */
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+/**
+ * @brief Pubblica un puntatore: le scritture precedenti sul nodo sono
+ *        visibili prima del puntatore stesso
+ */
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Inizializza RCU e registra la CPU di boot
+ */
+void rcu_init(void);
+
+/**
+ * @brief Registra la CPU corrente come online (AP dopo il bring-up)
+ */
+void rcu_cpu_online(void);
+
+/**
+ * @brief Riporta uno stato quiescente per la CPU corrente
+ *
+ * Da chiamare solo fuori da ogni sezione di lettura: il loop di idle la
+ * chiama dopo ogni tick, non dall'handler del tick perché i callback
+ * liberano memoria. Esegue i callback dei grace period completati.
+ */
+void rcu_quiescent_state(void);
+
+/**
+ * @brief Esegue func(head) dopo il prossimo grace period completo
+ *
+ * Non blocca: utilizzabile con lock presi.
+ */
+void call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head));
+
+/**
+ * @brief Attende la fine di un grace period completo
+ *
+ * Il chiamante non deve trovarsi in una sezione di lettura.
+ */
+void synchronize_rcu(void);
@@ -0,0 +1,176 @@
+#include "static_key.h"
+#include <klib/cmdline/cmdline.h>
+#include <klib/klog/klog.h>
+#include <klib/spinlock.h>
+#include <lib/string/string.h>
+
+/**
+ * @file klib/static_key.c
+ * @brief Static key - Implementation
+ *
+ * Simboli del linker (tools/linker.ld):
+ * - _jump_table_start/_jump_table_end: un jump_entry_t per sito
+ * - _static_keys_start/_static_keys_end: le chiavi definite con
+ *   DEFINE_STATIC_KEY_*, cioè il registro
+ *
+ * La tabella dei siti non è ordinata: cambiare stato a una chiave la
+ * scorre tutta. I cambi di stato sono rari e la tabella piccola; in cambio
+ * la tabella resta in sola lettura.
+ */
+
+extern jump_entry_t _jump_table_start[];
+extern jump_entry_t _jump_table_end[];
+extern static_key_t _static_keys_start[];
+extern static_key_t _static_keys_end[];
+
+/* -------------------------------------------------------------------------- */
+/*                                 Stato globale                              */
+/* -------------------------------------------------------------------------- */
+
+// Serializza i cambi di stato e quindi le riscritture del codice
+static spinlock_t static_key_lock = SPINLOCK_INITIALIZER;
+
+#define STATIC_KEY_CMDLINE_MAX 256
+
+/* -------------------------------------------------------------------------- */
+/*                               Utility interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline static_key_t *jump_entry_key(const jump_entry_t *entry) {
+  uptr raw = (uptr)&entry->key + (uptr)entry->key;
+  return (static_key_t *)(raw & ~1UL);
+}
+
+static inline bool jump_entry_branch(const jump_entry_t *entry) {
+  return ((uptr)&entry->key + (uptr)entry->key) & 1;
+}
+
+/**
+ * Porta tutti i siti di key allo stato corrente. Chiamata con il lock.
+ */
+static size_t static_key_update_locked(static_key_t *key) {
+  bool enabled = key->enabled > 0;
+  size_t sites = 0;
+
+  for (jump_entry_t *entry = _jump_table_start; entry < _jump_table_end; entry++) {
+    if (jump_entry_key(entry) != key)
+      continue;
+    arch_jump_label_transform(entry, enabled != jump_entry_branch(entry));
+    sites++;
+  }
+  return sites;
+}
+
+static size_t static_key_site_count(const static_key_t *key) {
+  size_t sites = 0;
+  for (jump_entry_t *entry = _jump_table_start; entry < _jump_table_end; entry++) {
+    if (jump_entry_key(entry) == key)
+      sites++;
+  }
+  return sites;
+}
+
+/**
+ * Accende le chiavi elencate in "static_keys=a,b,c".
+ */
+static void static_key_apply_cmdline(void) {
+  char list[STATIC_KEY_CMDLINE_MAX];
+  if (!cmdline_get("static_keys", list, sizeof(list)))
+    return;
+
+  char *name = list;
+  while (*name) {
+    char *end = name;
+    while (*end && *end != ',')
+      end++;
+    bool last = (*end == '\0');
+    *end = '\0';
+
+    if (*name) {
+      static_key_t *key = static_key_find(name);
+      if (key)
+        static_key_enable(key);
+      else
+        klog_warn("static_key: chiave sconosciuta '%s' sulla command line", name);
+    }
+
+    if (last)
+      break;
+    name = end + 1;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void static_key_init(void) {
+  size_t entries = (size_t)(_jump_table_end - _jump_table_start);
+  size_t keys = (size_t)(_static_keys_end - _static_keys_start);
+
+  // I siti nascono già coerenti con lo stato iniziale: qui si verifica
+  // solo che la tabella sia sana (una voce corrotta fa panic subito)
+  spinlock_lock(&static_key_lock);
+  for (static_key_t *key = _static_keys_start; key < _static_keys_end; key++)
+    static_key_update_locked(key);
+  spinlock_unlock(&static_key_lock);
+
+  static_key_apply_cmdline();
+
+  klog_info("static_key: %zu chiavi, %zu siti", keys, entries);
+}
+
+void static_key_enable(static_key_t *key) {
+  spinlock_lock(&static_key_lock);
+  if (key->enabled == 0) {
+    key->enabled = 1;
+    static_key_update_locked(key);
+  }
+  spinlock_unlock(&static_key_lock);
+}
+
+void static_key_disable(static_key_t *key) {
+  spinlock_lock(&static_key_lock);
+  if (key->enabled != 0) {
+    key->enabled = 0;
+    static_key_update_locked(key);
+  }
+  spinlock_unlock(&static_key_lock);
+}
+
+void static_key_inc(static_key_t *key) {
+  spinlock_lock(&static_key_lock);
+  if (key->enabled++ == 0)
+    static_key_update_locked(key);
+  spinlock_unlock(&static_key_lock);
+}
+
+void static_key_dec(static_key_t *key) {
+  spinlock_lock(&static_key_lock);
+  if (key->enabled <= 0) {
+    spinlock_unlock(&static_key_lock);
+    klog_error("static_key: dec di '%s' già spenta", key->name ? key->name : "?");
+    return;
+  }
+  if (--key->enabled == 0)
+    static_key_update_locked(key);
+  spinlock_unlock(&static_key_lock);
+}
+
+bool static_key_enabled(const static_key_t *key) {
+  return __atomic_load_n(&key->enabled, __ATOMIC_RELAXED) > 0;
+}
+
+static_key_t *static_key_find(const char *name) {
+  for (static_key_t *key = _static_keys_start; key < _static_keys_end; key++) {
+    if (key->name && strcmp(key->name, name) == 0)
+      return key;
+  }
+  return NULL;
+}
+
+void static_key_dump(void) {
+  klog_info("static_key: %zu chiavi registrate", (size_t)(_static_keys_end - _static_keys_start));
+  for (static_key_t *key = _static_keys_start; key < _static_keys_end; key++)
+    klog_info("  %s: %s (utenti %d, siti %zu)", key->name, key->enabled > 0 ? "on" : "off", key->enabled, static_key_site_count(key));
+}
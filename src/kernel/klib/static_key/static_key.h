@@ -0,0 +1,145 @@
+/**
+ * @file klib/static_key.h
+ * @brief Static key: rami quasi gratuiti per strumentazione disattivata
+ *
+ * Tracing, statistiche dei lock e controlli di debug devono costare zero
+ * quando sono spenti. Una static key non viene letta a ogni passaggio: il
+ * ramo è un'istruzione nel codice (NOP o JMP) che viene riscritta quando
+ * la chiave cambia stato. Spento, il costo è un NOP a 5 byte.
+ *
+ * USO:
+ *   DEFINE_STATIC_KEY_FALSE(lockstat_enabled);
+ *
+ *   if (static_branch_unlikely(&lockstat_enabled))
+ *     lockstat_record(lock);
+ *
+ *   static_branch_enable(&lockstat_enabled);
+ *
+ * - DEFINE_STATIC_KEY_FALSE/TRUE fissano lo stato iniziale
+ * - static_branch_unlikely/likely dicono quale ramo mettere in linea:
+ *   l'altro è fuori dal percorso caldo, raggiunto con il JMP
+ * - static_branch_inc/dec contano gli utenti: il ramo resta attivo finché
+ *   almeno uno lo vuole
+ *
+ * Cambiare stato è lento (riscrittura del codice e sincronizzazione di
+ * tutte le CPU) e può solo essere fatto fuori da contesto di interrupt.
+ *
+ * REGISTRO:
+ * Ogni chiave definita con DEFINE_STATIC_KEY_* è raccolta dal linker e ha
+ * un nome: static_key_find() la cerca, e "static_keys=a,b" sulla command
+ * line accende le chiavi indicate al boot.
+ *
+ * NASM: vedi arch/x86_64/cpu/jump_label.inc.
+ */
+
+#pragma once
+
+#include <arch/jump_label.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               Strutture base                               */
+/* -------------------------------------------------------------------------- */
+
+typedef struct static_key {
+  s32 enabled;      // Utenti attivi (0 = spenta)
+  const char *name; // Nome nel registro
+} __attribute__((aligned(8))) static_key_t;
+
+// Tipi distinti solo per scegliere a compile time il sito iniziale
+typedef struct {
+  static_key_t key;
+} static_key_true_t;
+
+typedef struct {
+  static_key_t key;
+} static_key_false_t;
+
+#define STATIC_KEY_SECTION __attribute__((section(".data.static_keys"), used))
+
+#define DEFINE_STATIC_KEY_TRUE(key_name) static_key_true_t key_name STATIC_KEY_SECTION = {.key = {.enabled = 1, .name = #key_name}}
+#define DEFINE_STATIC_KEY_FALSE(key_name) static_key_false_t key_name STATIC_KEY_SECTION = {.key = {.enabled = 0, .name = #key_name}}
+#define DECLARE_STATIC_KEY_TRUE(key_name) extern static_key_true_t key_name
+#define DECLARE_STATIC_KEY_FALSE(key_name) extern static_key_false_t key_name
+
+/* -------------------------------------------------------------------------- */
+/*                                    Rami                                    */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Il sito salta se lo stato della chiave è diverso dal suo branch. Il tipo
+ * della chiave decide se il sito nasce NOP o JMP, così è corretto anche
+ * prima di static_key_init().
+ */
+#define __static_key_is(x, type) __builtin_types_compatible_p(__typeof__(*(x)), type)
+
+/**
+ * @brief true se la chiave è accesa; il ramo "true" è fuori linea
+ */
+#define static_branch_unlikely(x)                                                                                                                    \
+  __builtin_expect(__builtin_choose_expr(__static_key_is(x, static_key_true_t), arch_static_branch_jump(&(x)->key, false),                        \
+                                         arch_static_branch(&(x)->key, false)),                                                                      \
+                   0)
+
+/**
+ * @brief true se la chiave è accesa; il ramo "true" è in linea
+ */
+#define static_branch_likely(x)                                                                                                                      \
+  __builtin_expect(!__builtin_choose_expr(__static_key_is(x, static_key_true_t), arch_static_branch(&(x)->key, true),                             \
+                                          arch_static_branch_jump(&(x)->key, true)),                                                                 \
+                   1)
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni disponibili                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Porta ogni sito allo stato della sua chiave e applica la
+ *        command line ("static_keys=nome,nome")
+ *
+ * Da chiamare dopo cmdline_init(), su una sola CPU.
+ */
+void static_key_init(void);
+
+/**
+ * @brief Accende la chiave (idempotente)
+ */
+void static_key_enable(static_key_t *key);
+
+/**
+ * @brief Spegne la chiave (idempotente, azzera gli utenti)
+ */
+void static_key_disable(static_key_t *key);
+
+/**
+ * @brief Aggiunge un utente: accende la chiave al primo
+ */
+void static_key_inc(static_key_t *key);
+
+/**
+ * @brief Toglie un utente: spegne la chiave all'ultimo
+ */
+void static_key_dec(static_key_t *key);
+
+/**
+ * @brief Stato corrente (lettura in memoria, non per i percorsi caldi)
+ */
+bool static_key_enabled(const static_key_t *key);
+
+/**
+ * @brief Cerca una chiave per nome nel registro
+ *
+ * @return Chiave o NULL
+ */
+static_key_t *static_key_find(const char *name);
+
+/**
+ * @brief Stampa tutte le chiavi con stato e numero di siti
+ */
+void static_key_dump(void);
+
+#define static_branch_enable(x) static_key_enable(&(x)->key)
+#define static_branch_disable(x) static_key_disable(&(x)->key)
+#define static_branch_inc(x) static_key_inc(&(x)->key)
+#define static_branch_dec(x) static_key_dec(&(x)->key)
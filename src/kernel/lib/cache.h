@@ -0,0 +1,30 @@
+#pragma once
+
+/**
+ * @file lib/cache.h
+ * @brief Dimensione della cache line e attributi di piazzamento dei dati
+ *
+ * Due variabili sulla stessa cache line si contendono la linea anche se
+ * nessuno le condivide davvero (false sharing): ogni scrittura di una CPU
+ * invalida la copia delle altre. Il rimedio è separare i dati per modo
+ * d'uso, non per modulo:
+ *
+ * - __read_mostly: globali scritte all'avvio e poi solo lette nei percorsi
+ *   caldi (puntatori a tabelle, dimensioni, flag di inizializzazione).
+ *   Finiscono tutte insieme in .data.read_mostly, lontane dalle variabili
+ *   scritte spesso, e le loro linee restano in stato shared su ogni CPU
+ * - __cacheline_aligned: globali scritte spesso (lock, contatori, stato
+ *   protetto da un lock). Ognuna inizia una propria linea in
+ *   .data.cacheline_aligned, così non trascina vicini innocenti
+ * - ____cacheline_aligned: solo allineamento, per membri di struct e tipi
+ *   (es. separare il lato produttore da quello consumatore di una coda)
+ *
+ * Le sezioni sono raccolte in testa a .data da tools/linker.ld.
+ */
+
+#define L1_CACHE_SHIFT 6
+#define L1_CACHE_BYTES (1 << L1_CACHE_SHIFT)
+
+#define ____cacheline_aligned __attribute__((aligned(L1_CACHE_BYTES)))
+#define __cacheline_aligned __attribute__((aligned(L1_CACHE_BYTES), section(".data.cacheline_aligned")))
+#define __read_mostly __attribute__((section(".data.read_mostly")))
@@ -204,9 +204,14 @@ int ksprintf(char *buf, const char *fmt, ...) {
 int ksnprintf(char *buf, size_t size, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
+  int len = kvsnprintf(buf, size, fmt, args);
+  va_end(args);
+  return len;
+}
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
   char temp[1024];
   int len = kvsprintf(temp, fmt, args);
-  va_end(args);
   if (size > 0) {
     strncpy(buf, temp, size - 1);
     buf[size - 1] = '\0';
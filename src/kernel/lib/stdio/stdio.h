@@ -27,6 +27,16 @@ int ksprintf(char *buffer, const char *format, ...);
  */
 int ksnprintf(char *buffer, size_t size, const char *format, ...);
 
+/**
+ * @brief ksnprintf con va_list
+ * @param buffer Buffer di destinazione
+ * @param size Dimensione massima buffer (include '\0')
+ * @param format String di formato
+ * @param args Lista argomenti variabili
+ * @return Numero di caratteri che sarebbero stati scritti
+ */
+int kvsnprintf(char *buffer, size_t size, const char *format, va_list args);
+
 /**
  * @brief Printf con va_list - per implementazioni interne
  * @param format String di formato
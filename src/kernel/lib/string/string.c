@@ -2,26 +2,66 @@
 #include <lib/stddef.h>
 #include <lib/stdint.h>
 
+#if defined(__x86_64__)
+#include <arch/x86_64/cpu/alternative.h>
+#endif
+
 /**
  * @brief Copia n byte dalla sorgente alla destinazione (non gestisce overlap).
+ *
+ * x86_64: rep movsq per le word e rep movsb per la coda; con ERMS il sito
+ * viene riscritto al boot in un singolo rep movsb, più veloce su ogni
+ * lunghezza (vedi arch/x86_64/cpu/alternative.h).
  */
 void *memcpy(void *dest, const void *src, size_t n) {
+#if defined(__x86_64__)
+  void *d = dest;
+  const void *s = src;
+  __asm__ volatile(ALTERNATIVE("movq %%rcx, %%rdx\n\t"
+                               "shrq $3, %%rcx\n\t"
+                               "rep movsq\n\t"
+                               "movl %%edx, %%ecx\n\t"
+                               "andl $7, %%ecx\n\t"
+                               "rep movsb",
+                               "rep movsb", X86_FEATURE_ERMS)
+                   : "+D"(d), "+S"(s), "+c"(n)
+                   :
+                   : "rdx", "memory");
+#else
   uint8_t *d = (uint8_t *)dest;
   const uint8_t *s = (const uint8_t *)src;
   for (size_t i = 0; i < n; i++) {
     d[i] = s[i];
   }
+#endif
   return dest;
 }
 
 /**
  * @brief Imposta n byte della destinazione al valore specificato.
+ *
+ * x86_64: stesso schema di memcpy (rep stosq + coda, rep stosb con ERMS).
  */
 void *memset(void *dest, int value, size_t n) {
+#if defined(__x86_64__)
+  void *d = dest;
+  uint64_t pattern = 0x0101010101010101ULL * (uint8_t)value;
+  __asm__ volatile(ALTERNATIVE("movq %%rcx, %%rdx\n\t"
+                               "shrq $3, %%rcx\n\t"
+                               "rep stosq\n\t"
+                               "movl %%edx, %%ecx\n\t"
+                               "andl $7, %%ecx\n\t"
+                               "rep stosb",
+                               "rep stosb", X86_FEATURE_ERMS)
+                   : "+D"(d), "+c"(n)
+                   : "a"(pattern)
+                   : "rdx", "memory");
+#else
   uint8_t *d = (uint8_t *)dest;
   for (size_t i = 0; i < n; i++) {
     d[i] = (uint8_t)value;
   }
+#endif
   return dest;
 }
 
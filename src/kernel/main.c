@@ -1,17 +1,36 @@
 #include <arch/platform.h>
+#include <arch/cpu.h>
 #include <arch/segment.h>
+#include <arch/tick.h>
 #include <arch/x86_64/memory/memory.h>
+#include <drivers/serial/serial.h>
 #include <drivers/video/console.h>
 #include <drivers/video/framebuffer.h>
+#include <klib/bench/bench.h>
+#include <klib/cmdline/cmdline.h>
+#include <klib/ftrace/ftrace.h>
 #include <klib/klog/klog.h>
+#include <klib/ksym/ksym.h>
+#include <klib/lat_hist/lat_hist.h>
+#include <klib/perf/perf.h>
+#include <klib/profiler/profiler.h>
+#include <klib/radix_tree/radix_tree.h>
+#include <klib/rcu/rcu.h>
+#include <klib/static_key/static_key.h>
 #include <lib/stdio/stdio.h>
 #include <lib/string/string.h>
 #include <limine.h>
+#include <mm/cma.h>
 #include <mm/heap/heap.h>
+#include <mm/ksm.h>
 #include <mm/memory.h>
+#include <mm/memprof.h>
+#include <mm/percpu.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
 
+#define KERNEL_TICK_HZ 100 // Risvegli al secondo del loop di idle
+
 // === Richiesta framebuffer (LIMINE) ===
 volatile struct limine_framebuffer_request framebuffer_request = {.id = LIMINE_FRAMEBUFFER_REQUEST, .revision = 0};
 
@@ -21,15 +40,24 @@ void kmain(void) {
   framebuffer_init(fb->address, fb->width, fb->height, fb->pitch, fb->bpp);
   console_init();
   console_clear();
+  serial_init();
 
   arch_init();
+  cmdline_init(arch_get_cmdline());
+  static_key_init(); // Dopo le alternatives: i siti devono essere già definitivi
+  rcu_init();
+  perf_init();
+  ksym_init();
 
   arch_segment_init();
   klog_info("GDT + TSS initialized (Ring 0 attivo, Ring 3 pronto)");
+  percpu_early_init(); // Dopo la GDT: il caricamento di GS ne azzera la base
+  lat_hist_init();     // Registra nell'area per-CPU: dopo percpu_early_init
 
   // === Log iniziale ===
   klog_info("=== ZONE-OS MICROKERNEL ===");
   klog_info("Booted via Limine, architecture: %s", arch_get_name());
+  klog_info("Command line: %s", cmdline_raw());
 
   // === Inizializzazione memoria fisica (PMM) ===
   memory_init();
@@ -39,13 +67,22 @@ void kmain(void) {
   const pmm_stats_t *pmm = pmm_get_stats();
   klog_info("PMM: %lu MB free", pmm->free_pages * PAGE_SIZE / (1024 * 1024));
 
+  // === Regione CMA (riservata prima che la memoria si frammenti) ===
+  cma_init();
+
   // === Inizializzazione memoria virtuale (VMM) ===
   vmm_init();
   klog_info("VMM initialized");
+  percpu_init();
+  profiler_init();
+  ftrace_init();
+  memprof_init(); // Prima dello heap: "memprof" ne registra anche le allocazioni di boot
 
   // === Inizializzazione heap e memoria ritardata ===
   heap_init();
   memory_late_init();
+  radix_tree_init();
+  ksm_init();
 
   // === Statistiche finali memoria ===
   const pmm_stats_t *final = pmm_get_stats();
@@ -54,11 +91,53 @@ void kmain(void) {
   // === Test interruzione software (INT3) ===
   klog_info("ZONE-OS READY — entering idle");
 
+  // === Profilo del boot ("profile=" sulla command line) ===
+  if (profiler_is_running()) {
+    profiler_stop();
+    profiler_dump();
+  }
+
+  // === Traccia delle funzioni ("ftrace=" sulla command line) ===
+  if (ftrace_is_running()) {
+    ftrace_stop();
+    ftrace_dump();
+  }
+
+  // === Siti di allocazione ("memprof" sulla command line) ===
+  if (memprof_is_enabled())
+    memprof_report(MEMPROF_REPORT_TOP, MEMPROF_SORT_LIVE);
+
+  // === Latenze dei percorsi caldi ("lat_hist=" sulla command line) ===
+  if (lat_hist_any_enabled())
+    lat_hist_report_all();
+
+  // === Modalità benchmark ("bench" sulla command line, vedi scripts/bench.sh) ===
+  if (bench_mode_requested())
+    bench_main();
+
   // klog_info("Trigger INT3...");
   // asm volatile("int3");
   // klog_info("Returned from INT3");
   //
+  // === Tick periodico ===
+  // Dopo i report: il profiler a timer usa lo stesso timer locale
+  bool ticking = arch_tick_start(KERNEL_TICK_HZ);
+  if (ticking)
+    klog_info("Tick: %u Hz", KERNEL_TICK_HZ);
+  else
+    klog_warn("Tick: timer locale non disponibile, idle senza hlt");
+
   // === Loop di idle ===
-  while (1)
-    asm volatile("hlt");
+  // Il lavoro in background (teardown, merge KSM) gira a budget limitato
+  // a ogni risveglio del tick; l'idle è anche il quiescent state RCU della
+  // CPU. Senza tick un hlt non tornerebbe più: si gira in pausa attiva.
+  while (1) {
+    rcu_quiescent_state();
+    vmm_reclaim_work(VMM_RECLAIM_DEFAULT_BUDGET);
+    ksm_scan_pass();
+    if (ticking)
+      arch_cpu_idle();
+    else
+      arch_cpu_pause();
+  }
 }
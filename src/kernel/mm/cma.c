@@ -0,0 +1,404 @@
+#include <klib/cmdline/cmdline.h>
+#include <klib/klog/klog.h>
+#include <klib/spinlock.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/cma.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/cma.c
+ * @brief Contiguous Memory Allocator - implementazione
+ *
+ * Ogni pagina della regione ha un descrittore con stato e proprietario:
+ * - FREE:    disponibile per prestiti o buffer contigui
+ * - MOVABLE: prestata a una pagina anonima (space, virt_addr), migrabile
+ * - PINNED:  parte di un buffer restituito da cma_alloc()
+ *
+ * I descrittori vivono in pagine allocate dal PMM all'avvio e sono
+ * accessibili tramite il direct map (vmm_phys_to_virt).
+ */
+
+/*
+ * ============================================================================
+ * STRUTTURE DATI INTERNE
+ * ============================================================================
+ */
+
+typedef enum {
+  CMA_PAGE_FREE = 0,
+  CMA_PAGE_MOVABLE,
+  CMA_PAGE_PINNED,
+} cma_page_state_t;
+
+typedef struct {
+  vmm_space_t *space; // Proprietario (solo MOVABLE)
+  u64 virt_addr;      // Mapping del proprietario (solo MOVABLE)
+  u8 state;           // cma_page_state_t
+} cma_page_t;
+
+static spinlock_t cma_lock = SPINLOCK_INITIALIZER;
+
+static struct {
+  bool initialized;
+  u64 base;             // Primo indirizzo fisico della regione
+  u64 end;              // Primo indirizzo fisico oltre la regione
+  u64 meta_phys;        // Pagine dei descrittori
+  size_t meta_pages;    // Numero di pagine dei descrittori
+  cma_page_t *pages;    // Descrittori (uno per pagina)
+  u64 next_movable;     // Hint per i prestiti movable
+} cma_state;
+
+static cma_stats_t cma_stats;
+
+/*
+ * ============================================================================
+ * UTILITY
+ * ============================================================================
+ */
+
+static inline u64 cma_index(u64 phys) {
+  return (phys - cma_state.base) / PAGE_SIZE;
+}
+
+static inline u64 cma_phys(u64 index) {
+  return cma_state.base + index * PAGE_SIZE;
+}
+
+static void cma_set_free_locked(u64 idx) {
+  cma_page_t *page = &cma_state.pages[idx];
+
+  if (page->state == CMA_PAGE_MOVABLE)
+    cma_stats.movable_pages--;
+  else if (page->state == CMA_PAGE_PINNED)
+    cma_stats.pinned_pages--;
+  else
+    return;
+
+  page->state = CMA_PAGE_FREE;
+  page->space = (vmm_space_t *)NULL;
+  page->virt_addr = 0;
+  cma_stats.free_pages++;
+
+  if (idx < cma_state.next_movable)
+    cma_state.next_movable = idx;
+}
+
+/**
+ * @brief Migra una pagina movable in un frame del PMM
+ *
+ * La pagina viene resa read-only durante la copia; la PTE è poi sostituita
+ * con compare-and-swap ripristinando i flag originali. Se il proprietario
+ * ha nel frattempo rimappato la pagina, la migrazione fallisce.
+ */
+static bool cma_migrate_page_locked(u64 idx) {
+  cma_page_t *page = &cma_state.pages[idx];
+  u64 phys = cma_phys(idx);
+  u64 cur_phys, flags;
+
+  if (!vmm_query(page->space, page->virt_addr, &cur_phys, &flags) || cur_phys != phys)
+    return false; // Proprietario non più valido
+
+  if (flags & VMM_FLAG_COW)
+    return false; // Frame condiviso (KSM/COW): più mapping da aggiornare
+  if (flags & VMM_FLAG_PINNED)
+    return false; // Frame fissato (vmm_pin): l'indirizzo fisico non può cambiare
+
+  void *new_page = pmm_alloc_page();
+  if (!new_page)
+    return false;
+  pmm_set_owner(new_page, 1, PMM_OWNER_USER_ANON); // Solo pagine anonime sono movable
+
+  if (flags & VMM_FLAG_WRITE)
+    vmm_protect(page->space, page->virt_addr, 1, flags & ~(u64)VMM_FLAG_WRITE);
+
+  memcpy(vmm_phys_to_virt((u64)new_page), vmm_phys_to_virt(phys), PAGE_SIZE);
+
+  if (!vmm_replace_page(page->space, page->virt_addr, phys, (u64)new_page, flags)) {
+    vmm_protect(page->space, page->virt_addr, 1, flags);
+    pmm_free_page(new_page);
+    return false;
+  }
+
+  cma_stats.migrations++;
+  return true;
+}
+
+/**
+ * @brief Verifica se una finestra è utilizzabile per un buffer contiguo
+ *
+ * @param allow_movable Se false accetta solo finestre completamente libere
+ * @param out_skip Indice da cui riprendere la ricerca se la finestra è occupata
+ */
+static bool cma_window_usable_locked(u64 start, size_t count, bool allow_movable, u64 *out_skip) {
+  for (size_t i = 0; i < count; i++) {
+    u8 state = cma_state.pages[start + i].state;
+    if (state == CMA_PAGE_PINNED || (state == CMA_PAGE_MOVABLE && !allow_movable)) {
+      *out_skip = start + i + 1;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Riserva la finestra migrando le pagine in prestito
+ */
+static bool cma_claim_window_locked(u64 start, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    cma_page_t *page = &cma_state.pages[start + i];
+
+    if (page->state == CMA_PAGE_MOVABLE) {
+      if (!cma_migrate_page_locked(start + i)) {
+        cma_stats.migration_failures++;
+        goto rollback;
+      }
+      cma_stats.movable_pages--;
+    } else {
+      cma_stats.free_pages--;
+    }
+
+    page->state = CMA_PAGE_PINNED;
+    page->space = (vmm_space_t *)NULL;
+    page->virt_addr = 0;
+    cma_stats.pinned_pages++;
+  }
+
+  return true;
+
+rollback:
+  // Le pagine già prese (libere o migrate) tornano libere
+  for (size_t i = 0; i < count; i++) {
+    if (cma_state.pages[start + i].state == CMA_PAGE_PINNED)
+      cma_set_free_locked(start + i);
+  }
+  return false;
+}
+
+/*
+ * ============================================================================
+ * API PUBBLICA
+ * ============================================================================
+ */
+
+bool cma_init(void) {
+  const pmm_stats_t *pmm = pmm_get_stats();
+  if (!pmm) {
+    klog_error("cma: PMM non inizializzato");
+    return false;
+  }
+
+  u64 size = PAGE_ALIGN_UP(cmdline_get_size("cma", CMA_DEFAULT_SIZE));
+  if (size == 0) {
+    klog_info("cma: disabilitato da command line");
+    return false;
+  }
+
+  u64 max_size = PAGE_ALIGN_DOWN((pmm->free_pages * PAGE_SIZE) / CMA_MAX_FRACTION);
+  if (size > max_size) {
+    klog_warn("cma: richiesti %lu MB, limitati a %lu MB", size / MB, max_size / MB);
+    size = max_size;
+  }
+
+  size_t page_count = size / PAGE_SIZE;
+  if (page_count == 0)
+    return false;
+
+  size_t meta_pages = PAGE_ALIGN_UP(page_count * sizeof(cma_page_t)) / PAGE_SIZE;
+  void *meta = pmm_alloc_pages(meta_pages);
+  if (!meta) {
+    klog_error("cma: impossibile allocare i descrittori");
+    return false;
+  }
+  pmm_set_owner(meta, meta_pages, PMM_OWNER_BOOT);
+
+  void *region = pmm_alloc_aligned(page_count, CMA_REGION_ALIGN);
+  if (!region)
+    region = pmm_alloc_pages(page_count);
+  if (!region) {
+    pmm_free_pages(meta, meta_pages);
+    klog_error("cma: impossibile riservare %lu MB contigui", size / MB);
+    return false;
+  }
+  pmm_set_owner(region, page_count, PMM_OWNER_CMA);
+
+  spinlock_lock(&cma_lock);
+
+  cma_state.base = (u64)region;
+  cma_state.end = (u64)region + size;
+  cma_state.meta_phys = (u64)meta;
+  cma_state.meta_pages = meta_pages;
+  cma_state.pages = (cma_page_t *)vmm_phys_to_virt((u64)meta);
+  cma_state.next_movable = 0;
+  memset(cma_state.pages, 0, meta_pages * PAGE_SIZE);
+
+  memset(&cma_stats, 0, sizeof(cma_stats));
+  cma_stats.base = cma_state.base;
+  cma_stats.total_pages = page_count;
+  cma_stats.free_pages = page_count;
+
+  cma_state.initialized = true;
+  spinlock_unlock(&cma_lock);
+
+  klog_info("cma: regione [0x%lx - 0x%lx] (%lu MB)", cma_state.base, cma_state.end, size / MB);
+  return true;
+}
+
+void *cma_alloc(size_t page_count, size_t align_pages) {
+  if (!cma_state.initialized || page_count == 0)
+    return NULL;
+
+  if (align_pages == 0)
+    align_pages = 1;
+  if (align_pages & (align_pages - 1)) {
+    klog_error("cma: allineamento %zu non potenza di 2", align_pages);
+    return NULL;
+  }
+
+  spinlock_lock(&cma_lock);
+
+  u64 total = cma_stats.total_pages;
+  u64 base_pfn = ADDR_TO_PAGE(cma_state.base);
+
+  // Primo giro: solo finestre libere; secondo giro: anche con pagine da migrare
+  for (int pass = 0; pass < 2; pass++) {
+    u64 start = 0;
+
+    while (start + page_count <= total) {
+      // Allinea l'indirizzo fisico, non l'indice nella regione
+      u64 pfn = base_pfn + start;
+      u64 aligned_pfn = (pfn + align_pages - 1) & ~(u64)(align_pages - 1);
+      start += aligned_pfn - pfn;
+      if (start + page_count > total)
+        break;
+
+      u64 skip;
+      if (!cma_window_usable_locked(start, page_count, pass == 1, &skip)) {
+        start = skip;
+        continue;
+      }
+
+      if (cma_claim_window_locked(start, page_count)) {
+        spinlock_unlock(&cma_lock);
+        klog_debug("cma: buffer di %zu pagine a 0x%lx", page_count, cma_phys(start));
+        return (void *)cma_phys(start);
+      }
+
+      start += align_pages;
+    }
+  }
+
+  cma_stats.alloc_failures++;
+  spinlock_unlock(&cma_lock);
+
+  klog_warn("cma: impossibile allocare %zu pagine contigue", page_count);
+  return NULL;
+}
+
+void cma_release(void *phys, size_t page_count) {
+  u64 addr = (u64)phys;
+
+  if (!cma_state.initialized || !IS_PAGE_ALIGNED(addr) || addr < cma_state.base || addr + page_count * PAGE_SIZE > cma_state.end) {
+    klog_error("cma: release non valido %p (%zu pagine)", phys, page_count);
+    return;
+  }
+
+  spinlock_lock(&cma_lock);
+
+  u64 start = cma_index(addr);
+  for (size_t i = 0; i < page_count; i++) {
+    if (cma_state.pages[start + i].state != CMA_PAGE_PINNED) {
+      klog_warn("cma: pagina 0x%lx non allocata con cma_alloc", cma_phys(start + i));
+      continue;
+    }
+    cma_set_free_locked(start + i);
+  }
+
+  spinlock_unlock(&cma_lock);
+}
+
+void *cma_alloc_movable(vmm_space_t *space, u64 virt_addr) {
+  if (!cma_state.initialized)
+    return NULL;
+
+  // Come Linux: si attinge alla regione solo quando contiene più della metà
+  // della memoria libera, così i buffer contigui raramente richiedono migrazioni
+  const pmm_stats_t *pmm = pmm_get_stats();
+  u64 pmm_free = pmm ? pmm->free_pages : 0;
+
+  spinlock_lock(&cma_lock);
+
+  if (cma_stats.free_pages == 0 || cma_stats.free_pages <= pmm_free) {
+    spinlock_unlock(&cma_lock);
+    return NULL;
+  }
+
+  u64 total = cma_stats.total_pages;
+  for (u64 n = 0; n < total; n++) {
+    u64 idx = (cma_state.next_movable + n) % total;
+    cma_page_t *page = &cma_state.pages[idx];
+
+    if (page->state != CMA_PAGE_FREE)
+      continue;
+
+    page->state = CMA_PAGE_MOVABLE;
+    page->space = space ? space : vmm_kernel_space();
+    page->virt_addr = PAGE_ALIGN_DOWN(virt_addr);
+    cma_stats.free_pages--;
+    cma_stats.movable_pages++;
+    cma_state.next_movable = idx + 1 < total ? idx + 1 : 0;
+
+    spinlock_unlock(&cma_lock);
+    return (void *)cma_phys(idx);
+  }
+
+  spinlock_unlock(&cma_lock);
+  return NULL;
+}
+
+bool cma_contains(u64 phys) {
+  return cma_state.initialized && phys >= cma_state.base && phys < cma_state.end;
+}
+
+bool cma_free_page(u64 phys) {
+  if (!cma_contains(phys) || !IS_PAGE_ALIGNED(phys))
+    return false;
+
+  spinlock_lock(&cma_lock);
+
+  u64 idx = cma_index(phys);
+  u8 state = cma_state.pages[idx].state;
+
+  if (state != CMA_PAGE_MOVABLE) {
+    spinlock_unlock(&cma_lock);
+    if (state == CMA_PAGE_PINNED)
+      klog_warn("cma: pmm_free_page su buffer contiguo 0x%lx (usare cma_release)", phys);
+    return false;
+  }
+
+  cma_set_free_locked(idx);
+  spinlock_unlock(&cma_lock);
+  return true;
+}
+
+const cma_stats_t *cma_get_stats(void) {
+  return &cma_stats;
+}
+
+void cma_print_stats(void) {
+  if (!cma_state.initialized) {
+    klog_info("cma: regione non attiva");
+    return;
+  }
+
+  spinlock_lock(&cma_lock);
+  cma_stats_t snap = cma_stats;
+  spinlock_unlock(&cma_lock);
+
+  klog_info("=== CMA STATISTICS ===");
+  klog_info("Regione: 0x%lx (%lu MB)", snap.base, snap.total_pages * PAGE_SIZE / MB);
+  klog_info("Libere: %lu, in prestito: %lu, contigue: %lu", snap.free_pages, snap.movable_pages, snap.pinned_pages);
+  klog_info("Migrazioni: %lu (fallite: %lu), allocazioni fallite: %lu", snap.migrations, snap.migration_failures, snap.alloc_failures);
+  klog_info("======================");
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/cma.h
+ * @brief Contiguous Memory Allocator - regione riservata per buffer grandi
+ *
+ * All'avvio viene riservata una regione fisicamente contigua (dimensione
+ * da command line: "cma=<size>", es. "cma=64M", "cma=0" per disabilitarla).
+ * La regione non resta inutilizzata: le allocazioni MOVABLE (pagine anonime
+ * popolate dal page fault handler) possono prenderne in prestito le pagine.
+ *
+ * Quando un driver richiede un buffer contiguo con cma_alloc(), le pagine
+ * prese in prestito nella finestra scelta vengono migrate altrove:
+ * copia del contenuto in un frame del PMM e sostituzione della PTE con
+ * vmm_replace_page(). Per questo ogni pagina in prestito registra il
+ * proprio proprietario (spazio, indirizzo virtuale).
+ *
+ * Le pagine condivise (COW, KSM, zero page) non sono migrabili e rendono
+ * la finestra non utilizzabile: cma_alloc() prova la finestra successiva.
+ */
+
+/*
+ * ============================================================================
+ * CONFIGURATION CONSTANTS
+ * ============================================================================
+ */
+
+#define CMA_DEFAULT_SIZE (16 * MB) // Dimensione se "cma=" è assente
+#define CMA_REGION_ALIGN (2 * MB)  // Allineamento della regione riservata
+#define CMA_MAX_FRACTION 4         // Al massimo 1/4 della memoria libera
+
+/*
+ * ============================================================================
+ * TYPES
+ * ============================================================================
+ */
+
+typedef struct {
+  u64 base;               /* Indirizzo fisico della regione */
+  u64 total_pages;        /* Pagine nella regione */
+  u64 free_pages;         /* Pagine libere */
+  u64 movable_pages;      /* Pagine prestate ad allocazioni movable */
+  u64 pinned_pages;       /* Pagine assegnate a buffer contigui */
+  u64 migrations;         /* Pagine migrate fuori dalla regione */
+  u64 migration_failures; /* Migrazioni fallite (pagina condivisa o cambiata) */
+  u64 alloc_failures;     /* cma_alloc() senza finestra utilizzabile */
+} cma_stats_t;
+
+/*
+ * ============================================================================
+ * PUBLIC API
+ * ============================================================================
+ */
+
+/**
+ * @brief Riserva la regione CMA leggendo "cma=" dalla command line
+ *
+ * Va chiamata subito dopo pmm_init(), quando la memoria non è frammentata.
+ *
+ * @return true se la regione è attiva
+ */
+bool cma_init(void);
+
+/**
+ * @brief Alloca un buffer fisicamente contiguo dalla regione CMA
+ *
+ * @param page_count Numero di pagine
+ * @param align_pages Allineamento in pagine (potenza di 2, 0/1 = nessuno)
+ * @return Indirizzo fisico del buffer, NULL se impossibile
+ */
+void *cma_alloc(size_t page_count, size_t align_pages);
+
+/**
+ * @brief Restituisce un buffer ottenuto con cma_alloc()
+ */
+void cma_release(void *phys, size_t page_count);
+
+/**
+ * @brief Presta una pagina CMA a un'allocazione movable
+ *
+ * Usata per le pagine anonime: il proprietario viene registrato per
+ * poterla migrare in seguito. Ritorna NULL se la regione deve restare
+ * libera (politica di bilanciamento con il PMM) o è esaurita.
+ *
+ * @param space Spazio che mapperà la pagina
+ * @param virt_addr Indirizzo virtuale della mappatura
+ * @return Indirizzo fisico della pagina, o NULL
+ */
+void *cma_alloc_movable(vmm_space_t *space, u64 virt_addr);
+
+/**
+ * @brief Verifica se un indirizzo fisico appartiene alla regione CMA
+ */
+bool cma_contains(u64 phys);
+
+/**
+ * @brief Libera una pagina movable della regione (chiamata da pmm_free_page)
+ *
+ * @return true se la pagina era in prestito ed è stata liberata
+ */
+bool cma_free_page(u64 phys);
+
+/**
+ * @brief Ottiene le statistiche della regione CMA
+ */
+const cma_stats_t *cma_get_stats(void);
+
+/**
+ * @brief Stampa lo stato della regione CMA
+ */
+void cma_print_stats(void);
@@ -0,0 +1,394 @@
+#include <arch/cpu.h>
+#include <klib/klog/klog.h>
+#include <klib/spinlock.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/cma.h>
+#include <mm/dma.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/dma.c
+ * @brief DMA mapping API - implementazione
+ *
+ * POOL COERENTE:
+ * Ogni classe di dimensione mantiene una free list singolarmente
+ * concatenata di blocchi; il link "next" è salvato nei primi 8 byte del
+ * blocco libero (accesso via direct map). Il fisico 0 è un blocco valido
+ * sotto qualsiasi maschera: il vuoto lo dice free_blocks e la lista
+ * termina con DMA_POOL_LIST_END. I chunk vengono presi dal PMM
+ * sotto la maschera del dispositivo solo all'inizializzazione o quando
+ * una classe si esaurisce, quindi il percorso comune non scansiona mai il
+ * bitmap del PMM.
+ */
+
+/*
+ * ============================================================================
+ * UTILITY
+ * ============================================================================
+ */
+
+static inline u64 *dma_block_link(u64 phys) {
+  return (u64 *)vmm_phys_to_virt(phys);
+}
+
+static inline bool dma_addr_ok(const dma_device_t *dev, u64 phys, size_t size) {
+  return phys + size - 1 <= dev->dma_mask;
+}
+
+/**
+ * @brief Ritorna la classe per una dimensione, -1 se oltre la pagina
+ */
+static int dma_size_class(size_t size) {
+  size_t block = 1UL << DMA_POOL_MIN_SHIFT;
+  for (int i = 0; i < DMA_POOL_CLASSES; i++, block <<= 1) {
+    if (size <= block)
+      return i;
+  }
+  return -1;
+}
+
+static inline size_t dma_class_size(int idx) {
+  return 1UL << (DMA_POOL_MIN_SHIFT + idx);
+}
+
+/**
+ * @brief Alloca pagine contigue raggiungibili dal dispositivo
+ */
+static u64 dma_alloc_pages(const dma_device_t *dev, size_t count) {
+  void *pages;
+
+  if (dev->dma_mask == DMA_BIT_MASK(64))
+    pages = pmm_alloc_pages(count);
+  else
+    pages = pmm_alloc_pages_in_range(count, 0, dev->dma_mask + 1);
+  pmm_set_owner(pages, count, PMM_OWNER_DMA);
+
+  // Buffer grandi: la regione CMA resta contigua anche con memoria frammentata
+  if (!pages && count > 1) {
+    pages = cma_alloc(count, 1);
+    if (pages && !dma_addr_ok(dev, (u64)pages, count * PAGE_SIZE)) {
+      cma_release(pages, count);
+      pages = NULL;
+    }
+  }
+
+  return (u64)pages;
+}
+
+static void dma_free_pages(u64 phys, size_t count) {
+  if (cma_contains(phys))
+    cma_release((void *)phys, count);
+  else
+    pmm_free_pages((void *)phys, count);
+}
+
+/**
+ * @brief Aggiunge un chunk a una classe del pool
+ *
+ * Assume dev->lock acquisito.
+ */
+static bool dma_pool_refill_locked(dma_device_t *dev, int idx) {
+  if (dev->chunk_count >= DMA_POOL_MAX_CHUNKS) {
+    klog_warn("dma: %s: limite chunk raggiunto", dev->name);
+    return false;
+  }
+
+  u64 chunk = dma_alloc_pages(dev, DMA_POOL_CHUNK_PAGES);
+  if (!chunk)
+    return false;
+
+  dev->chunks[dev->chunk_count++] = chunk;
+
+  dma_pool_class_t *cls = &dev->classes[idx];
+  size_t block = dma_class_size(idx);
+  size_t blocks = (DMA_POOL_CHUNK_PAGES * PAGE_SIZE) / block;
+
+  for (size_t i = 0; i < blocks; i++) {
+    u64 phys = chunk + i * block;
+    *dma_block_link(phys) = cls->free_head;
+    cls->free_head = phys;
+  }
+
+  cls->free_blocks += blocks;
+  cls->total_blocks += blocks;
+  return true;
+}
+
+/**
+ * @brief Traduce un buffer del kernel, verificando la contiguità fisica
+ */
+static bool dma_buffer_phys(void *ptr, size_t size, u64 *out_phys) {
+  u64 va = (u64)ptr;
+  u64 phys;
+
+  if (!vmm_resolve(NULL, va, &phys))
+    return false;
+
+  // Ogni pagina successiva deve seguire fisicamente la precedente
+  for (u64 page = PAGE_ALIGN_DOWN(va) + PAGE_SIZE; page < va + size; page += PAGE_SIZE) {
+    u64 next;
+    if (!vmm_resolve(NULL, page, &next) || next != phys + (page - va))
+      return false;
+  }
+
+  *out_phys = phys;
+  return true;
+}
+
+static dma_bounce_t *dma_find_bounce_locked(dma_device_t *dev, dma_addr_t addr) {
+  for (int i = 0; i < DMA_MAX_BOUNCE; i++) {
+    if (dev->bounce[i].in_use && dev->bounce[i].bounce == addr)
+      return &dev->bounce[i];
+  }
+  return (dma_bounce_t *)NULL;
+}
+
+/*
+ * ============================================================================
+ * DEVICE SETUP
+ * ============================================================================
+ */
+
+bool dma_device_init(dma_device_t *dev, const char *name, u64 dma_mask) {
+  if (!dev || dma_mask < PAGE_SIZE - 1) {
+    klog_error("dma: parametri dispositivo non validi");
+    return false;
+  }
+
+  memset(dev, 0, sizeof(*dev));
+  dev->name = name ? name : "dma";
+  dev->dma_mask = dma_mask;
+  spinlock_init(&dev->lock);
+  for (int i = 0; i < DMA_POOL_CLASSES; i++)
+    dev->classes[i].free_head = DMA_POOL_LIST_END;
+
+  spinlock_lock(&dev->lock);
+  for (int i = 0; i < DMA_POOL_CLASSES; i++) {
+    if (!dma_pool_refill_locked(dev, i)) {
+      spinlock_unlock(&dev->lock);
+      klog_error("dma: %s: impossibile pre-allocare il pool", dev->name);
+      dma_device_destroy(dev);
+      return false;
+    }
+  }
+  spinlock_unlock(&dev->lock);
+
+  klog_info("dma: %s: pool pronto (mask=0x%lx, %u KB)", dev->name, dev->dma_mask, dev->chunk_count * DMA_POOL_CHUNK_PAGES * PAGE_SIZE / 1024);
+  return true;
+}
+
+void dma_device_destroy(dma_device_t *dev) {
+  if (!dev)
+    return;
+
+  spinlock_lock(&dev->lock);
+
+  for (int i = 0; i < DMA_POOL_CLASSES; i++) {
+    if (dev->classes[i].free_blocks != dev->classes[i].total_blocks)
+      klog_warn("dma: %s: %u blocchi da %zu byte ancora allocati", dev->name, dev->classes[i].total_blocks - dev->classes[i].free_blocks, dma_class_size(i));
+  }
+
+  for (u32 i = 0; i < dev->chunk_count; i++)
+    dma_free_pages(dev->chunks[i], DMA_POOL_CHUNK_PAGES);
+
+  dev->chunk_count = 0;
+  memset(dev->classes, 0, sizeof(dev->classes));
+
+  spinlock_unlock(&dev->lock);
+}
+
+/*
+ * ============================================================================
+ * COHERENT MEMORY
+ * ============================================================================
+ */
+
+void *dma_alloc_coherent(dma_device_t *dev, size_t size, dma_addr_t *dma_handle) {
+  if (!dev || size == 0 || !dma_handle)
+    return NULL;
+
+  u64 phys;
+  int idx = dma_size_class(size);
+
+  if (idx < 0) {
+    // Oltre la pagina: allocazione diretta di pagine contigue
+    size_t pages = PAGE_ALIGN_UP(size) / PAGE_SIZE;
+    phys = dma_alloc_pages(dev, pages);
+    if (!phys) {
+      klog_error("dma: %s: allocazione coerente di %zu byte fallita", dev->name, size);
+      return NULL;
+    }
+    memset(vmm_phys_to_virt(phys), 0, pages * PAGE_SIZE);
+  } else {
+    spinlock_lock(&dev->lock);
+
+    dma_pool_class_t *cls = &dev->classes[idx];
+    if (cls->free_blocks == 0 && !dma_pool_refill_locked(dev, idx)) {
+      spinlock_unlock(&dev->lock);
+      klog_error("dma: %s: pool esaurito per %zu byte", dev->name, size);
+      return NULL;
+    }
+
+    // Pop O(1) dalla free list della classe
+    phys = cls->free_head;
+    cls->free_head = *dma_block_link(phys);
+    cls->free_blocks--;
+
+    spinlock_unlock(&dev->lock);
+
+    memset(vmm_phys_to_virt(phys), 0, dma_class_size(idx));
+  }
+
+  *dma_handle = phys;
+  return vmm_phys_to_virt(phys);
+}
+
+void dma_free_coherent(dma_device_t *dev, size_t size, void *vaddr, dma_addr_t dma_handle) {
+  if (!dev || !vaddr || size == 0)
+    return;
+
+  int idx = dma_size_class(size);
+
+  if (idx < 0) {
+    dma_free_pages(dma_handle, PAGE_ALIGN_UP(size) / PAGE_SIZE);
+    return;
+  }
+
+  spinlock_lock(&dev->lock);
+
+  // Push O(1) sulla free list della classe
+  dma_pool_class_t *cls = &dev->classes[idx];
+  *dma_block_link(dma_handle) = cls->free_head;
+  cls->free_head = dma_handle;
+  cls->free_blocks++;
+
+  spinlock_unlock(&dev->lock);
+}
+
+/*
+ * ============================================================================
+ * STREAMING MAPPINGS
+ * ============================================================================
+ */
+
+dma_addr_t dma_map_single(dma_device_t *dev, void *ptr, size_t size, dma_direction_t dir) {
+  if (!dev || !ptr || size == 0)
+    return DMA_ADDR_INVALID;
+
+  u64 phys;
+  if (dma_buffer_phys(ptr, size, &phys) && dma_addr_ok(dev, phys, size))
+    return phys; // Mapping diretto: nessuna copia (DMA coerente)
+
+  // Bounce buffer dal pool coerente del dispositivo
+  dma_addr_t bounce;
+  void *bounce_virt = dma_alloc_coherent(dev, size, &bounce);
+  if (!bounce_virt)
+    return DMA_ADDR_INVALID;
+
+  spinlock_lock(&dev->lock);
+
+  dma_bounce_t *slot = (dma_bounce_t *)NULL;
+  for (int i = 0; i < DMA_MAX_BOUNCE; i++) {
+    if (!dev->bounce[i].in_use) {
+      slot = &dev->bounce[i];
+      break;
+    }
+  }
+
+  if (!slot) {
+    spinlock_unlock(&dev->lock);
+    dma_free_coherent(dev, size, bounce_virt, bounce);
+    klog_error("dma: %s: troppi bounce buffer attivi", dev->name);
+    return DMA_ADDR_INVALID;
+  }
+
+  slot->orig = ptr;
+  slot->bounce = bounce;
+  slot->size = size;
+  slot->dir = dir;
+  slot->in_use = true;
+  dev->bounce_count++;
+
+  spinlock_unlock(&dev->lock);
+
+  if (dir != DMA_FROM_DEVICE)
+    memcpy(bounce_virt, ptr, size);
+
+  arch_cpu_memory_barrier();
+  return bounce;
+}
+
+void dma_unmap_single(dma_device_t *dev, dma_addr_t addr, size_t size, dma_direction_t dir) {
+  if (!dev || addr == DMA_ADDR_INVALID)
+    return;
+
+  spinlock_lock(&dev->lock);
+  dma_bounce_t *slot = dma_find_bounce_locked(dev, addr);
+  if (!slot) {
+    spinlock_unlock(&dev->lock);
+    return; // Mapping diretto: niente da fare
+  }
+
+  dma_bounce_t copy = *slot;
+  slot->in_use = false;
+  spinlock_unlock(&dev->lock);
+
+  if (copy.size != size)
+    klog_warn("dma: %s: unmap di %zu byte su mapping da %zu", dev->name, size, copy.size);
+
+  if (dir != DMA_TO_DEVICE)
+    memcpy(copy.orig, vmm_phys_to_virt(copy.bounce), copy.size);
+
+  dma_free_coherent(dev, copy.size, vmm_phys_to_virt(copy.bounce), copy.bounce);
+}
+
+int dma_map_sg(dma_device_t *dev, dma_sg_entry_t *sg, int nents, dma_direction_t dir) {
+  if (!dev || !sg || nents <= 0)
+    return 0;
+
+  for (int i = 0; i < nents; i++) {
+    sg[i].dma_address = dma_map_single(dev, sg[i].addr, sg[i].length, dir);
+    if (sg[i].dma_address == DMA_ADDR_INVALID) {
+      dma_unmap_sg(dev, sg, i, dir);
+      return 0;
+    }
+  }
+
+  return nents;
+}
+
+void dma_unmap_sg(dma_device_t *dev, dma_sg_entry_t *sg, int nents, dma_direction_t dir) {
+  if (!dev || !sg)
+    return;
+
+  for (int i = 0; i < nents; i++) {
+    dma_unmap_single(dev, sg[i].dma_address, sg[i].length, dir);
+    sg[i].dma_address = DMA_ADDR_INVALID;
+  }
+}
+
+void dma_sync_single_for_cpu(dma_device_t *dev, dma_addr_t addr, size_t size, dma_direction_t dir) {
+  if (!dev || dir == DMA_TO_DEVICE)
+    return;
+
+  spinlock_lock(&dev->lock);
+  dma_bounce_t *slot = dma_find_bounce_locked(dev, addr);
+  if (slot)
+    memcpy(slot->orig, vmm_phys_to_virt(slot->bounce), size < slot->size ? size : slot->size);
+  spinlock_unlock(&dev->lock);
+}
+
+void dma_sync_single_for_device(dma_device_t *dev, dma_addr_t addr, size_t size, dma_direction_t dir) {
+  if (!dev || dir == DMA_FROM_DEVICE)
+    return;
+
+  spinlock_lock(&dev->lock);
+  dma_bounce_t *slot = dma_find_bounce_locked(dev, addr);
+  if (slot)
+    memcpy(vmm_phys_to_virt(slot->bounce), slot->orig, size < slot->size ? size : slot->size);
+  spinlock_unlock(&dev->lock);
+
+  arch_cpu_memory_barrier();
+}
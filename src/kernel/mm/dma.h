@@ -0,0 +1,193 @@
+#pragma once
+
+#include <klib/spinlock.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/**
+ * @file mm/dma.h
+ * @brief DMA mapping API - memoria coerente e mapping streaming
+ *
+ * Fornisce ai driver memoria con indirizzo fisico noto e compatibile con
+ * la maschera DMA del dispositivo (es. 32 bit per dispositivi legacy).
+ * Senza IOMMU l'indirizzo DMA coincide con l'indirizzo fisico.
+ *
+ * MEMORIA COERENTE (dma_alloc_coherent):
+ * - Ogni dispositivo ha un pool pre-allocato, diviso in classi di
+ *   dimensione (32..4096 byte) ricavate da chunk sotto la maschera DMA
+ * - Allocazione e rilascio di blocchi piccoli (descrittori, ring) sono
+ *   O(1): pop/push su una free list per classe
+ * - Richieste più grandi di una pagina vanno al PMM (o alla regione CMA)
+ *
+ * MAPPING STREAMING (dma_map_single / dma_map_sg):
+ * - Buffer già esistenti del kernel vengono tradotti in indirizzi DMA
+ * - Se il buffer non è fisicamente contiguo o supera la maschera del
+ *   dispositivo, viene usato un bounce buffer dal pool coerente
+ * - Su x86_64 la DMA è cache-coherent: le sync copiano solo i bounce buffer
+ */
+
+/*
+ * ============================================================================
+ * CONFIGURATION CONSTANTS
+ * ============================================================================
+ */
+
+#define DMA_BIT_MASK(n) (((n) >= 64) ? ~0ULL : ((1ULL << (n)) - 1))
+
+#define DMA_POOL_MIN_SHIFT 5      // Classe più piccola: 32 byte
+#define DMA_POOL_CLASSES 8        // 32, 64, ..., 4096 byte
+#define DMA_POOL_CHUNK_PAGES 4    // Pagine per chunk di ogni classe
+#define DMA_POOL_MAX_CHUNKS 64    // Chunk massimi per dispositivo
+#define DMA_POOL_LIST_END (~0ULL) // Fine della free list: 0 è un fisico valido
+#define DMA_MAX_BOUNCE 32         // Bounce buffer attivi per dispositivo
+#define DMA_ADDR_INVALID (~0ULL)  // Errore di mapping
+
+/*
+ * ============================================================================
+ * TYPES
+ * ============================================================================
+ */
+
+typedef u64 dma_addr_t;
+
+/**
+ * @brief Direzione del trasferimento per i mapping streaming
+ */
+typedef enum {
+  DMA_BIDIRECTIONAL = 0,
+  DMA_TO_DEVICE,   /* CPU → dispositivo: copia nel bounce al map */
+  DMA_FROM_DEVICE, /* Dispositivo → CPU: copia dal bounce all'unmap */
+} dma_direction_t;
+
+/**
+ * @brief Elemento di una scatter-gather list
+ */
+typedef struct {
+  void *addr;             /* Indirizzo virtuale del segmento */
+  size_t length;          /* Lunghezza in byte */
+  dma_addr_t dma_address; /* Riempito da dma_map_sg() */
+} dma_sg_entry_t;
+
+/**
+ * @brief Classe di dimensione del pool coerente
+ */
+typedef struct {
+  u64 free_head;   /* Fisico del primo blocco libero (DMA_POOL_LIST_END = vuota) */
+  u32 free_blocks; /* Blocchi liberi: decide se la lista è vuota */
+  u32 total_blocks;
+} dma_pool_class_t;
+
+/**
+ * @brief Bounce buffer attivo di un mapping streaming
+ */
+typedef struct {
+  void *orig;         /* Buffer originale del chiamante */
+  dma_addr_t bounce;  /* Indirizzo DMA del bounce buffer */
+  size_t size;        /* Dimensione del mapping */
+  dma_direction_t dir;
+  bool in_use;
+} dma_bounce_t;
+
+/**
+ * @brief Dispositivo capace di DMA
+ *
+ * Struttura embedded nel driver; va inizializzata con dma_device_init().
+ */
+typedef struct {
+  const char *name;
+  u64 dma_mask; /* Indirizzo fisico massimo raggiungibile */
+  spinlock_t lock;
+  dma_pool_class_t classes[DMA_POOL_CLASSES];
+  u64 chunks[DMA_POOL_MAX_CHUNKS]; /* Chunk allocati (per il rilascio) */
+  u32 chunk_count;
+  dma_bounce_t bounce[DMA_MAX_BOUNCE];
+  u64 bounce_count; /* Statistica: mapping che hanno richiesto bounce */
+} dma_device_t;
+
+/*
+ * ============================================================================
+ * DEVICE SETUP
+ * ============================================================================
+ */
+
+/**
+ * @brief Inizializza un dispositivo e pre-alloca il suo pool coerente
+ *
+ * @param dev Dispositivo da inizializzare
+ * @param name Nome per i log
+ * @param dma_mask Maschera di indirizzamento (es. DMA_BIT_MASK(32))
+ * @return true se il pool è stato creato
+ */
+bool dma_device_init(dma_device_t *dev, const char *name, u64 dma_mask);
+
+/**
+ * @brief Rilascia il pool del dispositivo
+ *
+ * Tutte le allocazioni coerenti devono essere già state liberate.
+ */
+void dma_device_destroy(dma_device_t *dev);
+
+/*
+ * ============================================================================
+ * COHERENT MEMORY
+ * ============================================================================
+ */
+
+/**
+ * @brief Alloca memoria coerente per il dispositivo
+ *
+ * Il blocco è azzerato e allineato alla sua classe di dimensione.
+ *
+ * @param dev Dispositivo
+ * @param size Dimensione in byte
+ * @param dma_handle[out] Indirizzo DMA da programmare nel dispositivo
+ * @return Indirizzo virtuale del kernel, NULL su errore
+ */
+void *dma_alloc_coherent(dma_device_t *dev, size_t size, dma_addr_t *dma_handle);
+
+/**
+ * @brief Libera memoria ottenuta con dma_alloc_coherent()
+ *
+ * @param size Stessa dimensione passata all'allocazione
+ */
+void dma_free_coherent(dma_device_t *dev, size_t size, void *vaddr, dma_addr_t dma_handle);
+
+/*
+ * ============================================================================
+ * STREAMING MAPPINGS
+ * ============================================================================
+ */
+
+/**
+ * @brief Mappa un buffer del kernel per un singolo trasferimento
+ *
+ * @return Indirizzo DMA, DMA_ADDR_INVALID su errore
+ */
+dma_addr_t dma_map_single(dma_device_t *dev, void *ptr, size_t size, dma_direction_t dir);
+
+/**
+ * @brief Termina un mapping streaming (copia dal bounce se necessario)
+ */
+void dma_unmap_single(dma_device_t *dev, dma_addr_t addr, size_t size, dma_direction_t dir);
+
+/**
+ * @brief Mappa una scatter-gather list
+ *
+ * @return Numero di elementi mappati (nents) o 0 su errore
+ */
+int dma_map_sg(dma_device_t *dev, dma_sg_entry_t *sg, int nents, dma_direction_t dir);
+
+/**
+ * @brief Termina il mapping di una scatter-gather list
+ */
+void dma_unmap_sg(dma_device_t *dev, dma_sg_entry_t *sg, int nents, dma_direction_t dir);
+
+/**
+ * @brief Rende visibili alla CPU i dati scritti dal dispositivo
+ */
+void dma_sync_single_for_cpu(dma_device_t *dev, dma_addr_t addr, size_t size, dma_direction_t dir);
+
+/**
+ * @brief Rende visibili al dispositivo i dati scritti dalla CPU
+ */
+void dma_sync_single_for_device(dma_device_t *dev, dma_addr_t addr, size_t size, dma_direction_t dir);
@@ -8,25 +8,46 @@
 #include <lib/stdio/stdio.h>
 #include <lib/string/string.h>
 #include <mm/memory.h>
+#include <mm/memprof.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
 
 #define HEAP_SLAB_MAX_SIZE 2048
+#define HEAP_BUDDY_SIZE (32ULL * MB) // Area del buddy presa dal PMM al boot
+#define HEAP_BUDDY_MAX_FRACTION 4    // Al massimo 1/4 della memoria libera
 
 static buddy_allocator_t buddy;
 static u64 buddy_bitmap[(1 << 18) / 64];
 static bool heap_initialized = false;
 
 void heap_init(void) {
-  u64 base = 0, size = 0;
-  if (!memory_find_largest_region(&base, &size)) {
-    klog_panic("heap: nessuna regione valida trovata");
+  const pmm_stats_t *pmm = pmm_get_stats();
+  if (!pmm) {
+    klog_panic("heap: PMM non inizializzato");
     return;
   }
 
-  base = PAGE_ALIGN_UP(base);
-  size = PAGE_ALIGN_DOWN(size);
+  // L'area del buddy appartiene al PMM come le altre: va riservata, non
+  // scelta fra le regioni che il PMM considera libere
+  u64 size = HEAP_BUDDY_SIZE;
+  u64 max_size = PAGE_ALIGN_DOWN((pmm->free_pages * PAGE_SIZE) / HEAP_BUDDY_MAX_FRACTION);
+  u64 bitmap_size = (u64)sizeof(buddy_bitmap) * 8 * BUDDY_MIN_BLOCK_SIZE;
+  if (size > max_size)
+    size = max_size;
+  if (size > bitmap_size)
+    size = bitmap_size;
+
+  size_t page_count = size / PAGE_SIZE;
+  void *region = page_count ? pmm_alloc_aligned(page_count, BUDDY_MAX_BLOCK_SIZE) : NULL;
+  if (!region && page_count)
+    region = pmm_alloc_pages(page_count);
+  if (!region) {
+    klog_panic("heap: impossibile riservare %llu KB per il buddy", size / 1024);
+    return;
+  }
+  pmm_set_owner(region, page_count, PMM_OWNER_HEAP);
 
+  u64 base = (u64)region;
   if (!buddy_init(&buddy, base, size, buddy_bitmap, sizeof(buddy_bitmap) * 8)) {
     klog_panic("heap: inizializzazione buddy fallita");
     return;
@@ -38,26 +59,34 @@ void heap_init(void) {
   klog_info("heap: inizializzato su [%p - %p] (%llu KB)", (void *)base, (void *)(base + size), size / 1024);
 }
 
-void *kmalloc(size_t size) {
+/**
+ * @brief Allocazione effettiva; site è il chiamante da registrare in memprof
+ */
+static void *heap_alloc(size_t size, uptr site) {
   if (!heap_initialized || size == 0)
     return NULL;
 
+  void *ptr;
   if (size <= HEAP_SLAB_MAX_SIZE) {
     klog_debug("kmalloc(%lu): SLAB allocator", size);
-    return slab_alloc(size);
+    ptr = slab_alloc(size);
+  } else {
+    klog_debug("kmalloc(%lu): BUDDY allocator", size);
+    u64 phys = buddy_alloc(&buddy, size);
+    ptr = phys ? (void *)vmm_phys_to_virt(phys) : NULL;
   }
 
-  klog_debug("kmalloc(%lu): BUDDY allocator", size);
-  u64 phys = buddy_alloc(&buddy, size);
-  if (!phys)
-    return NULL;
+  memprof_alloc(ptr, size, MEMPROF_KMALLOC, site);
+  return ptr;
+}
 
-  return (void *)vmm_phys_to_virt(phys);
+void *kmalloc(size_t size) {
+  return heap_alloc(size, ftrace_return_address());
 }
 
 void *kcalloc(size_t nmemb, size_t size) {
   size_t total = nmemb * size;
-  void *ptr = kmalloc(total);
+  void *ptr = heap_alloc(total, ftrace_return_address());
   if (ptr)
     memset(ptr, 0, total);
   return ptr;
@@ -67,13 +96,11 @@ void kfree(void *ptr) {
   if (!heap_initialized || !ptr)
     return;
 
-  if (SLAB_PTR_VALID(ptr)) {
-    slab_cache_t *cache = slab_find_cache_for_ptr(ptr);
-    if (cache) {
-      slab_cache_free(cache, ptr);
-      return;
-    }
-  }
+  // Unico gancio della liberazione: slab_free() non lo ripete
+  memprof_free(ptr);
+
+  if (SLAB_PTR_VALID(ptr) && slab_free(ptr))
+    return;
 
   u64 phys = vmm_virt_to_phys((u64)ptr);
   buddy_free(&buddy, phys);
@@ -24,7 +24,9 @@
 /**
  * @brief Inizializza il sistema heap del kernel
  *
- * Inizializza slab allocator e buddy allocator.
+ * Inizializza slab allocator e buddy allocator. L'area del buddy
+ * (32MB, al più 1/4 della memoria libera) è allocata dal PMM e
+ * conteggiata come PMM_OWNER_HEAP.
  * Richiede che PMM, VMM e logging siano già inizializzati.
  */
 void heap_init(void);
@@ -1,17 +1,24 @@
 #include "slab.h"
 #include "heap.h"
 #include <klib/klog/klog.h>
+#include <klib/lat_hist/lat_hist.h>
 #include <klib/list/list.h>
+#include <lib/cache.h>
 #include <lib/stdio/stdio.h>
 #include <lib/string/string.h>
+#include <mm/memprof.h>
 #include <mm/pmm.h>
 
 #define list_first_entry(head, type, member) LIST_ENTRY((head)->next, type, member)
 #define list_insert_tail(head, node) list_insert_before((head), (node))
 
-// Esposti anche per altri moduli (heap.c)
-slab_cache_t slab_caches[SLAB_MAX_CACHES];
-u32 slab_cache_count = 0;
+// Esposti anche per altri moduli (heap.c). Ogni cache (lock e contatori)
+// occupa linee proprie; il numero di cache cambia solo alla creazione
+slab_cache_t slab_caches[SLAB_MAX_CACHES] __cacheline_aligned;
+u32 slab_cache_count __read_mostly = 0;
+
+// Latenza delle allocazioni, anche quelle di kmalloc ("lat_hist=lat_slab_alloc")
+DEFINE_LAT_HIST(lat_slab_alloc);
 
 void slab_init(void) {
   memset(slab_caches, 0, sizeof(slab_caches));
@@ -38,18 +45,29 @@ slab_cache_t *slab_find_cache_for_size(size_t size) {
   return (slab_cache_t *)NULL;
 }
 
+static void *slab_cache_alloc_object(slab_cache_t *cache);
+static void slab_cache_free_object(slab_cache_t *cache, void *ptr);
+
+// Usata da kmalloc, che registra in memprof il proprio chiamante: qui niente
+// gancio, altrimenti l'oggetto sarebbe contato due volte
 void *slab_alloc(size_t size) {
   slab_cache_t *cache = slab_find_cache_for_size(size);
   if (!cache)
     return NULL;
-  return slab_cache_alloc(cache);
+
+  u64 lat = lat_hist_start(lat_slab_alloc);
+  void *obj = slab_cache_alloc_object(cache);
+  lat_hist_stop(lat_slab_alloc, lat);
+  return obj;
 }
 
-void slab_free(void *ptr) {
+// Usata da kfree, che ha già tolto l'oggetto da memprof: stesso motivo
+bool slab_free(void *ptr) {
   slab_cache_t *cache = slab_find_cache_for_ptr(ptr);
   if (!cache)
-    return;
-  slab_cache_free(cache, ptr);
+    return false;
+  slab_cache_free_object(cache, ptr);
+  return true;
 }
 
 slab_cache_t *slab_find_cache_for_ptr(void *ptr) {
@@ -91,10 +109,12 @@ slab_cache_t *slab_cache_create(const char *name, size_t object_size, size_t ali
   list_init(&cache->partial_slabs);
   list_init(&cache->empty_slabs);
   spinlock_init(&cache->lock);
+  percpu_counter_init(&cache->alloc_count, 0, 0);
+  percpu_counter_init(&cache->free_count, 0, 0);
   return cache;
 }
 
-void *slab_cache_alloc(slab_cache_t *cache) {
+static void *slab_cache_alloc_object(slab_cache_t *cache) {
   spinlock_lock(&cache->lock);
 
   slab_t *slab = (slab_t *)NULL;
@@ -110,6 +130,7 @@ void *slab_cache_alloc(slab_cache_t *cache) {
       spinlock_unlock(&cache->lock);
       return NULL;
     }
+    pmm_set_owner(page, 1, PMM_OWNER_SLAB);
 
     slab = (slab_t *)page;
     memset(slab, 0, sizeof(slab_t));
@@ -136,7 +157,7 @@ void *slab_cache_alloc(slab_cache_t *cache) {
   slab->free_list = obj->next_free;
   slab->free_objects--;
   cache->allocated_objects++;
-  cache->alloc_count++;
+  percpu_counter_inc(&cache->alloc_count);
 
   if (slab->free_objects == 0) {
     list_remove(&slab->node);
@@ -147,10 +168,24 @@ void *slab_cache_alloc(slab_cache_t *cache) {
   return (void *)obj;
 }
 
+void *slab_cache_alloc(slab_cache_t *cache) {
+  u64 lat = lat_hist_start(lat_slab_alloc);
+  void *obj = slab_cache_alloc_object(cache);
+  lat_hist_stop(lat_slab_alloc, lat);
+
+  memprof_alloc(obj, cache->object_size, MEMPROF_SLAB, ftrace_return_address());
+  return obj;
+}
+
 void slab_cache_free(slab_cache_t *cache, void *ptr) {
   if (!cache || !ptr)
     return;
 
+  memprof_free(ptr);
+  slab_cache_free_object(cache, ptr);
+}
+
+static void slab_cache_free_object(slab_cache_t *cache, void *ptr) {
   spinlock_lock(&cache->lock);
 
   slab_t *slab = (slab_t *)PAGE_ALIGN_DOWN((u64)ptr);
@@ -164,7 +199,7 @@ void slab_cache_free(slab_cache_t *cache, void *ptr) {
   slab->free_list = obj;
   slab->free_objects++;
   cache->allocated_objects--;
-  cache->free_count++;
+  percpu_counter_inc(&cache->free_count);
 
   list_remove(&slab->node);
 
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <klib/list/list.h>
+#include <klib/percpu_counter/percpu_counter.h>
 #include <klib/spinlock.h>
+#include <lib/cache.h>
 #include <lib/types.h>
 
 /**
@@ -78,24 +80,24 @@ typedef void (*slab_dtor_t)(void *object, size_t size);
  * @brief Cache per oggetti di dimensione fissa
  */
 struct slab_cache {
-  char name[32];             /* Nome della cache (debug) */
-  size_t object_size;        /* Dimensione oggetti */
-  size_t align;              /* Allineamento */
-  slab_ctor_t ctor;          /* Costruttore (opzionale) */
-  slab_dtor_t dtor;          /* Distruttore (opzionale) */
-  list_node_t full_slabs;    /* Slab completamente piene */
-  list_node_t partial_slabs; /* Slab parzialmente piene */
-  list_node_t empty_slabs;   /* Slab vuote */
-  u32 total_slabs;           /* Slab totali */
-  u32 total_objects;         /* Oggetti totali */
-  u32 allocated_objects;     /* Oggetti attualmente allocati */
-  u64 alloc_count;           /* Numero allocazioni */
-  u64 free_count;            /* Numero deallocazioni */
-  u32 color_offset;          /* Offset corrente (cache coloring) */
-  u32 color_range;           /* Range colori disponibili */
-  spinlock_t lock;           /* Lock della cache */
-  u32 magic;                 /* Magic per validazione */
-};
+  char name[32];                /* Nome della cache (debug) */
+  size_t object_size;           /* Dimensione oggetti */
+  size_t align;                 /* Allineamento */
+  slab_ctor_t ctor;             /* Costruttore (opzionale) */
+  slab_dtor_t dtor;             /* Distruttore (opzionale) */
+  list_node_t full_slabs;       /* Slab completamente piene */
+  list_node_t partial_slabs;    /* Slab parzialmente piene */
+  list_node_t empty_slabs;      /* Slab vuote */
+  u32 total_slabs;              /* Slab totali */
+  u32 total_objects;            /* Oggetti totali */
+  u32 allocated_objects;        /* Oggetti attualmente allocati */
+  percpu_counter_t alloc_count; /* Numero allocazioni (per-CPU) */
+  percpu_counter_t free_count;  /* Numero deallocazioni (per-CPU) */
+  u32 color_offset;             /* Offset corrente (cache coloring) */
+  u32 color_range;              /* Range colori disponibili */
+  spinlock_t lock;              /* Lock della cache */
+  u32 magic;                    /* Magic per validazione */
+} ____cacheline_aligned;
 
 /**
  * @brief Statistiche globali del sistema slab
@@ -118,7 +120,7 @@ typedef struct {
 
 void slab_init(void);
 void *slab_alloc(size_t size);
-void slab_free(void *ptr);
+bool slab_free(void *ptr); // false se ptr non appartiene a una cache
 
 /* ==========================================================================
  * CACHE MANAGEMENT API
@@ -0,0 +1,799 @@
+#include <arch/cpu.h>
+#include <klib/hash/hash.h>
+#include <klib/hashtable/hashtable.h>
+#include <klib/klog/klog.h>
+#include <klib/list/list.h>
+#include <klib/rbtree/rbtree.h>
+#include <klib/spinlock.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/heap/heap.h>
+#include <mm/ksm.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/ksm.c
+ * @brief Kernel Samepage Merging - implementazione dello scanner
+ *
+ * Strutture principali:
+ * - ksm_range_t: range registrato, contiene un array di rmap item
+ * - ksm_rmap_item_t: stato per singola pagina virtuale (checksum, link)
+ * - ksm_stable_node_t: frame condiviso read-only con la lista dei mapping
+ *
+ * Gli alberi sono red-black tree (klib/rbtree) ordinati per
+ * (checksum, memcmp). L'albero instabile non supporta rimozione: viene
+ * scartato a ogni giro completo incrementando unstable_seq, così gli item di
+ * giri precedenti risultano automaticamente "fuori albero".
+ *
+ * LOCKING:
+ * ksm_lock protegge solo le strutture di KSM (range, cursore, albero
+ * stabile, mapping dei nodi) e non resta mai preso attorno a chiamate a
+ * VMM, PMM o heap. Il resto si regge su tre regole:
+ * - un solo scanner alla volta (ksm_state.scanning): albero instabile,
+ *   checksum e cursore degli item sono suoi; ksm_unregister_space()
+ *   aspetta la fine del passaggio prima di liberare i range
+ * - un nodo stabile usato fuori lock dallo scanner ha un pin: il COW break
+ *   dell'ultimo mapping non lo libera finché il pin resta
+ * - il frame di una pagina in corso di merge è "reclamato" (ksm_claim_t):
+ *   un COW break nella finestra fra write-protect e sostituzione lo segna,
+ *   e lo scanner libera il frame rimasto senza mapping
+ */
+
+/*
+ * ============================================================================
+ * STRUTTURE DATI INTERNE
+ * ============================================================================
+ */
+
+typedef struct ksm_stable_node {
+  rb_node_t rb;                      // Albero stabile
+  ht_node_t hnode;                   // Indice pfn → nodo
+  list_node_t mappings;              // rmap item che mappano questo frame
+  u64 phys;                          // Frame condiviso (read-only)
+  u32 checksum;                      // CRC32C del contenuto
+  u32 mapcount;                      // Numero di mapping attivi
+  u32 pins;                          // Riferimenti dello scanner fuori lock
+  bool in_tree;                      // Collegato all'albero stabile
+} ksm_stable_node_t;
+
+struct ksm_range;
+
+typedef struct ksm_rmap_item {
+  rb_node_t rb;               // Albero instabile
+  list_node_t stable_link;    // Link in ksm_stable_node_t.mappings
+  struct ksm_range *range;    // Range di appartenenza (space)
+  ksm_stable_node_t *stable;  // Nodo stabile se la pagina è fusa
+  u64 virt_addr;              // Indirizzo della pagina
+  u32 checksum;               // Checksum all'ultima scansione
+  u32 unstable_seq;           // Giro in cui è stato inserito nell'albero instabile
+  bool checksum_valid;        // false finché la pagina non è stata vista
+} ksm_rmap_item_t;
+
+typedef struct ksm_range {
+  list_node_t link;
+  vmm_space_t *space;
+  u64 virt_addr;
+  size_t page_count;
+  ksm_rmap_item_t *items;
+} ksm_range_t;
+
+/**
+ * @brief Frame di una pagina fra write-protect e sostituzione della PTE
+ */
+typedef struct {
+  u64 phys;    // 0 = nessun merge in corso
+  bool broken; // COW break nella finestra: il frame non ha più mapping
+} ksm_claim_t;
+
+/*
+ * ============================================================================
+ * STATO GLOBALE
+ * ============================================================================
+ */
+
+static spinlock_t ksm_lock = SPINLOCK_INITIALIZER;
+
+static struct {
+  bool initialized;
+  list_node_t ranges;                                      // Lista di ksm_range_t
+  rb_root_t stable_root;                                   // Albero stabile
+  hashtable_t stable_index;                                // pfn → nodo
+  rb_root_t unstable_root;                                 // Albero instabile
+  u32 unstable_seq;                                        // Giro corrente (0 = mai)
+  ksm_range_t *cursor_range;                               // Cursore dello scanner
+  size_t cursor_index;
+  u32 pages_per_pass;
+  u64 cycle_budget;
+  bool scanning;                                           // Passaggio dello scanner in corso
+  ksm_claim_t claim;                                       // Merge in corso (uno solo: scanner unico)
+} ksm_state;
+
+static ksm_stats_t ksm_stats;
+
+/*
+ * ============================================================================
+ * UTILITY
+ * ============================================================================
+ */
+
+static inline const void *ksm_page_ptr(u64 phys) {
+  return (const void *)vmm_phys_to_virt(phys);
+}
+
+static inline u32 ksm_page_checksum(u64 phys) {
+  return arch_crc32c(0, ksm_page_ptr(phys), PAGE_SIZE);
+}
+
+/**
+ * @brief Confronta due pagine per l'ordinamento negli alberi
+ *
+ * Il checksum discrimina quasi sempre; memcmp risolve le collisioni.
+ */
+static int ksm_page_compare(u32 crc_a, u64 phys_a, u32 crc_b, u64 phys_b) {
+  if (crc_a != crc_b)
+    return crc_a < crc_b ? -1 : 1;
+  return memcmp(ksm_page_ptr(phys_a), ksm_page_ptr(phys_b), PAGE_SIZE);
+}
+
+static inline u64 ksm_readonly_flags(u64 flags) {
+  // Il frame condiviso non appartiene più a un solo spazio: niente ANON
+  return (flags & ~(u64)(VMM_FLAG_WRITE | VMM_FLAG_ANON)) | VMM_FLAG_COW;
+}
+
+static u64 ksm_phys_hash(const void *key, u64 seed) {
+  return hash_u64(*(const u64 *)key >> 12, seed);
+}
+
+static bool ksm_phys_eq(const ht_node_t *node, const void *key) {
+  return HT_ENTRY(node, ksm_stable_node_t, hnode)->phys == *(const u64 *)key;
+}
+
+/*
+ * ============================================================================
+ * ALBERO STABILE
+ * ============================================================================
+ */
+
+static ksm_stable_node_t *stable_tree_search(u32 checksum, u64 phys) {
+  rb_node_t *it = ksm_state.stable_root.node;
+
+  while (it) {
+    ksm_stable_node_t *node = RB_ENTRY(it, ksm_stable_node_t, rb);
+    int cmp = ksm_page_compare(checksum, phys, node->checksum, node->phys);
+    if (cmp == 0)
+      return node;
+    it = cmp < 0 ? it->left : it->right;
+  }
+
+  return (ksm_stable_node_t *)NULL;
+}
+
+static void stable_tree_insert(ksm_stable_node_t *new_node) {
+  rb_node_t **link = &ksm_state.stable_root.node;
+  rb_node_t *parent = (rb_node_t *)NULL;
+
+  while (*link) {
+    parent = *link;
+    ksm_stable_node_t *node = RB_ENTRY(parent, ksm_stable_node_t, rb);
+    int cmp = ksm_page_compare(new_node->checksum, new_node->phys, node->checksum, node->phys);
+    link = cmp < 0 ? &parent->left : &parent->right;
+  }
+
+  rb_link_node(&new_node->rb, parent, link);
+  rb_insert_color(&ksm_state.stable_root, &new_node->rb, NULL);
+  new_node->in_tree = true;
+}
+
+/**
+ * @brief Stacca un nodo da albero e indice (con ksm_lock preso)
+ *
+ * Frame e nodo vanno liberati dal chiamante dopo aver rilasciato il lock.
+ */
+static void stable_tree_erase(ksm_stable_node_t *node) {
+  if (node->in_tree)
+    rb_erase(&ksm_state.stable_root, &node->rb, NULL);
+  node->in_tree = false;
+
+  hashtable_remove_node(&ksm_state.stable_index, &node->hnode);
+}
+
+static ksm_stable_node_t *stable_hash_lookup(u64 phys) {
+  ht_node_t *hnode = hashtable_lookup(&ksm_state.stable_index, &phys);
+  return hnode ? HT_ENTRY(hnode, ksm_stable_node_t, hnode) : (ksm_stable_node_t *)NULL;
+}
+
+/*
+ * pages_sharing vale la somma di (mapcount - 1) sui nodi con almeno un
+ * mapping: il primo mapping è il frame stesso, non un risparmio. Ogni
+ * variazione di mapcount (qui e in ksm_page_unshare) la mantiene, così un
+ * merge fallito o un COW break nella finestra non lasciano derive.
+ */
+static void stable_node_add_mapping(ksm_stable_node_t *node, ksm_rmap_item_t *item) {
+  list_insert_before(&node->mappings, &item->stable_link);
+  item->stable = node;
+  if (node->mapcount++ > 0)
+    ksm_stats.pages_sharing++;
+}
+
+static void stable_node_del_mapping(ksm_stable_node_t *node, ksm_rmap_item_t *item) {
+  list_remove(&item->stable_link);
+  item->stable = (ksm_stable_node_t *)NULL;
+  if (--node->mapcount > 0 && ksm_stats.pages_sharing > 0)
+    ksm_stats.pages_sharing--;
+}
+
+/**
+ * @brief Rilascia il pin dello scanner (con ksm_lock preso)
+ *
+ * @return true se il nodo è rimasto senza mapping: staccato, il chiamante
+ *         libera frame e nodo fuori lock
+ */
+static bool stable_node_unpin(ksm_stable_node_t *node) {
+  node->pins--;
+  if (node->mapcount || node->pins)
+    return false;
+
+  stable_tree_erase(node);
+  ksm_stats.pages_shared--;
+  return true;
+}
+
+static void stable_node_free(ksm_stable_node_t *node) {
+  pmm_free_page((void *)node->phys);
+  kfree(node);
+}
+
+/*
+ * ============================================================================
+ * ALBERO INSTABILE
+ * ============================================================================
+ */
+
+/**
+ * @brief Cerca un candidato identico o inserisce l'item nell'albero
+ *
+ * @param out_phys Frame attuale del candidato trovato
+ * @return Item identico già presente, NULL se l'item è stato inserito
+ */
+static ksm_rmap_item_t *unstable_tree_search_insert(ksm_rmap_item_t *item, u64 phys, u64 *out_phys) {
+  rb_node_t **link = &ksm_state.unstable_root.node;
+  rb_node_t *parent = (rb_node_t *)NULL;
+
+  while (*link) {
+    parent = *link;
+    ksm_rmap_item_t *tree_item = RB_ENTRY(parent, ksm_rmap_item_t, rb);
+    u64 tree_phys;
+
+    // Il candidato nell'albero potrebbe essere stato smappato nel frattempo
+    if (!vmm_query(tree_item->range->space, tree_item->virt_addr, &tree_phys, NULL))
+      return (ksm_rmap_item_t *)NULL;
+
+    if (tree_phys == phys)
+      return (ksm_rmap_item_t *)NULL; // Stesso frame (alias): niente da fondere
+
+    int cmp = ksm_page_compare(item->checksum, phys, tree_item->checksum, tree_phys);
+    if (cmp == 0) {
+      *out_phys = tree_phys;
+      return tree_item;
+    }
+    link = cmp < 0 ? &parent->left : &parent->right;
+  }
+
+  item->unstable_seq = ksm_state.unstable_seq;
+  rb_link_node(&item->rb, parent, link);
+  rb_insert_color(&ksm_state.unstable_root, &item->rb, NULL);
+  return (ksm_rmap_item_t *)NULL;
+}
+
+/*
+ * ============================================================================
+ * MERGE
+ * ============================================================================
+ */
+
+/**
+ * @brief Reclama il frame di item prima del write-protect (con ksm_lock preso)
+ */
+static inline void ksm_claim_begin(u64 phys) {
+  ksm_state.claim.phys = phys;
+  ksm_state.claim.broken = false;
+}
+
+/**
+ * @brief Chiude la finestra di merge (con ksm_lock preso)
+ *
+ * @return true se un COW break ha lasciato il frame senza mapping
+ */
+static inline bool ksm_claim_end(void) {
+  bool broken = ksm_state.claim.broken;
+  ksm_state.claim.phys = 0;
+  ksm_state.claim.broken = false;
+  return broken;
+}
+
+/**
+ * @brief Rende read-only una pagina, verifica che coincida con target e la rimappa
+ *
+ * Se il contenuto differisce ripristina i flag originali. Senza ksm_lock.
+ */
+static bool ksm_protect_and_replace(ksm_rmap_item_t *item, u64 phys, u64 flags, u64 target_phys) {
+  vmm_space_t *space = item->range->space;
+
+  if (!vmm_protect(space, item->virt_addr, 1, ksm_readonly_flags(flags)))
+    return false;
+
+  // Da qui il contenuto non può più cambiare senza passare dal fault handler
+  if (memcmp(ksm_page_ptr(phys), ksm_page_ptr(target_phys), PAGE_SIZE) != 0 || !vmm_replace_page(space, item->virt_addr, phys, target_phys, ksm_readonly_flags(flags))) {
+    vmm_protect(space, item->virt_addr, 1, flags);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Fonde la pagina dell'item in un nodo stabile esistente
+ *
+ * Il chiamante ha preso un pin sul nodo; viene rilasciato qui. Il mapping
+ * è contato prima della sostituzione: un COW break subito dopo la trova.
+ */
+static bool ksm_merge_with_stable(ksm_rmap_item_t *item, u64 phys, u64 flags, ksm_stable_node_t *node) {
+  spinlock_lock(&ksm_lock);
+  ksm_claim_begin(phys);
+  stable_node_add_mapping(node, item);
+  spinlock_unlock(&ksm_lock);
+
+  bool merged = ksm_protect_and_replace(item, phys, flags, node->phys);
+
+  spinlock_lock(&ksm_lock);
+  bool orphan = ksm_claim_end();
+  if (!merged) {
+    if (item->stable == node)
+      stable_node_del_mapping(node, item);
+    ksm_stats.merge_failures++;
+  }
+  bool release = stable_node_unpin(node);
+  spinlock_unlock(&ksm_lock);
+
+  // Fusa: il duplicato torna al PMM. Rotta da un COW break: non ha più mapping
+  if (merged || orphan)
+    pmm_free_page((void *)phys);
+  if (release)
+    stable_node_free(node);
+  return merged;
+}
+
+/**
+ * @brief Fonde due pagine trovate nell'albero instabile in un nuovo nodo stabile
+ *
+ * Il frame dell'item già nell'albero diventa il frame condiviso. Il nodo è
+ * nell'indice, con i due mapping, prima di rendere read-only qualsiasi
+ * pagina: ogni COW break della finestra passa da ksm_page_unshare().
+ */
+static bool ksm_merge_with_unstable(ksm_rmap_item_t *item, u64 phys, u64 flags, ksm_rmap_item_t *tree_item, u64 tree_phys) {
+  vmm_space_t *tree_space = tree_item->range->space;
+  u64 tree_flags;
+  if (!vmm_query(tree_space, tree_item->virt_addr, NULL, &tree_flags))
+    return false;
+
+  ksm_stable_node_t *node = (ksm_stable_node_t *)kmalloc(sizeof(ksm_stable_node_t));
+  if (!node)
+    return false;
+
+  memset(node, 0, sizeof(*node));
+  list_init(&node->mappings);
+  node->phys = tree_phys;
+  node->checksum = item->checksum;
+  node->pins = 1;
+  if (!hashtable_insert(&ksm_state.stable_index, &node->hnode, &node->phys)) {
+    kfree(node);
+    return false;
+  }
+
+  spinlock_lock(&ksm_lock);
+  ksm_claim_begin(phys);
+  stable_node_add_mapping(node, tree_item);
+  stable_node_add_mapping(node, item);
+  ksm_stats.pages_shared++;
+  spinlock_unlock(&ksm_lock);
+
+  // Il frame condiviso deve essere read-only prima di poterlo confrontare
+  bool tree_protected = vmm_protect(tree_space, tree_item->virt_addr, 1, ksm_readonly_flags(tree_flags));
+  bool merged = tree_protected && ksm_protect_and_replace(item, phys, flags, tree_phys);
+
+  // Flag ripristinati prima di staccare il nodo: da qui niente più COW break
+  if (!merged && tree_protected)
+    vmm_protect(tree_space, tree_item->virt_addr, 1, tree_flags);
+
+  spinlock_lock(&ksm_lock);
+  bool orphan = ksm_claim_end();
+  bool tree_orphan = false;
+  bool release = false;
+  if (merged) {
+    stable_tree_insert(node);
+    release = stable_node_unpin(node);
+  } else {
+    if (item->stable == node)
+      stable_node_del_mapping(node, item);
+    // Senza il mapping dell'albero il frame è rimasto orfano di un COW break
+    if (tree_item->stable == node)
+      stable_node_del_mapping(node, tree_item);
+    else
+      tree_orphan = true;
+    stable_tree_erase(node);
+    ksm_stats.pages_shared--;
+    ksm_stats.merge_failures++;
+  }
+  spinlock_unlock(&ksm_lock);
+
+  if (merged || orphan)
+    pmm_free_page((void *)phys);
+  if (release)
+    stable_node_free(node);
+  else if (!merged) {
+    if (tree_orphan)
+      pmm_free_page((void *)tree_phys);
+    kfree(node);
+  }
+  return merged;
+}
+
+/**
+ * @brief Cerca nell'albero stabile e prende un pin sul nodo trovato
+ */
+static ksm_stable_node_t *stable_tree_search_pin(u32 checksum, u64 phys) {
+  spinlock_lock(&ksm_lock);
+  ksm_stable_node_t *node = stable_tree_search(checksum, phys);
+  if (node)
+    node->pins++;
+  spinlock_unlock(&ksm_lock);
+  return node;
+}
+
+/**
+ * @brief Elabora una singola pagina candidata (scanner, senza ksm_lock)
+ *
+ * @return true se un frame è stato liberato
+ */
+static bool ksm_scan_item(ksm_rmap_item_t *item) {
+  u64 phys, flags;
+
+  ksm_stats.pages_scanned++;
+
+  if (__atomic_load_n(&item->stable, __ATOMIC_RELAXED))
+    return false; // Già fusa: resta tale fino al COW break
+
+  if (!vmm_query(item->range->space, item->virt_addr, &phys, &flags))
+    return false; // Pagina non ancora popolata
+
+  if (flags & VMM_FLAG_COW)
+    return false; // Frame condiviso da altri (es. zero page): non è anonimo privato
+
+  if (flags & VMM_FLAG_PINNED)
+    return false; // Frame fissato (es. DMA): non deve cambiare
+
+  u32 checksum = ksm_page_checksum(phys);
+
+  // 1. Albero stabile: il contenuto coincide con un frame già condiviso?
+  ksm_stable_node_t *node = stable_tree_search_pin(checksum, phys);
+  if (node) {
+    item->checksum = checksum;
+    item->checksum_valid = true;
+    return ksm_merge_with_stable(item, phys, flags, node);
+  }
+
+  // 2. Pagine volatili: candidate solo se stabili tra due scansioni
+  if (!item->checksum_valid || item->checksum != checksum) {
+    item->checksum = checksum;
+    item->checksum_valid = true;
+    ksm_stats.pages_volatile++;
+    return false;
+  }
+
+  if (item->unstable_seq == ksm_state.unstable_seq)
+    return false; // Già inserita nell'albero instabile in questo giro
+
+  // 3. Albero instabile: cerca un gemello oppure inserisce la pagina
+  u64 tree_phys = 0;
+  ksm_rmap_item_t *tree_item = unstable_tree_search_insert(item, phys, &tree_phys);
+  if (!tree_item) {
+    ksm_stats.pages_unshared++;
+    return false;
+  }
+
+  // Il gemello potrebbe essere già stato fuso nel frattempo
+  spinlock_lock(&ksm_lock);
+  node = tree_item->stable;
+  if (node)
+    node->pins++;
+  spinlock_unlock(&ksm_lock);
+  if (node)
+    return ksm_merge_with_stable(item, phys, flags, node);
+
+  return ksm_merge_with_unstable(item, phys, flags, tree_item, tree_phys);
+}
+
+/**
+ * @brief Avanza il cursore dello scanner, ritorna il prossimo item
+ */
+static ksm_rmap_item_t *ksm_next_item(void) {
+  if (list_is_empty(&ksm_state.ranges))
+    return (ksm_rmap_item_t *)NULL;
+
+  if (!ksm_state.cursor_range) {
+    ksm_state.cursor_range = LIST_ENTRY(ksm_state.ranges.next, ksm_range_t, link);
+    ksm_state.cursor_index = 0;
+  }
+
+  while (ksm_state.cursor_index >= ksm_state.cursor_range->page_count) {
+    list_node_t *next = ksm_state.cursor_range->link.next;
+
+    if (next == &ksm_state.ranges) {
+      // Giro completo: l'albero instabile non è più affidabile
+      next = ksm_state.ranges.next;
+      rb_root_init(&ksm_state.unstable_root);
+      ksm_state.unstable_seq++;
+      ksm_stats.full_scans++;
+      ksm_stats.pages_unshared = 0;
+    }
+
+    ksm_state.cursor_range = LIST_ENTRY(next, ksm_range_t, link);
+    ksm_state.cursor_index = 0;
+  }
+
+  return &ksm_state.cursor_range->items[ksm_state.cursor_index++];
+}
+
+/*
+ * ============================================================================
+ * API PUBBLICA
+ * ============================================================================
+ */
+
+void ksm_init(void) {
+  // Chiamata una sola volta al boot, prima di ogni registrazione
+  if (ksm_state.initialized)
+    return;
+
+  memset(&ksm_state, 0, sizeof(ksm_state));
+  memset(&ksm_stats, 0, sizeof(ksm_stats));
+  list_init(&ksm_state.ranges);
+  ksm_state.unstable_seq = 1;
+  ksm_state.pages_per_pass = KSM_DEFAULT_PAGES_PER_PASS;
+  ksm_state.cycle_budget = KSM_DEFAULT_CYCLE_BUDGET;
+
+  // L'indice ha un lock proprio (e alloca): fuori da ksm_lock
+  if (!hashtable_init(&ksm_state.stable_index, KSM_STABLE_HASH_SHIFT, ksm_phys_hash, ksm_phys_eq, 0)) {
+    klog_error("ksm: impossibile allocare l'indice dei nodi stabili");
+    return;
+  }
+
+  spinlock_lock(&ksm_lock);
+  ksm_state.initialized = true;
+  spinlock_unlock(&ksm_lock);
+
+  klog_info("ksm: scanner pronto (%u pagine / %lu cicli per passaggio), nessun range finché non viene registrato", KSM_DEFAULT_PAGES_PER_PASS, KSM_DEFAULT_CYCLE_BUDGET);
+}
+
+bool ksm_register_range(vmm_space_t *space, u64 virt_addr, size_t page_count) {
+  if (!IS_PAGE_ALIGNED(virt_addr) || page_count == 0) {
+    klog_error("ksm: range non valido 0x%lx (%zu pagine)", virt_addr, page_count);
+    return false;
+  }
+
+  if (!space)
+    space = vmm_kernel_space();
+
+  ksm_range_t *range = (ksm_range_t *)kmalloc(sizeof(ksm_range_t));
+  if (!range)
+    return false;
+
+  range->items = (ksm_rmap_item_t *)kcalloc(page_count, sizeof(ksm_rmap_item_t));
+  if (!range->items) {
+    kfree(range);
+    return false;
+  }
+
+  range->space = space;
+  range->virt_addr = virt_addr;
+  range->page_count = page_count;
+
+  for (size_t i = 0; i < page_count; i++) {
+    range->items[i].range = range;
+    range->items[i].virt_addr = virt_addr + i * PAGE_SIZE;
+    list_init(&range->items[i].stable_link);
+  }
+
+  spinlock_lock(&ksm_lock);
+
+  if (!ksm_state.initialized) {
+    spinlock_unlock(&ksm_lock);
+    kfree(range->items);
+    kfree(range);
+    klog_error("ksm: registrazione prima di ksm_init()");
+    return false;
+  }
+
+  list_insert_before(&ksm_state.ranges, &range->link);
+  ksm_stats.registered_pages += page_count;
+
+  spinlock_unlock(&ksm_lock);
+
+  klog_debug("ksm: registrato range 0x%lx (%zu pagine)", virt_addr, page_count);
+  return true;
+}
+
+void ksm_unregister_space(vmm_space_t *space) {
+  spinlock_lock(&ksm_lock);
+
+  if (!ksm_state.initialized) {
+    spinlock_unlock(&ksm_lock);
+    return;
+  }
+
+  // Lo scanner usa item e albero instabile fuori lock: si aspetta il passaggio
+  while (ksm_state.scanning) {
+    spinlock_unlock(&ksm_lock);
+    arch_cpu_pause();
+    spinlock_lock(&ksm_lock);
+  }
+
+  list_node_t removed_ranges;
+  list_init(&removed_ranges);
+  bool removed = false;
+  list_node_t *it, *tmp;
+  LIST_FOR_EACH_SAFE(it, tmp, &ksm_state.ranges) {
+    ksm_range_t *range = LIST_ENTRY(it, ksm_range_t, link);
+    if (range->space != space)
+      continue;
+
+    // mapcount conta le PTE, non gli item: lo decrementerà il teardown
+    for (size_t i = 0; i < range->page_count; i++) {
+      if (range->items[i].stable)
+        list_remove(&range->items[i].stable_link);
+    }
+
+    if (ksm_state.cursor_range == range)
+      ksm_state.cursor_range = (ksm_range_t *)NULL;
+
+    list_remove(&range->link);
+    list_insert_before(&removed_ranges, &range->link);
+    ksm_stats.registered_pages -= range->page_count;
+    removed = true;
+  }
+
+  // L'albero instabile può puntare agli item che stanno per essere liberati
+  if (removed) {
+    rb_root_init(&ksm_state.unstable_root);
+    ksm_state.unstable_seq++;
+  }
+
+  spinlock_unlock(&ksm_lock);
+
+  LIST_FOR_EACH_SAFE(it, tmp, &removed_ranges) {
+    ksm_range_t *range = LIST_ENTRY(it, ksm_range_t, link);
+    kfree(range->items);
+    kfree(range);
+  }
+}
+
+void ksm_set_budget(u32 pages_per_pass, u64 cycle_budget) {
+  spinlock_lock(&ksm_lock);
+  if (pages_per_pass)
+    ksm_state.pages_per_pass = pages_per_pass;
+  if (cycle_budget)
+    ksm_state.cycle_budget = cycle_budget;
+  spinlock_unlock(&ksm_lock);
+}
+
+size_t ksm_scan_pass(void) {
+  spinlock_lock(&ksm_lock);
+
+  if (!ksm_state.initialized || ksm_state.scanning || list_is_empty(&ksm_state.ranges)) {
+    spinlock_unlock(&ksm_lock);
+    return 0;
+  }
+
+  ksm_state.scanning = true;
+  u32 pages_per_pass = ksm_state.pages_per_pass;
+  u64 cycle_budget = ksm_state.cycle_budget;
+  spinlock_unlock(&ksm_lock);
+
+  u64 start = arch_cpu_cycles();
+  size_t freed = 0;
+
+  for (u32 i = 0; i < pages_per_pass; i++) {
+    spinlock_lock(&ksm_lock);
+    ksm_rmap_item_t *item = ksm_next_item();
+    spinlock_unlock(&ksm_lock);
+    if (!item)
+      break;
+
+    // VMM, PMM e heap senza ksm_lock: ksm_scan_item lo prende solo sulle strutture KSM
+    if (ksm_scan_item(item))
+      freed++;
+
+    if (arch_cpu_cycles() - start >= cycle_budget)
+      break;
+  }
+
+  spinlock_lock(&ksm_lock);
+  ksm_stats.scan_cycles += arch_cpu_cycles() - start;
+  ksm_stats.scan_passes++;
+  ksm_state.scanning = false;
+  spinlock_unlock(&ksm_lock);
+  return freed;
+}
+
+bool ksm_page_unshare(vmm_space_t *space, u64 virt_addr, u64 phys_addr) {
+  spinlock_lock(&ksm_lock);
+
+  ksm_stable_node_t *node = ksm_state.initialized ? stable_hash_lookup(phys_addr) : (ksm_stable_node_t *)NULL;
+  if (!node) {
+    // COW break su una pagina a metà merge: il frame lo libera lo scanner
+    bool claimed = ksm_state.claim.phys && ksm_state.claim.phys == phys_addr;
+    if (claimed)
+      ksm_state.claim.broken = true;
+    spinlock_unlock(&ksm_lock);
+    return claimed;
+  }
+
+  list_node_t *it;
+  LIST_FOR_EACH(it, &node->mappings) {
+    ksm_rmap_item_t *item = LIST_ENTRY(it, ksm_rmap_item_t, stable_link);
+    if (item->range->space == space && item->virt_addr == PAGE_ALIGN_DOWN(virt_addr)) {
+      list_remove(&item->stable_link);
+      item->stable = (ksm_stable_node_t *)NULL;
+      item->checksum_valid = false;
+      break;
+    }
+  }
+
+  ksm_stats.cow_breaks++;
+  node->mapcount--;
+
+  // Ultimo mapping rilasciato: il frame torna al PMM (dopo lo scanner se ha un pin)
+  bool release = false;
+  if (node->mapcount == 0 && node->pins == 0) {
+    stable_tree_erase(node);
+    ksm_stats.pages_shared--;
+    release = true;
+  } else if (node->mapcount > 0 && ksm_stats.pages_sharing > 0) {
+    ksm_stats.pages_sharing--;
+  }
+
+  spinlock_unlock(&ksm_lock);
+
+  if (release)
+    stable_node_free(node);
+  return true;
+}
+
+bool ksm_is_shared_frame(u64 phys_addr) {
+  spinlock_lock(&ksm_lock);
+  bool shared = ksm_state.initialized && stable_hash_lookup(PAGE_ALIGN_DOWN(phys_addr)) != NULL;
+  spinlock_unlock(&ksm_lock);
+  return shared;
+}
+
+const ksm_stats_t *ksm_get_stats(void) {
+  return &ksm_stats;
+}
+
+void ksm_print_stats(void) {
+  spinlock_lock(&ksm_lock);
+  ksm_stats_t snap = ksm_stats;
+  spinlock_unlock(&ksm_lock);
+
+  u64 per_page = snap.pages_scanned ? snap.scan_cycles / snap.pages_scanned : 0;
+
+  klog_info("=== KSM STATISTICS ===");
+  klog_info("Pagine registrate: %lu", snap.registered_pages);
+  klog_info("Frame condivisi: %lu, mapping condivisi: %lu", snap.pages_shared, snap.pages_sharing);
+  klog_info("Pagine risparmiate: %lu (%lu KB)", snap.pages_sharing, snap.pages_sharing * PAGE_SIZE / 1024);
+  klog_info("Pagine volatili: %lu, merge falliti: %lu, COW break: %lu", snap.pages_volatile, snap.merge_failures, snap.cow_breaks);
+  klog_info("Scansioni complete: %lu, passaggi: %lu", snap.full_scans, snap.scan_passes);
+  klog_info("Costo CPU: %lu cicli totali, %lu cicli/pagina", snap.scan_cycles, per_page);
+  klog_info("======================");
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/ksm.h
+ * @brief Kernel Samepage Merging - deduplica di pagine anonime identiche
+ *
+ * Uno scanner in background confronta le pagine dei range registrati e
+ * fonde quelle con contenuto identico in un unico frame read-only marcato
+ * COW. La prima scrittura su una pagina fusa passa dal page fault handler
+ * che ne crea una copia privata (vedi vmm_fault.c).
+ *
+ * ALGORITMO (ispirato a Linux KSM):
+ * - Ogni pagina registrata ha un rmap item con l'ultimo checksum CRC32C
+ * - Albero STABILE: frame già fusi, read-only, ordinati per (crc, contenuto)
+ * - Albero INSTABILE: candidati del passaggio corrente; viene svuotato a
+ *   ogni giro completo perché il contenuto delle pagine può cambiare
+ * - Una pagina entra nell'albero instabile solo se il checksum non è
+ *   cambiato dall'ultima scansione (pagine "volatili" ignorate)
+ *
+ * PROTOCOLLO DI MERGE:
+ * 1. Write-protect della pagina candidata (RO + COW)
+ * 2. Confronto completo del contenuto con il frame di destinazione
+ * 3. Sostituzione della PTE con compare-and-swap (vmm_replace_page)
+ * 4. Rilascio del frame duplicato al PMM
+ *
+ * BUDGET: ogni chiamata a ksm_scan_pass() analizza al massimo
+ * pages_per_pass pagine e si interrompe superato cycle_budget cicli.
+ * Il loop di idle ne esegue una a ogni risveglio del tick del kernel
+ * (arch/tick.h): il ritmo di scansione è pages_per_pass per tick.
+ *
+ * REGISTRAZIONE (opt-in):
+ * Al boot non viene registrato nulla: lo scanner gira a ogni tick ma
+ * esce subito finché la lista dei range è vuota. Come MADV_MERGEABLE su
+ * Linux, è il proprietario della memoria a chiedere la deduplica con
+ * ksm_register_range() per i range anonimi che sa essere ripetitivi (es.
+ * heap di VM o processi identici). La registrazione vale fino a
+ * vmm_destroy_space(), che chiama ksm_unregister_space(); i range non
+ * ancora popolati costano solo il loro array di rmap item.
+ */
+
+/*
+ * ============================================================================
+ * CONFIGURATION CONSTANTS
+ * ============================================================================
+ */
+
+#define KSM_DEFAULT_PAGES_PER_PASS 64       // Pagine analizzate per passaggio
+#define KSM_DEFAULT_CYCLE_BUDGET 2000000ULL // Cicli CPU massimi per passaggio
+#define KSM_STABLE_HASH_SHIFT 8             // Bucket iniziali (log2) dell'indice pfn → nodo stabile
+
+/*
+ * ============================================================================
+ * TYPES
+ * ============================================================================
+ */
+
+/**
+ * @brief Statistiche dello scanner KSM
+ */
+typedef struct {
+  u64 pages_shared;   /* Frame condivisi presenti nell'albero stabile */
+  u64 pages_sharing;  /* Mapping aggiuntivi sui frame condivisi = pagine risparmiate */
+  u64 pages_unshared; /* Candidati senza duplicati nell'ultimo giro */
+  u64 pages_volatile; /* Candidati scartati perché modificati tra due scansioni */
+  u64 pages_scanned;  /* Totale pagine analizzate */
+  u64 cow_breaks;     /* Copie private create da scritture su frame fusi */
+  u64 merge_failures; /* Merge annullati (contenuto cambiato o PTE modificata) */
+  u64 full_scans;     /* Giri completi su tutti i range registrati */
+  u64 scan_passes;    /* Chiamate a ksm_scan_pass() */
+  u64 scan_cycles;    /* Cicli CPU totali spesi dallo scanner */
+  u64 registered_pages;
+} ksm_stats_t;
+
+/*
+ * ============================================================================
+ * PUBLIC API
+ * ============================================================================
+ */
+
+/**
+ * @brief Inizializza lo scanner KSM
+ *
+ * Richiede VMM e heap inizializzati.
+ */
+void ksm_init(void);
+
+/**
+ * @brief Registra un range di pagine anonime come candidato al merge
+ *
+ * Unico modo per dare lavoro allo scanner (vedi REGISTRAZIONE). Può essere
+ * chiamata da qualsiasi contesto che possa allocare dall'heap.
+ *
+ * @param space Spazio di indirizzamento (NULL = spazio kernel)
+ * @param virt_addr Indirizzo base (allineato a pagina)
+ * @param page_count Numero di pagine
+ * @return true se il range è stato registrato
+ */
+bool ksm_register_range(vmm_space_t *space, u64 virt_addr, size_t page_count);
+
+/**
+ * @brief Rimuove tutti i range registrati per uno spazio
+ *
+ * Chiamata da vmm_destroy_space() prima che lo spazio venga messo in coda
+ * per il teardown. I frame condivisi ancora mappati dallo spazio vengono
+ * rilasciati dal teardown tramite ksm_page_unshare().
+ */
+void ksm_unregister_space(vmm_space_t *space);
+
+/**
+ * @brief Imposta il budget di ogni passaggio dello scanner
+ *
+ * @param pages_per_pass Pagine massime per passaggio (0 = invariato)
+ * @param cycle_budget Cicli CPU massimi per passaggio (0 = invariato)
+ */
+void ksm_set_budget(u32 pages_per_pass, u64 cycle_budget);
+
+/**
+ * @brief Esegue un passaggio incrementale dello scanner
+ *
+ * Chiamata dal loop di idle dopo ogni tick del kernel; senza tick l'idle
+ * la ripete in pausa attiva. Uno scanner alla volta: una chiamata
+ * concorrente a un passaggio in corso ritorna subito.
+ *
+ * @return Numero di pagine liberate in questo passaggio
+ */
+size_t ksm_scan_pass(void);
+
+/**
+ * @brief Rilascia un mapping di un frame condiviso dopo un COW break
+ *
+ * Chiamata dal page fault handler dopo che la pagina (space, virt_addr) è
+ * stata rimappata su una copia privata. Quando l'ultimo mapping viene
+ * rilasciato il frame condiviso torna al PMM.
+ *
+ * @param space Spazio che ha eseguito il COW break
+ * @param virt_addr Indirizzo della pagina
+ * @param phys_addr Frame condiviso precedentemente mappato
+ * @return true se il frame era gestito da KSM
+ */
+bool ksm_page_unshare(vmm_space_t *space, u64 virt_addr, u64 phys_addr);
+
+/**
+ * @brief Verifica se un frame fisico è un frame condiviso KSM
+ */
+bool ksm_is_shared_frame(u64 phys_addr);
+
+/**
+ * @brief Ottiene un puntatore alle statistiche correnti
+ */
+const ksm_stats_t *ksm_get_stats(void);
+
+/**
+ * @brief Stampa pagine risparmiate e costo CPU dello scanner
+ */
+void ksm_print_stats(void);
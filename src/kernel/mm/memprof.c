@@ -0,0 +1,393 @@
+#include <arch/cpu.h>
+#include <klib/cmdline/cmdline.h>
+#include <klib/hash/hash.h>
+#include <klib/klog/klog.h>
+#include <klib/ksym/ksym.h>
+#include <klib/spinlock.h>
+#include <lib/stdio/stdio.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/memprof.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/memprof.c
+ * @brief Profiler delle allocazioni per sito di chiamata - Implementation
+ *
+ * Due tabelle hash ad indirizzamento aperto (linear probing), allocate dal
+ * PMM in memprof_init() così il profiler non dipende dagli allocatori che
+ * osserva:
+ * - siti: chiave (indirizzo del chiamante, tipo di allocatore), mai rimossi
+ *   fino a memprof_reset()
+ * - allocazioni vive: chiave il puntatore restituito, rimosse alla free con
+ *   cancellazione a spostamento all'indietro (niente tombstone, le sonde
+ *   restano corte anche con molto ricambio)
+ *
+ * I puntatori di kmalloc/slab sono virtuali nella metà alta, quelli del PMM
+ * fisici: i due insiemi non si sovrappongono e convivono nella stessa
+ * tabella.
+ *
+ * Il lock è una foglia: si prende anche con i lock degli allocatori già
+ * acquisiti (slab che chiede pagine al PMM), ma sotto di esso non si prende
+ * nessun altro lock e non si alloca.
+ */
+
+DEFINE_STATIC_KEY_FALSE(memprof_key);
+
+#define MEMPROF_LIVE_LIMIT (MEMPROF_MAX_LIVE / 4 * 3) // Carico massimo della tabella delle vive
+#define MEMPROF_REPORT_MAX 16                         // Siti per report (copiati sullo stack)
+
+typedef struct {
+  memprof_site_t stats;
+  u64 window_allocs; // allocs all'inizio dell'intervallo corrente
+  bool used;
+} memprof_slot_t;
+
+typedef struct {
+  uptr ptr; // 0 = slot libero
+  u32 size;
+  u16 site;
+} memprof_live_t;
+
+static struct {
+  bool ready;
+  memprof_slot_t *sites;
+  memprof_live_t *live;
+  u32 site_count;
+  u32 live_count;
+  u64 site_overflow; // Allocazioni perse per tabella dei siti piena
+  u64 window_start;  // Cicli all'inizio dell'intervallo del report
+} memprof_state;
+
+static spinlock_t memprof_lock = SPINLOCK_INITIALIZER;
+
+static const char *const memprof_kind_names[MEMPROF_KIND_COUNT] = {
+    [MEMPROF_KMALLOC] = "kmalloc",
+    [MEMPROF_SLAB] = "slab",
+    [MEMPROF_PMM] = "pmm",
+};
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline u32 memprof_live_home(uptr ptr) {
+  return (u32)hash_u64(ptr, 0) & (MEMPROF_MAX_LIVE - 1);
+}
+
+static inline u32 memprof_size_bucket(size_t size) {
+  u32 bucket = 0;
+  while (bucket < MEMPROF_SIZE_BUCKETS - 1 && ((size_t)1 << (bucket + MEMPROF_SIZE_MIN_SHIFT)) < size)
+    bucket++;
+  return bucket;
+}
+
+/**
+ * @brief Trova o crea il sito (lock preso)
+ * @return Indice del sito, MEMPROF_MAX_SITES se la tabella è piena
+ */
+static u32 memprof_site_get(uptr site, memprof_kind_t kind) {
+  u32 index = (u32)hash_u64(site ^ (uptr)kind, 0) % MEMPROF_MAX_SITES;
+
+  for (u32 probe = 0; probe < MEMPROF_MAX_SITES; probe++) {
+    memprof_slot_t *slot = &memprof_state.sites[index];
+    if (!slot->used) {
+      if (memprof_state.site_count >= MEMPROF_MAX_SITES - 1)
+        return MEMPROF_MAX_SITES;
+      slot->used = true;
+      slot->stats.site = site;
+      slot->stats.kind = kind;
+      memprof_state.site_count++;
+      return index;
+    }
+    if (slot->stats.site == site && slot->stats.kind == kind)
+      return index;
+    index = (index + 1) % MEMPROF_MAX_SITES;
+  }
+  return MEMPROF_MAX_SITES;
+}
+
+/**
+ * @brief Cerca un'allocazione viva (lock preso)
+ * @return Indice dello slot, MEMPROF_MAX_LIVE se assente
+ */
+static u32 memprof_live_find(uptr ptr) {
+  u32 index = memprof_live_home(ptr);
+  while (memprof_state.live[index].ptr) {
+    if (memprof_state.live[index].ptr == ptr)
+      return index;
+    index = (index + 1) & (MEMPROF_MAX_LIVE - 1);
+  }
+  return MEMPROF_MAX_LIVE;
+}
+
+/**
+ * @brief Rimuove lo slot index riportando indietro le voci che lo seguono
+ *
+ * Una voce in j può occupare il buco in i solo se la sua posizione ideale
+ * non cade, ciclicamente, in (i, j]: altrimenti la ricerca non la
+ * troverebbe più.
+ */
+static void memprof_live_remove(u32 hole) {
+  u32 mask = MEMPROF_MAX_LIVE - 1;
+  u32 next = hole;
+
+  for (;;) {
+    next = (next + 1) & mask;
+    if (!memprof_state.live[next].ptr)
+      break;
+    u32 home = memprof_live_home(memprof_state.live[next].ptr);
+    bool between = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+    if (!between) {
+      memprof_state.live[hole] = memprof_state.live[next];
+      hole = next;
+    }
+  }
+
+  memprof_state.live[hole].ptr = 0;
+  memprof_state.live_count--;
+}
+
+static u64 memprof_window_allocs(const memprof_slot_t *slot) {
+  return slot->stats.allocs - slot->window_allocs;
+}
+
+static u64 memprof_sort_key(const memprof_slot_t *slot, memprof_sort_t sort) {
+  return sort == MEMPROF_SORT_RATE ? memprof_window_allocs(slot) : slot->stats.live_bytes;
+}
+
+static void memprof_print_site(const memprof_site_t *site, u64 window_allocs, u64 window_cycles, u64 hz) {
+  char where[96];
+  char hist[160];
+  size_t pos = 0;
+
+  ksym_snprint(where, sizeof(where), site->site);
+
+  hist[0] = '\0';
+  for (u32 b = 0; b < MEMPROF_SIZE_BUCKETS && pos < sizeof(hist); b++) {
+    if (!site->size_hist[b])
+      continue;
+    u64 limit = 1ULL << (b + MEMPROF_SIZE_MIN_SHIFT);
+    if (b == MEMPROF_SIZE_BUCKETS - 1)
+      pos += ksnprintf(hist + pos, sizeof(hist) - pos, " >%luK:%lu", limit / 2048, site->size_hist[b]);
+    else if (limit >= 1024)
+      pos += ksnprintf(hist + pos, sizeof(hist) - pos, " %luK:%lu", limit / 1024, site->size_hist[b]);
+    else
+      pos += ksnprintf(hist + pos, sizeof(hist) - pos, " %lu:%lu", limit, site->size_hist[b]);
+  }
+
+  klog_info("  %s %s: vivi %lu B (picco %lu B), alloc %lu free %lu", memprof_kind_names[site->kind], where, site->live_bytes, site->peak_bytes, site->allocs, site->frees);
+  if (hz && window_cycles)
+    klog_info("    %lu alloc/s, dimensioni fino a:%s", window_allocs * hz / window_cycles, hist);
+  else
+    klog_info("    %lu alloc nell'intervallo, dimensioni fino a:%s", window_allocs, hist);
+  if (site->untracked)
+    klog_info("    %lu allocazioni non tracciate (tabella delle vive piena)", site->untracked);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+void memprof_init(void) {
+  size_t site_pages = (MEMPROF_MAX_SITES * sizeof(memprof_slot_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+  size_t live_pages = (MEMPROF_MAX_LIVE * sizeof(memprof_live_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+
+  void *sites = pmm_alloc_pages(site_pages);
+  void *live = pmm_alloc_pages(live_pages);
+  if (!sites || !live) {
+    klog_error("memprof: tabelle non allocate (%lu + %lu pagine)", (u64)site_pages, (u64)live_pages);
+    if (sites)
+      pmm_free_pages(sites, site_pages);
+    if (live)
+      pmm_free_pages(live, live_pages);
+    return;
+  }
+
+  memprof_state.sites = (memprof_slot_t *)vmm_phys_to_virt((u64)sites);
+  memprof_state.live = (memprof_live_t *)vmm_phys_to_virt((u64)live);
+  memprof_state.ready = true;
+  memprof_reset();
+
+  if (cmdline_has("memprof"))
+    memprof_enable();
+}
+
+bool memprof_enable(void) {
+  if (!memprof_state.ready)
+    return false;
+
+  memprof_reset();
+  static_branch_enable(&memprof_key);
+  klog_info("memprof: registrazione dei siti di allocazione attiva");
+  return true;
+}
+
+void memprof_disable(void) {
+  static_branch_disable(&memprof_key);
+}
+
+bool memprof_is_enabled(void) {
+  return static_key_enabled(&memprof_key.key);
+}
+
+void memprof_reset(void) {
+  if (!memprof_state.ready)
+    return;
+
+  spinlock_lock(&memprof_lock);
+  memset(memprof_state.sites, 0, MEMPROF_MAX_SITES * sizeof(memprof_slot_t));
+  memset(memprof_state.live, 0, MEMPROF_MAX_LIVE * sizeof(memprof_live_t));
+  memprof_state.site_count = 0;
+  memprof_state.live_count = 0;
+  memprof_state.site_overflow = 0;
+  memprof_state.window_start = arch_cpu_cycles();
+  spinlock_unlock(&memprof_lock);
+}
+
+void memprof_record_alloc(const void *ptr, size_t size, memprof_kind_t kind, uptr site) {
+  if (!memprof_state.ready)
+    return;
+
+  spinlock_lock(&memprof_lock);
+
+  u32 index = memprof_site_get(site, kind);
+  if (index == MEMPROF_MAX_SITES) {
+    memprof_state.site_overflow++;
+    spinlock_unlock(&memprof_lock);
+    return;
+  }
+
+  memprof_site_t *stats = &memprof_state.sites[index].stats;
+  stats->allocs++;
+  stats->total_bytes += size;
+  stats->size_hist[memprof_size_bucket(size)]++;
+
+  if (memprof_state.live_count >= MEMPROF_LIVE_LIMIT) {
+    stats->untracked++;
+    spinlock_unlock(&memprof_lock);
+    return;
+  }
+
+  u32 slot = memprof_live_find((uptr)ptr);
+  if (slot != MEMPROF_MAX_LIVE) {
+    // Indirizzo riusato senza una free vista (allocato prima dell'accensione
+    // e liberato da un percorso non agganciato): la voce vecchia è morta
+    memprof_site_t *old = &memprof_state.sites[memprof_state.live[slot].site].stats;
+    old->live_bytes -= memprof_state.live[slot].size;
+    memprof_live_remove(slot);
+  }
+
+  slot = memprof_live_home((uptr)ptr);
+  while (memprof_state.live[slot].ptr)
+    slot = (slot + 1) & (MEMPROF_MAX_LIVE - 1);
+  memprof_state.live[slot].ptr = (uptr)ptr;
+  memprof_state.live[slot].size = (u32)size;
+  memprof_state.live[slot].site = (u16)index;
+  memprof_state.live_count++;
+
+  stats->live_bytes += size;
+  if (stats->live_bytes > stats->peak_bytes)
+    stats->peak_bytes = stats->live_bytes;
+
+  spinlock_unlock(&memprof_lock);
+}
+
+void memprof_record_free(const void *ptr) {
+  if (!memprof_state.ready)
+    return;
+
+  spinlock_lock(&memprof_lock);
+
+  u32 slot = memprof_live_find((uptr)ptr);
+  if (slot != MEMPROF_MAX_LIVE) {
+    memprof_site_t *stats = &memprof_state.sites[memprof_state.live[slot].site].stats;
+    stats->live_bytes -= memprof_state.live[slot].size;
+    stats->frees++;
+    memprof_live_remove(slot);
+  }
+
+  spinlock_unlock(&memprof_lock);
+}
+
+bool memprof_get_site(uptr site, memprof_kind_t kind, memprof_site_t *out) {
+  if (!memprof_state.ready || !out)
+    return false;
+
+  bool found = false;
+  spinlock_lock(&memprof_lock);
+  for (u32 i = 0; i < MEMPROF_MAX_SITES; i++) {
+    memprof_slot_t *slot = &memprof_state.sites[i];
+    if (slot->used && slot->stats.site == site && slot->stats.kind == kind) {
+      *out = slot->stats;
+      found = true;
+      break;
+    }
+  }
+  spinlock_unlock(&memprof_lock);
+  return found;
+}
+
+void memprof_report(u32 top, memprof_sort_t sort) {
+  if (!memprof_state.ready) {
+    klog_warn("memprof: non inizializzato");
+    return;
+  }
+  if (top > MEMPROF_REPORT_MAX)
+    top = MEMPROF_REPORT_MAX;
+
+  memprof_site_t best[MEMPROF_REPORT_MAX];
+  u64 best_window[MEMPROF_REPORT_MAX];
+  u32 taken_index[MEMPROF_REPORT_MAX];
+  u32 count = 0;
+
+  // Copia sotto lock dei primi top siti (selezione: top è piccolo), poi
+  // stampa senza lock: il log non deve bloccare gli allocatori
+  spinlock_lock(&memprof_lock);
+
+  u64 now = arch_cpu_cycles();
+  u64 window_cycles = now - memprof_state.window_start;
+  u32 sites = memprof_state.site_count;
+  u32 live = memprof_state.live_count;
+  u64 overflow = memprof_state.site_overflow;
+
+  for (; count < top; count++) {
+    u32 pick = MEMPROF_MAX_SITES;
+    u64 pick_key = 0;
+    for (u32 i = 0; i < MEMPROF_MAX_SITES; i++) {
+      memprof_slot_t *slot = &memprof_state.sites[i];
+      if (!slot->used)
+        continue;
+      bool already = false;
+      for (u32 t = 0; t < count; t++)
+        already |= taken_index[t] == i;
+      u64 key = memprof_sort_key(slot, sort);
+      if (!already && (pick == MEMPROF_MAX_SITES || key > pick_key)) {
+        pick = i;
+        pick_key = key;
+      }
+    }
+    if (pick == MEMPROF_MAX_SITES)
+      break;
+    taken_index[count] = pick;
+    best[count] = memprof_state.sites[pick].stats;
+    best_window[count] = memprof_window_allocs(&memprof_state.sites[pick]);
+  }
+
+  // Nuovo intervallo per il tasso di allocazione
+  for (u32 i = 0; i < MEMPROF_MAX_SITES; i++)
+    memprof_state.sites[i].window_allocs = memprof_state.sites[i].stats.allocs;
+  memprof_state.window_start = now;
+
+  spinlock_unlock(&memprof_lock);
+
+  u64 hz = arch_cpu_cycles_hz();
+  klog_info("memprof: primi %u siti per %s (%u siti, %u allocazioni vive tracciate, intervallo %lu ms)", count, sort == MEMPROF_SORT_RATE ? "allocazioni/s" : "byte vivi", sites, live,
+            hz ? window_cycles / (hz / 1000) : 0);
+  if (overflow)
+    klog_warn("memprof: %lu allocazioni perse, tabella dei siti piena", overflow);
+
+  for (u32 i = 0; i < count; i++)
+    memprof_print_site(&best[i], best_window[i], window_cycles, hz);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <klib/ftrace/ftrace.h>
+#include <klib/static_key/static_key.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/**
+ * @file mm/memprof.h
+ * @brief Profiler delle allocazioni per sito di chiamata
+ *
+ * Risponde a "chi possiede questa memoria?": kmalloc, slab_cache_alloc e
+ * pmm_alloc_page(s) registrano il proprio chiamante
+ * (ftrace_return_address(), che vede attraverso il tracer delle funzioni)
+ * e ogni sito accumula:
+ * - byte vivi (allocati e non ancora liberati) e picco
+ * - allocazioni e liberazioni totali, e allocazioni al secondo
+ * - istogramma delle dimensioni in potenze di due
+ *
+ * Spento costa un NOP per allocazione: i ganci sono dietro la static key
+ * memprof_key. Acceso, ogni allocazione prende un lock globale e inserisce
+ * l'indirizzo in una tabella delle allocazioni vive, che alla liberazione
+ * dice a quale sito restituire i byte. È uno strumento di diagnosi, non da
+ * lasciare attivo in produzione.
+ *
+ * LIMITI:
+ * - Le allocazioni fatte prima dell'accensione non sono note: liberarle
+ *   non tocca alcun sito
+ * - Con la tabella delle vive piena le nuove allocazioni contano solo nei
+ *   totali del sito (vedi "untracked" nel report)
+ * - kmalloc e slab_cache_alloc sono siti distinti: un oggetto di kmalloc
+ *   è attribuito al chiamante di kmalloc, non alla cache slab interna. Le
+ *   pagine che lo slab prende dal PMM sono attribuite allo slab stesso
+ *
+ * COMMAND LINE:
+ * - "memprof": accende il profiler al boot (stampa il report all'idle)
+ *
+ * I siti sono risolti in nomi con la tabella dei simboli del kernel.
+ */
+
+/*
+ * ============================================================================
+ * CONFIGURATION CONSTANTS
+ * ============================================================================
+ */
+
+#define MEMPROF_MAX_SITES 512       // Siti distinti (tabella hash aperta)
+#define MEMPROF_MAX_LIVE 16384      // Allocazioni vive tracciate (potenza di 2)
+#define MEMPROF_SIZE_BUCKETS 12     // 16B, 32B, ... 16KB, oltre
+#define MEMPROF_SIZE_MIN_SHIFT 4    // Primo bucket: fino a 16 byte
+#define MEMPROF_REPORT_TOP 10       // Siti stampati da memprof_report di default
+
+/*
+ * ============================================================================
+ * DATA STRUCTURES
+ * ============================================================================
+ */
+
+typedef enum {
+  MEMPROF_KMALLOC,
+  MEMPROF_SLAB,
+  MEMPROF_PMM,
+  MEMPROF_KIND_COUNT
+} memprof_kind_t;
+
+typedef enum {
+  MEMPROF_SORT_LIVE,   // Byte vivi: chi trattiene la memoria
+  MEMPROF_SORT_RATE,   // Allocazioni al secondo: chi la fa girare
+} memprof_sort_t;
+
+typedef struct {
+  uptr site;
+  memprof_kind_t kind;
+  u64 allocs;
+  u64 frees;
+  u64 live_bytes;
+  u64 peak_bytes;
+  u64 total_bytes;
+  u64 untracked; // Allocazioni non entrate nella tabella delle vive
+  u64 size_hist[MEMPROF_SIZE_BUCKETS];
+} memprof_site_t;
+
+DECLARE_STATIC_KEY_FALSE(memprof_key);
+
+/*
+ * ============================================================================
+ * PUBLIC API
+ * ============================================================================
+ */
+
+/**
+ * @brief Alloca le tabelle; con "memprof" sulla command line accende il profiler
+ *
+ * Richiede il PMM e il direct map (dopo vmm_init).
+ */
+void memprof_init(void);
+
+/**
+ * @brief Accende la registrazione e azzera le statistiche
+ * @return false se le tabelle non sono allocate
+ */
+bool memprof_enable(void);
+
+/**
+ * @brief Spegne la registrazione (le statistiche restano leggibili)
+ */
+void memprof_disable(void);
+
+/**
+ * @brief Verifica se la registrazione è attiva
+ */
+bool memprof_is_enabled(void);
+
+/**
+ * @brief Azzera siti e allocazioni vive
+ */
+void memprof_reset(void);
+
+/**
+ * @brief Stampa nel log i primi top siti secondo l'ordinamento richiesto
+ *
+ * Il tasso di allocazione è calcolato sull'intervallo dal report precedente
+ * (o dall'accensione), così report successivi sotto carico mostrano il
+ * ricambio corrente e non la media dal boot.
+ */
+void memprof_report(u32 top, memprof_sort_t sort);
+
+/**
+ * @brief Copia le statistiche di un sito
+ * @return false se il sito non è presente
+ */
+bool memprof_get_site(uptr site, memprof_kind_t kind, memprof_site_t *out);
+
+/* Percorsi lenti, chiamati solo a chiave accesa */
+void memprof_record_alloc(const void *ptr, size_t size, memprof_kind_t kind, uptr site);
+void memprof_record_free(const void *ptr);
+
+/**
+ * @brief Gancio per gli allocatori: da chiamare con il chiamante dell'allocatore
+ *
+ *   void *kmalloc(size_t size) {
+ *     ...
+ *     memprof_alloc(ptr, size, MEMPROF_KMALLOC, ftrace_return_address());
+ *   }
+ */
+static inline void memprof_alloc(const void *ptr, size_t size, memprof_kind_t kind, uptr site) {
+  if (static_branch_unlikely(&memprof_key) && ptr)
+    memprof_record_alloc(ptr, size, kind, site);
+}
+
+/**
+ * @brief Gancio per le liberazioni: restituisce i byte al sito che li ha allocati
+ */
+static inline void memprof_free(const void *ptr) {
+  if (static_branch_unlikely(&memprof_key) && ptr)
+    memprof_record_free(ptr);
+}
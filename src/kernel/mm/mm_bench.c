@@ -0,0 +1,242 @@
+#include <klib/bench/bench.h>
+#include <klib/klog/klog.h>
+#include <klib/queue/queue.h>
+#include <lib/types.h>
+#include <mm/heap/heap.h>
+#include <mm/heap/slab.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <mm/vmm_advise.h>
+
+/**
+ * @file mm/mm_bench.c
+ * @brief Benchmark dei percorsi caldi della memoria (suite di klib/bench)
+ *
+ * Ogni benchmark ripete coppie allocazione/liberazione: lo stato finale è
+ * quello iniziale e le esecuzioni sono confrontabili fra loro. Le
+ * strutture d'appoggio (cache slab, spazio virtuale) nascono al primo
+ * giro, quello di riscaldamento, e restano per le esecuzioni successive.
+ * In coda ci sono le code lock-free di klib/queue, che reggono work queue
+ * e completamenti dei percorsi di memoria.
+ */
+
+#define MM_BENCH_BATCH 64          // Pagine per giro nel benchmark del batch
+#define MM_BENCH_VADDR 0x400000ULL // Indirizzo del benchmark vmm (spazio privato)
+#define MM_BENCH_ARENA 0x800000ULL // Arena del benchmark degli hint (spazio privato)
+#define MM_BENCH_ARENA_PAGES 64    // Pagine dell'arena (256KB)
+#define MM_BENCH_QUEUE_SLOTS 256   // Capacità delle code (potenza di 2)
+#define MM_BENCH_QUEUE_BURST 64    // Elementi accodati prima di svuotare
+
+/* -------------------------------------------------------------------------- */
+/*                                    PMM                                     */
+/* -------------------------------------------------------------------------- */
+
+static bool mm_bench_pmm_page(u64 iters) {
+  for (u64 i = 0; i < iters; i++) {
+    void *page = pmm_alloc_page();
+    if (!page)
+      return false;
+    pmm_free_page(page);
+  }
+  return true;
+}
+DEFINE_BENCH(pmm_page, mm_bench_pmm_page, 100000);
+
+static bool mm_bench_pmm_pages16(u64 iters) {
+  for (u64 i = 0; i < iters; i++) {
+    void *pages = pmm_alloc_pages(16);
+    if (!pages)
+      return false;
+    pmm_free_pages(pages, 16);
+  }
+  return true;
+}
+DEFINE_BENCH(pmm_pages16, mm_bench_pmm_pages16, 20000);
+
+// iters pagine, allocate a gruppi e restituite con un solo lock per gruppo
+static bool mm_bench_pmm_batch(u64 iters) {
+  void *pages[MM_BENCH_BATCH];
+  for (u64 done = 0; done < iters; done += MM_BENCH_BATCH) {
+    size_t count = 0;
+    for (; count < MM_BENCH_BATCH; count++) {
+      pages[count] = pmm_alloc_page();
+      if (!pages[count])
+        break;
+    }
+    pmm_free_pages_batch(pages, count);
+    if (count < MM_BENCH_BATCH)
+      return false;
+  }
+  return true;
+}
+DEFINE_BENCH(pmm_batch, mm_bench_pmm_batch, 64 * 1024);
+
+// Il pattern che lib/cache.h separa: chi alloca scrive lock, hint e
+// statistiche, chi legge soltanto (pmm_is_page_free, livello di log) tocca
+// pmm_state e current_log_level. Ogni giro fa entrambe le cose; su più CPU
+// lo stesso ciclo eseguito in parallelo misura quanto le scritture
+// invalidano le linee lette dagli altri. Con la sola CPU di boot si ottiene
+// il costo di riferimento del percorso, da confrontare fra layout diversi
+static bool mm_bench_pmm_shared(u64 iters) {
+  for (u64 i = 0; i < iters; i++) {
+    void *page = pmm_alloc_page();
+    if (!page)
+      return false;
+    if (pmm_is_page_free(page) || klog_get_level() > KLOG_LEVEL_PANIC)
+      return false;
+    pmm_free_page(page);
+    if (!pmm_is_page_free(page))
+      return false;
+  }
+  return true;
+}
+DEFINE_BENCH(pmm_shared, mm_bench_pmm_shared, 100000);
+
+/* -------------------------------------------------------------------------- */
+/*                                   Heap                                     */
+/* -------------------------------------------------------------------------- */
+
+static bool mm_bench_kmalloc(u64 iters, size_t size) {
+  for (u64 i = 0; i < iters; i++) {
+    void *ptr = kmalloc(size);
+    if (!ptr)
+      return false;
+    kfree(ptr);
+  }
+  return true;
+}
+
+static bool mm_bench_kmalloc64(u64 iters) {
+  return mm_bench_kmalloc(iters, 64);
+}
+DEFINE_BENCH(kmalloc64, mm_bench_kmalloc64, 100000);
+
+// Oltre HEAP_SLAB_MAX_SIZE: percorso del buddy
+static bool mm_bench_kmalloc8k(u64 iters) {
+  return mm_bench_kmalloc(iters, 8192);
+}
+DEFINE_BENCH(kmalloc8k, mm_bench_kmalloc8k, 20000);
+
+static bool mm_bench_slab_cache(u64 iters) {
+  static slab_cache_t *cache;
+  if (!cache)
+    cache = slab_cache_create("bench_obj", 128, 16, NULL, NULL);
+  if (!cache)
+    return false;
+
+  for (u64 i = 0; i < iters; i++) {
+    void *obj = slab_cache_alloc(cache);
+    if (!obj)
+      return false;
+    slab_cache_free(cache, obj);
+  }
+  return true;
+}
+DEFINE_BENCH(slab_cache, mm_bench_slab_cache, 100000);
+
+/* -------------------------------------------------------------------------- */
+/*                                    VMM                                     */
+/* -------------------------------------------------------------------------- */
+
+// Le page table intermedie restano dopo il primo giro: si misura la PTE e il TLB
+static bool mm_bench_vmm_map(u64 iters) {
+  static vmm_space_t *space;
+  static void *frame;
+  if (!space)
+    space = vmm_create_space();
+  if (!frame)
+    frame = pmm_alloc_page();
+  if (!space || !frame)
+    return false;
+
+  for (u64 i = 0; i < iters; i++) {
+    if (!vmm_map(space, MM_BENCH_VADDR, (u64)frame, 1, VMM_FLAG_READ | VMM_FLAG_WRITE | VMM_FLAG_USER))
+      return false;
+    vmm_unmap(space, MM_BENCH_VADDR, 1);
+  }
+  return true;
+}
+DEFINE_BENCH(vmm_map, mm_bench_vmm_map, 50000);
+
+// Ciclo di un allocatore ad arene: prefault dell'arena, poi reset con DONTNEED.
+// Lo spazio non è attivo: il costo dei flush del TLB non entra nella misura
+static bool mm_bench_arena_reset(u64 iters) {
+  static vmm_space_t *space;
+  if (!space) {
+    space = vmm_create_space();
+    if (!space || !vmm_reserve(space, MM_BENCH_ARENA, MM_BENCH_ARENA_PAGES, VMM_FLAG_READ | VMM_FLAG_WRITE | VMM_FLAG_USER))
+      return false;
+  }
+
+  for (u64 i = 0; i < iters; i++) {
+    if (!vmm_advise(space, MM_BENCH_ARENA, MM_BENCH_ARENA_PAGES, VMM_ADVISE_WILLNEED))
+      return false;
+    vmm_advise(space, MM_BENCH_ARENA, MM_BENCH_ARENA_PAGES, VMM_ADVISE_DONTNEED);
+  }
+  return true;
+}
+DEFINE_BENCH(arena_reset, mm_bench_arena_reset, 2000);
+
+/* -------------------------------------------------------------------------- */
+/*                                   Code                                     */
+/* -------------------------------------------------------------------------- */
+
+// Throughput delle code di klib/queue: iters elementi accodati a raffiche
+// di MM_BENCH_QUEUE_BURST e poi estratti. Produttore e consumatore sono la
+// stessa CPU: si misura il costo delle operazioni atomiche e del layout,
+// non il passaggio di linee fra CPU
+static bool mm_bench_spsc_ring(u64 iters) {
+  static spsc_ring_t ring;
+  static void *slots[MM_BENCH_QUEUE_SLOTS];
+  if (!spsc_ring_init(&ring, slots, MM_BENCH_QUEUE_SLOTS))
+    return false;
+
+  for (u64 done = 0; done < iters; done += MM_BENCH_QUEUE_BURST) {
+    for (uptr i = 0; i < MM_BENCH_QUEUE_BURST; i++)
+      if (!spsc_ring_push(&ring, (void *)(i + 1)))
+        return false;
+    for (uptr i = 0; i < MM_BENCH_QUEUE_BURST; i++) {
+      void *item;
+      if (!spsc_ring_pop(&ring, &item) || item != (void *)(i + 1))
+        return false;
+    }
+  }
+  return true;
+}
+DEFINE_BENCH(spsc_ring, mm_bench_spsc_ring, 1024 * 1024);
+
+static bool mm_bench_mpsc_queue(u64 iters) {
+  static mpsc_queue_t queue;
+  static mpsc_node_t nodes[MM_BENCH_QUEUE_BURST];
+  mpsc_queue_init(&queue);
+
+  for (u64 done = 0; done < iters; done += MM_BENCH_QUEUE_BURST) {
+    for (size_t i = 0; i < MM_BENCH_QUEUE_BURST; i++)
+      mpsc_queue_push(&queue, &nodes[i]);
+    for (size_t i = 0; i < MM_BENCH_QUEUE_BURST; i++)
+      if (mpsc_queue_pop(&queue) != &nodes[i])
+        return false;
+  }
+  return true;
+}
+DEFINE_BENCH(mpsc_queue, mm_bench_mpsc_queue, 1024 * 1024);
+
+static bool mm_bench_mpmc_queue(u64 iters) {
+  static mpmc_queue_t queue;
+  static mpmc_cell_t cells[MM_BENCH_QUEUE_SLOTS];
+  if (!mpmc_queue_init(&queue, cells, MM_BENCH_QUEUE_SLOTS))
+    return false;
+
+  for (u64 done = 0; done < iters; done += MM_BENCH_QUEUE_BURST) {
+    for (uptr i = 0; i < MM_BENCH_QUEUE_BURST; i++)
+      if (!mpmc_queue_push(&queue, (void *)(i + 1)))
+        return false;
+    for (uptr i = 0; i < MM_BENCH_QUEUE_BURST; i++) {
+      void *item;
+      if (!mpmc_queue_pop(&queue, &item) || item != (void *)(i + 1))
+        return false;
+    }
+  }
+  return true;
+}
+DEFINE_BENCH(mpmc_queue, mm_bench_mpmc_queue, 1024 * 1024);
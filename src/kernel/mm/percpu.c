@@ -0,0 +1,242 @@
+#include <arch/cpu.h>
+#include <klib/bitmap/bitmap.h>
+#include <klib/klog/klog.h>
+#include <klib/spinlock.h>
+#include <lib/cache.h>
+#include <lib/math/math.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/percpu.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/percpu.c
+ * @brief Aree per-CPU - implementazione
+ *
+ * Simboli del linker (tools/linker.ld):
+ * - _percpu_start/_percpu_end: immagine iniziale (.data.percpu), con
+ *   l'header come primo oggetto. Non viene mai modificata a runtime,
+ *   così ogni CPU secondaria parte dai valori di compilazione
+ * - _percpu_boot_start: copia in .bss usata dalla CPU di boot finché le
+ *   unità non sono allocate
+ *
+ * Allocatore dinamico: due bitmap sui granuli dell'area dinamica, comuni
+ * a tutte le unità (un'allocazione occupa lo stesso offset in ognuna):
+ * - alloc_map: granuli occupati
+ * - bound_map: primo granulo di ogni allocazione, per sapere dove finisce
+ *   un'allocazione in percpu_free() senza memorizzarne la dimensione
+ */
+
+extern char _percpu_start[];
+extern char _percpu_end[];
+extern char _percpu_boot_start[];
+
+/*
+ * ============================================================================
+ * STRUTTURE DATI INTERNE
+ * ============================================================================
+ */
+
+#define PERCPU_MAX_GRANULES (PERCPU_UNIT_SIZE / PERCPU_GRANULE)
+
+// Primo oggetto dell'immagine: il registro base punta qui in ogni unità
+static percpu_header_t percpu_header __attribute__((section(".data.percpu.head"), used));
+
+uptr percpu_offsets[PERCPU_MAX_CPUS] __read_mostly;
+
+static spinlock_t percpu_lock = SPINLOCK_INITIALIZER;
+
+static struct {
+  bool ready;          // Unità allocate, percpu_alloc() disponibile
+  u32 cpu_count;       // CPU con un'unità
+  u8 *units;           // Prima unità (direct map)
+  size_t static_size;  // Byte dell'immagine statica
+  size_t dyn_start;    // Offset dell'area dinamica nell'unità
+  size_t dyn_granules; // Granuli dell'area dinamica
+  size_t dyn_used;     // Granuli allocati
+} percpu_state = {.cpu_count = 1};
+
+static u64 percpu_alloc_bits[PERCPU_MAX_GRANULES / 64];
+static u64 percpu_bound_bits[PERCPU_MAX_GRANULES / 64];
+static bitmap_t percpu_alloc_map;
+static bitmap_t percpu_bound_map;
+
+/*
+ * ============================================================================
+ * UTILITY
+ * ============================================================================
+ */
+
+static inline u8 *percpu_unit(u32 cpu) {
+  return percpu_state.units + (size_t)cpu * PERCPU_UNIT_SIZE;
+}
+
+/**
+ * Scrive l'header di un'unità e registra il suo offset.
+ */
+static void percpu_setup_unit(u32 cpu, u8 *unit) {
+  percpu_header_t *header = (percpu_header_t *)unit;
+  header->offset = (uptr)unit - (uptr)_percpu_start;
+  header->cpu = cpu;
+  header->self = (uptr)unit;
+  percpu_offsets[cpu] = header->offset;
+}
+
+static bool percpu_run_is_free(size_t first, size_t count) {
+  for (size_t i = first; i < first + count; i++) {
+    if (bitmap_get(&percpu_alloc_map, i))
+      return false;
+  }
+  return true;
+}
+
+/*
+ * ============================================================================
+ * IMPLEMENTAZIONE
+ * ============================================================================
+ */
+
+void percpu_early_init(void) {
+  size_t static_size = (size_t)(_percpu_end - _percpu_start);
+
+  memcpy(_percpu_boot_start, _percpu_start, static_size);
+  percpu_setup_unit(0, (u8 *)_percpu_boot_start);
+  arch_percpu_set_base(_percpu_boot_start);
+}
+
+bool percpu_init(void) {
+  size_t static_size = (size_t)(_percpu_end - _percpu_start);
+  size_t dyn_start = math_align_up(static_size, L1_CACHE_BYTES);
+
+  if (dyn_start >= PERCPU_UNIT_SIZE)
+    klog_panic("percpu: variabili statiche (%zu byte) oltre l'unità di %lu byte", static_size, PERCPU_UNIT_SIZE);
+
+  u32 cpus = arch_cpu_count();
+  if (cpus == 0)
+    cpus = 1;
+  if (cpus > PERCPU_MAX_CPUS)
+    cpus = PERCPU_MAX_CPUS;
+
+  void *phys = pmm_alloc_pages((size_t)cpus * (PERCPU_UNIT_SIZE / PAGE_SIZE));
+  if (!phys) {
+    klog_error("percpu: impossibile allocare %u unità da %lu KB", cpus, PERCPU_UNIT_SIZE / KB);
+    return false;
+  }
+  pmm_set_owner(phys, (size_t)cpus * (PERCPU_UNIT_SIZE / PAGE_SIZE), PMM_OWNER_BOOT);
+
+  percpu_state.units = (u8 *)vmm_phys_to_virt((u64)phys);
+  percpu_state.static_size = static_size;
+  percpu_state.dyn_start = dyn_start;
+  percpu_state.dyn_granules = (PERCPU_UNIT_SIZE - dyn_start) / PERCPU_GRANULE;
+
+  // La CPU di boot porta con sé lo stato accumulato nell'area di appoggio
+  for (u32 cpu = 0; cpu < cpus; cpu++) {
+    u8 *unit = percpu_unit(cpu);
+    memcpy(unit, cpu == 0 ? _percpu_boot_start : _percpu_start, static_size);
+    memset(unit + static_size, 0, PERCPU_UNIT_SIZE - static_size);
+    percpu_setup_unit(cpu, unit);
+  }
+  arch_percpu_set_base(percpu_unit(0));
+
+  bitmap_init(&percpu_alloc_map, percpu_alloc_bits, percpu_state.dyn_granules);
+  bitmap_init(&percpu_bound_map, percpu_bound_bits, percpu_state.dyn_granules);
+  bitmap_clear_all(&percpu_alloc_map);
+  bitmap_clear_all(&percpu_bound_map);
+
+  percpu_state.cpu_count = cpus;
+  percpu_state.ready = true;
+
+  klog_info("percpu: %u unità da %lu KB (statiche %zu byte, dinamiche %zu byte)", cpus, PERCPU_UNIT_SIZE / KB, static_size, percpu_state.dyn_granules * PERCPU_GRANULE);
+  return true;
+}
+
+void percpu_cpu_online(u32 cpu) {
+  if (!percpu_state.ready || cpu >= percpu_state.cpu_count) {
+    klog_error("percpu: nessuna unità per la CPU %u", cpu);
+    return;
+  }
+  arch_percpu_set_base(percpu_unit(cpu));
+}
+
+u32 percpu_cpu_count(void) {
+  return percpu_state.cpu_count;
+}
+
+void *percpu_alloc(size_t size, size_t align) {
+  if (!percpu_state.ready) {
+    klog_warn("percpu: percpu_alloc() prima di percpu_init()");
+    return NULL;
+  }
+  if (size == 0)
+    return NULL;
+
+  if (align < PERCPU_GRANULE)
+    align = PERCPU_GRANULE;
+  if ((align & (align - 1)) || align > PAGE_SIZE)
+    return NULL;
+
+  size_t need = (size + PERCPU_GRANULE - 1) / PERCPU_GRANULE;
+  size_t step = align / PERCPU_GRANULE;
+  size_t first = (math_align_up(percpu_state.dyn_start, align) - percpu_state.dyn_start) / PERCPU_GRANULE;
+
+  spinlock_lock(&percpu_lock);
+
+  size_t found = (size_t)-1;
+  for (size_t g = first; g + need <= percpu_state.dyn_granules; g += step) {
+    if (percpu_run_is_free(g, need)) {
+      found = g;
+      break;
+    }
+  }
+
+  if (found == (size_t)-1) {
+    spinlock_unlock(&percpu_lock);
+    klog_warn("percpu: area dinamica esaurita (%zu byte richiesti)", size);
+    return NULL;
+  }
+
+  for (size_t g = found; g < found + need; g++)
+    bitmap_set(&percpu_alloc_map, g);
+  bitmap_set(&percpu_bound_map, found);
+  percpu_state.dyn_used += need;
+
+  size_t offset = percpu_state.dyn_start + found * PERCPU_GRANULE;
+  for (u32 cpu = 0; cpu < percpu_state.cpu_count; cpu++)
+    memset(percpu_unit(cpu) + offset, 0, need * PERCPU_GRANULE);
+
+  spinlock_unlock(&percpu_lock);
+  return _percpu_start + offset;
+}
+
+void percpu_free(void *ptr) {
+  if (!ptr || !percpu_state.ready)
+    return;
+
+  size_t offset = (size_t)((char *)ptr - _percpu_start);
+  if (offset < percpu_state.dyn_start || offset >= PERCPU_UNIT_SIZE || (offset - percpu_state.dyn_start) % PERCPU_GRANULE) {
+    klog_error("percpu: free di un puntatore non per-CPU %p", ptr);
+    return;
+  }
+
+  size_t first = (offset - percpu_state.dyn_start) / PERCPU_GRANULE;
+
+  spinlock_lock(&percpu_lock);
+
+  if (!bitmap_get(&percpu_bound_map, first)) {
+    spinlock_unlock(&percpu_lock);
+    klog_error("percpu: free di %p non allocato", ptr);
+    return;
+  }
+
+  bitmap_clear(&percpu_bound_map, first);
+  // L'allocazione finisce al primo granulo libero o all'inizio della successiva
+  for (size_t g = first; g < percpu_state.dyn_granules && bitmap_get(&percpu_alloc_map, g); g++) {
+    if (g != first && bitmap_get(&percpu_bound_map, g))
+      break;
+    bitmap_clear(&percpu_alloc_map, g);
+    percpu_state.dyn_used--;
+  }
+
+  spinlock_unlock(&percpu_lock);
+}
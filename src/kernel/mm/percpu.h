@@ -0,0 +1,155 @@
+#pragma once
+
+#include <arch/percpu.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/percpu.h
+ * @brief Aree per-CPU: variabili statiche e allocatore dinamico
+ *
+ * Ogni CPU possiede un'unità di PERCPU_UNIT_SIZE byte; le unità sono
+ * contigue a passo fisso, quindi la stessa variabile si trova allo stesso
+ * offset in ogni unità e CPU diverse non condividono mai una cache line.
+ *
+ * LAYOUT DI UN'UNITÀ:
+ *   [ header | variabili statiche (.data.percpu) | area dinamica ]
+ * - L'header (percpu_header_t) è sempre il primo: il registro base della
+ *   CPU (GS) punta all'unità e l'header si legge a offset fisso
+ * - Le variabili statiche sono definite con DEFINE_PER_CPU e linkate nella
+ *   sezione .data.percpu, che funge da immagine iniziale di ogni unità
+ * - L'area dinamica è gestita da percpu_alloc() a granuli di 16 byte
+ *
+ * PUNTATORI PER-CPU:
+ * &var di una variabile statica e il valore restituito da percpu_alloc()
+ * sono indirizzi nell'immagine, da non dereferenziare direttamente:
+ * this_cpu_ptr() li sposta nell'unità della CPU corrente, per_cpu_ptr()
+ * in quella di una CPU qualsiasi.
+ *
+ * AVVIO:
+ * - percpu_early_init(): subito dopo il caricamento della GDT. La CPU di
+ *   boot usa un'area statica di appoggio (solo variabili statiche)
+ * - percpu_init(): dopo il VMM. Alloca le unità, vi copia l'area di boot
+ *   e da quel momento percpu_alloc() è disponibile
+ *
+ * Il codice non deve essere interrotto da un cambio di CPU tra il calcolo
+ * di this_cpu_ptr() e l'accesso: oggi non c'è preemption né migrazione.
+ */
+
+/*
+ * ============================================================================
+ * CONFIGURATION CONSTANTS
+ * ============================================================================
+ */
+
+#define PERCPU_MAX_CPUS 64               // CPU gestibili (unità allocate: min(CPU rilevate, limite))
+#define PERCPU_UNIT_SIZE (16 * PAGE_SIZE) // Dimensione di un'unità (statiche + dinamiche)
+#define PERCPU_GRANULE 16                // Granularità dell'allocatore dinamico
+
+/*
+ * ============================================================================
+ * TYPES
+ * ============================================================================
+ */
+
+/**
+ * @brief Intestazione di ogni unità, letta tramite il registro base
+ */
+typedef struct {
+  uptr offset; // Distanza unità - immagine: aggiunta ai puntatori per-CPU
+  uptr cpu;    // Indice logico della CPU (0 = CPU di boot)
+  uptr self;   // Indirizzo dell'unità
+} percpu_header_t;
+
+/*
+ * ============================================================================
+ * VARIABILI STATICHE
+ * ============================================================================
+ */
+
+#define __percpu_section __attribute__((section(".data.percpu")))
+
+/**
+ * @brief Definisce una variabile per-CPU (una copia per CPU)
+ *
+ * Esempio: DEFINE_PER_CPU(u64, irq_count);  this_cpu(irq_count)++;
+ */
+#define DEFINE_PER_CPU(type, name) __percpu_section __typeof__(type) name
+#define DECLARE_PER_CPU(type, name) extern __percpu_section __typeof__(type) name
+
+extern uptr percpu_offsets[PERCPU_MAX_CPUS];
+
+/*
+ * ============================================================================
+ * ACCESSORI
+ * ============================================================================
+ */
+
+/**
+ * @brief Offset dell'unità della CPU corrente rispetto all'immagine
+ */
+static inline uptr this_cpu_offset(void) {
+  return arch_percpu_read(__builtin_offsetof(percpu_header_t, offset));
+}
+
+/**
+ * @brief Indice logico della CPU corrente (senza CPUID)
+ */
+static inline u32 this_cpu_id(void) {
+  return (u32)arch_percpu_read(__builtin_offsetof(percpu_header_t, cpu));
+}
+
+#define this_cpu_ptr(ptr) ((__typeof__(ptr))((uptr)(ptr) + this_cpu_offset()))
+#define per_cpu_ptr(ptr, cpu) ((__typeof__(ptr))((uptr)(ptr) + percpu_offsets[(cpu)]))
+#define this_cpu(var) (*this_cpu_ptr(&(var)))
+#define per_cpu(var, cpu) (*per_cpu_ptr(&(var), (cpu)))
+
+/**
+ * @brief Itera sulle CPU che hanno un'unità
+ */
+#define FOR_EACH_PERCPU_CPU(cpu) for ((cpu) = 0; (cpu) < percpu_cpu_count(); (cpu)++)
+
+/*
+ * ============================================================================
+ * PUBLIC API
+ * ============================================================================
+ */
+
+/**
+ * @brief Attiva l'area di boot sulla CPU corrente
+ *
+ * Va chiamata dopo arch_segment_init(): il caricamento della GDT azzera la
+ * base di GS.
+ */
+void percpu_early_init(void);
+
+/**
+ * @brief Alloca le unità di tutte le CPU e sposta la CPU di boot sulla sua
+ *
+ * @return false se manca memoria (si resta sull'area di boot, una sola CPU)
+ */
+bool percpu_init(void);
+
+/**
+ * @brief Attiva l'unità di una CPU secondaria (dal codice di avvio dell'AP)
+ */
+void percpu_cpu_online(u32 cpu);
+
+/**
+ * @brief Numero di CPU con un'unità (1 prima di percpu_init())
+ */
+u32 percpu_cpu_count(void);
+
+/**
+ * @brief Alloca size byte in ogni unità, azzerati
+ *
+ * @param align Allineamento (potenza di 2, 0 = PERCPU_GRANULE)
+ * @return Puntatore per-CPU (da usare con this_cpu_ptr/per_cpu_ptr) o NULL
+ */
+void *percpu_alloc(size_t size, size_t align);
+
+/**
+ * @brief Rilascia un'allocazione di percpu_alloc()
+ */
+void percpu_free(void *ptr);
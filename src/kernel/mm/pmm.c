@@ -1,9 +1,16 @@
 #include <arch/x86_64/memory/memory.h>
 #include <klib/klog/klog.h>
+#include <klib/lat_hist/lat_hist.h>
+#include <klib/percpu_counter/percpu_counter.h>
 #include <klib/spinlock.h>
+#include <lib/cache.h>
+#include <lib/math/math.h>
 #include <lib/string/string.h>
 #include <lib/types.h>
+#include <mm/cma.h>
+#include <mm/heap/slab.h>
 #include <mm/memory.h>
+#include <mm/memprof.h>
 #include <mm/pmm.h>
 
 /*
@@ -47,24 +54,39 @@
  * ANALOGIA: È come l'ufficio del direttore di un cinema che sa:
  * - Quanti posti ci sono in totale
  * - Dove si trova la mappa dei posti (bitmap)
- * - Da dove iniziare a cercare posti liberi (hint)
  */
 typedef struct {
   bool initialized;   /* PMM è pronto all'uso? */
   u8 *bitmap;         /* Puntatore alla "mappa dei posti" */
   u64 bitmap_size;    /* Quanto è grande la mappa (in byte) */
+  u8 *owners;         /* Descrittori: un pmm_owner_t per pagina, dopo il bitmap */
   u64 total_pages;    /* Quante pagine totali gestiamo */
-  u64 next_free_hint; /* Suggerimento: da dove cercare prossima pagina libera */
 
   /* Cache delle informazioni generali sulla memoria */
   u64 total_memory_bytes;  /* Memoria fisica totale del sistema */
   u64 usable_memory_bytes; /* Memoria che possiamo effettivamente usare */
 } pmm_state_t;
 
+/*
+ * Piazzamento: pmm_state è scritto solo in init e letto a ogni operazione,
+ * quindi sta fra i dati read-mostly. Lock, hint e statistiche cambiano a
+ * ogni allocazione: ognuno su una propria cache line, lontano da pmm_state.
+ */
+static pmm_state_t pmm_state __read_mostly = {.initialized = false};
+static spinlock_t pmm_lock __cacheline_aligned = SPINLOCK_INITIALIZER;
+/* Suggerimento: da dove cercare la prossima pagina libera (sotto pmm_lock) */
+static u64 pmm_next_free_hint __cacheline_aligned;
 /* Statistiche globali - condivise con il resto del kernel */
-static pmm_stats_t pmm_stats;
-static pmm_state_t pmm_state = {.initialized = false};
-static spinlock_t pmm_lock = SPINLOCK_INITIALIZER;
+static pmm_stats_t pmm_stats __cacheline_aligned;
+/* Contatori di operazioni: per-CPU, riportati in pmm_stats alla lettura */
+static percpu_counter_t pmm_alloc_ops __cacheline_aligned;
+static percpu_counter_t pmm_free_ops __cacheline_aligned;
+/* Pagine occupate per proprietario (sotto pmm_lock) */
+static u64 pmm_owner_pages[PMM_OWNER_COUNT] __cacheline_aligned;
+/* Blocchi allineati interamente liberi per ordine: scritti sotto pmm_lock, letti anche senza */
+static u64 pmm_free_blocks[PMM_MAX_ORDER + 1] __cacheline_aligned;
+/* Latenza di pmm_alloc_page(s), lock e ricerca compresi ("lat_hist=lat_pmm_alloc") */
+DEFINE_LAT_HIST(lat_pmm_alloc);
 
 /* -------------------------------------------------------------------------- */
 /*                     HINT MANAGEMENT (THREAD-SAFE READY)                    */
@@ -72,9 +94,9 @@ static spinlock_t pmm_lock = SPINLOCK_INITIALIZER;
 
 static inline void pmm_update_hint_locked(u64 new_hint) {
   if (new_hint < pmm_state.total_pages) {
-    pmm_state.next_free_hint = new_hint;
+    pmm_next_free_hint = new_hint;
   } else {
-    pmm_state.next_free_hint = 0;
+    pmm_next_free_hint = 0;
   }
 }
 
@@ -165,35 +187,225 @@ static bool pmm_is_page_used_internal(u64 page_index) {
   return BITMAP_TEST_BIT(pmm_state.bitmap, page_index) != 0;
 }
 
+/**
+ * @brief Parole da 64 bit del bitmap
+ *
+ * Il bitmap è allineato a pagina e arrotondato a parole intere: la pagina
+ * N è il bit N % 64 della parola N / 64 (x86_64 è little-endian, quindi
+ * coincide con il bit N % 8 del byte N / 8 usato da BITMAP_*_BIT). I bit
+ * oltre total_pages nell'ultima parola restano sempre a 1 (occupati).
+ */
+static inline const u64 *pmm_bitmap_words(void) {
+  return (const u64 *)pmm_state.bitmap;
+}
+
+static inline u64 pmm_bitmap_word_count(void) {
+  return pmm_state.bitmap_size / sizeof(u64);
+}
+
+/**
+ * @brief Conta le pagine occupate a parole, con popcount
+ *
+ * Una parola costa un'istruzione invece di 64 test di bit; i bit di
+ * riempimento dell'ultima parola vengono sottratti.
+ */
+static u64 pmm_count_used_pages(void) {
+  const u64 *words = pmm_bitmap_words();
+  u64 word_count = pmm_bitmap_word_count();
+  u64 used = 0;
+
+  for (u64 w = 0; w < word_count; w++) {
+    used += math_popcount64(words[w]);
+  }
+  return used - (word_count * 64 - pmm_state.total_pages);
+}
+
 /**
  * @brief Ricalcola le statistiche contando tutto il bitmap
  *
  * QUANDO USARLA:
- * Questa funzione è "costosa" (O(n)) perché deve guardare ogni singola
- * pagina. La usiamo solo quando necessiamo accuratezza assoluta,
- * non ad ogni allocazione/deallocazione.
+ * Questa funzione è "costosa" (O(n)) perché deve guardare tutto il
+ * bitmap, anche se una parola da 64 bit alla volta. La usiamo solo
+ * quando necessiamo accuratezza assoluta, non ad ogni
+ * allocazione/deallocazione.
  *
  * ALTERNATIVE PIÙ VELOCI:
  * Durante le operazioni normali, aggiorniamo le statistiche
  * incrementalmente (±1 ad ogni alloc/free) per performance.
  */
 static void pmm_update_stats(void) {
-  u64 free_count = 0;
-  u64 used_count = 0;
+  u64 used_count = pmm_count_used_pages();
+
+  /* Aggiorna le statistiche globali */
+  pmm_stats.free_pages = pmm_state.total_pages - used_count;
+  pmm_stats.used_pages = used_count;
+  pmm_stats.total_pages = pmm_state.total_pages;
+}
+
+/*
+ * ============================================================================
+ * PROPRIETARI - CONTABILITÀ PER TIPO
+ * ============================================================================
+ *
+ * Ogni transizione di una pagina passa da qui, sotto pmm_lock: il
+ * contatore del vecchio proprietario scende, quello del nuovo sale.
+ */
+
+static const char *const pmm_owner_names[PMM_OWNER_COUNT] = {
+    [PMM_OWNER_RESERVED] = "riservate",
+    [PMM_OWNER_BOOT] = "boot",
+    [PMM_OWNER_KERNEL] = "kernel",
+    [PMM_OWNER_PAGE_TABLE] = "page table",
+    [PMM_OWNER_SLAB] = "slab",
+    [PMM_OWNER_HEAP] = "heap buddy",
+    [PMM_OWNER_VMALLOC] = "vmalloc",
+    [PMM_OWNER_USER_ANON] = "anon utente",
+    [PMM_OWNER_PAGE_CACHE] = "page cache",
+    [PMM_OWNER_DMA] = "dma",
+    [PMM_OWNER_CMA] = "cma",
+};
 
-  /* Conta tutte le pagine una per una */
-  for (u64 i = 0; i < pmm_state.total_pages; i++) {
-    if (pmm_is_page_used_internal(i)) {
-      used_count++;
+/**
+ * @brief Pagine appena marcate occupate: proprietario iniziale KERNEL
+ */
+static inline void pmm_owner_claim_locked(u64 start_page, size_t count) {
+  memset(&pmm_state.owners[start_page], PMM_OWNER_KERNEL, count);
+  pmm_owner_pages[PMM_OWNER_KERNEL] += count;
+}
+
+/**
+ * @brief Pagina in liberazione: esce dal contatore del suo proprietario
+ */
+static inline void pmm_owner_release_locked(u64 page_index) {
+  pmm_owner_pages[pmm_state.owners[page_index]]--;
+}
+
+/*
+ * ============================================================================
+ * BLOCCHI LIBERI PER ORDINE - FRAMMENTAZIONE SENZA SCANSIONI
+ * ============================================================================
+ *
+ * Un blocco di ordine k è un gruppo di 2^k pagine allineato a 2^k pagine
+ * (come nel buddy). pmm_free_blocks[k] conta i blocchi di ordine k con
+ * tutte le pagine libere; pmm_free_blocks[0] è quindi il numero di pagine
+ * libere. Da qui escono in O(1) l'ordine più grande disponibile e
+ * l'indice di frammentazione, senza guardare il bitmap.
+ *
+ * AGGIORNAMENTO:
+ * Un'allocazione rompe i blocchi liberi che toccano il range, una
+ * liberazione può completarne di nuovi. Basta guardare i blocchi che
+ * contengono il range, ordine per ordine, e fermarsi al primo ordine in
+ * cui nessuno è (o era) libero: se non c'è un blocco libero di ordine k,
+ * non c'è nemmeno di ordine k+1. Un blocco fino all'ordine 6 sta in una
+ * parola del bitmap, oltre costa 2^(k-6) parole.
+ */
+
+/**
+ * @brief true se il blocco di ordine order è tutto libero
+ */
+static bool pmm_block_is_free(u64 block, u32 order) {
+  u64 first = block << order;
+  if (first + (1ULL << order) > pmm_state.total_pages) {
+    return false;
+  }
+
+  const u64 *words = pmm_bitmap_words();
+  if (order < 6) {
+    u64 mask = ((1ULL << (1U << order)) - 1) << (first % 64);
+    return (words[first / 64] & mask) == 0;
+  }
+
+  for (u64 w = first / 64; w < (first + (1ULL << order)) / 64; w++) {
+    if (words[w]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Aggiorna i blocchi liberi per il range [start, start + count)
+ *
+ * @param freed false: da chiamare PRIMA di marcare il range occupato (i
+ *              blocchi liberi trovati stanno per rompersi); true: DOPO
+ *              averlo marcato libero (i blocchi liberi trovati sono nuovi)
+ */
+static void pmm_blocks_update_locked(u64 start, u64 count, bool freed) {
+  for (u32 order = 0; order <= PMM_MAX_ORDER; order++) {
+    u64 changed = 0;
+
+    if (order == 0) {
+      changed = count; /* Ogni pagina del range cambia stato */
     } else {
-      free_count++;
+      for (u64 block = start >> order; block <= (start + count - 1) >> order; block++) {
+        changed += pmm_block_is_free(block, order);
+      }
     }
+
+    if (changed == 0) {
+      break;
+    }
+
+    u64 value = freed ? pmm_free_blocks[order] + changed : pmm_free_blocks[order] - changed;
+    __atomic_store_n(&pmm_free_blocks[order], value, __ATOMIC_RELAXED);
   }
+}
 
-  /* Aggiorna le statistiche globali */
-  pmm_stats.free_pages = free_count;
-  pmm_stats.used_pages = used_count;
-  pmm_stats.total_pages = pmm_state.total_pages;
+/**
+ * @brief Conta da zero i blocchi liberi per ordine (init e verifica)
+ *
+ * Fino all'ordine 6 i blocchi si contano dentro ogni parola: la maschera
+ * delle pagine libere viene "piegata" su se stessa e a ogni passo resta
+ * un bit per ogni coppia allineata di blocchi liberi dell'ordine prima.
+ */
+static void pmm_count_free_blocks(u64 out[PMM_MAX_ORDER + 1]) {
+  static const u64 fold_mask[6] = {
+      0x5555555555555555ULL, 0x1111111111111111ULL, 0x0101010101010101ULL,
+      0x0001000100010001ULL, 0x0000000100000001ULL, 0x0000000000000001ULL,
+  };
+  const u64 *words = pmm_bitmap_words();
+  u64 word_count = pmm_bitmap_word_count();
+
+  for (u32 order = 0; order <= PMM_MAX_ORDER; order++) {
+    out[order] = 0;
+  }
+
+  for (u64 w = 0; w < word_count; w++) {
+    u64 free_mask = ~words[w]; /* I bit di riempimento sono occupati */
+    out[0] += math_popcount64(free_mask);
+    for (u32 order = 1; order <= 6 && order <= PMM_MAX_ORDER && free_mask; order++) {
+      free_mask &= (free_mask >> (1U << (order - 1))) & fold_mask[order - 1];
+      out[order] += math_popcount64(free_mask);
+    }
+  }
+
+  for (u32 order = 7; order <= PMM_MAX_ORDER; order++) {
+    for (u64 block = 0; (block + 1) << order <= pmm_state.total_pages; block++) {
+      out[order] += pmm_block_is_free(block, order);
+    }
+  }
+}
+
+/**
+ * @brief Marca occupato un range libero: blocchi, bitmap e proprietario
+ */
+static void pmm_mark_range_used_locked(u64 start_page, size_t count) {
+  pmm_blocks_update_locked(start_page, count, false);
+  for (size_t i = 0; i < count; i++) {
+    pmm_mark_page_used(start_page + i);
+  }
+  pmm_owner_claim_locked(start_page, count);
+}
+
+/**
+ * @brief Marca libero un range occupato: bitmap, proprietario e blocchi
+ */
+static void pmm_mark_range_free_locked(u64 start_page, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    pmm_mark_page_free(start_page + i);
+    pmm_owner_release_locked(start_page + i);
+  }
+  pmm_blocks_update_locked(start_page, count, true);
 }
 
 /*
@@ -391,17 +603,22 @@ pmm_result_t pmm_init(void) {
    * STEP 4: DIMENSIONAMENTO E ALLOCAZIONE BITMAP
    *
    * Il bitmap ha bisogno di 1 bit per pagina.
-   * Se abbiamo N pagine, servono N/8 byte (arrotondati in su).
+   * Se abbiamo N pagine, servono N/8 byte, arrotondati in su a parole da
+   * 64 bit: conteggi e verifiche leggono il bitmap una parola alla volta.
    *
-   * ESEMPIO: 262144 pagine → (262144 + 7) / 8 = 32768 byte = 32KB
+   * ESEMPIO: 262144 pagine → (262144 + 63) / 64 * 8 = 32768 byte = 32KB
    *
    * Il bitmap stesso occuperà delle pagine fisiche!
    * 32KB → PAGE_ALIGN_UP(32768) / 4096 = 8 pagine per il bitmap
+   *
+   * Subito dopo il bitmap stanno i descrittori: un byte per pagina con il
+   * proprietario (pmm_owner_t). 262144 pagine → 256KB in più.
    */
-  pmm_state.bitmap_size = (pmm_state.total_pages + 7) / 8;
-  u64 bitmap_pages_needed = PAGE_ALIGN_UP(pmm_state.bitmap_size) / PAGE_SIZE;
+  pmm_state.bitmap_size = (pmm_state.total_pages + 63) / 64 * sizeof(u64);
+  u64 meta_size = pmm_state.bitmap_size + pmm_state.total_pages;
+  u64 bitmap_pages_needed = PAGE_ALIGN_UP(meta_size) / PAGE_SIZE;
 
-  klog_info("PMM: Il bitmap richiede %lu bytes (%lu pagine)", pmm_state.bitmap_size, bitmap_pages_needed);
+  klog_info("PMM: Bitmap e descrittori richiedono %lu bytes (%lu pagine)", meta_size, bitmap_pages_needed);
 
   /*
    * RICERCA POSIZIONE PER IL BITMAP:
@@ -416,12 +633,12 @@ pmm_result_t pmm_init(void) {
     memory_region_t *region = &regions[i];
 
     /* Candidato: regione usabile e abbastanza grande */
-    if (region->type == MEMORY_USABLE && region->length >= pmm_state.bitmap_size) {
+    if (region->type == MEMORY_USABLE && region->length >= meta_size) {
       /* Allineamento: il bitmap deve iniziare a un boundary di pagina */
       u64 aligned_base = PAGE_ALIGN_UP(region->base);
       u64 available = region->base + region->length - aligned_base;
 
-      if (available >= pmm_state.bitmap_size) {
+      if (available >= meta_size) {
         bitmap_addr = aligned_base;
         bitmap_found = true;
         break; /* Primo candidato valido = buono */
@@ -435,6 +652,7 @@ pmm_result_t pmm_init(void) {
   }
 
   pmm_state.bitmap = (u8 *)bitmap_addr;
+  pmm_state.owners = pmm_state.bitmap + pmm_state.bitmap_size;
   pmm_stats.bitmap_pages = bitmap_pages_needed;
 
   klog_info("PMM: Bitmap allocato all'indirizzo 0x%lx", bitmap_addr);
@@ -507,7 +725,7 @@ pmm_result_t pmm_init(void) {
    * SOLUZIONE: Marca esplicitamente come occupate le pagine del bitmap.
    */
   u64 bitmap_start_page = ADDR_TO_PAGE(bitmap_addr);
-  u64 bitmap_end_page = ADDR_TO_PAGE(bitmap_addr + pmm_state.bitmap_size - 1);
+  u64 bitmap_end_page = ADDR_TO_PAGE(bitmap_addr + meta_size - 1);
 
   for (u64 page = bitmap_start_page; page <= bitmap_end_page; page++) {
     pmm_mark_page_used(page);
@@ -532,6 +750,16 @@ pmm_result_t pmm_init(void) {
    * e marchiamo come inizializzato.
    */
   pmm_update_stats();           /* Conta tutto per avere statistiche accurate */
+  pmm_count_free_blocks(pmm_free_blocks);
+
+  /* Proprietari iniziali: bitmap e descrittori al boot, il resto occupato è riservato */
+  memset(pmm_state.owners, PMM_OWNER_RESERVED, pmm_state.total_pages);
+  memset(&pmm_state.owners[bitmap_start_page], PMM_OWNER_BOOT, bitmap_end_page - bitmap_start_page + 1);
+  pmm_owner_pages[PMM_OWNER_BOOT] = bitmap_end_page - bitmap_start_page + 1;
+  pmm_owner_pages[PMM_OWNER_RESERVED] = pmm_stats.used_pages - pmm_owner_pages[PMM_OWNER_BOOT];
+
+  percpu_counter_init(&pmm_alloc_ops, 0, 0);
+  percpu_counter_init(&pmm_free_ops, 0, 0);
   pmm_update_hint(0);           /* Inizia a cercare dall'inizio */
   pmm_state.initialized = true; /* Ora il PMM è operativo! */
 
@@ -561,7 +789,7 @@ pmm_result_t pmm_init(void) {
  * 4. Aggiorna statistiche e hint
  * 5. Restituisce l'indirizzo fisico della pagina
  */
-void *pmm_alloc_page(void) {
+static void *pmm_alloc_page_internal(void) {
   /* Precondizione: PMM deve essere inizializzato */
   if (!pmm_state.initialized) {
     return NULL;
@@ -576,17 +804,17 @@ void *pmm_alloc_page(void) {
   }
 
   /* Cerca pagina libera usando l'hint per ottimizzazione */
-  u64 page_index = pmm_find_free_page_from(pmm_state.next_free_hint);
+  u64 page_index = pmm_find_free_page_from(pmm_next_free_hint);
   if (page_index >= pmm_state.total_pages) {
     spinlock_unlock(&pmm_lock);
     return NULL; /* Nessuna pagina trovata */
   }
 
   /* Allocazione riuscita: aggiorna stato e statistiche */
-  pmm_mark_page_used(page_index);
+  pmm_mark_range_used_locked(page_index, 1);
   pmm_stats.free_pages--;
   pmm_stats.used_pages++;
-  pmm_stats.alloc_count++;
+  percpu_counter_inc(&pmm_alloc_ops);
 
   /* Aggiorna hint per la prossima ricerca (località temporale) */
   pmm_update_hint_locked(page_index + 1);
@@ -596,6 +824,15 @@ void *pmm_alloc_page(void) {
   return (void *)PAGE_TO_ADDR(page_index);
 }
 
+void *pmm_alloc_page(void) {
+  u64 lat = lat_hist_start(lat_pmm_alloc);
+  void *page = pmm_alloc_page_internal();
+  lat_hist_stop(lat_pmm_alloc, lat);
+
+  memprof_alloc(page, PAGE_SIZE, MEMPROF_PMM, ftrace_return_address());
+  return page;
+}
+
 /**
  * @brief Alloca multiple pagine fisiche contigue
  *
@@ -609,7 +846,7 @@ void *pmm_alloc_page(void) {
  * è frammentata. Questa operazione può fallire anche se ci sono
  * N pagine libere totali ma non consecutive.
  */
-void *pmm_alloc_pages(size_t count) {
+static void *pmm_alloc_pages_internal(size_t count) {
   /* Validazione parametri */
   if (!pmm_state.initialized || count == 0) {
     return NULL;
@@ -624,21 +861,19 @@ void *pmm_alloc_pages(size_t count) {
   }
 
   /* Cerca blocco contiguo di 'count' pagine */
-  u64 start_page = pmm_find_free_pages_from(pmm_state.next_free_hint, count);
+  u64 start_page = pmm_find_free_pages_from(pmm_next_free_hint, count);
   if (start_page >= pmm_state.total_pages) {
     spinlock_unlock(&pmm_lock);
     return NULL; /* Nessun blocco contiguo disponibile */
   }
 
   /* Allocazione riuscita: marca tutte le pagine come occupate */
-  for (size_t i = 0; i < count; i++) {
-    pmm_mark_page_used(start_page + i);
-  }
+  pmm_mark_range_used_locked(start_page, count);
 
   /* Aggiorna statistiche */
   pmm_stats.free_pages -= count;
   pmm_stats.used_pages += count;
-  pmm_stats.alloc_count++;
+  percpu_counter_inc(&pmm_alloc_ops);
 
   /* Aggiorna hint con controllo overflow */
   pmm_update_hint_locked(start_page + count);
@@ -647,6 +882,15 @@ void *pmm_alloc_pages(size_t count) {
   return (void *)PAGE_TO_ADDR(start_page);
 }
 
+void *pmm_alloc_pages(size_t count) {
+  u64 lat = lat_hist_start(lat_pmm_alloc);
+  void *pages = pmm_alloc_pages_internal(count);
+  lat_hist_stop(lat_pmm_alloc, lat);
+
+  memprof_alloc(pages, count * PAGE_SIZE, MEMPROF_PMM, ftrace_return_address());
+  return pages;
+}
+
 /**
  * @brief Libera una singola pagina fisica
  *
@@ -675,6 +919,11 @@ pmm_result_t pmm_free_page(void *page) {
     return PMM_INVALID_ADDRESS;
   }
 
+  /* Le pagine prestate dalla regione CMA tornano alla regione, non al bitmap */
+  if (cma_contains(addr)) {
+    return cma_free_page(addr) ? PMM_SUCCESS : PMM_ALREADY_FREE;
+  }
+
   u64 page_index = ADDR_TO_PAGE(addr);
 
   spinlock_lock(&pmm_lock);
@@ -692,18 +941,19 @@ pmm_result_t pmm_free_page(void *page) {
   }
 
   /* Liberazione: marca come libera e aggiorna statistiche */
-  pmm_mark_page_free(page_index);
+  pmm_mark_range_free_locked(page_index, 1);
   pmm_stats.free_pages++;
   pmm_stats.used_pages--;
-  pmm_stats.free_count++;
+  percpu_counter_inc(&pmm_free_ops);
 
   /* Aggiorna hint se questa pagina è "più a sinistra" dell'hint corrente */
-  if (page_index < pmm_state.next_free_hint) {
+  if (page_index < pmm_next_free_hint) {
     pmm_update_hint_locked(page_index);
   }
 
   spinlock_unlock(&pmm_lock);
 
+  memprof_free(page);
   return PMM_SUCCESS;
 }
 
@@ -756,25 +1006,87 @@ pmm_result_t pmm_free_pages(void *pages, size_t count) {
   }
 
   /* Validazione OK: ora libera tutte le pagine */
-  for (size_t i = 0; i < count; i++) {
-    pmm_mark_page_free(start_page + i);
-  }
+  pmm_mark_range_free_locked(start_page, count);
 
   /* Aggiorna statistiche */
   pmm_stats.free_pages += count;
   pmm_stats.used_pages -= count;
-  pmm_stats.free_count++;
+  percpu_counter_inc(&pmm_free_ops);
 
   /* Aggiorna hint */
-  if (start_page < pmm_state.next_free_hint) {
+  if (start_page < pmm_next_free_hint) {
     pmm_update_hint_locked(start_page);
   }
 
   spinlock_unlock(&pmm_lock);
 
+  memprof_free(pages);
   return PMM_SUCCESS;
 }
 
+/**
+ * @brief Libera un insieme di pagine sparse con un solo lock
+ *
+ * Pensata per la distruzione degli spazi: le pagine arrivano a gruppi da
+ * un page walk e non sono contigue. Invece di N coppie lock/unlock si
+ * prende pmm_lock una volta per batch.
+ *
+ * Le pagine CMA vengono restituite alla regione PRIMA di prendere pmm_lock
+ * (cma_alloc() chiama il PMM con il proprio lock preso: l'ordine opposto
+ * rischierebbe un deadlock). Indirizzi non validi o già liberi vengono
+ * saltati e non contati.
+ */
+size_t pmm_free_pages_batch(void *const *pages, size_t count) {
+  if (!pmm_state.initialized || !pages || count == 0) {
+    return 0;
+  }
+
+  size_t freed = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    u64 addr = (u64)pages[i];
+    if (addr && cma_contains(addr) && cma_free_page(addr)) {
+      freed++;
+    }
+  }
+
+  u64 lowest = ~0ULL;
+
+  spinlock_lock(&pmm_lock);
+
+  for (size_t i = 0; i < count; i++) {
+    u64 addr = (u64)pages[i];
+    if (!addr || addr % PAGE_SIZE != 0 || cma_contains(addr)) {
+      continue;
+    }
+
+    u64 page_index = ADDR_TO_PAGE(addr);
+    if (page_index >= pmm_state.total_pages || !pmm_is_page_used_internal(page_index)) {
+      continue;
+    }
+
+    pmm_mark_range_free_locked(page_index, 1);
+    pmm_stats.free_pages++;
+    pmm_stats.used_pages--;
+    memprof_free(pages[i]);
+    freed++;
+
+    if (page_index < lowest) {
+      lowest = page_index;
+    }
+  }
+
+  percpu_counter_inc(&pmm_free_ops);
+
+  if (lowest < pmm_next_free_hint) {
+    pmm_update_hint_locked(lowest);
+  }
+
+  spinlock_unlock(&pmm_lock);
+
+  return freed;
+}
+
 /**
  * @brief Controlla se una pagina è libera (query non-distruttiva)
  *
@@ -815,6 +1127,9 @@ const pmm_stats_t *pmm_get_stats(void) {
   if (!pmm_state.initialized) {
     return NULL;
   }
+  // I contatori di operazioni vivono per-CPU: la copia si aggiorna qui
+  pmm_stats.alloc_count = percpu_counter_sum_positive(&pmm_alloc_ops);
+  pmm_stats.free_count = percpu_counter_sum_positive(&pmm_free_ops);
   return &pmm_stats;
 }
 
@@ -843,24 +1158,44 @@ void pmm_print_info(void) {
   klog_info("Pagine libere: %lu (%lu MB)", pmm_stats.free_pages, pmm_stats.free_pages * PAGE_SIZE / MB);
   klog_info("Pagine occupate: %lu (%lu MB)", pmm_stats.used_pages, pmm_stats.used_pages * PAGE_SIZE / MB);
   klog_info("Pagine riservate: %lu (%lu MB)", pmm_stats.reserved_pages, pmm_stats.reserved_pages * PAGE_SIZE / MB);
-  klog_info("Bitmap: %lu pagine (%lu KB)", pmm_stats.bitmap_pages, pmm_state.bitmap_size / KB);
-  klog_info("Operazioni: %lu allocazioni, %lu deallocazioni", pmm_stats.alloc_count, pmm_stats.free_count);
+  klog_info("Bitmap e descrittori: %lu pagine (%lu KB di bitmap)", pmm_stats.bitmap_pages, pmm_state.bitmap_size / KB);
+  klog_info("Operazioni: %lu allocazioni, %lu deallocazioni", percpu_counter_sum_positive(&pmm_alloc_ops), percpu_counter_sum_positive(&pmm_free_ops));
 
   /* Calcola e mostra percentuale di utilizzo */
   u64 usage_percent = (pmm_stats.used_pages * 100) / pmm_stats.total_pages;
   klog_info("Utilizzo memoria: %lu%%", usage_percent);
+
+  /* Ripartizione delle pagine occupate: solo contatori, nessuna scansione */
+  u64 owners[PMM_OWNER_COUNT];
+  pmm_get_owner_stats(owners);
+  klog_info("Pagine occupate per proprietario:");
+  for (u32 owner = 0; owner < PMM_OWNER_COUNT; owner++) {
+    if (owners[owner]) {
+      klog_info("  %s: %lu pagine (%lu KB)", pmm_owner_names[owner], owners[owner], owners[owner] * PAGE_SIZE / KB);
+    }
+  }
+
+  /* Dettaglio delle slab: una pagina per slab, contata da ogni cache */
+  for (u32 i = 0; i < slab_cache_count; i++) {
+    const slab_cache_t *cache = &slab_caches[i];
+    if (cache->magic == SLAB_MAGIC_CACHE && cache->total_slabs) {
+      klog_info("    slab %s: %u pagine", cache->name, cache->total_slabs);
+    }
+  }
 }
 
 /**
  * @brief Verifica integrità del PMM (operazione costosa!)
  *
  * QUANDO USARLA:
- * Solo durante debugging o dopo operazioni sospette. È O(n) quindi
- * lenta su sistemi con molta memoria.
+ * Solo durante debugging o dopo operazioni sospette. È O(n), anche se
+ * a parole da 64 bit con popcount, quindi lenta su sistemi con molta
+ * memoria. Tiene pmm_lock per tutto il conteggio.
  *
  * COSA CONTROLLA:
  * 1. Le statistiche corrispondono al contenuto effettivo del bitmap?
  * 2. Non ci sono inconsistenze nei contatori?
+ * 3. I blocchi liberi per ordine corrispondono a un conteggio da zero?
  *
  * SE FALLISCE:
  * Indica bug nel PMM o corruzione della memoria → sistema instabile
@@ -870,17 +1205,11 @@ bool pmm_check_integrity(void) {
     return false;
   }
 
-  u64 free_count = 0;
-  u64 used_count = 0;
+  spinlock_lock(&pmm_lock);
 
-  /* Conta manualmente tutto il bitmap */
-  for (u64 i = 0; i < pmm_state.total_pages; i++) {
-    if (pmm_is_page_used_internal(i)) {
-      used_count++;
-    } else {
-      free_count++;
-    }
-  }
+  /* Conta tutto il bitmap, una parola da 64 bit alla volta */
+  u64 used_count = pmm_count_used_pages();
+  u64 free_count = pmm_state.total_pages - used_count;
 
   /* Confronta con le statistiche cached */
   bool consistent = (free_count == pmm_stats.free_pages) && (used_count == pmm_stats.used_pages);
@@ -892,6 +1221,18 @@ bool pmm_check_integrity(void) {
     klog_error("  Il sistema potrebbe essere instabile!");
   }
 
+  /* I blocchi liberi incrementali devono coincidere con un conteggio da zero */
+  u64 blocks[PMM_MAX_ORDER + 1];
+  pmm_count_free_blocks(blocks);
+  for (u32 order = 0; order <= PMM_MAX_ORDER; order++) {
+    if (blocks[order] != pmm_free_blocks[order]) {
+      klog_error("PMM: Blocchi liberi di ordine %u: contati %lu, contatore %lu", order, blocks[order], pmm_free_blocks[order]);
+      consistent = false;
+    }
+  }
+
+  spinlock_unlock(&pmm_lock);
+
   return consistent;
 }
 
@@ -908,6 +1249,10 @@ bool pmm_validate_stats(void) {
     klog_error("PMM: Largest free run invalid: %lu > %lu", pmm_stats.largest_free_run, pmm_stats.free_pages);
     return false;
   }
+  if (pmm_free_blocks[0] != pmm_stats.free_pages) {
+    klog_error("PMM: Free blocks of order 0 invalid: %lu != %lu", pmm_free_blocks[0], pmm_stats.free_pages);
+    return false;
+  }
   return true;
 }
 
@@ -921,7 +1266,10 @@ bool pmm_validate_stats(void) {
  *
  * ALGORITMO "SLIDING WINDOW":
  * Scorre tutto il bitmap tenendo traccia della sequenza corrente
- * di pagine libere e del record massimo trovato finora.
+ * di pagine libere e del record massimo trovato finora. Le parole da
+ * 64 bit tutte libere o tutte occupate si saltano senza guardare i bit.
+ *
+ * Resta O(n): per il monitoraggio periodico usare i blocchi per ordine.
  */
 size_t pmm_find_largest_free_run(size_t *start_page) {
   if (!pmm_state.initialized) {
@@ -933,22 +1281,49 @@ size_t pmm_find_largest_free_run(size_t *start_page) {
   size_t max_start = 0;     /* Dove inizia la sequenza più lunga */
   size_t current_start = 0; /* Dove inizia la sequenza corrente */
 
-  for (u64 i = 0; i < pmm_state.total_pages; i++) {
-    if (!pmm_is_page_used_internal(i)) {
-      /* Pagina libera: estendi sequenza corrente */
+  const u64 *words = pmm_bitmap_words();
+  u64 word_count = pmm_bitmap_word_count();
+
+  for (u64 w = 0; w < word_count; w++) {
+    u64 word = words[w];
+
+    /* Parola tutta occupata: la sequenza corrente si interrompe */
+    if (word == ~0ULL) {
+      current_run = 0;
+      continue;
+    }
+
+    /* Parola tutta libera: 64 pagine in un colpo (mai di riempimento) */
+    if (word == 0) {
       if (current_run == 0) {
-        current_start = i; /* Inizio nuova sequenza */
+        current_start = w * 64;
       }
-      current_run++;
-
-      /* Nuovo record? */
+      current_run += 64;
       if (current_run > max_run) {
         max_run = current_run;
         max_start = current_start;
       }
-    } else {
-      /* Pagina occupata: interrompi sequenza corrente */
-      current_run = 0;
+      continue;
+    }
+
+    /* Parola mista: bit per bit */
+    for (u32 bit = 0; bit < 64; bit++) {
+      if (!(word & (1ULL << bit))) {
+        /* Pagina libera: estendi sequenza corrente */
+        if (current_run == 0) {
+          current_start = w * 64 + bit; /* Inizio nuova sequenza */
+        }
+        current_run++;
+
+        /* Nuovo record? */
+        if (current_run > max_run) {
+          max_run = current_run;
+          max_start = current_start;
+        }
+      } else {
+        /* Pagina occupata: interrompi sequenza corrente */
+        current_run = 0;
+      }
     }
   }
 
@@ -965,14 +1340,14 @@ size_t pmm_find_largest_free_run(size_t *start_page) {
 /**
  * @brief Analisi dettagliata della frammentazione
  *
- * METRICHE DI FRAMMENTAZIONE:
- * - Blocco contiguo più grande
- * - Percentuale di frammentazione
- * - Posizione del blocco più grande
+ * METRICHE DI FRAMMENTAZIONE (tutte dai contatori per ordine, O(1)):
+ * - Blocchi liberi per ordine
+ * - Ordine più grande disponibile
+ * - Indice di frammentazione per un blocco da 2MB (ordine 9)
  *
  * INTERPRETAZIONE:
- * - Frammentazione 0%: Tutta la memoria libera è in un unico blocco
- * - Frammentazione 50%: La memoria libera è abbastanza frammentata
+ * - Frammentazione 0%: Tutta la memoria libera è in blocchi da 2MB
+ * - Frammentazione 50%: Metà della memoria libera non serve un blocco da 2MB
  * - Frammentazione 90%+: Memoria molto frammentata, difficile allocare blocchi grandi
  */
 void pmm_print_fragmentation_info(void) {
@@ -980,29 +1355,62 @@ void pmm_print_fragmentation_info(void) {
     return;
   }
 
-  size_t start_page;
-  size_t largest_run = pmm_find_largest_free_run(&start_page);
+  u64 blocks[PMM_MAX_ORDER + 1];
+  pmm_get_free_blocks(blocks);
 
   klog_info("=== ANALISI FRAMMENTAZIONE MEMORIA ===");
-  klog_info("Blocco contiguo più grande: %lu pagine (%lu MB)", largest_run, largest_run * PAGE_SIZE / MB);
+  for (u32 order = 0; order <= PMM_MAX_ORDER; order++) {
+    klog_info("Ordine %2u (%5lu KB): %lu blocchi liberi", order, (PAGE_SIZE << order) / KB, blocks[order]);
+  }
 
-  if (largest_run > 0) {
-    klog_info("Posizione: pagina %lu (indirizzo fisico 0x%lx)", start_page, PAGE_TO_ADDR(start_page));
+  int largest_order = pmm_largest_free_order();
+  if (largest_order < 0) {
+    klog_info("Nessuna pagina libera");
+    return;
   }
+  klog_info("Blocco allineato più grande: ordine %d (%lu KB)", largest_order, (PAGE_SIZE << largest_order) / KB);
 
-  /* Calcola percentuale di frammentazione */
-  if (pmm_stats.free_pages > 0) {
-    u64 fragmentation = 100 - ((largest_run * 100) / pmm_stats.free_pages);
-    klog_info("Frammentazione: %lu%%", fragmentation);
+  /* Frammentazione vista da un'allocazione da 2MB (una huge page) */
+  u32 order = PMM_MAX_ORDER < 9 ? PMM_MAX_ORDER : 9;
+  u32 fragmentation = pmm_fragmentation_index(order) / 10;
+  klog_info("Frammentazione (ordine %u): %u%%", order, fragmentation);
 
-    if (fragmentation < 20) {
-      klog_info("→ Memoria poco frammentata (ottimo)");
-    } else if (fragmentation < 50) {
-      klog_info("→ Frammentazione moderata (accettabile)");
-    } else {
-      klog_warn("→ Memoria molto frammentata (problematico per allocazioni grandi)");
+  if (fragmentation < 20) {
+    klog_info("→ Memoria poco frammentata (ottimo)");
+  } else if (fragmentation < 50) {
+    klog_info("→ Frammentazione moderata (accettabile)");
+  } else {
+    klog_warn("→ Memoria molto frammentata (problematico per allocazioni grandi)");
+  }
+}
+
+void pmm_get_free_blocks(u64 out[PMM_MAX_ORDER + 1]) {
+  for (u32 order = 0; order <= PMM_MAX_ORDER; order++) {
+    out[order] = __atomic_load_n(&pmm_free_blocks[order], __ATOMIC_RELAXED);
+  }
+}
+
+int pmm_largest_free_order(void) {
+  for (int order = PMM_MAX_ORDER; order >= 0; order--) {
+    if (__atomic_load_n(&pmm_free_blocks[order], __ATOMIC_RELAXED)) {
+      return order;
     }
   }
+  return -1;
+}
+
+u32 pmm_fragmentation_index(u32 order) {
+  if (order > PMM_MAX_ORDER) {
+    return 1000;
+  }
+
+  /* Letture senza lock: i due contatori possono essere di istanti diversi */
+  u64 free_pages = __atomic_load_n(&pmm_free_blocks[0], __ATOMIC_RELAXED);
+  u64 usable = __atomic_load_n(&pmm_free_blocks[order], __ATOMIC_RELAXED) << order;
+  if (free_pages == 0 || usable >= free_pages) {
+    return free_pages ? 0 : 1000;
+  }
+  return (u32)((free_pages - usable) * 1000 / free_pages);
 }
 
 /*
@@ -1055,13 +1463,11 @@ void *pmm_alloc_pages_in_range(size_t count, u64 min_addr, u64 max_addr) {
     }
 
     if (found) {
-      for (size_t i = 0; i < count; i++) {
-        pmm_mark_page_used(p + i);
-      }
+      pmm_mark_range_used_locked(p, count);
 
       pmm_stats.free_pages -= count;
       pmm_stats.used_pages += count;
-      pmm_stats.alloc_count++;
+      percpu_counter_inc(&pmm_alloc_ops);
 
       pmm_update_hint_locked(p + count);
       spinlock_unlock(&pmm_lock);
@@ -1096,7 +1502,7 @@ void *pmm_alloc_aligned(size_t pages, size_t alignment) {
 
   spinlock_lock(&pmm_lock);
 
-  for (u64 p = pmm_state.next_free_hint; p + pages <= pmm_state.total_pages; p++) {
+  for (u64 p = pmm_next_free_hint; p + pages <= pmm_state.total_pages; p++) {
     if (PAGE_TO_ADDR(p) % alignment != 0)
       continue;
 
@@ -1110,13 +1516,11 @@ void *pmm_alloc_aligned(size_t pages, size_t alignment) {
     }
 
     if (found) {
-      for (size_t i = 0; i < pages; i++) {
-        pmm_mark_page_used(p + i);
-      }
+      pmm_mark_range_used_locked(p, pages);
 
       pmm_stats.free_pages -= pages;
       pmm_stats.used_pages += pages;
-      pmm_stats.alloc_count++;
+      percpu_counter_inc(&pmm_alloc_ops);
 
       pmm_update_hint_locked(p + pages);
       spinlock_unlock(&pmm_lock);
@@ -1125,7 +1529,7 @@ void *pmm_alloc_aligned(size_t pages, size_t alignment) {
     }
   }
 
-  for (u64 p = 0; p < pmm_state.next_free_hint && p + pages <= pmm_state.total_pages; p++) {
+  for (u64 p = 0; p < pmm_next_free_hint && p + pages <= pmm_state.total_pages; p++) {
     if (PAGE_TO_ADDR(p) % alignment != 0)
       continue;
 
@@ -1139,13 +1543,11 @@ void *pmm_alloc_aligned(size_t pages, size_t alignment) {
     }
 
     if (found) {
-      for (size_t i = 0; i < pages; i++) {
-        pmm_mark_page_used(p + i);
-      }
+      pmm_mark_range_used_locked(p, pages);
 
       pmm_stats.free_pages -= pages;
       pmm_stats.used_pages += pages;
-      pmm_stats.alloc_count++;
+      percpu_counter_inc(&pmm_alloc_ops);
 
       pmm_update_hint_locked(p + pages);
       spinlock_unlock(&pmm_lock);
@@ -1192,6 +1594,52 @@ bool pmm_get_page_info(void *page, u64 *page_index, bool *is_free) {
   return true; /* Informazioni valide */
 }
 
+/**
+ * @brief Riassegna pagine occupate a un nuovo proprietario
+ *
+ * Sposta ogni pagina dal contatore del vecchio proprietario a quello
+ * del nuovo. La regione CMA resta intera sotto PMM_OWNER_CMA: le sue
+ * pagine tornano alla regione e non passano da pmm_owner_release_locked().
+ */
+void pmm_set_owner(void *pages, size_t count, pmm_owner_t owner) {
+  if (!pmm_state.initialized || !pages || owner >= PMM_OWNER_COUNT) {
+    return;
+  }
+
+  u64 addr = (u64)pages;
+  if (addr % PAGE_SIZE != 0 || cma_contains(addr)) {
+    return;
+  }
+
+  u64 start_page = ADDR_TO_PAGE(addr);
+
+  spinlock_lock(&pmm_lock);
+
+  for (size_t i = 0; i < count && start_page + i < pmm_state.total_pages; i++) {
+    u64 page_index = start_page + i;
+    if (!pmm_is_page_used_internal(page_index)) {
+      continue;
+    }
+    pmm_owner_pages[pmm_state.owners[page_index]]--;
+    pmm_owner_pages[owner]++;
+    pmm_state.owners[page_index] = (u8)owner;
+  }
+
+  spinlock_unlock(&pmm_lock);
+}
+
+void pmm_get_owner_stats(u64 out[PMM_OWNER_COUNT]) {
+  spinlock_lock(&pmm_lock);
+  for (u32 owner = 0; owner < PMM_OWNER_COUNT; owner++) {
+    out[owner] = pmm_owner_pages[owner];
+  }
+  spinlock_unlock(&pmm_lock);
+}
+
+const char *pmm_owner_name(pmm_owner_t owner) {
+  return owner < PMM_OWNER_COUNT ? pmm_owner_names[owner] : "?";
+}
+
 /*
  * ============================================================================
  * CONCLUSIONI E NOTE PEDAGOGICHE
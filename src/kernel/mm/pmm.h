@@ -14,6 +14,12 @@
  */
 #define PMM_MAX_REASONABLE_ALLOC_PAGES (1UL << 20)
 
+/*
+ * Ordine massimo seguito dalle metriche di frammentazione: blocchi
+ * allineati fino a 2^10 pagine (4MB), come il MAX_ORDER del buddy.
+ */
+#define PMM_MAX_ORDER 10
+
 /**
  * @file mm/pmm.h
  * @brief Physical Memory Manager - Architecture Agnostic
@@ -49,6 +55,31 @@ typedef enum {
   PMM_NOT_INITIALIZED  /* PMM non ancora inizializzato */
 } pmm_result_t;
 
+/**
+ * @brief Proprietario di una pagina occupata
+ *
+ * Ogni pagina occupata ha un proprietario, registrato nel suo descrittore
+ * (un byte per pagina, accanto al bitmap). Le allocazioni partono come
+ * PMM_OWNER_KERNEL; il sottosistema che usa la pagina la riassegna con
+ * pmm_set_owner(). Un contatore per tipo segue ogni transizione
+ * (allocazione, riassegnazione, liberazione): la ripartizione della
+ * memoria occupata costa O(tipi), senza scansioni.
+ */
+typedef enum {
+  PMM_OWNER_RESERVED,   /* Firmware, buchi e regioni non usabili (dal boot) */
+  PMM_OWNER_BOOT,       /* Strutture di boot: descrittori PMM/CMA, aree per-CPU */
+  PMM_OWNER_KERNEL,     /* Allocazioni del kernel non classificate */
+  PMM_OWNER_PAGE_TABLE, /* Page table */
+  PMM_OWNER_SLAB,       /* Pagine delle slab (il dettaglio per cache è in slab_cache_t) */
+  PMM_OWNER_HEAP,       /* Heap buddy */
+  PMM_OWNER_VMALLOC,    /* Mapping virtuali del kernel */
+  PMM_OWNER_USER_ANON,  /* Pagine anonime degli spazi utente */
+  PMM_OWNER_PAGE_CACHE, /* Cache delle pagine dei file */
+  PMM_OWNER_DMA,        /* Buffer e pool DMA */
+  PMM_OWNER_CMA,        /* Regione CMA (riservata, anche se prestata) */
+  PMM_OWNER_COUNT
+} pmm_owner_t;
+
 /**
  * @brief Statistiche del PMM
  *
@@ -63,8 +94,8 @@ typedef struct {
   u64 bitmap_pages;   /* Pagine usate dal bitmap stesso */
 
   /* Statistiche di utilizzo */
-  u64 alloc_count;      /* Numero totale di allocazioni */
-  u64 free_count;       /* Numero totale di deallocazioni */
+  u64 alloc_count;      /* Numero totale di allocazioni (al momento di pmm_get_stats) */
+  u64 free_count;       /* Numero totale di deallocazioni (al momento di pmm_get_stats) */
   u64 largest_free_run; /* Sequenza più lunga di pagine libere contigue */
 } pmm_stats_t;
 
@@ -169,6 +200,18 @@ pmm_result_t pmm_free_page(void *page);
  */
 pmm_result_t pmm_free_pages(void *pages, size_t count);
 
+/**
+ * @brief Libera pagine singole non contigue prendendo il lock una volta
+ *
+ * @param pages Array di indirizzi fisici (le voci NULL sono ignorate)
+ * @param count Numero di voci nell'array
+ * @return Numero di pagine effettivamente liberate
+ *
+ * @note Le pagine non valide o già libere vengono saltate, non è un
+ *       errore fatale per il batch
+ */
+size_t pmm_free_pages_batch(void *const *pages, size_t count);
+
 /*
  * ============================================================================
  * QUERY AND INSPECTION API
@@ -217,6 +260,33 @@ const pmm_stats_t *pmm_get_stats(void);
  */
 bool pmm_get_page_info(void *page, u64 *page_index, bool *is_free);
 
+/**
+ * @brief Riassegna pagine occupate a un proprietario
+ *
+ * Da chiamare subito dopo l'allocazione, dal sottosistema che userà le
+ * pagine. Le pagine libere, fuori range o della regione CMA (che ha un
+ * proprietario unico) vengono ignorate.
+ *
+ * @param pages Indirizzo fisico della prima pagina
+ * @param count Numero di pagine contigue
+ * @param owner Nuovo proprietario
+ */
+void pmm_set_owner(void *pages, size_t count, pmm_owner_t owner);
+
+/**
+ * @brief Pagine occupate per proprietario
+ *
+ * @param out Array di PMM_OWNER_COUNT contatori, letti sotto lock
+ *
+ * @note O(PMM_OWNER_COUNT): i contatori sono mantenuti a ogni transizione
+ */
+void pmm_get_owner_stats(u64 out[PMM_OWNER_COUNT]);
+
+/**
+ * @brief Nome leggibile di un proprietario
+ */
+const char *pmm_owner_name(pmm_owner_t owner);
+
 /*
  * ============================================================================
  * ANALYSIS AND DEBUGGING API
@@ -234,8 +304,9 @@ void pmm_print_info(void);
 /**
  * @brief Verifica l'integrità del bitmap interno
  *
- * Controlla che il bitmap sia consistente e che le statistiche
- * corrispondano allo stato effettivo. Operazione lenta ma completa.
+ * Controlla che il bitmap sia consistente e che le statistiche e i
+ * blocchi liberi per ordine corrispondano allo stato effettivo.
+ * Operazione lenta ma completa (popcount a parole da 64 bit).
  *
  * @return true se il bitmap è integro e consistente
  * @return false se rileva corruzioni o inconsistenze
@@ -254,13 +325,14 @@ bool pmm_validate_stats(void);
  * @brief Trova la sequenza più lunga di pagine libere contigue
  *
  * Analizza l'intero bitmap per trovare il blocco contiguo più grande
- * di pagine libere. Utile per analisi frammentazione e capacità massima.
+ * di pagine libere, anche non allineato. Per il monitoraggio bastano
+ * pmm_largest_free_order() e pmm_fragmentation_index(), che non scansionano.
  *
  * @param start_page[out] Puntatore dove salvare l'indice della prima pagina (opzionale)
  * @return Numero di pagine nella sequenza più lunga trovata
  * @return 0 se nessuna pagina libera o PMM non inizializzato
  *
- * @note Operazione O(n) - può essere lenta su sistemi con molta memoria
+ * @note Operazione O(n) a parole da 64 bit - lenta su sistemi con molta memoria
  * @note Aggiorna anche la statistica pmm_stats.largest_free_run
  */
 size_t pmm_find_largest_free_run(size_t *start_page);
@@ -268,11 +340,41 @@ size_t pmm_find_largest_free_run(size_t *start_page);
 /**
  * @brief Stampa statistiche dettagliate di frammentazione
  *
- * Analizza la frammentazione della memoria e stampa informazioni
- * su blocchi contigui, frammentazione percentuale, e distribuzioni.
+ * Blocchi liberi per ordine, ordine più grande disponibile e indice di
+ * frammentazione: tutto dai contatori, senza scansioni del bitmap.
  */
 void pmm_print_fragmentation_info(void);
 
+/**
+ * @brief Blocchi liberi per ordine
+ *
+ * out[k] = blocchi di 2^k pagine, allineati a 2^k pagine, con tutte le
+ * pagine libere (out[0] = pagine libere). I contatori sono aggiornati a
+ * ogni allocazione e liberazione e letti senza lock: adatti al
+ * monitoraggio periodico, non a decidere un'allocazione.
+ *
+ * @note O(PMM_MAX_ORDER)
+ */
+void pmm_get_free_blocks(u64 out[PMM_MAX_ORDER + 1]);
+
+/**
+ * @brief Ordine del blocco allineato libero più grande
+ *
+ * @return Da 0 a PMM_MAX_ORDER, -1 se non ci sono pagine libere
+ */
+int pmm_largest_free_order(void);
+
+/**
+ * @brief Indice di frammentazione per un ordine, in millesimi
+ *
+ * Quota della memoria libera che NON può servire un blocco allineato di
+ * 2^order pagine: 0 = tutta la memoria libera è in blocchi di quell'ordine,
+ * 1000 = nessun blocco di quell'ordine (o nessuna pagina libera).
+ *
+ * @note O(1)
+ */
+u32 pmm_fragmentation_index(u32 order);
+
 /*
  * ============================================================================
  * ADVANCED ALLOCATION API (TODO - FUTURE EXTENSIONS)
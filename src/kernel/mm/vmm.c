@@ -1,7 +1,10 @@
 #include <klib/klog/klog.h>
+#include <klib/lat_hist/lat_hist.h>
 #include <klib/spinlock.h>
+#include <lib/cache.h>
 #include <lib/string/string.h>
 #include <lib/types.h>
+#include <mm/ksm.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
 
@@ -45,6 +48,17 @@ extern bool arch_vmm_map_pages(vmm_space_t *space, u64 virt_addr, u64 phys_addr,
 extern void arch_vmm_unmap_pages(vmm_space_t *space, u64 virt_addr, size_t page_count);
 extern bool arch_vmm_resolve(vmm_space_t *space, u64 virt_addr, u64 *phys_addr);
 extern bool arch_vmm_check_integrity(vmm_space_t *space);
+extern bool arch_vmm_query(vmm_space_t *space, u64 virt_addr, u64 *phys_addr, u64 *flags);
+extern bool arch_vmm_protect(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags);
+extern bool arch_vmm_replace_page(vmm_space_t *space, u64 virt_addr, u64 old_phys, u64 new_phys, u64 flags);
+extern vmm_space_t *arch_vmm_get_current_space(void);
+extern bool arch_vmm_reserve(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags);
+extern bool arch_vmm_query_reserved(vmm_space_t *space, u64 virt_addr, u64 *flags);
+extern bool arch_vmm_populate(vmm_space_t *space, u64 virt_addr, u64 phys_addr, u64 flags);
+extern size_t arch_vmm_teardown_work(size_t budget);
+extern size_t arch_vmm_walk(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_walk_fn_t fn, void *arg);
+extern size_t arch_vmm_discard(vmm_space_t *space, u64 virt_addr, size_t page_count, bool lazy_only);
+extern size_t arch_vmm_lazyfree(vmm_space_t *space, u64 virt_addr, size_t page_count);
 extern void *vmm_phys_to_virt(u64 phys_addr);
 extern u64 vmm_virt_to_phys(u64 virt_addr);
 
@@ -60,7 +74,10 @@ extern u64 vmm_virt_to_phys(u64 virt_addr);
  * IMPORTANTE: Questo lock protegge TUTTO l'accesso a vmm_state.
  * Deve essere acquisito prima di leggere o modificare qualsiasi campo.
  */
-static spinlock_t vmm_lock = SPINLOCK_INITIALIZER;
+static spinlock_t vmm_lock __cacheline_aligned = SPINLOCK_INITIALIZER;
+
+// Latenza di vmm_map, page table comprese ("lat_hist=lat_vmm_map")
+DEFINE_LAT_HIST(lat_vmm_map);
 
 /**
  * @brief Stato interno del VMM generico - PROTETTO DA vmm_lock
@@ -74,7 +91,8 @@ static struct {
   u64 total_spaces_created;  // Statistiche globali
   u64 total_mappings;        // Numero totale di mapping eseguiti
   u64 total_unmappings;      // Numero totale di unmapping eseguiti
-} vmm_state = {.initialized = false, .kernel_space = (vmm_space_t *)NULL, .total_spaces_created = 0, .total_mappings = 0, .total_unmappings = 0};
+  u64 zero_page_phys;        // Frame globale azzerato (read fault su pagine anonime)
+} vmm_state __cacheline_aligned = {.initialized = false, .kernel_space = (vmm_space_t *)NULL, .total_spaces_created = 0, .total_mappings = 0, .total_unmappings = 0, .zero_page_phys = 0};
 
 /*
  * ============================================================================
@@ -191,6 +209,17 @@ void vmm_init(void) {
     klog_panic("VMM: Impossibile ottenere kernel space dall'arch layer");
   }
 
+  // Alloca la zero page globale (fuori dal lock: chiama il PMM)
+  spinlock_unlock(&vmm_lock);
+  void *zero_page = pmm_alloc_page();
+  if (!zero_page) {
+    klog_panic("VMM: Impossibile allocare la zero page");
+  }
+  memset(vmm_phys_to_virt((u64)zero_page), 0, PAGE_SIZE);
+  spinlock_lock(&vmm_lock);
+
+  vmm_state.zero_page_phys = (u64)zero_page;
+
   // Aggiorna stato in modo atomico (con lock tenuto)
   vmm_state.kernel_space = kernel_space;
   vmm_state.total_spaces_created = 1; // Kernel space
@@ -228,6 +257,20 @@ vmm_space_t *vmm_kernel_space(void) {
   return kernel_space;
 }
 
+/**
+ * @brief Ottiene lo spazio di indirizzamento attivo
+ *
+ * Lo spazio attivo è tracciato dall'arch layer (CR3 corrente); prima
+ * dell'inizializzazione ritorna NULL.
+ */
+vmm_space_t *vmm_current_space(void) {
+  if (!vmm_is_initialized()) {
+    return (vmm_space_t *)NULL;
+  }
+
+  return arch_vmm_get_current_space();
+}
+
 /**
  * @brief Crea un nuovo spazio virtuale
  *
@@ -293,10 +336,52 @@ void vmm_destroy_space(vmm_space_t *space) {
 
   klog_debug("VMM: Distruzione spazio %p", space);
 
-  // Delega all'implementazione arch-specific (senza lock)
+  // Lo scanner KSM e il reclaim globale non devono più visitare lo spazio
+  ksm_unregister_space(space);
+  vmm_space_lazyfree_forget(space);
+
+  // Delega all'implementazione arch-specific (senza lock): lo spazio viene
+  // staccato e messo in coda, page table e frame si liberano in background
   arch_vmm_destroy_space(space);
 
-  klog_debug("VMM: Spazio distrutto con successo");
+  klog_debug("VMM: Spazio in coda per il teardown");
+}
+
+/**
+ * @brief Esegue una porzione del teardown degli spazi distrutti
+ *
+ * THREAD-SAFE: Ogni spazio in coda viene lavorato da un solo chiamante
+ */
+size_t vmm_reclaim_work(size_t budget) {
+  if (!vmm_state.initialized || budget == 0) {
+    return 0;
+  }
+
+  size_t work = arch_vmm_teardown_work(budget);
+
+  // Memoria scarsa: le pagine lazy free sono le prime da restituire
+  const pmm_stats_t *pmm = pmm_get_stats();
+  u64 low_water = pmm ? pmm->total_pages / VMM_LOWMEM_FRACTION : 0;
+  if (pmm && pmm->free_pages < low_water) {
+    work += vmm_reclaim_lazyfree((size_t)(low_water - pmm->free_pages));
+  }
+
+  return work;
+}
+
+/**
+ * @brief Rilascia un frame condiviso incontrato dal teardown
+ *
+ * Chiamata dall'arch layer per le foglie COW che non sono frame anonimi
+ * dello spazio. La zero page non ha contatori; i frame KSM perdono un
+ * mapping e tornano al PMM con l'ultimo.
+ */
+void vmm_teardown_release_shared(vmm_space_t *space, u64 virt_addr, u64 phys_addr) {
+  if (phys_addr == vmm_state.zero_page_phys) {
+    return;
+  }
+
+  ksm_page_unshare(space, virt_addr, phys_addr);
 }
 
 /**
@@ -330,6 +415,8 @@ void vmm_switch_space(vmm_space_t *space) {
  * THREAD-SAFE: Protezione completa di validazione e aggiornamento statistiche
  */
 bool vmm_map(vmm_space_t *space, u64 virt_addr, u64 phys_addr, size_t page_count, u64 flags) {
+  u64 lat = lat_hist_start(lat_vmm_map);
+
   // ACQUIRE LOCK per operazione completa
   spinlock_lock(&vmm_lock);
 
@@ -371,6 +458,7 @@ bool vmm_map(vmm_space_t *space, u64 virt_addr, u64 phys_addr, size_t page_count
   // RELEASE LOCK
   spinlock_unlock(&vmm_lock);
 
+  lat_hist_stop(lat_vmm_map, lat);
   return success;
 }
 
@@ -458,6 +546,242 @@ bool vmm_resolve(vmm_space_t *space, u64 virt_addr, u64 *out_phys_addr) {
   return found;
 }
 
+/**
+ * @brief Legge frame e flag di una pagina mappata
+ *
+ * THREAD-SAFE: Validazione thread-safe prima del page walk
+ */
+bool vmm_query(vmm_space_t *space, u64 virt_addr, u64 *out_phys, u64 *out_flags) {
+  // ACQUIRE LOCK per validazione
+  spinlock_lock(&vmm_lock);
+
+  if (!space) {
+    space = vmm_state.kernel_space;
+  }
+
+  if (!validate_space_operation_locked(space, "query")) {
+    spinlock_unlock(&vmm_lock);
+    return false;
+  }
+
+  // RELEASE LOCK per chiamata arch-specific
+  spinlock_unlock(&vmm_lock);
+
+  return arch_vmm_query(space, PAGE_ALIGN_DOWN(virt_addr), out_phys, out_flags);
+}
+
+/**
+ * @brief Cambia le protezioni di un range già mappato
+ *
+ * THREAD-SAFE: Validazione thread-safe prima dell'aggiornamento delle PTE
+ */
+bool vmm_protect(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags) {
+  // ACQUIRE LOCK per validazione
+  spinlock_lock(&vmm_lock);
+
+  if (!space) {
+    space = vmm_state.kernel_space;
+  }
+
+  if (!validate_space_operation_locked(space, "protect")) {
+    spinlock_unlock(&vmm_lock);
+    return false;
+  }
+
+  if (!IS_PAGE_ALIGNED(virt_addr) || page_count == 0) {
+    klog_error("VMM: Parametri protect non validi (0x%lx, %zu pagine)", virt_addr, page_count);
+    spinlock_unlock(&vmm_lock);
+    return false;
+  }
+
+  // RELEASE LOCK per chiamata arch-specific
+  spinlock_unlock(&vmm_lock);
+
+  return arch_vmm_protect(space, virt_addr, page_count, flags);
+}
+
+/**
+ * @brief Sostituisce il frame di una pagina (compare-and-swap sulla PTE)
+ *
+ * THREAD-SAFE: La sostituzione è atomica nell'arch layer; qui solo validazione
+ */
+bool vmm_replace_page(vmm_space_t *space, u64 virt_addr, u64 old_phys, u64 new_phys, u64 flags) {
+  // ACQUIRE LOCK per validazione
+  spinlock_lock(&vmm_lock);
+
+  if (!space) {
+    space = vmm_state.kernel_space;
+  }
+
+  if (!validate_space_operation_locked(space, "replace page")) {
+    spinlock_unlock(&vmm_lock);
+    return false;
+  }
+
+  // RELEASE LOCK per chiamata arch-specific
+  spinlock_unlock(&vmm_lock);
+
+  bool replaced = arch_vmm_replace_page(space, virt_addr, old_phys, new_phys, flags);
+
+  if (replaced) {
+    klog_debug("VMM: Replace 0x%lx: 0x%lx → 0x%lx", virt_addr, old_phys, new_phys);
+  }
+
+  return replaced;
+}
+
+/**
+ * @brief Riserva un range anonimo per il demand paging
+ *
+ * THREAD-SAFE: Validazione thread-safe prima della scrittura dei marker
+ */
+bool vmm_reserve(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags) {
+  // ACQUIRE LOCK per validazione
+  spinlock_lock(&vmm_lock);
+
+  if (!space) {
+    space = vmm_state.kernel_space;
+  }
+
+  if (!validate_mapping_params_locked(space, virt_addr, 0, page_count)) {
+    spinlock_unlock(&vmm_lock);
+    return false;
+  }
+
+  // RELEASE LOCK per chiamata arch-specific
+  spinlock_unlock(&vmm_lock);
+
+  klog_debug("VMM: Riserva %zu pagine da 0x%lx (flags=0x%lx)", page_count, virt_addr, flags);
+
+  return arch_vmm_reserve(space, virt_addr, page_count, flags);
+}
+
+/**
+ * @brief Legge i flag di una pagina riservata non popolata
+ *
+ * THREAD-SAFE: Lettura della sola PTE, nessuno stato globale modificato
+ */
+bool vmm_query_reserved(vmm_space_t *space, u64 virt_addr, u64 *out_flags) {
+  if (!space) {
+    space = vmm_kernel_space();
+  }
+
+  if (!space) {
+    return false;
+  }
+
+  return arch_vmm_query_reserved(space, PAGE_ALIGN_DOWN(virt_addr), out_flags);
+}
+
+/**
+ * @brief Popola una pagina riservata (percorso veloce del page fault)
+ *
+ * THREAD-SAFE: Compare-and-swap sulla PTE nell'arch layer
+ */
+bool vmm_populate(vmm_space_t *space, u64 virt_addr, u64 phys_addr, u64 flags) {
+  if (!space) {
+    space = vmm_kernel_space();
+  }
+
+  if (!space) {
+    return false;
+  }
+
+  bool populated = arch_vmm_populate(space, PAGE_ALIGN_DOWN(virt_addr), phys_addr, flags);
+
+  if (populated) {
+    spinlock_lock(&vmm_lock);
+    vmm_state.total_mappings++;
+    spinlock_unlock(&vmm_lock);
+  }
+
+  return populated;
+}
+
+/**
+ * @brief Indirizzo fisico della zero page globale
+ */
+u64 vmm_zero_page_phys(void) {
+  return vmm_state.zero_page_phys;
+}
+
+/**
+ * @brief Visita le pagine presenti o riservate di un range
+ *
+ * THREAD-SAFE: Sola lettura delle page table; le modifiche del callback
+ * passano dalle API pubbliche
+ */
+size_t vmm_walk(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_walk_fn_t fn, void *arg) {
+  if (!space) {
+    space = vmm_kernel_space();
+  }
+
+  if (!space || !fn || page_count == 0) {
+    return 0;
+  }
+
+  return arch_vmm_walk(space, PAGE_ALIGN_DOWN(virt_addr), page_count, fn, arg);
+}
+
+/**
+ * @brief Riporta a riserva le pagine anonime di un range
+ *
+ * THREAD-SAFE: Validazione thread-safe, PTE riscritte con compare-and-swap
+ */
+size_t vmm_discard(vmm_space_t *space, u64 virt_addr, size_t page_count, bool lazy_only) {
+  // ACQUIRE LOCK per validazione
+  spinlock_lock(&vmm_lock);
+
+  if (!space) {
+    space = vmm_state.kernel_space;
+  }
+
+  if (!validate_space_operation_locked(space, "discard")) {
+    spinlock_unlock(&vmm_lock);
+    return 0;
+  }
+
+  // RELEASE LOCK per chiamata arch-specific
+  spinlock_unlock(&vmm_lock);
+
+  size_t dropped = arch_vmm_discard(space, PAGE_ALIGN_DOWN(virt_addr), page_count, lazy_only);
+
+  if (dropped) {
+    spinlock_lock(&vmm_lock);
+    vmm_state.total_unmappings += dropped;
+    spinlock_unlock(&vmm_lock);
+  }
+
+  return dropped;
+}
+
+/**
+ * @brief Marca lazy free le pagine anonime di un range
+ *
+ * THREAD-SAFE: Validazione thread-safe, PTE riscritte con compare-and-swap
+ */
+size_t vmm_lazyfree(vmm_space_t *space, u64 virt_addr, size_t page_count) {
+  // ACQUIRE LOCK per validazione
+  spinlock_lock(&vmm_lock);
+
+  if (!space) {
+    space = vmm_state.kernel_space;
+  }
+
+  if (!validate_space_operation_locked(space, "lazy free")) {
+    spinlock_unlock(&vmm_lock);
+    return 0;
+  }
+
+  // RELEASE LOCK per chiamata arch-specific
+  spinlock_unlock(&vmm_lock);
+
+  size_t marked = arch_vmm_lazyfree(space, PAGE_ALIGN_DOWN(virt_addr), page_count);
+  if (marked)
+    vmm_space_lazyfree_queue(space);
+  return marked;
+}
+
 /**
  * @brief Stampa lo stato delle page table per uno spazio
  *
@@ -2,6 +2,7 @@
 
 #include <arch/x86_64/memory/memory.h>
 #include <lib/types.h>
+#include <mm/vmm_acct.h>
 
 /* -------------------------------------------------------------------------- */
 /*                         VMM CONFIGURATION CONSTANTS                        */
@@ -88,6 +89,10 @@ typedef enum {
   VMM_FLAG_USER = (1 << 3),
   VMM_FLAG_GLOBAL = (1 << 4),
   VMM_FLAG_NO_CACHE = (1 << 5),
+  VMM_FLAG_COW = (1 << 6),      // Read-only condivisa: la scrittura genera una copia
+  VMM_FLAG_ANON = (1 << 7),     // Frame privato dello spazio, liberato alla distruzione
+  VMM_FLAG_PINNED = (1 << 8),   // Escluso da reclaim, KSM e migrazione (vedi vmm_pin)
+  VMM_FLAG_LAZYFREE = (1 << 9), // Scartabile dal reclaim finché non riscritta (VMM_ADVISE_FREE)
 } vmm_flags_t;
 
 /**
@@ -95,6 +100,16 @@ typedef enum {
  */
 typedef struct vmm_space vmm_space_t;
 
+/**
+ * @brief Callback di vmm_walk() per ogni foglia presente o riservata
+ *
+ * @param phys Frame mappato (0 per una riserva non popolata)
+ * @param flags Flag VMM della PTE
+ * @param present false per una riserva di vmm_reserve()
+ * @return false per interrompere la visita
+ */
+typedef bool (*vmm_walk_fn_t)(u64 virt_addr, u64 phys, u64 flags, bool present, void *arg);
+
 /*
  * ============================================================================
  * INITIALIZATION
@@ -110,6 +125,13 @@ typedef struct vmm_space vmm_space_t;
  */
 void vmm_init(void);
 
+/**
+ * @brief Verifica che il VMM sia pronto per l'uso
+ *
+ * @return true dopo vmm_init()
+ */
+bool vmm_is_initialized(void);
+
 /*
  * ============================================================================
  * KERNEL ADDRESS SPACE
@@ -123,6 +145,13 @@ void vmm_init(void);
  */
 vmm_space_t *vmm_kernel_space(void);
 
+/**
+ * @brief Ottiene lo spazio di indirizzamento attualmente attivo
+ *
+ * @return Spazio caricato sulla CPU corrente
+ */
+vmm_space_t *vmm_current_space(void);
+
 /*
  * ============================================================================
  * ADDRESS SPACE MANAGEMENT
@@ -139,10 +168,31 @@ vmm_space_t *vmm_create_space(void);
 /**
  * @brief Distrugge uno spazio virtuale e libera risorse
  *
+ * Lo spazio viene staccato subito (PML4 non più raggiungibile) e messo in
+ * coda: page table e frame anonimi (VMM_FLAG_ANON) vengono restituiti al
+ * PMM in background da vmm_reclaim_work(). La latenza della chiamata non
+ * dipende quindi dalla dimensione dello spazio.
+ *
  * @param space Puntatore allo spazio da distruggere
  */
 void vmm_destroy_space(vmm_space_t *space);
 
+/**
+ * @brief Esegue una porzione del lavoro di distruzione in coda
+ *
+ * Il loop di idle la chiama dopo ogni tick del kernel (arch/tick.h), così
+ * il teardown avanza e la soglia di memoria scarsa viene ricontrollata a
+ * intervalli regolari anche senza nuove allocazioni. Sotto la soglia
+ * VMM_LOWMEM_FRACTION di pagine libere esegue anche un passaggio di
+ * reclaim globale delle pagine lazy free (vmm_reclaim_lazyfree).
+ *
+ * @param budget Numero massimo di entry di page table da visitare
+ * @return Entry visitate più frame recuperati (0 = nessun lavoro pendente)
+ */
+size_t vmm_reclaim_work(size_t budget);
+
+#define VMM_RECLAIM_DEFAULT_BUDGET 512 // Entry per tick dal loop di idle
+
 /**
  * @brief Attiva uno spazio virtuale come corrente (CR3 switch)
  *
@@ -187,6 +237,130 @@ void vmm_unmap(vmm_space_t *space, u64 virt_addr, size_t page_count);
  */
 bool vmm_resolve(vmm_space_t *space, u64 virt_addr, u64 *out_phys_addr);
 
+/**
+ * @brief Legge frame e flag di una singola pagina mappata
+ *
+ * @param space Spazio target (NULL = spazio kernel)
+ * @param virt_addr Indirizzo virtuale (allineato a pagina)
+ * @param out_phys (opzionale) indirizzo fisico del frame
+ * @param out_flags (opzionale) combinazione di VMM_FLAG_*
+ * @return true se la pagina è presente
+ */
+bool vmm_query(vmm_space_t *space, u64 virt_addr, u64 *out_phys, u64 *out_flags);
+
+/**
+ * @brief Cambia le protezioni di un range già mappato
+ *
+ * Le pagine non presenti vengono ignorate. Il frame fisico non cambia.
+ *
+ * @param space Spazio target (NULL = spazio kernel)
+ * @param virt_addr Indirizzo virtuale base (allineato a pagina)
+ * @param page_count Numero di pagine
+ * @param flags Nuovi flag VMM_FLAG_*
+ * @return true se almeno una pagina è stata aggiornata
+ */
+bool vmm_protect(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags);
+
+/**
+ * @brief Sostituisce il frame di una pagina solo se è ancora old_phys
+ *
+ * Aggiorna la PTE con una compare-and-swap: se nel frattempo la pagina è
+ * stata rimappata (es. COW break) l'operazione fallisce senza effetti.
+ *
+ * @param space Spazio target (NULL = spazio kernel)
+ * @param virt_addr Indirizzo virtuale (allineato a pagina)
+ * @param old_phys Frame atteso nella PTE
+ * @param new_phys Nuovo frame
+ * @param flags Flag VMM_FLAG_* della nuova PTE
+ * @return true se la PTE è stata sostituita
+ */
+bool vmm_replace_page(vmm_space_t *space, u64 virt_addr, u64 old_phys, u64 new_phys, u64 flags);
+
+/*
+ * ============================================================================
+ * DEMAND PAGING
+ * ============================================================================
+ */
+
+/**
+ * @brief Riserva un range anonimo senza allocare memoria fisica
+ *
+ * Le pagine vengono popolate dal page fault handler al primo accesso:
+ * una lettura mappa la zero page condivisa (read-only, COW), solo una
+ * scrittura alloca un frame reale.
+ *
+ * @param space Spazio target (NULL = spazio kernel)
+ * @param virt_addr Indirizzo base (allineato a pagina)
+ * @param page_count Numero di pagine
+ * @param flags Flag VMM_FLAG_* con cui le pagine verranno popolate
+ * @return true se il range è stato riservato
+ */
+bool vmm_reserve(vmm_space_t *space, u64 virt_addr, size_t page_count, u64 flags);
+
+/**
+ * @brief Verifica se una pagina è riservata e non ancora popolata
+ *
+ * @param space Spazio target (NULL = spazio kernel)
+ * @param virt_addr Indirizzo virtuale
+ * @param out_flags (opzionale) flag salvati al momento della riserva
+ * @return true se la pagina è una riserva non popolata
+ */
+bool vmm_query_reserved(vmm_space_t *space, u64 virt_addr, u64 *out_flags);
+
+/**
+ * @brief Popola una pagina riservata con un frame
+ *
+ * Percorso veloce per il page fault handler: una sola scrittura atomica
+ * della PTE, senza flush del TLB.
+ *
+ * @return false se la pagina non è più una riserva (fault concorrente)
+ */
+bool vmm_populate(vmm_space_t *space, u64 virt_addr, u64 phys_addr, u64 flags);
+
+/**
+ * @brief Indirizzo fisico della zero page globale
+ *
+ * Frame unico azzerato all'avvio e mai scritto: viene mappato read-only
+ * per le letture su pagine anonime mai toccate.
+ */
+u64 vmm_zero_page_phys(void);
+
+/**
+ * @brief Visita le pagine presenti o riservate di un range in un passaggio
+ *
+ * Le regioni senza page table vengono saltate a blocchi interi: il costo
+ * segue le tabelle esistenti, non la lunghezza del range. Il callback può
+ * cambiare la pagina visitata (vmm_protect, vmm_replace_page) ma non
+ * togliere mapping.
+ *
+ * @return Pagine visitate
+ */
+size_t vmm_walk(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_walk_fn_t fn, void *arg);
+
+/**
+ * @brief Riporta a riserva le pagine anonime di un range
+ *
+ * I frame privati tornano al PMM, quelli condivisi (zero page, KSM)
+ * perdono un mapping; il prossimo accesso ripassa dal demand paging e
+ * vede zeri. Le PTE vengono scritte tutte prima di un solo flush del TLB
+ * per batch. Pagine pinned e mappature esplicite (vmm_map senza ANON/COW)
+ * non vengono toccate.
+ *
+ * @param lazy_only Scarta solo le pagine VMM_FLAG_LAZYFREE non riscritte
+ * @return Pagine scartate
+ */
+size_t vmm_discard(vmm_space_t *space, u64 virt_addr, size_t page_count, bool lazy_only);
+
+/**
+ * @brief Marca VMM_FLAG_LAZYFREE le pagine anonime presenti di un range
+ *
+ * Restano mappate e leggibili; il reclaim le scarta solo se nessuno le
+ * ha riscritte dopo l'hint.
+ *
+ * @return Pagine marcate
+ */
+size_t vmm_lazyfree(vmm_space_t *space, u64 virt_addr, size_t page_count);
+
 /*
  * ============================================================================
  * DEBUG AND INTROSPECTION
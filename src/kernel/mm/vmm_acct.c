@@ -0,0 +1,358 @@
+#include <arch/cpu.h>
+#include <klib/klog/klog.h>
+#include <klib/spinlock.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/percpu.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <mm/vmm_acct.h>
+
+/**
+ * @file mm/vmm_acct.c
+ * @brief Contabilità e limiti di memoria per spazio - Implementation
+ *
+ * I contatori vivono dentro la struttura dello spazio (arch layer) e
+ * vengono aggiornati dalle transizioni delle PTE; qui ci sono le letture,
+ * i limiti e il reclaim, tutti costruiti sopra l'API pubblica del VMM
+ * (vmm_walk, vmm_protect, vmm_replace_page).
+ */
+
+#define VMM_ACCT_USER_END 0x0000800000000000ULL // Fine della metà utente (canonical hole)
+
+// Implementata in arch/<arch>/vmm_arch.c: NULL per lo spazio kernel
+extern vmm_space_acct_t *arch_vmm_space_acct(vmm_space_t *space);
+
+// Spazi con pagine lazy free, per il reclaim globale
+static list_node_t vmm_acct_lazy_spaces = {&vmm_acct_lazy_spaces, &vmm_acct_lazy_spaces};
+static spinlock_t vmm_acct_lazy_lock = SPINLOCK_INITIALIZER;
+static vmm_space_t *vmm_acct_lazy_busy; // Spazio visitato ora da vmm_reclaim_lazyfree
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni interne                              */
+/* -------------------------------------------------------------------------- */
+
+static inline u64 vmm_acct_read(vmm_space_acct_t *acct, vmm_acct_item_t item) {
+  return (u64)percpu_counter_read_positive(&acct->counters[item]);
+}
+
+static inline u64 vmm_acct_sum(vmm_space_acct_t *acct, vmm_acct_item_t item) {
+  return percpu_counter_sum_positive(&acct->counters[item]);
+}
+
+static inline u64 vmm_acct_rss_exact(vmm_space_acct_t *acct) {
+  return vmm_acct_sum(acct, VMM_ACCT_RSS_ANON) + vmm_acct_sum(acct, VMM_ACCT_RSS_SHARED);
+}
+
+static bool vmm_acct_page_is_zero(u64 phys) {
+  const u64 *words = (const u64 *)vmm_phys_to_virt(phys);
+  for (size_t i = 0; i < PAGE_SIZE / sizeof(u64); i++) {
+    if (words[i])
+      return false;
+  }
+  return true;
+}
+
+typedef struct {
+  vmm_space_t *space;
+  bool lazy_only; // Solo pagine lazy free (reclaim globale)
+  size_t target;  // Frame ancora da restituire
+  size_t budget; // Foglie ancora visitabili
+  size_t freed;  // Frame restituiti al PMM
+  u64 last_virt; // Ultima foglia visitata (nuovo cursore)
+} vmm_acct_reclaim_ctx_t;
+
+/**
+ * @brief Riporta sulla zero page una pagina anonima azzerata
+ *
+ * Stessa sequenza di KSM: write-protect (COW, così una scrittura
+ * concorrente passa dal COW break), verifica del contenuto, sostituzione
+ * con compare-and-swap. Se qualcosa cambia in mezzo i flag originali
+ * vengono ripristinati.
+ */
+static bool vmm_acct_reclaim_page(vmm_space_t *space, u64 virt, u64 phys, u64 flags) {
+  u64 ro_flags = (flags & ~(u64)(VMM_FLAG_WRITE | VMM_FLAG_ANON)) | ((flags & VMM_FLAG_WRITE) ? VMM_FLAG_COW : 0);
+
+  if (!vmm_protect(space, virt, 1, ro_flags))
+    return false;
+
+  if (!vmm_acct_page_is_zero(phys) || !vmm_replace_page(space, virt, phys, vmm_zero_page_phys(), ro_flags)) {
+    vmm_protect(space, virt, 1, flags);
+    return false;
+  }
+
+  pmm_free_page((void *)phys);
+  return true;
+}
+
+static bool vmm_acct_reclaim_visit(u64 virt, u64 phys, u64 flags, bool present, void *arg) {
+  vmm_acct_reclaim_ctx_t *ctx = (vmm_acct_reclaim_ctx_t *)arg;
+  ctx->last_virt = virt;
+
+  if (present && (flags & VMM_FLAG_ANON) && !(flags & (VMM_FLAG_PINNED | VMM_FLAG_COW))) {
+    // Lazy free: nessun confronto, basta che non sia stata riscritta dopo l'hint
+    if (flags & VMM_FLAG_LAZYFREE) {
+      if (vmm_discard(ctx->space, virt, 1, true)) {
+        ctx->freed++;
+        ctx->target--;
+      }
+    } else if (!ctx->lazy_only && vmm_acct_reclaim_page(ctx->space, virt, phys, flags)) {
+      ctx->freed++;
+      ctx->target--;
+    }
+  }
+
+  return --ctx->budget > 0 && ctx->target > 0;
+}
+
+typedef struct {
+  vmm_space_t *space;
+  bool pin;
+  size_t changed;
+} vmm_acct_pin_ctx_t;
+
+static bool vmm_acct_pin_visit(u64 virt, u64 phys, u64 flags, bool present, void *arg) {
+  (void)phys;
+  vmm_acct_pin_ctx_t *ctx = (vmm_acct_pin_ctx_t *)arg;
+
+  // Una pagina COW cambia frame alla prima scrittura: pin solo su frame privati
+  if (!present || (flags & VMM_FLAG_COW) || ctx->pin == !!(flags & VMM_FLAG_PINNED))
+    return true;
+
+  u64 new_flags = ctx->pin ? (flags | VMM_FLAG_PINNED) : (flags & ~(u64)VMM_FLAG_PINNED);
+  if (vmm_protect(ctx->space, virt, 1, new_flags))
+    ctx->changed++;
+  return true;
+}
+
+static size_t vmm_acct_set_pinned(vmm_space_t *space, u64 virt_addr, size_t page_count, bool pin) {
+  if (!space || !arch_vmm_space_acct(space) || !IS_PAGE_ALIGNED(virt_addr) || page_count == 0)
+    return 0;
+
+  vmm_acct_pin_ctx_t ctx = {.space = space, .pin = pin, .changed = 0};
+  vmm_walk(space, virt_addr, page_count, vmm_acct_pin_visit, &ctx);
+  return ctx.changed;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Arch layer                                 */
+/* -------------------------------------------------------------------------- */
+
+void vmm_acct_init(vmm_space_acct_t *acct) {
+  memset(acct, 0, sizeof(*acct));
+
+  // Solo le voci del fault path prendono slot per-CPU; senza slot restano globali
+  percpu_counter_init(&acct->counters[VMM_ACCT_RSS_ANON], 0, 0);
+  percpu_counter_init(&acct->counters[VMM_ACCT_RSS_SHARED], 0, 0);
+  percpu_counter_init(&acct->counters[VMM_ACCT_PAGE_TABLES], 0, 0);
+}
+
+void vmm_acct_destroy(vmm_space_acct_t *acct) {
+  for (int i = 0; i < VMM_ACCT_COUNT; i++)
+    percpu_counter_destroy(&acct->counters[i]);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+u64 vmm_space_rss(vmm_space_t *space) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct)
+    return 0;
+  return vmm_acct_read(acct, VMM_ACCT_RSS_ANON) + vmm_acct_read(acct, VMM_ACCT_RSS_SHARED);
+}
+
+bool vmm_space_get_usage(vmm_space_t *space, vmm_space_usage_t *out) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct || !out)
+    return false;
+
+  out->rss_anon = vmm_acct_sum(acct, VMM_ACCT_RSS_ANON);
+  out->rss_shared = vmm_acct_sum(acct, VMM_ACCT_RSS_SHARED);
+  out->page_tables = vmm_acct_sum(acct, VMM_ACCT_PAGE_TABLES);
+  out->swap = vmm_acct_sum(acct, VMM_ACCT_SWAP);
+  out->pinned = vmm_acct_sum(acct, VMM_ACCT_PINNED);
+  out->soft_limit = acct->soft_limit;
+  out->hard_limit = acct->hard_limit;
+  out->reclaim_runs = __atomic_load_n(&acct->reclaim_runs, __ATOMIC_RELAXED);
+  out->reclaimed_pages = __atomic_load_n(&acct->reclaimed_pages, __ATOMIC_RELAXED);
+  out->limit_failures = __atomic_load_n(&acct->limit_failures, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool vmm_space_set_limits(vmm_space_t *space, u64 soft_pages, u64 hard_pages) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct) {
+    klog_warn("VMM: Limiti non applicabili allo spazio kernel");
+    return false;
+  }
+
+  if (soft_pages && hard_pages && hard_pages < soft_pages) {
+    klog_warn("VMM: Hard limit (%lu) sotto il soft limit (%lu)", hard_pages, soft_pages);
+    return false;
+  }
+
+  __atomic_store_n(&acct->soft_limit, soft_pages, __ATOMIC_RELAXED);
+  __atomic_store_n(&acct->hard_limit, hard_pages, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool vmm_space_charge(vmm_space_t *space, size_t pages) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct)
+    return true;
+
+  u64 soft = __atomic_load_n(&acct->soft_limit, __ATOMIC_RELAXED);
+  u64 hard = __atomic_load_n(&acct->hard_limit, __ATOMIC_RELAXED);
+  if (!soft && !hard)
+    return true;
+
+  // Percorso veloce: anche con l'errore massimo dei due contatori si resta sotto
+  u64 lowest = soft ? soft : hard;
+  u64 slack = 2 * (u64)PERCPU_COUNTER_BATCH * percpu_cpu_count();
+  if (vmm_space_rss(space) + pages + slack <= lowest)
+    return true;
+
+  u64 rss = vmm_acct_rss_exact(acct) + pages;
+  if (rss > lowest) {
+    vmm_space_reclaim(space, (size_t)(rss - lowest));
+    rss = vmm_acct_rss_exact(acct) + pages;
+  }
+
+  if (hard && rss > hard) {
+    __atomic_add_fetch(&acct->limit_failures, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Un passaggio di reclaim nello spazio, dal suo cursore
+ *
+ * @return true se il passaggio ha percorso tutta la metà utente
+ */
+static bool vmm_acct_reclaim_pass(vmm_space_t *space, vmm_space_acct_t *acct, size_t target, bool lazy_only, size_t *freed) {
+  vmm_acct_reclaim_ctx_t ctx = {.space = space, .lazy_only = lazy_only, .target = target, .budget = VMM_ACCT_RECLAIM_SCAN, .freed = 0, .last_virt = 0};
+
+  // Dal cursore alla fine della metà utente, poi un giro dall'inizio
+  u64 start = __atomic_load_n(&acct->reclaim_cursor, __ATOMIC_RELAXED);
+  if (start < PAGE_SIZE || start >= VMM_ACCT_USER_END)
+    start = PAGE_SIZE;
+
+  u64 resume = PAGE_SIZE;
+  vmm_walk(space, start, (VMM_ACCT_USER_END - start) / PAGE_SIZE, vmm_acct_reclaim_visit, &ctx);
+  if (ctx.budget > 0 && ctx.target > 0 && start > PAGE_SIZE) {
+    vmm_walk(space, PAGE_SIZE, (start - PAGE_SIZE) / PAGE_SIZE, vmm_acct_reclaim_visit, &ctx);
+  }
+  bool complete = ctx.budget > 0 && ctx.target > 0;
+  if (!complete)
+    resume = ctx.last_virt + PAGE_SIZE;
+
+  __atomic_store_n(&acct->reclaim_cursor, resume, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&acct->reclaim_runs, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&acct->reclaimed_pages, ctx.freed, __ATOMIC_RELAXED);
+
+  *freed = ctx.freed;
+  return complete;
+}
+
+size_t vmm_space_reclaim(vmm_space_t *space, size_t target) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct || target == 0)
+    return 0;
+
+  size_t freed;
+  vmm_acct_reclaim_pass(space, acct, target, false, &freed);
+
+  klog_debug("VMM: Reclaim nello spazio %p: %zu/%zu frame", space, freed, target);
+  return freed;
+}
+
+void vmm_space_lazyfree_queue(vmm_space_t *space) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct || __atomic_load_n(&acct->lazy_space, __ATOMIC_RELAXED))
+    return;
+
+  spinlock_lock(&vmm_acct_lazy_lock);
+  if (!acct->lazy_space) {
+    acct->lazy_space = space;
+    list_insert_before(&vmm_acct_lazy_spaces, &acct->lazy_link);
+  }
+  spinlock_unlock(&vmm_acct_lazy_lock);
+}
+
+void vmm_space_lazyfree_forget(vmm_space_t *space) {
+  vmm_space_acct_t *acct = space ? arch_vmm_space_acct(space) : NULL;
+  if (!acct)
+    return;
+
+  spinlock_lock(&vmm_acct_lazy_lock);
+  // Un passaggio in corso sullo spazio lo sta ancora visitando: si aspetta
+  while (vmm_acct_lazy_busy == space) {
+    spinlock_unlock(&vmm_acct_lazy_lock);
+    arch_cpu_pause();
+    spinlock_lock(&vmm_acct_lazy_lock);
+  }
+  if (acct->lazy_space) {
+    list_remove(&acct->lazy_link);
+    acct->lazy_space = NULL;
+  }
+  spinlock_unlock(&vmm_acct_lazy_lock);
+}
+
+size_t vmm_reclaim_lazyfree(size_t target) {
+  if (target == 0)
+    return 0;
+
+  // Il primo spazio passa in fondo: i passaggi successivi ruotano sulla coda.
+  // Il lock non resta preso durante la visita (vmm_walk, vmm_discard, PMM)
+  spinlock_lock(&vmm_acct_lazy_lock);
+  if (vmm_acct_lazy_busy || list_is_empty(&vmm_acct_lazy_spaces)) {
+    spinlock_unlock(&vmm_acct_lazy_lock);
+    return 0;
+  }
+  vmm_space_acct_t *acct = LIST_ENTRY(vmm_acct_lazy_spaces.next, vmm_space_acct_t, lazy_link);
+  vmm_space_t *space = acct->lazy_space;
+  list_remove(&acct->lazy_link);
+  list_insert_before(&vmm_acct_lazy_spaces, &acct->lazy_link);
+  vmm_acct_lazy_busy = space;
+  spinlock_unlock(&vmm_acct_lazy_lock);
+
+  size_t freed;
+  bool complete = vmm_acct_reclaim_pass(space, acct, target, true, &freed);
+
+  spinlock_lock(&vmm_acct_lazy_lock);
+  // Percorso tutto: nessuna pagina lazy free rimasta fino al prossimo hint
+  if (complete && acct->lazy_space) {
+    list_remove(&acct->lazy_link);
+    acct->lazy_space = NULL;
+  }
+  vmm_acct_lazy_busy = NULL;
+  spinlock_unlock(&vmm_acct_lazy_lock);
+
+  klog_debug("VMM: Reclaim globale lazy free nello spazio %p: %zu/%zu frame", space, freed, target);
+  return freed;
+}
+
+size_t vmm_pin(vmm_space_t *space, u64 virt_addr, size_t page_count) {
+  return vmm_acct_set_pinned(space, virt_addr, page_count, true);
+}
+
+size_t vmm_unpin(vmm_space_t *space, u64 virt_addr, size_t page_count) {
+  return vmm_acct_set_pinned(space, virt_addr, page_count, false);
+}
+
+void vmm_space_print_usage(vmm_space_t *space) {
+  vmm_space_usage_t usage;
+  if (!vmm_space_get_usage(space, &usage)) {
+    klog_info("VMM: Spazio %p senza contabilità (kernel)", space);
+    return;
+  }
+
+  klog_info("=== Memoria dello spazio %p ===", space);
+  klog_info("RSS: %lu pagine (anonime %lu, condivise %lu)", usage.rss_anon + usage.rss_shared, usage.rss_anon, usage.rss_shared);
+  klog_info("Page table: %lu, swap: %lu, pinned: %lu", usage.page_tables, usage.swap, usage.pinned);
+  klog_info("Limiti: soft %lu, hard %lu (0 = nessuno)", usage.soft_limit, usage.hard_limit);
+  klog_info("Reclaim: %lu passaggi, %lu frame restituiti, %lu allocazioni rifiutate", usage.reclaim_runs, usage.reclaimed_pages, usage.limit_failures);
+}
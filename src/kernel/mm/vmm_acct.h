@@ -0,0 +1,222 @@
+#pragma once
+
+#include <klib/list/list.h>
+#include <klib/percpu_counter/percpu_counter.h>
+#include <lib/stdbool.h>
+#include <lib/types.h>
+
+/**
+ * @file mm/vmm_acct.h
+ * @brief Contabilità e limiti di memoria per spazio di indirizzamento
+ *
+ * Ogni vmm_space_t porta con sé i contatori delle pagine che usa. L'arch
+ * layer li aggiorna a ogni transizione di una PTE (map, unmap, populate,
+ * replace, protect) e a ogni page table creata: nessuna scansione per
+ * sapere quanto pesa uno spazio.
+ *
+ * CONTATORI:
+ * Sono percpu_counter (klib/percpu_counter): il fault path aggiorna uno
+ * slot della propria CPU senza lock né cache line condivise, la lettura
+ * veloce (percpu_counter_read) ha un errore di al più batch × CPU.
+ * Swap e pinned cambiano di rado e restano sul solo totale globale, per
+ * non consumare slot per-CPU (sono PERCPU_COUNTER_SLOTS in tutto).
+ *
+ * LIMITI:
+ * Soft e hard limit in pagine sull'RSS (anonime + condivise). Prima di
+ * prendere frame dal PMM per uno spazio il chiamante usa
+ * vmm_space_charge():
+ * - sopra il soft limit si recupera memoria dentro lo spazio, ma
+ *   l'allocazione procede comunque
+ * - sopra l'hard limit si recupera dentro lo spazio; se non basta
+ *   l'allocazione fallisce e il fault resta allo spazio che sfora
+ * In entrambi i casi la memoria globale non viene toccata per far posto
+ * al vicino rumoroso.
+ *
+ * RECLAIM NELLO SPAZIO:
+ * Senza swap, il reclaim restituisce le pagine lazy free (VMM_ADVISE_FREE)
+ * non più riscritte, che tornano riserve, e le pagine anonime private che
+ * contengono solo zeri: tornano a puntare alla zero page (read-only,
+ * COW) come una riserva appena letta. In entrambi i casi il frame torna
+ * al PMM. Le pagine
+ * pinned non vengono mai toccate. Un cursore per spazio fa ripartire
+ * ogni passaggio da dove si era fermato il precedente.
+ *
+ * RECLAIM GLOBALE:
+ * Le pagine lazy free sono memoria che il proprietario ha già ceduto: con
+ * la memoria globale scarsa vanno restituite anche senza limiti impostati.
+ * vmm_lazyfree() mette lo spazio in una coda; vmm_reclaim_lazyfree() la
+ * percorre a giro e scarta solo le pagine lazy free, mai quelle azzerate.
+ * La chiamano il loop di idle sotto la soglia VMM_LOWMEM_FRACTION e il
+ * fault path quando il PMM è esaurito.
+ */
+
+/*
+ * ============================================================================
+ * TYPES
+ * ============================================================================
+ */
+
+#define VMM_ACCT_RECLAIM_SCAN 4096 // Pagine visitate al massimo per passaggio di reclaim
+#define VMM_LOWMEM_FRACTION 16     // Sotto 1/16 di pagine libere parte il reclaim globale
+
+typedef struct vmm_space vmm_space_t;
+
+/**
+ * @brief Voci contate per ogni spazio (in pagine)
+ */
+typedef enum {
+  VMM_ACCT_RSS_ANON,    // Frame anonimi privati (VMM_FLAG_ANON)
+  VMM_ACCT_RSS_SHARED,  // Altri frame mappati: KSM, memoria condivisa (zero page esclusa)
+  VMM_ACCT_PAGE_TABLES, // Page table dello spazio, PML4 compresa
+  VMM_ACCT_SWAP,        // Pagine su swap (nessun backend ancora: resta a 0)
+  VMM_ACCT_PINNED,      // Pagine presenti con VMM_FLAG_PINNED: né reclaim né migrazione
+  VMM_ACCT_COUNT
+} vmm_acct_item_t;
+
+/**
+ * @brief Stato di contabilità di uno spazio (dentro vmm_space_t)
+ */
+typedef struct {
+  percpu_counter_t counters[VMM_ACCT_COUNT];
+  u64 soft_limit;      // Pagine di RSS oltre cui si recupera nello spazio (0 = nessuno)
+  u64 hard_limit;      // Pagine di RSS oltre cui le allocazioni falliscono (0 = nessuno)
+  u64 reclaim_cursor;  // Prossimo indirizzo visitato dal reclaim
+  u64 reclaim_runs;    // Passaggi di reclaim eseguiti
+  u64 reclaimed_pages; // Frame restituiti al PMM dal reclaim
+  u64 limit_failures;  // Allocazioni rifiutate dall'hard limit
+  list_node_t lazy_link;   // Nella coda del reclaim globale
+  vmm_space_t *lazy_space; // Spazio proprietario se in coda, NULL altrimenti
+} vmm_space_acct_t;
+
+/**
+ * @brief Istantanea dei contatori di uno spazio
+ */
+typedef struct {
+  u64 rss_anon;
+  u64 rss_shared;
+  u64 page_tables;
+  u64 swap;
+  u64 pinned;
+  u64 soft_limit;
+  u64 hard_limit;
+  u64 reclaim_runs;
+  u64 reclaimed_pages;
+  u64 limit_failures;
+} vmm_space_usage_t;
+
+/*
+ * ============================================================================
+ * ARCH LAYER
+ * ============================================================================
+ */
+
+/**
+ * @brief Prepara i contatori di uno spazio appena creato
+ */
+void vmm_acct_init(vmm_space_acct_t *acct);
+
+/**
+ * @brief Rilascia gli slot per-CPU di uno spazio smontato
+ */
+void vmm_acct_destroy(vmm_space_acct_t *acct);
+
+/**
+ * @brief Aggiorna una voce (delta in pagine, anche negativo)
+ */
+static inline void vmm_acct_add(vmm_space_acct_t *acct, vmm_acct_item_t item, s64 pages) {
+  percpu_counter_add(&acct->counters[item], pages);
+}
+
+/*
+ * ============================================================================
+ * PUBLIC API
+ * ============================================================================
+ */
+
+/**
+ * @brief Pagine residenti (anonime + condivise), lettura veloce approssimata
+ *
+ * @note O(1), errore massimo PERCPU_COUNTER_BATCH × CPU per voce
+ */
+u64 vmm_space_rss(vmm_space_t *space);
+
+/**
+ * @brief Somma esatta di tutti i contatori di uno spazio
+ */
+bool vmm_space_get_usage(vmm_space_t *space, vmm_space_usage_t *out);
+
+/**
+ * @brief Imposta i limiti di RSS di uno spazio
+ *
+ * @param soft_pages Soglia di reclaim nello spazio (0 = nessuna)
+ * @param hard_pages Tetto delle allocazioni (0 = nessuno)
+ * @return false se hard_pages è sotto soft_pages o lo spazio è il kernel
+ */
+bool vmm_space_set_limits(vmm_space_t *space, u64 soft_pages, u64 hard_pages);
+
+/**
+ * @brief Chiede di portare pages nuovi frame nello spazio
+ *
+ * Da chiamare prima di allocare dal PMM per conto dello spazio (page
+ * fault, prefault). Con RSS ben sotto i limiti costa una lettura dei
+ * contatori; vicino ai limiti somma gli slot e, se serve, recupera nello
+ * spazio.
+ *
+ * @return false se l'hard limit resta superato anche dopo il reclaim
+ */
+bool vmm_space_charge(vmm_space_t *space, size_t pages);
+
+/**
+ * @brief Recupera memoria dentro lo spazio
+ *
+ * @param target Frame da restituire al PMM
+ * @return Frame effettivamente restituiti
+ */
+size_t vmm_space_reclaim(vmm_space_t *space, size_t target);
+
+/**
+ * @brief Mette lo spazio nella coda del reclaim globale (da vmm_lazyfree)
+ */
+void vmm_space_lazyfree_queue(vmm_space_t *space);
+
+/**
+ * @brief Toglie lo spazio dalla coda del reclaim globale (da vmm_destroy_space)
+ *
+ * Al ritorno nessun passaggio di vmm_reclaim_lazyfree() sta visitando lo spazio.
+ */
+void vmm_space_lazyfree_forget(vmm_space_t *space);
+
+/**
+ * @brief Restituisce al PMM pagine lazy free degli spazi in coda
+ *
+ * Un passaggio (al più VMM_ACCT_RECLAIM_SCAN pagine) sul primo spazio della
+ * coda, che passa in fondo; lo spazio esce dalla coda quando un passaggio
+ * lo percorre tutto.
+ *
+ * @param target Frame da restituire
+ * @return Frame effettivamente restituiti
+ */
+size_t vmm_reclaim_lazyfree(size_t target);
+
+/**
+ * @brief Marca pinned le pagine presenti di un range
+ *
+ * Le pagine pinned non vengono recuperate, fuse da KSM né migrate da CMA
+ * (es. buffer su cui un dispositivo fa DMA). Le pagine non presenti o
+ * COW sono ignorate: vanno popolate in scrittura prima.
+ *
+ * @return Pagine marcate
+ */
+size_t vmm_pin(vmm_space_t *space, u64 virt_addr, size_t page_count);
+
+/**
+ * @brief Toglie VMM_FLAG_PINNED dalle pagine di un range
+ *
+ * @return Pagine liberate dal pin
+ */
+size_t vmm_unpin(vmm_space_t *space, u64 virt_addr, size_t page_count);
+
+/**
+ * @brief Stampa contatori e limiti di uno spazio
+ */
+void vmm_space_print_usage(vmm_space_t *space);
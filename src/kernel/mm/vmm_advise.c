@@ -0,0 +1,69 @@
+#include <klib/klog/klog.h>
+#include <lib/types.h>
+#include <mm/vmm.h>
+#include <mm/vmm_advise.h>
+#include <mm/vmm_fault.h>
+
+/**
+ * @file mm/vmm_advise.c
+ * @brief Hint sull'uso della memoria anonima - Implementation
+ *
+ * DONTNEED e FREE sono operazioni sulle PTE e vivono nell'arch layer
+ * (vmm_discard, vmm_lazyfree); WILLNEED è una visita del range con
+ * vmm_walk() che riusa il percorso del page fault.
+ */
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni interne                              */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  vmm_space_t *space;
+  bool ok;
+} vmm_advise_willneed_ctx_t;
+
+static bool vmm_advise_willneed_visit(u64 virt_addr, u64 phys, u64 flags, bool present, void *arg) {
+  (void)phys;
+  vmm_advise_willneed_ctx_t *ctx = (vmm_advise_willneed_ctx_t *)arg;
+
+  if (present)
+    return true;
+
+  ctx->ok = vmm_fault_prefault(ctx->space, virt_addr, flags);
+  return ctx->ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Funzioni pubbliche                            */
+/* -------------------------------------------------------------------------- */
+
+bool vmm_advise(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_advice_t advice) {
+  if (!space || space == vmm_kernel_space()) {
+    klog_warn("VMM: Hint non applicabili allo spazio kernel");
+    return false;
+  }
+
+  if (!IS_PAGE_ALIGNED(virt_addr) || page_count == 0) {
+    klog_error("VMM: Parametri advise non validi (0x%lx, %zu pagine)", virt_addr, page_count);
+    return false;
+  }
+
+  switch (advice) {
+  case VMM_ADVISE_DONTNEED:
+    vmm_discard(space, virt_addr, page_count, false);
+    return true;
+
+  case VMM_ADVISE_FREE:
+    vmm_lazyfree(space, virt_addr, page_count);
+    return true;
+
+  case VMM_ADVISE_WILLNEED: {
+    vmm_advise_willneed_ctx_t ctx = {.space = space, .ok = true};
+    vmm_walk(space, virt_addr, page_count, vmm_advise_willneed_visit, &ctx);
+    return ctx.ok;
+  }
+  }
+
+  klog_error("VMM: Hint sconosciuto %d", (int)advice);
+  return false;
+}
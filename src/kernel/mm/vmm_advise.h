@@ -0,0 +1,47 @@
+#pragma once
+
+#include <lib/stdbool.h>
+#include <lib/types.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/vmm_advise.h
+ * @brief Hint sull'uso della memoria anonima di uno spazio (stile madvise)
+ *
+ * Un server che ricicla le proprie arene sa meglio del kernel quali
+ * pagine non servono più e quali serviranno a breve. Gli hint lavorano
+ * sulle riserve di vmm_reserve() e sulle pagine popolate dal demand
+ * paging; le mappature esplicite (vmm_map senza ANON/COW) non vengono
+ * mai toccate. Sono la base delle future syscall sulle VMA dei processi.
+ *
+ * HINT:
+ * - DONTNEED: scarta subito. Le PTE tornano riserve in un passaggio, i
+ *   frame tornano al PMM a batch con un solo flush del TLB per batch; la
+ *   prossima lettura vede zeri
+ * - FREE: scarta solo sotto pressione. Le pagine restano mappate con
+ *   VMM_FLAG_LAZYFREE e dirty azzerato; il reclaim dello spazio (limiti)
+ *   o quello globale (memoria scarsa, vmm_reclaim_lazyfree) le scarta se
+ *   nessuno le ha riscritte, altrimenti tornano normali
+ * - WILLNEED: prefault del range in un passaggio del range walker, come
+ *   se ogni riserva fosse stata toccata (scrittura se scrivibile)
+ *
+ * Niente HUGEPAGE per ora: le foglie di unmap, protect, teardown e della
+ * contabilità sono solo PTE da 4KB. L'hint arriverà con il supporto alle
+ * PDE con PS=1 in tutti quei percorsi.
+ */
+
+typedef enum {
+  VMM_ADVISE_DONTNEED, // Scarta subito: la prossima lettura vede zeri
+  VMM_ADVISE_FREE,     // Scartabile dal reclaim finché non riscritta
+  VMM_ADVISE_WILLNEED, // Popola subito le riserve del range
+} vmm_advice_t;
+
+/**
+ * @brief Applica un hint a un range di uno spazio utente
+ *
+ * @param virt_addr Inizio del range (allineato alla pagina)
+ * @param page_count Pagine del range
+ * @return false per parametri non validi, spazio kernel o, con WILLNEED,
+ *         memoria esaurita / hard limit dello spazio superato
+ */
+bool vmm_advise(vmm_space_t *space, u64 virt_addr, size_t page_count, vmm_advice_t advice);
@@ -1,55 +1,178 @@
-// #include <arch/cpu.h>
-// #include <arch/interrupt_context.h>
-// #include <klib/klog/klog.h>
-// #include <lib/types.h>
-// #include <mm/pmm.h>
-// #include <mm/vmm.h>
-//
-// #define VMM_FAULT_STACK_MAX_GROWTH (32 * PAGE_SIZE)
-//
-// bool vmm_handle_page_fault(u64 fault_addr, u64 err_code, arch_interrupt_context_t *ctx) {
-//   // Protezione base: null pointer
-//   if (fault_addr < 0x1000) {
-//     klog_error("[#PF] Null pointer access (addr=0x%lx)", fault_addr);
-//     return false;
-//   }
-//
-//   // Allinea l’indirizzo a pagina
-//   u64 page_addr = fault_addr & ~(PAGE_SIZE - 1);
-//
-//   // Determina tipo accesso (solo per log/debug)
-//   bool is_present = err_code & 0x1;
-//   bool is_write = err_code & 0x2;
-//   bool is_user = err_code & 0x4;
-//   bool is_exec = err_code & 0x10;
-//
-//   klog_debug("[#PF] Fault addr = %p (present=%d write=%d user=%d exec=%d)", (void *)fault_addr, is_present, is_write, is_user, is_exec);
-//
-//   // Caso 1: pagina non presente → allochiamola (lazy alloc)
-//   if (!is_present) {
-//     void *new_page = pmm_alloc_page();
-//     if (!new_page) {
-//       klog_error("[#PF] Impossibile allocare nuova pagina");
-//       return false;
-//     }
-//
-//     u64 flags = VMM_FLAG_READ | VMM_FLAG_WRITE;
-//
-//     if (is_user)
-//       flags |= VMM_FLAG_USER;
-//
-//     bool ok = vmm_map(NULL, page_addr, (u64)new_page, 1, flags);
-//     if (!ok) {
-//       klog_error("[#PF] Mapping fallito per nuova pagina");
-//       return false;
-//     }
-//
-//     klog_info("[#PF] Risolta con mappatura dinamica (%p)", new_page);
-//     return true;
-//   }
-//
-//   // Caso 2: protezione (scrittura su read-only / NX / accesso user→kernel)
-//   klog_error("[#PF] Violazione di protezione — RIP=%p", (void *)ctx->rip);
-//   return false;
-// }
-//
\ No newline at end of file
+#include <klib/klog/klog.h>
+#include <klib/lat_hist/lat_hist.h>
+#include <lib/string/string.h>
+#include <lib/types.h>
+#include <mm/cma.h>
+#include <mm/ksm.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <mm/vmm_fault.h>
+
+/**
+ * @file mm/vmm_fault.c
+ * @brief Page fault handler generico
+ *
+ * Casi gestiti:
+ * - Lettura su pagina riservata (vmm_reserve) → zero page globale, RO + COW
+ * - Scrittura su pagina riservata → nuovo frame azzerato
+ * - Scrittura su pagina presente marcata COW → copia privata del frame
+ *   (o frame azzerato se la pagina condivisa è la zero page)
+ *
+ * I frame delle pagine anonime sono movable: possono essere presi in
+ * prestito dalla regione CMA, che li migrerà se serve spazio contiguo.
+ * Ogni nuovo frame passa prima da vmm_space_charge(): oltre l'hard limit
+ * dello spazio il fault fallisce (mm/vmm_acct.h).
+ *
+ * Tutti gli altri fault (pagina non presente, violazioni di protezione,
+ * accessi a NULL) sono considerati fatali e restituiti al chiamante.
+ */
+
+// Latenza dei fault gestiti e non ("lat_hist=lat_page_fault")
+DEFINE_LAT_HIST(lat_page_fault);
+
+/**
+ * @brief Alloca il frame di una pagina anonima (movable)
+ */
+static void *vmm_fault_alloc_anon(vmm_space_t *space, u64 page_addr) {
+  void *page = cma_alloc_movable(space, page_addr);
+  if (!page) {
+    page = pmm_alloc_page();
+    // PMM esaurito: si riprova dopo aver restituito pagine lazy free di tutti
+    if (!page && vmm_reclaim_lazyfree(1))
+      page = pmm_alloc_page();
+    if (page)
+      pmm_set_owner(page, 1, PMM_OWNER_USER_ANON);
+  }
+  return page;
+}
+
+/**
+ * @brief Rompe la condivisione di una pagina COW creando una copia privata
+ *
+ * La nuova PTE viene installata con vmm_replace_page(): se un altro
+ * contesto ha già risolto il fault, la copia viene scartata e il fault
+ * è comunque considerato gestito (l'istruzione verrà rieseguita).
+ */
+static bool vmm_fault_cow_break(vmm_space_t *space, u64 page_addr, u64 old_phys, u64 flags) {
+  if (!vmm_space_charge(space, 1)) {
+    klog_error("[#PF] COW: hard limit dello spazio superato a 0x%lx", page_addr);
+    return false;
+  }
+
+  void *new_page = vmm_fault_alloc_anon(space, page_addr);
+  if (!new_page) {
+    klog_error("[#PF] COW: impossibile allocare pagina per 0x%lx", page_addr);
+    return false;
+  }
+
+  bool from_zero = (old_phys == vmm_zero_page_phys());
+  if (from_zero) {
+    memset(vmm_phys_to_virt((u64)new_page), 0, PAGE_SIZE);
+  } else {
+    memcpy(vmm_phys_to_virt((u64)new_page), vmm_phys_to_virt(old_phys), PAGE_SIZE);
+  }
+
+  u64 new_flags = (flags | VMM_FLAG_WRITE | VMM_FLAG_ANON) & ~(u64)(VMM_FLAG_COW | VMM_FLAG_LAZYFREE);
+  if (!vmm_replace_page(space, page_addr, old_phys, (u64)new_page, new_flags)) {
+    pmm_free_page(new_page);
+    return true;
+  }
+
+  // Rilascia il riferimento al frame condiviso (se gestito da KSM)
+  if (!from_zero) {
+    ksm_page_unshare(space, page_addr, old_phys);
+  }
+
+  klog_debug("[#PF] COW break 0x%lx: 0x%lx → %p", page_addr, old_phys, new_page);
+  return true;
+}
+
+/**
+ * @brief Primo accesso a una pagina anonima riservata
+ *
+ * Le letture mappano la zero page: nessun frame allocato, il costo è la
+ * sola scrittura della PTE. La scrittura successiva passerà dal COW break.
+ */
+static bool vmm_fault_anonymous(vmm_space_t *space, u64 page_addr, u64 flags, bool is_write) {
+  if (!is_write) {
+    u64 zero_flags = flags & ~(u64)(VMM_FLAG_WRITE | VMM_FLAG_ANON);
+    if (flags & VMM_FLAG_WRITE) {
+      zero_flags |= VMM_FLAG_COW;
+    }
+
+    // Se fallisce un fault concorrente ha già popolato la pagina
+    vmm_populate(space, page_addr, vmm_zero_page_phys(), zero_flags);
+    return true;
+  }
+
+  if (!(flags & VMM_FLAG_WRITE)) {
+    klog_error("[#PF] Scrittura su riserva read-only 0x%lx", page_addr);
+    return false;
+  }
+
+  if (!vmm_space_charge(space, 1)) {
+    klog_error("[#PF] Hard limit dello spazio superato a 0x%lx", page_addr);
+    return false;
+  }
+
+  void *new_page = vmm_fault_alloc_anon(space, page_addr);
+  if (!new_page) {
+    klog_error("[#PF] Impossibile allocare pagina anonima per 0x%lx", page_addr);
+    return false;
+  }
+
+  memset(vmm_phys_to_virt((u64)new_page), 0, PAGE_SIZE);
+
+  if (!vmm_populate(space, page_addr, (u64)new_page, flags | VMM_FLAG_ANON)) {
+    pmm_free_page(new_page);
+  }
+
+  return true;
+}
+
+static bool vmm_fault_dispatch(u64 fault_addr, u64 err_code, u64 fault_ip) {
+  // Protezione base: null pointer
+  if (fault_addr < PAGE_SIZE) {
+    klog_error("[#PF] Null pointer access (addr=0x%lx, ip=0x%lx)", fault_addr, fault_ip);
+    return false;
+  }
+
+  u64 page_addr = PAGE_ALIGN_DOWN(fault_addr);
+  bool is_present = err_code & VMM_FAULT_PRESENT;
+  bool is_write = err_code & VMM_FAULT_WRITE;
+
+  vmm_space_t *space = vmm_current_space();
+  if (!space) {
+    klog_error("[#PF] Fault prima dell'inizializzazione VMM (addr=0x%lx)", fault_addr);
+    return false;
+  }
+
+  u64 phys, flags;
+
+  // Pagina anonima riservata e mai toccata
+  if (!is_present && vmm_query_reserved(space, page_addr, &flags)) {
+    return vmm_fault_anonymous(space, page_addr, flags, is_write);
+  }
+
+  bool mapped = vmm_query(space, page_addr, &phys, &flags);
+
+  // Scrittura su pagina condivisa copy-on-write
+  if (is_present && is_write && mapped && (flags & VMM_FLAG_COW)) {
+    return vmm_fault_cow_break(space, page_addr, phys, flags);
+  }
+
+  klog_error("[#PF] Fault non gestito addr=0x%lx err=0x%lx ip=0x%lx", fault_addr, err_code, fault_ip);
+  return false;
+}
+
+bool vmm_fault_prefault(vmm_space_t *space, u64 page_addr, u64 flags) {
+  // Le riserve scrivibili ricevono subito il frame: niente COW break dopo
+  return vmm_fault_anonymous(space, page_addr, flags, (flags & VMM_FLAG_WRITE) != 0);
+}
+
+bool vmm_handle_page_fault(u64 fault_addr, u64 err_code, u64 fault_ip) {
+  u64 lat = lat_hist_start(lat_page_fault);
+  bool handled = vmm_fault_dispatch(fault_addr, err_code, fault_ip);
+  lat_hist_stop(lat_page_fault, lat);
+  return handled;
+}
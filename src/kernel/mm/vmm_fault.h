@@ -1,13 +1,38 @@
 #pragma once
-#include <interrupts/interrupts.h>
 #include <lib/types.h>
+#include <mm/vmm.h>
+
+/**
+ * @file mm/vmm_fault.h
+ * @brief Gestione dei page fault lato VMM (demand paging e copy-on-write)
+ *
+ * Il gestore è indipendente dal meccanismo di interrupt: lo stub #PF
+ * dell'architettura estrae indirizzo, codice errore e IP e lo invoca.
+ */
+
+// Bit del codice errore #PF (formato x86_64, usato come formato neutro)
+#define VMM_FAULT_PRESENT (1UL << 0) // 0 = pagina non presente, 1 = violazione protezione
+#define VMM_FAULT_WRITE (1UL << 1)   // Accesso in scrittura
+#define VMM_FAULT_USER (1UL << 2)    // Accesso da user mode
+#define VMM_FAULT_EXEC (1UL << 4)    // Instruction fetch
 
 /**
  * @brief Gestore per eccezioni di tipo Page Fault (#PF)
  *
  * @param fault_addr Indirizzo che ha generato il fault (CR2)
  * @param err_code Codice errore della CPU
- * @param ctx Contesto CPU completo salvato dallo stub
+ * @param fault_ip Indirizzo dell'istruzione che ha generato il fault
  * @return true se gestito, false se fatale
  */
-bool vmm_handle_page_fault(u64 fault_addr, u64 err_code, arch_interrupt_context_t *ctx);
+bool vmm_handle_page_fault(u64 fault_addr, u64 err_code, u64 fault_ip);
+
+/**
+ * @brief Popola una pagina riservata come farebbe il suo primo accesso
+ *
+ * Per VMM_ADVISE_WILLNEED: le riserve scrivibili ricevono un frame
+ * azzerato, le altre la zero page. Soggetta ai limiti dello spazio come un fault.
+ *
+ * @param flags Flag della riserva (vmm_query_reserved)
+ * @return false se la memoria non basta o l'hard limit è superato
+ */
+bool vmm_fault_prefault(vmm_space_t *space, u64 page_addr, u64 flags);
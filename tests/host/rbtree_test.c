@@ -0,0 +1,226 @@
+/**
+ * @file tests/host/rbtree_test.c
+ * @brief Test host delle invarianti di klib/rbtree
+ *
+ * Compilato con il cc dell'host insieme a src/kernel/klib/rbtree/rbtree.c
+ * (vedi scripts/test.sh). Sequenze pseudocasuali di inserimenti,
+ * rimozioni, sostituzioni e costruzioni da array ordinato; dopo ogni
+ * operazione si verifica l'intero albero:
+ * - ordine BST e puntatori parent coerenti
+ * - radice nera, nessun rosso con figli rossi, stessa altezza nera
+ * - valore aumentato (dimensione del sottoalbero) uguale a quello ricalcolato
+ * - numero di nodi uguale a quello atteso
+ */
+
+#include <klib/rbtree/rbtree.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_NODES 512  // Nodi disponibili (chiavi 0..TEST_NODES-1)
+#define TEST_ROUNDS 64  // Sequenze casuali indipendenti
+#define TEST_OPS 4096   // Operazioni per sequenza
+
+typedef struct {
+  rb_node_t rb;
+  u64 key;
+  u64 size; // Valore aumentato: nodi nel sottoalbero
+  bool linked;
+} test_item_t;
+
+static test_item_t pool[2][TEST_NODES]; // Due nodi per chiave: rb_replace_node li alterna
+static test_item_t *slots[TEST_NODES];  // Nodo corrente di ogni chiave
+static u64 rng_state;
+static unsigned long checks;
+
+static u64 rng_next(void) {
+  rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return rng_state >> 33;
+}
+
+#define ITEM(node) RB_ENTRY(node, test_item_t, rb)
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                               \
+    if (!(cond)) {                                                                                                                                   \
+      fprintf(stderr, "rbtree_test: %s:%d: ", __FILE__, __LINE__);                                                                                   \
+      fprintf(stderr, __VA_ARGS__);                                                                                                                  \
+      fprintf(stderr, "\n");                                                                                                                         \
+      exit(1);                                                                                                                                       \
+    }                                                                                                                                                \
+  } while (0)
+
+/* -------------------------------------------------------------------------- */
+/*                                  Callback                                  */
+/* -------------------------------------------------------------------------- */
+
+static inline u64 subtree_size(const rb_node_t *node) {
+  return node ? ITEM(node)->size : 0;
+}
+
+static bool test_augment(rb_node_t *node) {
+  u64 size = 1 + subtree_size(node->left) + subtree_size(node->right);
+  if (ITEM(node)->size == size)
+    return false;
+  ITEM(node)->size = size;
+  return true;
+}
+
+static bool test_less(const rb_node_t *a, const rb_node_t *b) {
+  return ITEM(a)->key < ITEM(b)->key;
+}
+
+static int test_cmp(const void *key, const rb_node_t *node) {
+  u64 k = *(const u64 *)key;
+  u64 nk = ITEM(node)->key;
+  return k < nk ? -1 : (k > nk ? 1 : 0);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Invarianti                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @return Altezza nera del sottoalbero (foglie NULL escluse)
+ */
+static int check_subtree(const rb_node_t *node, const rb_node_t *parent, u64 lo, u64 hi, u64 *count) {
+  if (!node)
+    return 0;
+
+  const test_item_t *item = ITEM(node);
+  CHECK(node->parent == parent, "parent errato sul nodo %llu", (unsigned long long)item->key);
+  CHECK(item->key >= lo && item->key <= hi, "chiave %llu fuori da [%llu, %llu]", (unsigned long long)item->key, (unsigned long long)lo, (unsigned long long)hi);
+  CHECK(node->color == RB_RED || node->color == RB_BLACK, "colore non valido sul nodo %llu", (unsigned long long)item->key);
+  if (node->color == RB_RED) {
+    CHECK(!node->left || node->left->color == RB_BLACK, "rosso con figlio sinistro rosso (%llu)", (unsigned long long)item->key);
+    CHECK(!node->right || node->right->color == RB_BLACK, "rosso con figlio destro rosso (%llu)", (unsigned long long)item->key);
+  }
+
+  int left = check_subtree(node->left, node, lo, item->key ? item->key - 1 : 0, count);
+  int right = check_subtree(node->right, node, item->key + 1, hi, count);
+  CHECK(left == right, "altezza nera diversa sotto %llu (%d/%d)", (unsigned long long)item->key, left, right);
+
+  u64 size = 1 + subtree_size(node->left) + subtree_size(node->right);
+  CHECK(item->size == size, "aumento errato su %llu: %llu invece di %llu", (unsigned long long)item->key, (unsigned long long)item->size, (unsigned long long)size);
+
+  (*count)++;
+  return left + (node->color == RB_BLACK);
+}
+
+static void check_tree(const rb_root_t *root, u64 expected) {
+  u64 count = 0;
+  checks++;
+  CHECK(!root->node || root->node->color == RB_BLACK, "radice rossa");
+  check_subtree(root->node, NULL, 0, ~0ULL, &count);
+  CHECK(count == expected, "%llu nodi invece di %llu", (unsigned long long)count, (unsigned long long)expected);
+
+  // La visita in ordine deve dare le chiavi crescenti
+  u64 seen = 0, last = 0;
+  for (rb_node_t *it = rb_first(root); it; it = rb_next(it), seen++) {
+    CHECK(seen == 0 || ITEM(it)->key > last, "rb_next fuori ordine dopo %llu", (unsigned long long)last);
+    last = ITEM(it)->key;
+  }
+  CHECK(seen == expected, "rb_next visita %llu nodi invece di %llu", (unsigned long long)seen, (unsigned long long)expected);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Operazioni                                 */
+/* -------------------------------------------------------------------------- */
+
+static void op_insert(rb_root_t *root, test_item_t *item) {
+  item->size = 1;
+  item->linked = true;
+  rb_add(root, &item->rb, test_less, test_augment);
+}
+
+static void op_erase(rb_root_t *root, test_item_t *item) {
+  rb_erase(root, &item->rb, test_augment);
+  item->linked = false;
+}
+
+/*
+ * Il sostituto prende posto e valore aumentato del vecchio nodo, che resta
+ * fuori dall'albero: la slot della chiave passa all'altro nodo del pool.
+ */
+static void op_replace(rb_root_t *root, u64 key) {
+  test_item_t *old_item = slots[key];
+  test_item_t *new_item = old_item == &pool[0][key] ? &pool[1][key] : &pool[0][key];
+
+  new_item->key = key;
+  new_item->size = old_item->size;
+  rb_replace_node(root, &old_item->rb, &new_item->rb);
+  new_item->linked = true;
+  old_item->linked = false;
+  slots[key] = new_item;
+}
+
+static u64 op_build(rb_root_t *root) {
+  static rb_node_t *sorted[TEST_NODES];
+  size_t count = 0;
+  u64 step = 1 + rng_next() % 4;
+
+  for (u64 key = 0; key < TEST_NODES; key += step) {
+    slots[key]->size = 1;
+    slots[key]->linked = true;
+    sorted[count++] = &slots[key]->rb;
+  }
+  rb_build_from_sorted(root, sorted, count, test_augment);
+  return count;
+}
+
+static void run_round(u64 seed) {
+  rb_root_t root = RB_ROOT_INIT;
+  u64 linked = 0;
+
+  rng_state = seed;
+  for (u64 key = 0; key < TEST_NODES; key++) {
+    pool[0][key].key = key;
+    pool[0][key].linked = false;
+    pool[1][key].linked = false;
+    slots[key] = &pool[0][key];
+  }
+
+  // Metà delle sequenze parte da un albero costruito in O(n)
+  if (seed & 1) {
+    linked = op_build(&root);
+    check_tree(&root, linked);
+  }
+
+  for (u64 op = 0; op < TEST_OPS; op++) {
+    u64 key = rng_next() % TEST_NODES;
+    u64 kind = rng_next() % 8;
+    test_item_t *item = slots[key];
+
+    if (!item->linked) {
+      CHECK(!rb_find(&root, &key, test_cmp), "rb_find trova la chiave assente %llu", (unsigned long long)key);
+      op_insert(&root, item);
+      linked++;
+    } else if (kind < 4) {
+      op_erase(&root, item);
+      linked--;
+    } else if (kind < 6) {
+      op_replace(&root, key);
+    } else {
+      CHECK(rb_find(&root, &key, test_cmp) == &item->rb, "rb_find non trova la chiave %llu", (unsigned long long)key);
+    }
+    check_tree(&root, linked);
+  }
+
+  // Svuotamento completo in ordine casuale
+  while (linked) {
+    test_item_t *item = slots[rng_next() % TEST_NODES];
+    if (!item->linked)
+      continue;
+    op_erase(&root, item);
+    linked--;
+    check_tree(&root, linked);
+  }
+  CHECK(rb_is_empty(&root), "albero non vuoto dopo lo svuotamento");
+}
+
+int main(void) {
+  for (u64 round = 0; round < TEST_ROUNDS; round++)
+    run_round(0x9e3779b97f4a7c15ULL * (round + 1));
+
+  printf("rbtree_test: %d sequenze, %lu verifiche complete: ok\n", TEST_ROUNDS, checks);
+  return 0;
+}